@@ -256,6 +256,34 @@ class BaseTestCase(unittest.TestCase):
         res = self.run_prog("sqliterepo_c", dir, args)
         return res
 
+    def run_mergerepo(self, repos, args=None, outdir=None):
+        """Run mergerepo_c and return CrResult object with results
+
+        :returns: Result of the mergerepo_c run
+        :rtype: CrResult
+        """
+        res = CrResult()
+        res.prog = "mergerepo_c"
+        res.dir = repos
+
+        if not outdir:
+            outdir = os.path.join(self.tdir, res.prog)
+        else:
+            outdir = os.path.join(self.tdir, outdir)
+        if not os.path.exists(outdir):
+            os.mkdir(outdir)
+        res.outdir = outdir
+
+        res.logfile = os.path.join(self.tdir, "out_%s" % res.prog)
+        res.cmd = "%(prog)s --verbose -o %(outdir)s %(args)s %(repos)s" % {
+            "prog": res.prog,
+            "outdir": res.outdir,
+            "args": args or "",
+            "repos": " ".join("--repo %s" % repo for repo in repos),
+        }
+        res.rc, res.out = self.runcmd(res.cmd, logfile=res.logfile)
+        return res
+
     def compare_repos(self, repo1, repo2):
         """Compare two repos
 
@@ -303,6 +331,16 @@ class BaseTestCase(unittest.TestCase):
         self.assertFalse(res.rc)
         return res
 
+    def assert_run_mergerepo(self, *args, **kwargs):
+        """Run mergerepo_c and assert that it finished with return code 0
+
+        :returns: Result of the mergerepo_c run
+        :rtype: CrResult
+        """
+        res = self.run_mergerepo(*args, **kwargs)
+        self.assertFalse(res.rc)
+        return res
+
     def assert_same_results(self, indir, args=None):
         """Run both createrepo and createrepo_c and assert that results are same
 
@@ -0,0 +1,63 @@
+import os
+import re
+import glob
+import gzip
+import os.path
+
+from .fixtures import PACKAGES
+from .base import BaseTestCase
+
+
+def read_packages(repo, name):
+    """Return the number of packages from the header of the metadata
+    file and the <package> elements of the file"""
+    path, = glob.glob(os.path.join(repo, "repodata", "*%s.xml.gz" % name))
+    with gzip.open(path, "rt") as f:
+        content = f.read()
+    count = int(re.search(r'packages="(\d+)"', content).group(1))
+    return count, re.findall(r"<package .*?</package>", content, re.S)
+
+
+class TestCaseMergerepo(BaseTestCase):
+    """Merge of several repos, the first two repos share a package"""
+
+    def setup(self):
+        self.repos = []
+        for i, pkgs in enumerate([PACKAGES[:1], PACKAGES[:2], PACKAGES[2:]]):
+            pkgdir = self.indir_makedirs("repo%d" % i)
+            for pkg in pkgs:
+                self.copy_pkg(pkg, pkgdir)
+            res = self.assert_run_cr(pkgdir, c=True, outdir="repo%d" % i)
+            self.repos.append(res.outdir)
+
+    def test_01_mergerepo_low_memory(self):
+        """--low-memory writes the same packages as the normal merge"""
+        normal = self.assert_run_mergerepo(self.repos, outdir="normal")
+        low = self.assert_run_mergerepo(self.repos, args="--low-memory",
+                                        outdir="low_memory")
+
+        for name in ("primary", "filelists", "other"):
+            count, pkgs = read_packages(normal.outdir, name)
+            low_count, low_pkgs = read_packages(low.outdir, name)
+            self.assertEqual(count, 3)
+            self.assertEqual(count, len(pkgs))
+            self.assertEqual(low_count, len(low_pkgs))
+            # Packages are grouped by their repos with --low-memory,
+            # only their order may differ
+            self.assertEqual(sorted(pkgs), sorted(low_pkgs))
+
+    def test_02_mergerepo_workers(self):
+        """The number of workers doesn't change the merged repo"""
+        single = self.assert_run_mergerepo(self.repos, args="--workers 1",
+                                           outdir="workers_1")
+        multi = self.assert_run_mergerepo(self.repos, args="--workers 3",
+                                          outdir="workers_3")
+
+        for name in ("primary", "filelists", "other"):
+            count, pkgs = read_packages(single.outdir, name)
+            multi_count, multi_pkgs = read_packages(multi.outdir, name)
+            self.assertEqual(count, 3)
+            self.assertEqual(count, multi_count)
+            # The repos are merged in the same order, so even the order
+            # of the packages is the same
+            self.assertEqual(pkgs, multi_pkgs)
@@ -2,7 +2,7 @@
 
 _cr_compress_type()
 {
-    COMPREPLY=( $( compgen -W "bz2 gz xz" -- "$2" ) )
+    COMPREPLY=( $( compgen -W "bz2 gz xz zstd" -- "$2" ) )
 }
 
 _cr_checksum_type()
@@ -65,9 +65,10 @@ _cr_createrepo()
             --skip-stat --pkglist --includepkg --outputdir
             --skip-symlinks --changelog-limit --unique-md-filenames
             --simple-md-filenames --retain-old-md --distro --content --repo
-            --revision --read-pkgs-list --workers --xz
+            --revision --read-pkgs-list --workers --checksum-read-size --xz
             --compress-type --keep-all-metadata --compatibility
-            --retain-old-md-by-age --cachedir --local-sqlite
+            --retain-old-md-by-age --cachedir --cache-gc --local-sqlite
+            --sharded-sqlite
             --cut-dirs --location-prefix
             --deltas --oldpackagedirs
             --num-deltas --max-delta-rpm-size --recycle-pkglist' -- "$2" ) )
@@ -176,6 +177,30 @@ _cr_sqliterepo()
 } &&
 complete -F _cr_sqliterepo -o filenames sqliterepo_c
 
+_cr_zckdict()
+{
+    COMPREPLY=()
+
+    case $3 in
+        -h|--help|-V|--version|--dict-size|--max-samples-size)
+            return 0
+            ;;
+        -o|--outputdir)
+            COMPREPLY=( $( compgen -d -- "$2" ) )
+            return 0
+            ;;
+    esac
+
+    if [[ $2 == -* ]] ; then
+        COMPREPLY=( $( compgen -W '--help --version --quiet --verbose
+            --outputdir --old-repo --dict-size --max-samples-size
+            --dry-run ' -- "$2" ) )
+    else
+        COMPREPLY=( $( compgen -d -- "$2" ) )
+    fi
+} &&
+complete -F _cr_zckdict -o filenames zckdict_c
+
 # Local variables:
 # mode: shell-script
 # sh-basic-offset: 4
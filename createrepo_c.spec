@@ -27,6 +27,12 @@
 %bcond_without zchunk
 %endif
 
+%if 0%{?rhel} && 0%{?rhel} <= 7
+%bcond_with zstd
+%else
+%bcond_without zstd
+%endif
+
 %if 0%{?rhel} || 0%{?fedora} < 29
 %bcond_with libmodulemd
 %else
@@ -59,6 +65,9 @@ BuildRequires:  zlib-devel
 BuildRequires:  pkgconfig(zck) >= 0.9.11
 BuildRequires:  zchunk
 %endif
+%if %{with zstd}
+BuildRequires:  pkgconfig(libzstd) >= 1.4.0
+%endif
 %if %{with libmodulemd}
 BuildRequires:  pkgconfig(modulemd-2.0) >= %{libmodulemd_version}
 BuildRequires:  libmodulemd
@@ -145,7 +154,7 @@ mkdir build-py3
 # Build createrepo_c with Python 2
 %if %{with python2}
 pushd build-py2
-  %cmake .. -DPYTHON_DESIRED:FILEPATH=%{__python2} %{!?with_zchunk:-DWITH_ZCHUNK=OFF} %{!?with_libmodulemd:-DWITH_LIBMODULEMD=OFF}
+  %cmake .. -DPYTHON_DESIRED:FILEPATH=%{__python2} %{!?with_zchunk:-DWITH_ZCHUNK=OFF} %{!?with_zstd:-DWITH_ZSTD=OFF} %{!?with_libmodulemd:-DWITH_LIBMODULEMD=OFF}
   make %{?_smp_mflags} RPM_OPT_FLAGS="%{optflags}"
   %if %{without python3}
   # Build C documentation
@@ -157,7 +166,7 @@ popd
 # Build createrepo_c with Pyhon 3
 %if %{with python3}
 pushd build-py3
-  %cmake .. -DPYTHON_DESIRED:FILEPATH=%{__python3} %{!?with_zchunk:-DWITH_ZCHUNK=OFF} %{!?with_libmodulemd:-DWITH_LIBMODULEMD=OFF}
+  %cmake .. -DPYTHON_DESIRED:FILEPATH=%{__python3} %{!?with_zchunk:-DWITH_ZCHUNK=OFF} %{!?with_zstd:-DWITH_ZSTD=OFF} %{!?with_libmodulemd:-DWITH_LIBMODULEMD=OFF}
   make %{?_smp_mflags} RPM_OPT_FLAGS="%{optflags}"
   # Build C documentation
   make doc-c
@@ -222,11 +231,13 @@ ln -sr %{buildroot}%{_bindir}/modifyrepo_c %{buildroot}%{_bindir}/modifyrepo
 %{_mandir}/man8/mergerepo_c.8*
 %{_mandir}/man8/modifyrepo_c.8*
 %{_mandir}/man8/sqliterepo_c.8*
+%{_mandir}/man8/zckdict_c.8*
 %{bash_completion}
 %{_bindir}/createrepo_c
 %{_bindir}/mergerepo_c
 %{_bindir}/modifyrepo_c
 %{_bindir}/sqliterepo_c
+%{_bindir}/zckdict_c
 
 %if 0%{?fedora} || 0%{?rhel} > 7
 %{_bindir}/createrepo
@@ -23,13 +23,20 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <openssl/evp.h>
 #include "error.h"
 #include "checksum.h"
 
 #define ERR_DOMAIN              CREATEREPO_C_ERROR
 #define MAX_CHECKSUM_NAME_LEN   7
-#define BUFFER_SIZE             2048
+#define MIN_READ_SIZE           4096
+
+static gsize read_size = CR_CHECKSUM_DEFAULT_READ_SIZE;
+
+G_LOCK_DEFINE_STATIC(stats);
+static cr_ChecksumStats stats = { 0, 0, 0 };
 
 struct _cr_ChecksumCtx {
     EVP_MD_CTX      *ctx;
@@ -106,76 +113,135 @@ cr_checksum_name_str(cr_ChecksumType type)
     }
 }
 
+void
+cr_checksum_set_read_size(gsize size)
+{
+    if (size == 0)
+        size = CR_CHECKSUM_DEFAULT_READ_SIZE;
+
+    // Keep the reads aligned to whole pages
+    size = ((size + MIN_READ_SIZE - 1) / MIN_READ_SIZE) * MIN_READ_SIZE;
+    read_size = size;
+}
+
+gsize
+cr_checksum_get_read_size(void)
+{
+    return read_size;
+}
+
+void
+cr_checksum_get_stats(cr_ChecksumStats *out)
+{
+    assert(out);
+
+    G_LOCK(stats);
+    *out = stats;
+    G_UNLOCK(stats);
+}
+
+void
+cr_checksum_reset_stats(void)
+{
+    G_LOCK(stats);
+    stats.files = 0;
+    stats.bytes = 0;
+    stats.usecs = 0;
+    G_UNLOCK(stats);
+}
+
+int
+cr_checksum_update_fd(cr_ChecksumCtx *ctx,
+                      int fd,
+                      const char *filename,
+                      GError **err)
+{
+    gint64 total = 0;
+    gint64 start = g_get_monotonic_time();
+    gsize size = cr_checksum_get_read_size();
+    void *buf;
+    ssize_t readed;
+
+    assert(ctx);
+    assert(!err || *err == NULL);
+
+    // The file is read (not mapped) because a package could be
+    // truncated by another process while it is checksummed, which
+    // would kill us by SIGBUS with mmap()
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    posix_fadvise(fd, offset < 0 ? 0 : offset, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    // Large page aligned reads
+    if (posix_memalign(&buf, MIN_READ_SIZE, size) != 0) {
+        g_set_error(err, ERR_DOMAIN, CRE_MEMORY,
+                    "Cannot allocate a read buffer of %"G_GSIZE_FORMAT
+                    " bytes", size);
+        return CRE_MEMORY;
+    }
+
+    while ((readed = read(fd, buf, size)) != 0) {
+        if (readed < 0) {
+            if (errno == EINTR)
+                continue;
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "Error while reading a file %s: %s",
+                        filename, g_strerror(errno));
+            free(buf);
+            return CRE_IO;
+        }
+        int rc = cr_checksum_update(ctx, buf, readed, err);
+        if (rc != CRE_OK) {
+            free(buf);
+            return rc;
+        }
+        total += readed;
+    }
+
+    free(buf);
+
+    G_LOCK(stats);
+    stats.files++;
+    stats.bytes += total;
+    stats.usecs += g_get_monotonic_time() - start;
+    G_UNLOCK(stats);
+
+    return CRE_OK;
+}
+
 char *
 cr_checksum_file(const char *filename,
                  cr_ChecksumType type,
                  GError **err)
 {
-    FILE *f;
-    int rc;
-    unsigned int len;
-    ssize_t readed;
-    char buf[BUFFER_SIZE];
-    unsigned char raw_checksum[EVP_MAX_MD_SIZE];
-    char *checksum;
-    EVP_MD_CTX *ctx;
-    const EVP_MD *ctx_type;
+    int fd;
+    cr_ChecksumCtx *ctx;
 
-    switch (type) {
-        //case CR_CHECKSUM_MD2:    ctx_type = EVP_md2();    break;
-        case CR_CHECKSUM_MD5:    ctx_type = EVP_md5();    break;
-        case CR_CHECKSUM_SHA:    ctx_type = EVP_sha1();   break;
-        case CR_CHECKSUM_SHA1:   ctx_type = EVP_sha1();   break;
-        case CR_CHECKSUM_SHA224: ctx_type = EVP_sha224(); break;
-        case CR_CHECKSUM_SHA256: ctx_type = EVP_sha256(); break;
-        case CR_CHECKSUM_SHA384: ctx_type = EVP_sha384(); break;
-        case CR_CHECKSUM_SHA512: ctx_type = EVP_sha512(); break;
-        case CR_CHECKSUM_UNKNOWN:
-        default:
-            g_set_error(err, ERR_DOMAIN, CRE_UNKNOWNCHECKSUMTYPE,
-                        "Unknown checksum type");
-            return NULL;
-    }
+    assert(filename);
+    assert(!err || *err == NULL);
 
-    f = fopen(filename, "rb");
-    if (!f) {
-        g_set_error(err, ERR_DOMAIN, CRE_IO,
-                    "Cannot open a file: %s", g_strerror(errno));
+    ctx = cr_checksum_new(type, err);
+    if (!ctx)
         return NULL;
-    }
 
-    ctx = EVP_MD_CTX_create();
-    rc = EVP_DigestInit_ex(ctx, ctx_type, NULL);
-    if (!rc) {
-        g_set_error(err, ERR_DOMAIN, CRE_OPENSSL,
-                    "EVP_DigestInit_ex() failed");
-        EVP_MD_CTX_destroy(ctx);
-        fclose(f);
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot open a file: %s", g_strerror(errno));
+        g_free(cr_checksum_final(ctx, NULL));
         return NULL;
     }
 
-    while ((readed = fread(buf, 1, BUFFER_SIZE, f)) == BUFFER_SIZE)
-        EVP_DigestUpdate(ctx, buf, readed);
-
-    if (feof(f)) {
-        EVP_DigestUpdate(ctx, buf, readed);
-    } else {
-        g_set_error(err, ERR_DOMAIN, CRE_IO,
-                    "Error while reading a file: %s", g_strerror(errno));
-        EVP_MD_CTX_destroy(ctx);
-        fclose(f);
+    int rc = cr_checksum_update_fd(ctx, fd, filename, err);
+    close(fd);
+    if (rc != CRE_OK) {
+        g_free(cr_checksum_final(ctx, NULL));
         return NULL;
     }
 
-    fclose(f);
-
-    EVP_DigestFinal_ex(ctx, raw_checksum, &len);
-    EVP_MD_CTX_destroy(ctx);
-    checksum = g_malloc0(sizeof(char) * (len * 2 + 1));
-    for (size_t x = 0; x < len; x++)
-        sprintf(checksum+(x*2), "%02x", raw_checksum[x]);
-
-    return checksum;
+    return cr_checksum_final(ctx, err);
 }
 
 cr_ChecksumCtx *
@@ -53,6 +53,20 @@ typedef enum {
     CR_CHECKSUM_SENTINEL,   /*!< sentinel of the list */
 } cr_ChecksumType;
 
+/** Default size of a single read during file checksum calculation.
+ */
+#define CR_CHECKSUM_DEFAULT_READ_SIZE   (1024*1024)
+
+/** Throughput counters of the file checksum calculation.
+ * The counters are global (shared by all threads).
+ */
+typedef struct {
+    gint64 files;   /*!< Number of checksummed files */
+    gint64 bytes;   /*!< Number of checksummed bytes */
+    gint64 usecs;   /*!< Time spent by reading and hashing in microseconds
+                         (summed over all threads) */
+} cr_ChecksumStats;
+
 /** Return checksum name.
  * @param type          checksum type
  * @return              constant null terminated string with checksum name
@@ -77,6 +91,42 @@ char *cr_checksum_file(const char *filename,
                        cr_ChecksumType type,
                        GError **err);
 
+/** Feed the rest of an opened file (from the current offset to the end)
+ * into the checksum context. The file is read by large page aligned
+ * reads. Counters returned by cr_checksum_get_stats() are updated.
+ * @param ctx           checksum context
+ * @param fd            opened file descriptor
+ * @param filename      filename (used in error messages)
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+int cr_checksum_update_fd(cr_ChecksumCtx *ctx,
+                          int fd,
+                          const char *filename,
+                          GError **err);
+
+/** Set size of a single read used during file checksum calculation.
+ * The size is rounded up to the whole pages. This function is not
+ * thread safe, call it before checksums are computed.
+ * @param size          read size in bytes (0 means the default
+ *                      CR_CHECKSUM_DEFAULT_READ_SIZE)
+ */
+void cr_checksum_set_read_size(gsize size);
+
+/** Get size of a single read used during file checksum calculation.
+ * @return              read size in bytes
+ */
+gsize cr_checksum_get_read_size(void);
+
+/** Get throughput counters of the file checksum calculation.
+ * @param stats         structure to be filled
+ */
+void cr_checksum_get_stats(cr_ChecksumStats *stats);
+
+/** Reset throughput counters of the file checksum calculation.
+ */
+void cr_checksum_reset_stats(void);
+
 /** Create new checksum context.
  * @param type      Checksum algorithm of the new checksum context.
  * @param err       GError **
@@ -0,0 +1,490 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <assert.h>
+#include <string.h>
+#include <sqlite3.h>
+#include "error.h"
+#include "checksum_cache.h"
+
+#define ERR_DOMAIN              CREATEREPO_C_ERROR
+#define BUSY_TIMEOUT            10000   // ms
+
+struct _cr_ChecksumCache {
+    sqlite3 *db;                // Database with the records
+    GHashTable *records;        // key -> checksum (all records)
+    GHashTable *used;           // Keys used since the cache was opened
+                                // (point to keys owned by records)
+    GHashTable *by_checksum;    // checksum -> GPtrArray of keys owned by
+                                // records (built by the first
+                                // cr_checksum_cache_touch_checksum())
+    GPtrArray *pending_keys;    // Keys not yet written (or touched) in db
+    GPtrArray *pending_sums;    // Their checksums (NULL - only touch
+                                // last_used of an existing record)
+    gint64 stamp;               // Time of opening (in microseconds)
+                                // - value of last_used
+    GMutex mutex;
+};
+
+static int
+exec_sql(sqlite3 *db, const char *sql, GError **err)
+{
+    if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+        g_set_error(err, ERR_DOMAIN, CRE_DB,
+                    "Checksum cache: \"%s\" failed: %s",
+                    sql, sqlite3_errmsg(db));
+        return CRE_DB;
+    }
+    return CRE_OK;
+}
+
+static int
+load_records(cr_ChecksumCache *cache, GError **err)
+{
+    int rc;
+    sqlite3_stmt *stmt = NULL;
+
+    rc = sqlite3_prepare_v2(cache->db, "SELECT key, checksum FROM checksums",
+                            -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        g_set_error(err, ERR_DOMAIN, CRE_DB,
+                    "Cannot load checksum cache: %s",
+                    sqlite3_errmsg(cache->db));
+        return CRE_DB;
+    }
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *key = (const char *) sqlite3_column_text(stmt, 0);
+        const char *checksum = (const char *) sqlite3_column_text(stmt, 1);
+        if (!key || !checksum)
+            continue;
+        g_hash_table_insert(cache->records, g_strdup(key), g_strdup(checksum));
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE) {
+        g_set_error(err, ERR_DOMAIN, CRE_DB,
+                    "Cannot load checksum cache: %s",
+                    sqlite3_errmsg(cache->db));
+        return CRE_DB;
+    }
+
+    return CRE_OK;
+}
+
+cr_ChecksumCache *
+cr_checksum_cache_open(const char *path, GError **err)
+{
+    cr_ChecksumCache *cache;
+
+    assert(path);
+    assert(!err || *err == NULL);
+
+    cache = g_new0(cr_ChecksumCache, 1);
+    g_mutex_init(&(cache->mutex));
+    cache->records = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           g_free, g_free);
+    cache->used = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->pending_keys = g_ptr_array_new_with_free_func(g_free);
+    cache->pending_sums = g_ptr_array_new_with_free_func(g_free);
+    cache->stamp = g_get_real_time();
+
+    if (sqlite3_open(path, &(cache->db)) != SQLITE_OK) {
+        g_set_error(err, ERR_DOMAIN, CRE_DB,
+                    "Cannot open checksum cache %s: %s",
+                    path, sqlite3_errmsg(cache->db));
+        goto error;
+    }
+
+    // The cache could be shared by several createrepo_c instances
+    sqlite3_busy_timeout(cache->db, BUSY_TIMEOUT);
+    sqlite3_exec(cache->db, "PRAGMA journal_mode = WAL", NULL, NULL, NULL);
+    sqlite3_exec(cache->db, "PRAGMA synchronous = NORMAL", NULL, NULL, NULL);
+
+    if (exec_sql(cache->db,
+                 "CREATE TABLE IF NOT EXISTS checksums ("
+                 "  key TEXT PRIMARY KEY,"
+                 "  checksum TEXT NOT NULL,"
+                 "  last_used INTEGER NOT NULL)", err) != CRE_OK)
+        goto error;
+
+    if (load_records(cache, err) != CRE_OK)
+        goto error;
+
+    return cache;
+
+error:
+    sqlite3_close(cache->db);
+    cache->db = NULL;
+    cr_checksum_cache_close(cache, NULL);
+    return NULL;
+}
+
+/** Write the pending records. Mutex must be locked.
+ */
+static int
+flush_pending(cr_ChecksumCache *cache, GError **err)
+{
+    int rc = CRE_OK;
+    sqlite3_stmt *insert = NULL, *touch = NULL;
+
+    if (cache->pending_keys->len == 0)
+        return CRE_OK;
+
+    if (exec_sql(cache->db, "BEGIN", err) != CRE_OK)
+        return CRE_DB;
+
+    if (sqlite3_prepare_v2(cache->db,
+            "INSERT OR REPLACE INTO checksums (key, checksum, last_used) "
+            "VALUES (?, ?, ?)", -1, &insert, NULL) != SQLITE_OK
+        || sqlite3_prepare_v2(cache->db,
+            "UPDATE checksums SET last_used = ? WHERE key = ?",
+            -1, &touch, NULL) != SQLITE_OK)
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_DB,
+                    "Cannot prepare checksum cache statements: %s",
+                    sqlite3_errmsg(cache->db));
+        rc = CRE_DB;
+        goto exit;
+    }
+
+    for (guint x = 0; x < cache->pending_keys->len; x++) {
+        const char *key = g_ptr_array_index(cache->pending_keys, x);
+        const char *checksum = g_ptr_array_index(cache->pending_sums, x);
+        sqlite3_stmt *stmt;
+
+        if (checksum) {
+            stmt = insert;
+            sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, checksum, -1, SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, 3, cache->stamp);
+        } else {
+            stmt = touch;
+            sqlite3_bind_int64(stmt, 1, cache->stamp);
+            sqlite3_bind_text(stmt, 2, key, -1, SQLITE_STATIC);
+        }
+
+        int step_rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (step_rc != SQLITE_DONE) {
+            g_set_error(err, ERR_DOMAIN, CRE_DB,
+                        "Cannot write into checksum cache: %s",
+                        sqlite3_errmsg(cache->db));
+            rc = CRE_DB;
+            goto exit;
+        }
+    }
+
+exit:
+    sqlite3_finalize(insert);
+    sqlite3_finalize(touch);
+
+    if (rc == CRE_OK) {
+        rc = exec_sql(cache->db, "COMMIT", err);
+    } else {
+        sqlite3_exec(cache->db, "ROLLBACK", NULL, NULL, NULL);
+    }
+
+    // Records which couldn't be written stay only in memory
+    g_ptr_array_set_size(cache->pending_keys, 0);
+    g_ptr_array_set_size(cache->pending_sums, 0);
+
+    return rc;
+}
+
+static void
+add_pending(cr_ChecksumCache *cache, const char *key, const char *checksum)
+{
+    g_ptr_array_add(cache->pending_keys, g_strdup(key));
+    g_ptr_array_add(cache->pending_sums, g_strdup(checksum));
+}
+
+/** Mark the record as used. Mutex must be locked.
+ */
+static void
+mark_used(cr_ChecksumCache *cache, const char *key)
+{
+    gpointer orig_key;
+
+    if (!g_hash_table_lookup_extended(cache->records, key, &orig_key, NULL))
+        return;
+    g_hash_table_add(cache->used, orig_key);
+}
+
+/** Mark the existing record as used and update its last_used in the db.
+ * Mutex must be locked.
+ */
+static void
+touch_record(cr_ChecksumCache *cache, const char *key)
+{
+    if (!g_hash_table_contains(cache->used, key)) {
+        mark_used(cache, key);
+        add_pending(cache, key, NULL);
+    }
+}
+
+/** Add the key into the checksum index (if it exists). Mutex must be
+ * locked.
+ */
+static void
+index_record(cr_ChecksumCache *cache, gpointer key, const char *checksum)
+{
+    GPtrArray *keys;
+
+    if (!cache->by_checksum)
+        return;
+
+    keys = g_hash_table_lookup(cache->by_checksum, checksum);
+    if (!keys) {
+        keys = g_ptr_array_new();
+        g_hash_table_insert(cache->by_checksum, g_strdup(checksum), keys);
+    }
+    g_ptr_array_add(keys, key);
+}
+
+char *
+cr_checksum_cache_lookup(cr_ChecksumCache *cache, const char *key)
+{
+    char *checksum = NULL;
+
+    assert(cache);
+    assert(key);
+
+    g_mutex_lock(&(cache->mutex));
+    const char *value = g_hash_table_lookup(cache->records, key);
+    if (value) {
+        checksum = g_strdup(value);
+        touch_record(cache, key);
+    }
+    g_mutex_unlock(&(cache->mutex));
+
+    return checksum;
+}
+
+int
+cr_checksum_cache_add(cr_ChecksumCache *cache,
+                      const char *key,
+                      const char *checksum,
+                      GError **err)
+{
+    int rc = CRE_OK;
+
+    assert(cache);
+    assert(key);
+    assert(checksum);
+    assert(!err || *err == NULL);
+
+    g_mutex_lock(&(cache->mutex));
+
+    const char *value = g_hash_table_lookup(cache->records, key);
+    if (!value || strcmp(value, checksum)) {
+        gpointer orig_key;
+        g_hash_table_insert(cache->records, g_strdup(key), g_strdup(checksum));
+        g_hash_table_lookup_extended(cache->records, key, &orig_key, NULL);
+        index_record(cache, orig_key, checksum);
+        add_pending(cache, key, checksum);
+    }
+    mark_used(cache, key);
+
+    if (cache->pending_keys->len >= CR_CHECKSUM_CACHE_BATCH_SIZE)
+        rc = flush_pending(cache, err);
+
+    g_mutex_unlock(&(cache->mutex));
+
+    return rc;
+}
+
+int
+cr_checksum_cache_flush(cr_ChecksumCache *cache, GError **err)
+{
+    int rc;
+
+    assert(cache);
+    assert(!err || *err == NULL);
+
+    g_mutex_lock(&(cache->mutex));
+    rc = flush_pending(cache, err);
+    g_mutex_unlock(&(cache->mutex));
+
+    return rc;
+}
+
+guint
+cr_checksum_cache_touch_checksum(cr_ChecksumCache *cache,
+                                 const char *checksum)
+{
+    guint touched = 0;
+    GPtrArray *keys;
+
+    assert(cache);
+    assert(checksum);
+
+    g_mutex_lock(&(cache->mutex));
+
+    if (!cache->by_checksum) {
+        GHashTableIter iter;
+        gpointer key, value;
+
+        cache->by_checksum = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                    g_free, (GDestroyNotify) g_ptr_array_unref);
+        g_hash_table_iter_init(&iter, cache->records);
+        while (g_hash_table_iter_next(&iter, &key, &value))
+            index_record(cache, key, value);
+    }
+
+    keys = g_hash_table_lookup(cache->by_checksum, checksum);
+    for (guint x = 0; keys && x < keys->len; x++) {
+        const char *key = g_ptr_array_index(keys, x);
+        // The checksum of the record could be changed since it was indexed
+        if (g_strcmp0(g_hash_table_lookup(cache->records, key), checksum))
+            continue;
+        touch_record(cache, key);
+        touched++;
+    }
+
+    g_mutex_unlock(&(cache->mutex));
+
+    return touched;
+}
+
+guint
+cr_checksum_cache_touch_prefix(cr_ChecksumCache *cache, const char *prefix)
+{
+    guint touched = 0;
+    GHashTableIter iter;
+    gpointer key;
+
+    assert(cache);
+    assert(prefix);
+
+    g_mutex_lock(&(cache->mutex));
+
+    g_hash_table_iter_init(&iter, cache->records);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        if (!g_str_has_prefix(key, prefix))
+            continue;
+        touch_record(cache, key);
+        touched++;
+    }
+
+    g_mutex_unlock(&(cache->mutex));
+
+    return touched;
+}
+
+static gboolean
+unused_record(gpointer key, G_GNUC_UNUSED gpointer value, gpointer used)
+{
+    return !g_hash_table_contains((GHashTable *) used, key);
+}
+
+gint64
+cr_checksum_cache_gc(cr_ChecksumCache *cache, GError **err)
+{
+    gint64 removed = -1;
+    sqlite3_stmt *stmt = NULL;
+
+    assert(cache);
+    assert(!err || *err == NULL);
+
+    g_mutex_lock(&(cache->mutex));
+
+    if (flush_pending(cache, err) != CRE_OK)
+        goto exit;
+
+    if (sqlite3_prepare_v2(cache->db,
+            "DELETE FROM checksums WHERE last_used < ?",
+            -1, &stmt, NULL) != SQLITE_OK)
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_DB,
+                    "Cannot prepare checksum cache cleanup: %s",
+                    sqlite3_errmsg(cache->db));
+        goto exit;
+    }
+
+    sqlite3_bind_int64(stmt, 1, cache->stamp);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        g_set_error(err, ERR_DOMAIN, CRE_DB,
+                    "Cannot clean up checksum cache: %s",
+                    sqlite3_errmsg(cache->db));
+        goto exit;
+    }
+    removed = sqlite3_changes(cache->db);
+
+    g_hash_table_foreach_remove(cache->records, unused_record, cache->used);
+
+    // The index points to the removed keys, it is rebuilt when needed
+    if (cache->by_checksum) {
+        g_hash_table_destroy(cache->by_checksum);
+        cache->by_checksum = NULL;
+    }
+
+    // Give the space back
+    if (exec_sql(cache->db, "VACUUM", err) != CRE_OK)
+        removed = -1;
+
+exit:
+    sqlite3_finalize(stmt);
+    g_mutex_unlock(&(cache->mutex));
+
+    return removed;
+}
+
+guint
+cr_checksum_cache_size(cr_ChecksumCache *cache)
+{
+    guint size;
+
+    assert(cache);
+
+    g_mutex_lock(&(cache->mutex));
+    size = g_hash_table_size(cache->records);
+    g_mutex_unlock(&(cache->mutex));
+
+    return size;
+}
+
+int
+cr_checksum_cache_close(cr_ChecksumCache *cache, GError **err)
+{
+    int rc = CRE_OK;
+
+    assert(!err || *err == NULL);
+
+    if (!cache)
+        return CRE_OK;
+
+    if (cache->db) {
+        rc = flush_pending(cache, err);
+        sqlite3_close(cache->db);
+    }
+
+    if (cache->by_checksum)
+        g_hash_table_destroy(cache->by_checksum);
+    g_hash_table_destroy(cache->used);
+    g_hash_table_destroy(cache->records);
+    g_ptr_array_free(cache->pending_keys, TRUE);
+    g_ptr_array_free(cache->pending_sums, TRUE);
+    g_mutex_clear(&(cache->mutex));
+    g_free(cache);
+
+    return rc;
+}
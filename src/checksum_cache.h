@@ -0,0 +1,133 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef __C_CREATEREPOLIB_CHECKSUM_CACHE_H__
+#define __C_CREATEREPOLIB_CHECKSUM_CACHE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <glib.h>
+
+/** \defgroup   checksum_cache  Persistent cache of package checksums.
+ *  \addtogroup checksum_cache
+ *  @{
+ */
+
+/** Filename of the cache database inside of a cache directory.
+ */
+#define CR_CHECKSUM_CACHE_FILENAME      "checksums.sqlite"
+
+/** Number of new records written to the database in a single transaction.
+ */
+#define CR_CHECKSUM_CACHE_BATCH_SIZE    1000
+
+/** Prefix of keys of drpm checksums.
+ */
+#define CR_CHECKSUM_CACHE_DRPM_PREFIX   "drpm:"
+
+/** Persistent cache of package checksums.
+ * The whole cache is loaded into memory when opened, so lookups
+ * never touch the disk. New records (and records which were used)
+ * are written back in batches. All functions are thread safe.
+ */
+typedef struct _cr_ChecksumCache cr_ChecksumCache;
+
+/** Open (or create) the checksum cache database.
+ * @param path          Path to the database file
+ * @param err           GError **
+ * @return              cr_ChecksumCache or NULL on error
+ */
+cr_ChecksumCache *cr_checksum_cache_open(const char *path, GError **err);
+
+/** Get the cached checksum.
+ * @param cache         Checksum cache
+ * @param key           Key of the record
+ * @return              Malloced checksum or NULL if there is no record
+ */
+char *cr_checksum_cache_lookup(cr_ChecksumCache *cache, const char *key);
+
+/** Add a checksum into the cache. The record is written into the
+ * database with the next batch.
+ * @param cache         Checksum cache
+ * @param key           Key of the record
+ * @param checksum      Checksum
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+int cr_checksum_cache_add(cr_ChecksumCache *cache,
+                          const char *key,
+                          const char *checksum,
+                          GError **err);
+
+/** Write all pending records into the database.
+ * @param cache         Checksum cache
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+int cr_checksum_cache_flush(cr_ChecksumCache *cache, GError **err);
+
+/** Mark all records with the checksum as used, e.g. of a package whose
+ * metadata were reused from the old repodata (its header wasn't read,
+ * so its key is unknown).
+ * @param cache         Checksum cache
+ * @param checksum      Checksum
+ * @return              Number of touched records
+ */
+guint cr_checksum_cache_touch_checksum(cr_ChecksumCache *cache,
+                                       const char *checksum);
+
+/** Mark all records whose key starts with the prefix as used,
+ * e.g. the drpm records when no deltas are generated.
+ * @param cache         Checksum cache
+ * @param prefix        Key prefix
+ * @return              Number of touched records
+ */
+guint cr_checksum_cache_touch_prefix(cr_ChecksumCache *cache,
+                                     const char *prefix);
+
+/** Remove all records which were not used (looked up, added or touched)
+ * since the cache was opened and compact the database file.
+ * @param cache         Checksum cache
+ * @param err           GError **
+ * @return              Number of removed records or -1 on error
+ */
+gint64 cr_checksum_cache_gc(cr_ChecksumCache *cache, GError **err);
+
+/** Number of records in the cache.
+ * @param cache         Checksum cache
+ * @return              Number of records
+ */
+guint cr_checksum_cache_size(cr_ChecksumCache *cache);
+
+/** Write all pending records and close the cache.
+ * @param cache         Checksum cache
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+int cr_checksum_cache_close(cr_ChecksumCache *cache, GError **err);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __C_CREATEREPOLIB_CHECKSUM_CACHE_H__ */
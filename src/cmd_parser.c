@@ -36,6 +36,7 @@
 #define DEFAULT_UNIQUE_MD_FILENAMES     TRUE
 #define DEFAULT_IGNORE_LOCK             FALSE
 #define DEFAULT_LOCAL_SQLITE            FALSE
+#define DEFAULT_SHARDED_SQLITE          FALSE
 
 struct CmdOptions _cmd_options = {
         .changelog_limit            = DEFAULT_CHANGELOG_LIMIT,
@@ -50,6 +51,7 @@ struct CmdOptions _cmd_options = {
         .md_max_age                 = G_GINT64_CONSTANT(0),
         .cachedir                   = NULL,
         .local_sqlite               = DEFAULT_LOCAL_SQLITE,
+        .sharded_sqlite             = DEFAULT_SHARDED_SQLITE,
         .cut_dirs                   = 0,
         .location_prefix            = NULL,
         .repomd_checksum            = NULL,
@@ -60,6 +62,7 @@ struct CmdOptions _cmd_options = {
         .max_delta_rpm_size         = CR_DEFAULT_MAX_DELTA_RPM_SIZE,
 
         .checksum_cachedir          = NULL,
+        .checksum_read_size         = CR_CHECKSUM_DEFAULT_READ_SIZE,
         .repomd_checksum_type       = CR_CHECKSUM_SHA256,
 
         .zck_compression            = FALSE,
@@ -152,7 +155,11 @@ static GOptionEntry cmd_entries[] =
       "Output the paths to the pkgs actually read useful with --update.",
       "READ_PKGS_LIST" },
     { "workers", 0, 0, G_OPTION_ARG_INT, &(_cmd_options.workers),
-      "Number of workers to spawn to read rpms.", NULL },
+      "Number of workers to spawn to read rpms. The same number of threads "
+      "is used for gzip and zstd compression of the metadata, xz compression "
+      "uses at most 2 threads per file (each needs about 150 MiB of memory).", NULL },
+    { "checksum-read-size", 0, 0, G_OPTION_ARG_INT64, &(_cmd_options.checksum_read_size),
+      "Size of a single read (in bytes) used while checksumming packages.", "BYTES" },
     { "xz", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.xz_compression),
       "Use xz for repodata compression.", NULL },
     { "compress-type", 0, 0, G_OPTION_ARG_STRING, &(_cmd_options.compress_type),
@@ -177,6 +184,9 @@ static GOptionEntry cmd_entries[] =
       "Available units (m - minutes, h - hours, d - days)", "AGE" },
     { "cachedir", 'c', 0, G_OPTION_ARG_FILENAME, &(_cmd_options.cachedir),
       "Set path to cache dir", "CACHEDIR." },
+    { "cache-gc", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.cache_gc),
+      "Remove checksums of packages which were not found during this run "
+      "from the cache dir and compact the cache (Requires --cachedir).", NULL },
 #ifdef CR_DELTA_RPM_SUPPORT
     { "deltas", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.deltas),
       "Tells createrepo to generate deltarpms and the delta metadata.", NULL },
@@ -195,6 +205,11 @@ static GOptionEntry cmd_entries[] =
       "This option could lead to a higher memory consumption "
       "if TMPDIR is set to /tmp or not set at all, because then the /tmp is "
       "used and /tmp dir is often a ramdisk.", NULL },
+    { "sharded-sqlite", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.sharded_sqlite),
+      "Insert packages into the sqlite DBs by multiple threads (one per "
+      "worker, at most 8 per DB). Every thread writes its own shard which "
+      "are merged into the final DBs at the end. The resulting DBs are "
+      "the same, but the generation needs more disk space.", NULL },
     { "cut-dirs", 0, 0, G_OPTION_ARG_INT, &(_cmd_options.cut_dirs),
       "Ignore NUM of directory components in location_href during repodata "
       "generation", "NUM" },
@@ -279,6 +294,8 @@ check_and_set_compression_type(const char *type_str,
         *type = CR_CW_BZ2_COMPRESSION;
     } else if (!strcmp(compress_str->str, "xz")) {
         *type = CR_CW_XZ_COMPRESSION;
+    } else if (!strcmp(compress_str->str, "zstd")) {
+        *type = CR_CW_ZSTD_COMPRESSION;
     } else {
         g_set_error(err, ERR_DOMAIN, CRE_BADARG,
                     "Unknown/Unsupported compression type \"%s\"", type_str);
@@ -361,6 +378,19 @@ check_arguments(struct CmdOptions *options,
         options->workers = DEFAULT_WORKERS;
     }
 
+    // Check cache gc
+    if (options->cache_gc && !options->cachedir) {
+        g_warning("--cache-gc has no effect without --cachedir");
+        options->cache_gc = FALSE;
+    }
+
+    // Check checksum read size
+    if (options->checksum_read_size <= 0) {
+        g_warning("Wrong checksum read size \"%"G_GINT64_FORMAT"\" - Using %d",
+                  options->checksum_read_size, CR_CHECKSUM_DEFAULT_READ_SIZE);
+        options->checksum_read_size = CR_CHECKSUM_DEFAULT_READ_SIZE;
+    }
+
     // Check changelog_limit
     if ((options->changelog_limit < -1)) {
         g_warning("Wrong changelog limit \"%d\" - Using 10", options->changelog_limit);
@@ -72,6 +72,8 @@ struct CmdOptions {
                                              time for timestamps */
     char *read_pkgs_list;       /*!< output the paths to pkgs actually read */
     gint workers;               /*!< number of threads to spawn */
+    gint64 checksum_read_size;  /*!< size of a single read while
+                                     checksumming packages */
     gboolean xz_compression;    /*!< use xz for repodata compression */
     gboolean zck_compression;   /*!< generate zchunk files */
     char *zck_dict_dir;         /*!< directory with zchunk dictionaries */
@@ -93,6 +95,7 @@ struct CmdOptions {
                                      Available units: (m - minutes, h - hours,
                                      d - days) */
     char *cachedir;             /*!< Cache dir for checksums */
+    gboolean cache_gc;          /*!< Remove unused checksums from the cache */
 
     gboolean deltas;            /*!< Is delta generation enabled? */
     char **oldpackagedirs;      /*!< Paths to look for older pks
@@ -105,6 +108,8 @@ struct CmdOptions {
                                      temporary files.
                                      For situations when sqlite has a trouble
                                      to gen DBs on NFS mounts. */
+    gboolean sharded_sqlite;    /*!< Write sqlite DBs in shards by multiple
+                                     threads and merge them at the end */
     gint cut_dirs;              /*!< Ignore *num* of directory components
                                      during repodata generation in location
                                      href value. */
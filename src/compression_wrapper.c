@@ -17,9 +17,12 @@
  * USA.
  */
 
+#define _GNU_SOURCE     // fopencookie()
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <magic.h>
 #include <assert.h>
 #include <errno.h>
@@ -33,6 +36,9 @@
 #ifdef WITH_ZCHUNK
 #include <zck.h>
 #endif  // WITH_ZCHUNK
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif  // WITH_ZSTD
 #include "error.h"
 #include "compression_wrapper.h"
 
@@ -57,6 +63,12 @@
 #define GZ_STRATEGY             Z_DEFAULT_STRATEGY
 #define GZ_BUFFER_SIZE          (1024*128)
 
+#define GZ_MT_BLOCK_SIZE        (1024*128)  // Input compressed by one thread
+#define GZ_MT_DICT_SIZE         (1024*32)   // Deflate window size
+#define GZ_MT_FLUSH_RESERVE     16          // Space for the sync flush marker
+#define GZ_MT_JOBS_PER_THREAD   2           // Max unwritten blocks per thread
+#define GZ_OS_UNIX              3
+
 #define BZ2_VERBOSITY           0
 #define BZ2_BLOCKSIZE100K       5  // Higher gives better compression but takes
                                    // more memory
@@ -85,6 +97,16 @@ LZMA_CHECK_SHA256
 #define XZ_MEMORY_USAGE_LIMIT   UINT64_MAX
 #define XZ_DECODER_FLAGS        0
 #define XZ_BUFFER_SIZE          (1024*32)
+/* Every thread of the xz encoder needs ~150 MiB (level 5) */
+#define XZ_MAX_THREADS          2
+
+/*
+1..ZSTD_maxCLevel() (19 without ultra)
+Levels above 10 make the compression much slower, but the decompression
+speed is almost the same for all levels.
+*/
+#define CR_CW_ZSTD_COMPRESSION_LEVEL    10
+#define ZSTD_CHECKSUM_FLAG      1   // Append xxhash of the content to a frame
 
 #if ZLIB_VERNUM < 0x1240
 // XXX: Zlib has gzbuffer since 1.2.4
@@ -114,6 +136,7 @@ cr_contentstat_free(cr_ContentStat *cstat, GError **err)
 
     g_free(cstat->hdr_checksum);
     g_free(cstat->checksum);
+    g_free(cstat->compressed_checksum);
     g_free(cstat);
 }
 
@@ -123,6 +146,603 @@ typedef struct {
     unsigned char buffer[XZ_BUFFER_SIZE];
 } XzFile;
 
+#ifdef WITH_ZSTD
+typedef struct {
+    FILE *file;
+    ZSTD_CCtx *cctx;            // Write mode
+    ZSTD_DCtx *dctx;            // Read mode
+    ZSTD_inBuffer in;           // Read mode - not yet decompressed input
+    size_t frame_rest;          // Read mode - 0 if the last frame is complete
+    gboolean eof;               // Read mode - whole file has been read
+    unsigned char *buffer;
+    size_t buffer_size;
+} ZstdFile;
+
+static void
+cr_zstd_free(ZstdFile *zstd_file)
+{
+    ZSTD_freeCCtx(zstd_file->cctx);
+    ZSTD_freeDCtx(zstd_file->dctx);
+    g_free(zstd_file->buffer);
+    g_free(zstd_file);
+}
+
+/** Compress the data and write the output into the file.
+ * With ZSTD_e_continue the compressor may keep some of the data
+ * buffered, ZSTD_e_end writes out everything and ends the frame.
+ */
+static int
+cr_zstd_compress(ZstdFile *zstd_file,
+                 const void *data,
+                 size_t len,
+                 ZSTD_EndDirective directive,
+                 GError **err)
+{
+    ZSTD_inBuffer in = { data, len, 0 };
+    size_t rest;
+
+    do {
+        ZSTD_outBuffer out = { zstd_file->buffer, zstd_file->buffer_size, 0 };
+
+        rest = ZSTD_compressStream2(zstd_file->cctx, &out, &in, directive);
+        if (ZSTD_isError(rest)) {
+            g_set_error(err, ERR_DOMAIN, CRE_ZSTD,
+                        "Zstd: ZSTD_compressStream2() error: %s",
+                        ZSTD_getErrorName(rest));
+            return CRE_ZSTD;
+        }
+
+        if (out.pos && fwrite(zstd_file->buffer, 1, out.pos,
+                              zstd_file->file) != out.pos) {
+            g_set_error(err, ERR_DOMAIN, CRE_ZSTD,
+                        "Zstd: fwrite(): %s", g_strerror(errno));
+            return CRE_ZSTD;
+        }
+    } while (directive == ZSTD_e_continue ? in.pos < in.size : rest != 0);
+
+    return CRE_OK;
+}
+
+/** Read and decompress up to len bytes. Files with multiple
+ * concatenated frames are supported.
+ */
+static int
+cr_zstd_read(ZstdFile *zstd_file, void *buffer, size_t len, GError **err)
+{
+    ZSTD_outBuffer out = { buffer, len, 0 };
+
+    while (out.pos < out.size) {
+        size_t before = out.pos;
+        size_t rest;
+
+        // Fill input buffer
+        if (zstd_file->in.pos == zstd_file->in.size && !zstd_file->eof) {
+            size_t n = fread(zstd_file->buffer, 1, zstd_file->buffer_size,
+                             zstd_file->file);
+            if (n == 0) {
+                if (ferror(zstd_file->file)) {
+                    g_set_error(err, ERR_DOMAIN, CRE_ZSTD,
+                                "Zstd: fread(): %s", g_strerror(errno));
+                    return CR_CW_ERR;
+                }
+                zstd_file->eof = TRUE;
+            }
+            zstd_file->in.src = zstd_file->buffer;
+            zstd_file->in.size = n;
+            zstd_file->in.pos = 0;
+        }
+
+        if (zstd_file->eof && zstd_file->in.pos == zstd_file->in.size
+            && zstd_file->frame_rest == 0)
+            break;  // EOF
+
+        // Decode (the decoder may still have buffered output
+        // even if all input was consumed)
+        rest = ZSTD_decompressStream(zstd_file->dctx, &out, &zstd_file->in);
+        if (ZSTD_isError(rest)) {
+            g_set_error(err, ERR_DOMAIN, CRE_ZSTD,
+                        "Zstd: Error while decoding: %s",
+                        ZSTD_getErrorName(rest));
+            return CR_CW_ERR;
+        }
+        zstd_file->frame_rest = rest;
+
+        if (zstd_file->eof && out.pos == before) {
+            g_set_error(err, ERR_DOMAIN, CRE_ZSTD,
+                        "Zstd: Unexpected end of file (truncated frame)");
+            return CR_CW_ERR;
+        }
+    }
+
+    return (int) out.pos;
+}
+#endif // WITH_ZSTD
+
+/*
+ * Checksumming of written data
+ *
+ * The output file of compression which writes into a FILE stream
+ * is a stream created by fopencookie() which passes the data to
+ * the file descriptor and updates their checksum.
+ */
+
+typedef struct {
+    int             fd;         /*!< Output file */
+    cr_ChecksumCtx  *checksum;  /*!< Checksum of the written data */
+    gint64          size;       /*!< Size of the written data */
+} TeeFile;
+
+static ssize_t
+cr_tee_write(void *cookie, const char *buf, size_t size)
+{
+    TeeFile *tee = cookie;
+    size_t written = 0;
+
+    while (written < size) {
+        ssize_t ret = write(tee->fd, buf + written, size - written);
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        written += ret;
+    }
+
+    cr_checksum_update(tee->checksum, buf, written, NULL);
+    tee->size += written;
+
+    // Zero means an error for the stdio
+    return written;
+}
+
+static int
+cr_tee_close(void *cookie)
+{
+    TeeFile *tee = cookie;
+    return close(tee->fd);
+}
+
+/** Open the file for writing. If the type is known, the written data
+ * are checksummed (see cr_tee_finish()).
+ */
+static FILE *
+cr_tee_fopen(CR_FILE *file,
+             const char *filename,
+             const char *mode_str,
+             cr_ChecksumType type)
+{
+    int fd;
+    FILE *f;
+    TeeFile *tee;
+    cookie_io_functions_t io_funcs = {
+        .read = NULL,
+        .write = cr_tee_write,
+        .seek = NULL,
+        .close = cr_tee_close,
+    };
+
+    if (file->mode != CR_CW_MODE_WRITE || type == CR_CHECKSUM_UNKNOWN)
+        return fopen(filename, mode_str);
+
+    fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1)
+        return NULL;
+
+    tee = g_new0(TeeFile, 1);
+    tee->fd = fd;
+    tee->checksum = cr_checksum_new(type, NULL);
+    if (!tee->checksum) {
+        close(fd);
+        g_free(tee);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    f = fopencookie(tee, mode_str, io_funcs);
+    if (!f) {
+        int errsv = errno;
+        close(fd);
+        g_free(cr_checksum_final(tee->checksum, NULL));
+        g_free(tee);
+        errno = errsv;
+        return NULL;
+    }
+
+    file->tee = tee;
+    return f;
+}
+
+/** Free the TeeFile (its stream must be already closed) and return
+ * the checksum of the written data.
+ */
+static char *
+cr_tee_finish(TeeFile *tee, gint64 *size)
+{
+    char *checksum = cr_checksum_final(tee->checksum, NULL);
+    *size = tee->size;
+    g_free(tee);
+    return checksum;
+}
+
+/** Number of threads used for compression of newly opened files.
+ */
+static gint compression_threads = 1;
+
+void
+cr_compression_set_threads(int threads)
+{
+    g_atomic_int_set(&compression_threads, MAX(threads, 1));
+}
+
+int
+cr_compression_get_threads(void)
+{
+    return g_atomic_int_get(&compression_threads);
+}
+
+/*
+ * Block parallel gzip writer (the same approach as pigz uses).
+ *
+ * Input is split into GZ_MT_BLOCK_SIZE blocks which are compressed
+ * by a thread pool into raw deflate data. Every block is primed with
+ * the last GZ_MT_DICT_SIZE bytes of the previous block (so the
+ * compression ratio is almost the same as for the single threaded
+ * compression) and ended by a sync flush (so the blocks could be
+ * simply concatenated). Only the last block is finished.
+ * The result is a regular single member gzip file.
+ */
+
+typedef struct {
+    unsigned char   *in;        /*!< Input data (freed after compression) */
+    size_t          in_len;     /*!< Size of the input */
+    unsigned char   *dict;      /*!< Tail of the previous block or NULL */
+    size_t          dict_len;   /*!< Size of the dictionary */
+    gboolean        last;       /*!< Finish the deflate stream */
+    unsigned char   *out;       /*!< Compressed data */
+    size_t          out_len;    /*!< Size of the compressed data */
+    uLong           crc;        /*!< CRC32 of the input */
+    int             ret;        /*!< Zlib return code */
+    gboolean        done;       /*!< Compression is done */
+} GzMtJob;
+
+typedef struct {
+    FILE            *file;      /*!< Output file */
+    int             level;      /*!< Compression level */
+    GThreadPool     *pool;      /*!< Compressing threads */
+    guint           max_jobs;   /*!< Max number of unwritten blocks */
+    GQueue          *jobs;      /*!< Unwritten blocks in the input order */
+    GMutex          mutex;      /*!< Protects done flags of jobs */
+    GCond           cond;       /*!< Signalled when a job is done */
+    unsigned char   *in;        /*!< Currently filled block */
+    size_t          in_len;     /*!< Size of data in the current block */
+    unsigned char   dict[GZ_MT_DICT_SIZE]; /*!< Tail of the last block */
+    size_t          dict_len;   /*!< Size of data in the dict */
+    uLong           crc;        /*!< CRC32 of the written data */
+    guint64         size;       /*!< Size of the written data */
+    gboolean        failed;     /*!< An error already happened */
+} GzMtFile;
+
+static void
+cr_gz_mt_job_free(GzMtJob *job)
+{
+    if (!job)
+        return;
+    g_free(job->in);
+    g_free(job->dict);
+    g_free(job->out);
+    g_free(job);
+}
+
+static void
+cr_gz_mt_compress(gpointer data, gpointer user_data)
+{
+    GzMtJob *job = data;
+    GzMtFile *gz = user_data;
+    z_stream strm;
+    int flush = job->last ? Z_FINISH : Z_SYNC_FLUSH;
+    size_t alloc;
+    int ret;
+
+    memset(&strm, 0, sizeof(strm));
+    ret = deflateInit2(&strm, gz->level, Z_DEFLATED, -MAX_WBITS,
+                       MAX_MEM_LEVEL, GZ_STRATEGY);
+    if (ret == Z_OK && job->dict_len)
+        ret = deflateSetDictionary(&strm, job->dict, job->dict_len);
+
+    if (ret == Z_OK) {
+        alloc = deflateBound(&strm, job->in_len) + GZ_MT_FLUSH_RESERVE;
+        job->out = g_malloc(alloc);
+        strm.next_in = job->in;
+        strm.avail_in = job->in_len;
+        strm.next_out = job->out;
+        strm.avail_out = alloc;
+
+        while (ret == Z_OK) {
+            if (!strm.avail_out) {
+                // Should not happen thanks to the deflateBound()
+                job->out = g_realloc(job->out, alloc * 2);
+                strm.next_out = job->out + alloc;
+                strm.avail_out = alloc;
+                alloc *= 2;
+            }
+
+            ret = deflate(&strm, flush);
+            if (ret == Z_STREAM_END) {
+                ret = Z_OK;  // The last block was finished
+                break;
+            }
+            if (ret == Z_OK && flush == Z_SYNC_FLUSH && strm.avail_out)
+                break;       // The block was flushed
+        }
+
+        job->out_len = alloc - strm.avail_out;
+        deflateEnd(&strm);
+    }
+
+    job->crc = crc32(crc32(0L, Z_NULL, 0), job->in, job->in_len);
+    g_clear_pointer(&job->in, g_free);
+    g_clear_pointer(&job->dict, g_free);
+
+    g_mutex_lock(&gz->mutex);
+    job->ret = ret;
+    job->done = TRUE;
+    g_cond_broadcast(&gz->cond);
+    g_mutex_unlock(&gz->mutex);
+}
+
+/** Wait for the oldest block and write it out.
+ */
+static int
+cr_gz_mt_write_job(GzMtFile *gz, GError **err)
+{
+    GzMtJob *job = g_queue_pop_head(gz->jobs);
+    int ret = CRE_OK;
+
+    assert(job);
+
+    g_mutex_lock(&gz->mutex);
+    while (!job->done)
+        g_cond_wait(&gz->cond, &gz->mutex);
+    g_mutex_unlock(&gz->mutex);
+
+    if (gz->failed) {
+        ret = CRE_GZ;
+        g_set_error(err, ERR_DOMAIN, CRE_GZ,
+                    "A previous write to the file failed");
+    } else if (job->ret != Z_OK) {
+        ret = CRE_GZ;
+        g_set_error(err, ERR_DOMAIN, CRE_GZ,
+                    "deflate() error (%d): %s", job->ret, zError(job->ret));
+    } else if (fwrite(job->out, 1, job->out_len, gz->file) != job->out_len) {
+        ret = CRE_IO;
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "fwrite(): %s", g_strerror(errno));
+    } else {
+        gz->crc = crc32_combine(gz->crc, job->crc, job->in_len);
+        gz->size += job->in_len;
+    }
+
+    if (ret != CRE_OK)
+        gz->failed = TRUE;
+
+    cr_gz_mt_job_free(job);
+    return ret;
+}
+
+/** Pass the current block to the compressing threads.
+ */
+static int
+cr_gz_mt_submit(GzMtFile *gz, gboolean last, GError **err)
+{
+    GzMtJob *job = g_new0(GzMtJob, 1);
+
+    job->in = gz->in;
+    job->in_len = gz->in_len;
+    job->last = last;
+    if (gz->dict_len) {
+        job->dict = g_memdup(gz->dict, gz->dict_len);
+        job->dict_len = gz->dict_len;
+    }
+
+    // The tail of this block is the dictionary for the next one
+    gz->dict_len = MIN(gz->in_len, GZ_MT_DICT_SIZE);
+    memcpy(gz->dict, gz->in + gz->in_len - gz->dict_len, gz->dict_len);
+
+    gz->in = last ? NULL : g_malloc(GZ_MT_BLOCK_SIZE);
+    gz->in_len = 0;
+
+    g_queue_push_tail(gz->jobs, job);
+    g_thread_pool_push(gz->pool, job, NULL);
+
+    // Do not let the unwritten blocks pile up
+    while (g_queue_get_length(gz->jobs) > gz->max_jobs)
+        if (cr_gz_mt_write_job(gz, err) != CRE_OK)
+            return CR_CW_ERR;
+
+    return CRE_OK;
+}
+
+/** Write the gzip header and start a new member.
+ */
+static int
+cr_gz_mt_start_member(GzMtFile *gz, GError **err)
+{
+    // Header: magic, deflate, no flags, no mtime, no extra flags, unix
+    static const unsigned char header[10] = {
+        0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, GZ_OS_UNIX };
+
+    if (fwrite(header, 1, sizeof(header), gz->file) != sizeof(header)) {
+        gz->failed = TRUE;
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "fwrite(): %s", g_strerror(errno));
+        return CR_CW_ERR;
+    }
+
+    gz->in = g_malloc(GZ_MT_BLOCK_SIZE);
+    gz->in_len = 0;
+    gz->dict_len = 0;
+    gz->crc = crc32(0L, Z_NULL, 0);
+    gz->size = 0;
+
+    return CRE_OK;
+}
+
+/** Finish the deflate stream, write out all blocks and the gzip trailer.
+ */
+static int
+cr_gz_mt_finish_member(GzMtFile *gz, GError **err)
+{
+    GError *tmp_err = NULL;
+
+    if (!gz->failed)
+        cr_gz_mt_submit(gz, TRUE, &tmp_err);
+
+    while (!g_queue_is_empty(gz->jobs)) {
+        if (tmp_err)
+            cr_gz_mt_write_job(gz, NULL);
+        else
+            cr_gz_mt_write_job(gz, &tmp_err);
+    }
+
+    if (!tmp_err && !gz->failed) {
+        // Trailer: CRC32 and size of the input (modulo 2^32), little endian
+        unsigned char trailer[8];
+        for (int x = 0; x < 4; x++) {
+            trailer[x] = (gz->crc >> (8 * x)) & 0xff;
+            trailer[x + 4] = (gz->size >> (8 * x)) & 0xff;
+        }
+        if (fwrite(trailer, 1, sizeof(trailer), gz->file) != sizeof(trailer))
+            g_set_error(&tmp_err, ERR_DOMAIN, CRE_IO,
+                        "fwrite(): %s", g_strerror(errno));
+    }
+
+    if (!tmp_err && gz->failed)
+        g_set_error(&tmp_err, ERR_DOMAIN, CRE_GZ,
+                    "A previous write to the file failed");
+
+    if (tmp_err) {
+        gz->failed = TRUE;
+        g_propagate_error(err, tmp_err);
+        return CR_CW_ERR;
+    }
+
+    return CRE_OK;
+}
+
+/** Start the compression into the opened file. The file is closed
+ * on error.
+ */
+static GzMtFile *
+cr_gz_mt_open(FILE *f, int threads, GError **err)
+{
+    GzMtFile *gz;
+
+    gz = g_new0(GzMtFile, 1);
+    gz->file = f;
+    gz->level = CR_CW_GZ_COMPRESSION_LEVEL;
+    gz->pool = g_thread_pool_new(cr_gz_mt_compress, gz, threads, FALSE, NULL);
+    gz->max_jobs = threads * GZ_MT_JOBS_PER_THREAD;
+    gz->jobs = g_queue_new();
+    g_mutex_init(&gz->mutex);
+    g_cond_init(&gz->cond);
+
+    if (cr_gz_mt_start_member(gz, err) != CRE_OK) {
+        fclose(f);
+        g_thread_pool_free(gz->pool, FALSE, TRUE);
+        g_queue_free(gz->jobs);
+        g_mutex_clear(&gz->mutex);
+        g_cond_clear(&gz->cond);
+        g_free(gz->in);
+        g_free(gz);
+        return NULL;
+    }
+
+    return gz;
+}
+
+static int
+cr_gz_mt_write(GzMtFile *gz, const unsigned char *buffer, size_t len,
+               GError **err)
+{
+    if (gz->failed) {
+        g_set_error(err, ERR_DOMAIN, CRE_GZ,
+                    "A previous write to the file failed");
+        return CR_CW_ERR;
+    }
+
+    while (len) {
+        size_t n = MIN(len, GZ_MT_BLOCK_SIZE - gz->in_len);
+        memcpy(gz->in + gz->in_len, buffer, n);
+        gz->in_len += n;
+        buffer += n;
+        len -= n;
+
+        if (gz->in_len == GZ_MT_BLOCK_SIZE
+            && cr_gz_mt_submit(gz, FALSE, err) != CRE_OK)
+            return CR_CW_ERR;
+    }
+
+    return CRE_OK;
+}
+
+/** End the current gzip member and start a new one. The data written
+ * so far could be decompressed independently of the following data.
+ */
+static int
+cr_gz_mt_end_member(GzMtFile *gz, GError **err)
+{
+    if (cr_gz_mt_finish_member(gz, err) != CRE_OK)
+        return CR_CW_ERR;
+    return cr_gz_mt_start_member(gz, err);
+}
+
+static int
+cr_gz_mt_close(GzMtFile *gz, GError **err)
+{
+    int ret = CRE_OK;
+    GError *tmp_err = NULL;
+
+    cr_gz_mt_finish_member(gz, &tmp_err);
+
+    if (fclose(gz->file) != 0 && !tmp_err)
+        g_set_error(&tmp_err, ERR_DOMAIN, CRE_IO,
+                    "fclose(): %s", g_strerror(errno));
+
+    if (tmp_err) {
+        ret = tmp_err->code;
+        g_propagate_error(err, tmp_err);
+    }
+
+    g_thread_pool_free(gz->pool, FALSE, TRUE);
+    g_queue_free(gz->jobs);
+    g_mutex_clear(&gz->mutex);
+    g_cond_clear(&gz->cond);
+    g_free(gz->in);
+    g_free(gz);
+
+    return ret;
+}
+
+/** Check if the file starts with the zstd frame magic number.
+ */
+static gboolean
+cr_has_zstd_magic(const char *filename)
+{
+    static const unsigned char zstd_magic[4] = { 0x28, 0xB5, 0x2F, 0xFD };
+    unsigned char buf[sizeof(zstd_magic)];
+    gboolean ret = FALSE;
+
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+        return FALSE;
+
+    if (fread(buf, 1, sizeof(buf), f) == sizeof(buf))
+        ret = !memcmp(buf, zstd_magic, sizeof(zstd_magic));
+
+    fclose(f);
+    return ret;
+}
+
 cr_CompressionType
 cr_detect_compression(const char *filename, GError **err)
 {
@@ -156,6 +776,10 @@ cr_detect_compression(const char *filename, GError **err)
     } else if (g_str_has_suffix(filename, ".zck"))
     {
         return CR_CW_ZCK_COMPRESSION;
+    } else if (g_str_has_suffix(filename, ".zst") ||
+               g_str_has_suffix(filename, ".zstd"))
+    {
+        return CR_CW_ZSTD_COMPRESSION;
     } else if (g_str_has_suffix(filename, ".xml") ||
                g_str_has_suffix(filename, ".tar") ||
                g_str_has_suffix(filename, ".yaml") ||
@@ -166,6 +790,10 @@ cr_detect_compression(const char *filename, GError **err)
 
     // No success? Let's get hardcore... (Use magic bytes)
 
+    // Older libmagic versions do not know zstd, check its magic directly
+    if (cr_has_zstd_magic(filename))
+        return CR_CW_ZSTD_COMPRESSION;
+
     magic_t myt = magic_open(MAGIC_MIME | MAGIC_SYMLINK);
     if (myt == NULL) {
         g_set_error(err, ERR_DOMAIN, CRE_MAGIC,
@@ -211,6 +839,12 @@ cr_detect_compression(const char *filename, GError **err)
             type = CR_CW_XZ_COMPRESSION;
         }
 
+        else if (g_str_has_prefix(mime_type, "application/zstd") ||
+                 g_str_has_prefix(mime_type, "application/x-zstd"))
+        {
+            type = CR_CW_ZSTD_COMPRESSION;
+        }
+
         else if (g_str_has_prefix(mime_type, "text/plain") ||
                  g_str_has_prefix(mime_type, "text/xml") ||
                  g_str_has_prefix(mime_type, "application/xml") ||
@@ -261,6 +895,8 @@ cr_compression_type(const char *name)
         type = CR_CW_XZ_COMPRESSION;
     if (!g_strcmp0(name_lower, "zck"))
         type = CR_CW_ZCK_COMPRESSION;
+    if (!g_strcmp0(name_lower, "zstd") || !g_strcmp0(name_lower, "zst"))
+        type = CR_CW_ZSTD_COMPRESSION;
     g_free(name_lower);
 
     return type;
@@ -278,6 +914,8 @@ cr_compression_suffix(cr_CompressionType comtype)
             return ".xz";
         case CR_CW_ZCK_COMPRESSION:
             return ".zck";
+        case CR_CW_ZSTD_COMPRESSION:
+            return ".zst";
         default:
             return NULL;
     }
@@ -328,6 +966,7 @@ cr_sopen(const char *filename,
 {
     CR_FILE *file = NULL;
     cr_CompressionType type = comtype;
+    cr_ChecksumType tee_type = CR_CHECKSUM_UNKNOWN;
     GError *tmp_err = NULL;
 
     assert(filename);
@@ -378,6 +1017,16 @@ cr_sopen(const char *filename,
     }
 
 
+    // Checksum of the compressed data is computed only while writing
+
+    if (stat) {
+        g_free(stat->compressed_checksum);
+        stat->compressed_checksum = NULL;
+        stat->compressed_size = G_GINT64_CONSTANT(0);
+        if (mode == CR_CW_MODE_WRITE)
+            tee_type = stat->checksum_type;
+    }
+
     // Open file
 
     const char *mode_str = (mode == CR_CW_MODE_WRITE) ? "wb" : "rb";
@@ -391,13 +1040,27 @@ cr_sopen(const char *filename,
 
         case (CR_CW_NO_COMPRESSION): // ---------------------------------------
             mode_str = (mode == CR_CW_MODE_WRITE) ? "w" : "r";
-            file->FILE = (void *) fopen(filename, mode_str);
+            file->FILE = (void *) cr_tee_fopen(file, filename, mode_str,
+                                               tee_type);
             if (!file->FILE)
                 g_set_error(err, ERR_DOMAIN, CRE_IO,
                             "fopen(): %s", g_strerror(errno));
             break;
 
         case (CR_CW_GZ_COMPRESSION): // ---------------------------------------
+            if (mode == CR_CW_MODE_WRITE && cr_compression_get_threads() > 1) {
+                // Block parallel compression
+                FILE *f = cr_tee_fopen(file, filename, mode_str, tee_type);
+                if (!f) {
+                    g_set_error(err, ERR_DOMAIN, CRE_IO,
+                                "fopen(): %s", g_strerror(errno));
+                    break;
+                }
+                file->threads = cr_compression_get_threads();
+                file->FILE = (void *) cr_gz_mt_open(f, file->threads, err);
+                break;
+            }
+
             file->FILE = (void *) gzopen(filename, mode_str);
             if (!file->FILE) {
                 g_set_error(err, ERR_DOMAIN, CRE_GZ,
@@ -418,7 +1081,7 @@ cr_sopen(const char *filename,
             break;
 
         case (CR_CW_BZ2_COMPRESSION): { // ------------------------------------
-            FILE *f = fopen(filename, mode_str);
+            FILE *f = cr_tee_fopen(file, filename, mode_str, tee_type);
             file->INNERFILE = f;
             int bzerror;
 
@@ -487,53 +1150,52 @@ cr_sopen(const char *filename,
 
             if (mode == CR_CW_MODE_WRITE) {
 
+                uint32_t threads = (uint32_t) cr_compression_get_threads();
+
 #ifdef ENABLE_THREADED_XZ_ENCODER
-                // The threaded encoder takes the options as pointer to
-                // a lzma_mt structure.
-                lzma_mt mt = {
-                    // No flags are needed.
-                    .flags = 0,
-
-                    // Let liblzma determine a sane block size.
-                    .block_size = 0,
-
-                    // Use no timeout for lzma_code() calls by setting timeout
-                    // to zero. That is, sometimes lzma_code() might block for
-                    // a long time (from several seconds to even minutes).
-                    // If this is not OK, for example due to progress indicator
-                    // needing updates, specify a timeout in milliseconds here.
-                    // See the documentation of lzma_mt in lzma/container.h for
-                    // information how to choose a reasonable timeout.
-                    .timeout = 0,
-
-                    // Use the default preset (6) for LZMA2.
-                    // To use a preset, filters must be set to NULL.
-                    .preset = LZMA_PRESET_DEFAULT,
-                    .filters = NULL,
-
-                    // Integrity checking.
-                    .check = XZ_CHECK,
-                };
-
-                // Detect how many threads the CPU supports.
-                mt.threads = lzma_cputhreads();
-
-                // If the number of CPU cores/threads cannot be detected,
-                // use one thread.
-                if (mt.threads == 0)
-                    mt.threads = 1;
-
-                // If the number of CPU cores/threads exceeds threads_max,
-                // limit the number of threads to keep memory usage lower.
-                const uint32_t threads_max = 2;
-                if (mt.threads > threads_max)
-                    mt.threads = threads_max;
-
-                if (mt.threads > 1)
+                if (threads <= 1)
+                    // Detect how many threads the CPU supports
+                    threads = MAX(lzma_cputhreads(), 1);
+#endif
+
+                // Limit the number of threads to keep memory usage lower,
+                // the metadata files are compressed at the same time
+                threads = MIN(threads, XZ_MAX_THREADS);
+
+                // More threads than CPUs only waste memory
+                if (threads > 1 && lzma_cputhreads() > 0)
+                    threads = MIN(threads, lzma_cputhreads());
+
+                if (threads > 1) {
+                    // The threaded encoder takes the options as pointer to
+                    // a lzma_mt structure.
+                    lzma_mt mt = {
+                        // No flags are needed.
+                        .flags = 0,
+
+                        .threads = threads,
+
+                        // Let liblzma determine a sane block size.
+                        .block_size = 0,
+
+                        // Use no timeout for lzma_code() calls, sometimes
+                        // lzma_code() might block for a long time.
+                        .timeout = 0,
+
+                        // Use the same preset as the single-threaded
+                        // encoder. To use a preset, filters must be NULL.
+                        .preset = CR_CW_XZ_COMPRESSION_LEVEL,
+                        .filters = NULL,
+
+                        // Integrity checking.
+                        .check = XZ_CHECK,
+                    };
+
+                    file->threads = threads;
+
                     // Initialize the threaded encoder
                     ret = lzma_stream_encoder_mt(stream, &mt);
-                else
-#endif
+                } else
                     // Initialize the single-threaded encoder
                     ret = lzma_easy_encoder(stream,
                                             CR_CW_XZ_COMPRESSION_LEVEL,
@@ -575,7 +1237,7 @@ cr_sopen(const char *filename,
 
             // Open input/output file
 
-            FILE *f = fopen(filename, mode_str);
+            FILE *f = cr_tee_fopen(file, filename, mode_str, tee_type);
             if (!f) {
                 g_set_error(err, ERR_DOMAIN, CRE_XZ,
                             "fopen(): %s", g_strerror(errno));
@@ -627,6 +1289,77 @@ cr_sopen(const char *filename,
 #endif // WITH_ZCHUNK
         }
 
+        case (CR_CW_ZSTD_COMPRESSION): { // -----------------------------------
+#ifdef WITH_ZSTD
+            ZstdFile *zstd_file = g_malloc0(sizeof(ZstdFile));
+            size_t zret = 0;
+
+            // Prepare compressor/decompressor
+
+            if (mode == CR_CW_MODE_WRITE) {
+                int threads = cr_compression_get_threads();
+
+                zstd_file->buffer_size = ZSTD_CStreamOutSize();
+                zstd_file->cctx = ZSTD_createCCtx();
+                if (zstd_file->cctx) {
+                    zret = ZSTD_CCtx_setParameter(zstd_file->cctx,
+                                                  ZSTD_c_compressionLevel,
+                                                  CR_CW_ZSTD_COMPRESSION_LEVEL);
+                    if (!ZSTD_isError(zret))
+                        zret = ZSTD_CCtx_setParameter(zstd_file->cctx,
+                                                      ZSTD_c_checksumFlag,
+                                                      ZSTD_CHECKSUM_FLAG);
+                }
+
+                if (zstd_file->cctx && !ZSTD_isError(zret) && threads > 1) {
+                    // Worker threads compress the input in jobs, the
+                    // output is the same single frame. This fails if
+                    // libzstd was built without multithreading support.
+                    if (ZSTD_isError(ZSTD_CCtx_setParameter(zstd_file->cctx,
+                                                            ZSTD_c_nbWorkers,
+                                                            threads)))
+                        g_debug("%s: libzstd doesn't support multithreaded "
+                                "compression", __func__);
+                    else
+                        file->threads = threads;
+                }
+            } else {
+                zstd_file->buffer_size = ZSTD_DStreamInSize();
+                zstd_file->dctx = ZSTD_createDCtx();
+            }
+
+            if ((!zstd_file->cctx && !zstd_file->dctx) || ZSTD_isError(zret)) {
+                g_set_error(err, ERR_DOMAIN, CRE_ZSTD,
+                            "Zstd: Cannot initialize the %s: %s",
+                            mode == CR_CW_MODE_WRITE ? "compressor"
+                                                     : "decompressor",
+                            ZSTD_isError(zret) ? ZSTD_getErrorName(zret)
+                                               : "Cannot allocate memory");
+                cr_zstd_free(zstd_file);
+                break;
+            }
+
+            // Open input/output file
+
+            FILE *f = cr_tee_fopen(file, filename, mode_str, tee_type);
+            if (!f) {
+                g_set_error(err, ERR_DOMAIN, CRE_IO,
+                            "fopen(): %s", g_strerror(errno));
+                cr_zstd_free(zstd_file);
+                break;
+            }
+
+            zstd_file->file = f;
+            zstd_file->buffer = g_malloc(zstd_file->buffer_size);
+            file->FILE = (void *) zstd_file;
+            break;
+#else
+            g_set_error(err, ERR_DOMAIN, CRE_IO, "createrepo_c wasn't compiled "
+                        "with zstd support");
+            break;
+#endif // WITH_ZSTD
+        }
+
         default: // -----------------------------------------------------------
             break;
     }
@@ -636,6 +1369,10 @@ cr_sopen(const char *filename,
         if (err && *err == NULL)
             g_set_error(err, ERR_DOMAIN, CRE_XZ,
                         "Unknown error while opening: %s", filename);
+        if (file->tee) {
+            gint64 size;
+            g_free(cr_tee_finish(file->tee, &size));
+        }
         g_free(file);
         return NULL;
     }
@@ -733,6 +1470,8 @@ cr_close(CR_FILE *cr_file, GError **err)
     if (!cr_file)
         return CRE_OK;
 
+    cr_readahead_stop(cr_file);
+
     switch (cr_file->type) {
 
         case (CR_CW_NO_COMPRESSION): // ---------------------------------------
@@ -746,6 +1485,11 @@ cr_close(CR_FILE *cr_file, GError **err)
             break;
 
         case (CR_CW_GZ_COMPRESSION): // ---------------------------------------
+            if (cr_file->mode == CR_CW_MODE_WRITE && cr_file->threads > 1) {
+                ret = cr_gz_mt_close((GzMtFile *) cr_file->FILE, err);
+                break;
+            }
+
             rc = gzclose((gzFile) cr_file->FILE);
             if (rc == Z_OK)
                 ret = CRE_OK;
@@ -921,12 +1665,35 @@ cr_close(CR_FILE *cr_file, GError **err)
             break;
 #endif // WITH_ZCHUNK
         }
-        default: // -----------------------------------------------------------
-            ret = CRE_BADARG;
-            g_set_error(err, ERR_DOMAIN, CRE_BADARG,
-                        "Bad compressed file type");
-            break;
-    }
+        case (CR_CW_ZSTD_COMPRESSION): { // -----------------------------------
+#ifdef WITH_ZSTD
+            ZstdFile *zstd_file = (ZstdFile *) cr_file->FILE;
+
+            ret = CRE_OK;
+            if (cr_file->mode == CR_CW_MODE_WRITE)
+                // Write out rest of the data and end the frame
+                ret = cr_zstd_compress(zstd_file, NULL, 0, ZSTD_e_end, err);
+
+            if (fclose(zstd_file->file) != 0 && ret == CRE_OK) {
+                ret = CRE_IO;
+                g_set_error(err, ERR_DOMAIN, CRE_IO,
+                            "fclose(): %s", g_strerror(errno));
+            }
+            cr_zstd_free(zstd_file);
+            break;
+#else
+            ret = CRE_IO;
+            g_set_error(err, ERR_DOMAIN, CRE_IO, "createrepo_c wasn't compiled "
+                        "with zstd support");
+            break;
+#endif // WITH_ZSTD
+        }
+        default: // -----------------------------------------------------------
+            ret = CRE_BADARG;
+            g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                        "Bad compressed file type");
+            break;
+    }
 
     if (cr_file->stat) {
         g_free(cr_file->stat->checksum);
@@ -937,6 +1704,17 @@ cr_close(CR_FILE *cr_file, GError **err)
             cr_file->stat->checksum = NULL;
     }
 
+    if (cr_file->tee) {
+        gint64 size;
+        char *checksum = cr_tee_finish(cr_file->tee, &size);
+        if (cr_file->stat && ret == CRE_OK) {
+            cr_file->stat->compressed_checksum = checksum;
+            cr_file->stat->compressed_size = size;
+        } else {
+            g_free(checksum);
+        }
+    }
+
     g_free(cr_file);
 
     assert(!err || (ret != CRE_OK && *err != NULL)
@@ -947,8 +1725,8 @@ cr_close(CR_FILE *cr_file, GError **err)
 
 
 
-int
-cr_read(CR_FILE *cr_file, void *buffer, unsigned int len, GError **err)
+static int
+cr_read_internal(CR_FILE *cr_file, void *buffer, unsigned int len, GError **err)
 {
     int bzerror;
     int ret = CR_CW_ERR;
@@ -1139,6 +1917,17 @@ cr_read(CR_FILE *cr_file, void *buffer, unsigned int len, GError **err)
 #endif // WITH_ZCHUNK
         }
 
+        case (CR_CW_ZSTD_COMPRESSION): { // -----------------------------------
+#ifdef WITH_ZSTD
+            ret = cr_zstd_read((ZstdFile *) cr_file->FILE, buffer, len, err);
+            break;
+#else
+            g_set_error(err, ERR_DOMAIN, CRE_IO, "createrepo_c wasn't compiled "
+                        "with zstd support");
+            break;
+#endif // WITH_ZSTD
+        }
+
         default: // -----------------------------------------------------------
             ret = CR_CW_ERR;
             g_set_error(err, ERR_DOMAIN, CRE_BADARG,
@@ -1166,6 +1955,218 @@ cr_read(CR_FILE *cr_file, void *buffer, unsigned int len, GError **err)
 
 
 
+/*
+ * Read-ahead decompression.
+ *
+ * A background thread decompresses the file into a ring of blocks.
+ * Empty blocks are passed to the thread by the free queue, filled ones
+ * are passed back to the reader by the full queue. The thread is
+ * the only user of the underlying decompressor until it is joined.
+ */
+
+typedef struct {
+    char            *data;      /*!< Decompressed data */
+    int             len;        /*!< Size of the data (0 - end of file) */
+    GError          *err;       /*!< Read error */
+} ReadAheadBlock;
+
+typedef struct {
+    GThread         *thread;    /*!< Decompressing thread */
+    GAsyncQueue     *free;      /*!< Blocks to be filled */
+    GAsyncQueue     *full;      /*!< Filled blocks in the file order */
+    ReadAheadBlock  blocks[CR_CW_READAHEAD_BLOCKS];
+    ReadAheadBlock  stop;       /*!< Pushed into the free queue to stop
+                                     the thread */
+    ReadAheadBlock  *current;   /*!< Block owned by the reader */
+    int             offset;     /*!< Already read part of the current block
+                                     (used by cr_read()) */
+    gboolean        eof;        /*!< The last block was already returned */
+} ReadAhead;
+
+static gpointer
+cr_readahead_thread(gpointer data)
+{
+    CR_FILE *cr_file = data;
+    ReadAhead *ra = cr_file->readahead;
+
+    while (1) {
+        ReadAheadBlock *block = g_async_queue_pop(ra->free);
+        if (block == &ra->stop)
+            break;
+
+        block->len = cr_read_internal(cr_file, block->data,
+                                      CR_CW_READAHEAD_BLOCK_SIZE, &block->err);
+        g_async_queue_push(ra->full, block);
+
+        if (block->len <= 0)
+            break;  // End of file or an error
+    }
+
+    return NULL;
+}
+
+int
+cr_set_readahead(CR_FILE *cr_file, GError **err)
+{
+    ReadAhead *ra;
+    GError *tmp_err = NULL;
+
+    assert(cr_file);
+    assert(!err || *err == NULL);
+
+    if (cr_file->mode != CR_CW_MODE_READ) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "File is not opened in read mode");
+        return CR_CW_ERR;
+    }
+
+    if (cr_file->readahead)
+        return CRE_OK;
+
+    ra = g_new0(ReadAhead, 1);
+    ra->free = g_async_queue_new();
+    ra->full = g_async_queue_new();
+    for (int i = 0; i < CR_CW_READAHEAD_BLOCKS; i++) {
+        ra->blocks[i].data = g_malloc(CR_CW_READAHEAD_BLOCK_SIZE);
+        g_async_queue_push(ra->free, &ra->blocks[i]);
+    }
+
+    cr_file->readahead = ra;
+    ra->thread = g_thread_try_new("cr_readahead", cr_readahead_thread,
+                                  cr_file, &tmp_err);
+    if (!ra->thread) {
+        cr_file->readahead = NULL;
+        for (int i = 0; i < CR_CW_READAHEAD_BLOCKS; i++)
+            g_free(ra->blocks[i].data);
+        g_async_queue_unref(ra->free);
+        g_async_queue_unref(ra->full);
+        g_free(ra);
+        g_set_error(err, ERR_DOMAIN, CRE_ERROR,
+                    "Cannot start read-ahead thread: %s", tmp_err->message);
+        g_error_free(tmp_err);
+        return CR_CW_ERR;
+    }
+
+    return CRE_OK;
+}
+
+/** Stop the read-ahead thread and free the blocks.
+ */
+static void
+cr_readahead_stop(CR_FILE *cr_file)
+{
+    ReadAhead *ra = cr_file->readahead;
+
+    if (!ra)
+        return;
+
+    // The free queue is FIFO, so the thread could fill one more block
+    // before it gets the stop mark
+    g_async_queue_push(ra->free, &ra->stop);
+    g_thread_join(ra->thread);
+    cr_file->readahead = NULL;
+
+    for (int i = 0; i < CR_CW_READAHEAD_BLOCKS; i++) {
+        g_clear_error(&ra->blocks[i].err);
+        g_free(ra->blocks[i].data);
+    }
+    g_async_queue_unref(ra->free);
+    g_async_queue_unref(ra->full);
+    g_free(ra);
+}
+
+/** Make the next filled block the current one.
+ * @return      size of the block, 0 at the end of file or CR_CW_ERR
+ */
+static int
+cr_readahead_next(ReadAhead *ra, GError **err)
+{
+    if (ra->current) {
+        g_async_queue_push(ra->free, ra->current);
+        ra->current = NULL;
+    }
+
+    if (ra->eof)
+        return 0;
+
+    ra->current = g_async_queue_pop(ra->full);
+    ra->offset = 0;
+
+    if (ra->current->len <= 0) {
+        // Nothing follows this block
+        ra->eof = TRUE;
+        if (ra->current->err) {
+            g_propagate_error(err, ra->current->err);
+            ra->current->err = NULL;
+            return CR_CW_ERR;
+        }
+    }
+
+    return ra->current->len;
+}
+
+int
+cr_read_block(CR_FILE *cr_file, const void **buffer, GError **err)
+{
+    int ret;
+    ReadAhead *ra;
+
+    assert(cr_file);
+    assert(buffer);
+    assert(!err || *err == NULL);
+
+    ra = cr_file->readahead;
+    if (!ra) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "Read-ahead is not enabled for the file");
+        return CR_CW_ERR;
+    }
+
+    *buffer = NULL;
+    ret = cr_readahead_next(ra, err);
+    if (ret > 0)
+        *buffer = ra->current->data;
+
+    return ret;
+}
+
+int
+cr_read(CR_FILE *cr_file, void *buffer, unsigned int len, GError **err)
+{
+    ReadAhead *ra;
+    unsigned int done = 0;
+
+    assert(cr_file);
+    assert(buffer);
+    assert(!err || *err == NULL);
+
+    ra = cr_file->readahead;
+    if (!ra)
+        return cr_read_internal(cr_file, buffer, len, err);
+
+    while (done < len) {
+        int avail = ra->current ? ra->current->len - ra->offset : 0;
+
+        if (avail <= 0) {
+            int ret = cr_readahead_next(ra, err);
+            if (ret == CR_CW_ERR)
+                return CR_CW_ERR;
+            if (ret == 0)
+                break;
+            continue;
+        }
+
+        if ((unsigned int) avail > len - done)
+            avail = len - done;
+        memcpy((char *) buffer + done, ra->current->data + ra->offset, avail);
+        ra->offset += avail;
+        done += avail;
+    }
+
+    return (int) done;
+}
+
+
 int
 cr_write(CR_FILE *cr_file, const void *buffer, unsigned int len, GError **err)
 {
@@ -1210,6 +2211,14 @@ cr_write(CR_FILE *cr_file, const void *buffer, unsigned int len, GError **err)
                 break;
             }
 
+            if (cr_file->threads > 1) {
+                ret = cr_gz_mt_write((GzMtFile *) cr_file->FILE,
+                                     buffer, len, err);
+                if (ret != CR_CW_ERR)
+                    ret = len;
+                break;
+            }
+
             if ((ret = gzwrite((gzFile) cr_file->FILE, buffer, len)) == 0) {
                 ret = CR_CW_ERR;
                 g_set_error(err, ERR_DOMAIN, CRE_GZ,
@@ -1325,6 +2334,19 @@ cr_write(CR_FILE *cr_file, const void *buffer, unsigned int len, GError **err)
 #endif // WITH_ZCHUNK
         }
 
+        case (CR_CW_ZSTD_COMPRESSION): { // -----------------------------------
+#ifdef WITH_ZSTD
+            if (cr_zstd_compress((ZstdFile *) cr_file->FILE, buffer, len,
+                                 ZSTD_e_continue, err) == CRE_OK)
+                ret = len;
+            break;
+#else
+            g_set_error(err, ERR_DOMAIN, CRE_IO, "createrepo_c wasn't compiled "
+                        "with zstd support");
+            break;
+#endif // WITH_ZSTD
+        }
+
         default: // -----------------------------------------------------------
             g_set_error(err, ERR_DOMAIN, CRE_BADARG,
                         "Bad compressed file type");
@@ -1364,6 +2386,7 @@ cr_puts(CR_FILE *cr_file, const char *str, GError **err)
         case (CR_CW_BZ2_COMPRESSION): // --------------------------------------
         case (CR_CW_XZ_COMPRESSION): // ---------------------------------------
         case (CR_CW_ZCK_COMPRESSION): // --------------------------------------
+        case (CR_CW_ZSTD_COMPRESSION): // -------------------------------------
             len = strlen(str);
             ret = cr_write(cr_file, str, len, err);
             if (ret != (int) len)
@@ -1398,10 +2421,57 @@ cr_end_chunk(CR_FILE *cr_file, GError **err)
 
     switch (cr_file->type) {
         case (CR_CW_NO_COMPRESSION): // ---------------------------------------
-        case (CR_CW_GZ_COMPRESSION): // ---------------------------------------
         case (CR_CW_BZ2_COMPRESSION): // --------------------------------------
-        case (CR_CW_XZ_COMPRESSION): // ---------------------------------------
             break;
+
+        case (CR_CW_GZ_COMPRESSION): { // -------------------------------------
+            // End the gzip member, the next write starts a new one
+            if (cr_file->threads > 1) {
+                if (cr_gz_mt_end_member((GzMtFile *) cr_file->FILE, err) != CRE_OK)
+                    ret = CR_CW_ERR;
+                break;
+            }
+
+            int rc = gzflush((gzFile) cr_file->FILE, Z_FINISH);
+            if (rc != Z_OK) {
+                ret = CR_CW_ERR;
+                g_set_error(err, ERR_DOMAIN, CRE_GZ, "gzflush(): %s",
+                            cr_gz_strerror((gzFile) cr_file->FILE));
+            }
+            break;
+        }
+
+        case (CR_CW_XZ_COMPRESSION): { // -------------------------------------
+            // End the xz block, the next write starts a new one
+            XzFile *xz_file = (XzFile *) cr_file->FILE;
+            lzma_stream *stream = &(xz_file->stream);
+            lzma_ret lret = LZMA_OK;
+
+            stream->next_in = NULL;
+            stream->avail_in = 0;
+
+            while (lret == LZMA_OK) {
+                stream->next_out = xz_file->buffer;
+                stream->avail_out = XZ_BUFFER_SIZE;
+                lret = lzma_code(stream, LZMA_FULL_FLUSH);
+                if (lret != LZMA_OK && lret != LZMA_STREAM_END) {
+                    ret = CR_CW_ERR;
+                    g_set_error(err, ERR_DOMAIN, CRE_XZ,
+                                "XZ: lzma_code() error (%d)", lret);
+                    break;
+                }
+
+                size_t out_len = XZ_BUFFER_SIZE - stream->avail_out;
+                if ((fwrite(xz_file->buffer, 1, out_len, xz_file->file)) != out_len) {
+                    ret = CR_CW_ERR;
+                    g_set_error(err, ERR_DOMAIN, CRE_XZ,
+                                "XZ: fwrite(): %s", g_strerror(errno));
+                    break;
+                }
+            }
+            break;
+        }
+
         case (CR_CW_ZCK_COMPRESSION): { // ------------------------------------
 #ifdef WITH_ZCHUNK
             zckCtx *zck = (zckCtx *) cr_file->FILE;
@@ -1421,6 +2491,21 @@ cr_end_chunk(CR_FILE *cr_file, GError **err)
 #endif // WITH_ZCHUNK
         }
 
+        case (CR_CW_ZSTD_COMPRESSION): { // -----------------------------------
+#ifdef WITH_ZSTD
+            // End the zstd frame, the next write starts a new one
+            if (cr_zstd_compress((ZstdFile *) cr_file->FILE, NULL, 0,
+                                 ZSTD_e_end, err) != CRE_OK)
+                ret = CR_CW_ERR;
+            break;
+#else
+            ret = CR_CW_ERR;
+            g_set_error(err, ERR_DOMAIN, CRE_IO, "createrepo_c wasn't compiled "
+                        "with zstd support");
+            break;
+#endif // WITH_ZSTD
+        }
+
         default: // -----------------------------------------------------------
             g_set_error(err, ERR_DOMAIN, CRE_BADARG,
                         "Bad compressed file type");
@@ -1453,6 +2538,7 @@ cr_set_autochunk(CR_FILE *cr_file, gboolean auto_chunk, GError **err)
         case (CR_CW_GZ_COMPRESSION): // ---------------------------------------
         case (CR_CW_BZ2_COMPRESSION): // --------------------------------------
         case (CR_CW_XZ_COMPRESSION): // ---------------------------------------
+        case (CR_CW_ZSTD_COMPRESSION): // -------------------------------------
             break;
         case (CR_CW_ZCK_COMPRESSION): { // ------------------------------------
 #ifdef WITH_ZCHUNK
@@ -1526,6 +2612,7 @@ cr_printf(GError **err, CR_FILE *cr_file, const char *format, ...)
         case (CR_CW_BZ2_COMPRESSION): // --------------------------------------
         case (CR_CW_XZ_COMPRESSION): // ---------------------------------------
         case (CR_CW_ZCK_COMPRESSION): // --------------------------------------
+        case (CR_CW_ZSTD_COMPRESSION): // -------------------------------------
             tmp_ret = cr_write(cr_file, buf, ret, err);
             if (tmp_ret != (int) ret)
                 ret = CR_CW_ERR;
@@ -1575,3 +2662,538 @@ cr_get_zchunk_with_index(CR_FILE *cr_file, ssize_t zchunk_index, char **copy_buf
     return 0;
 #endif // WITH_ZCHUNK
 }
+
+/** Copy the [from, to) range of the src file into the dst file.
+ * If to is -1, the rest of the src file is copied.
+ */
+static int
+cr_copy_file_range(FILE *src, off_t from, off_t to, FILE *dst, GError **err)
+{
+    unsigned char buf[GZ_BUFFER_SIZE];
+
+    if (fseeko(src, from, SEEK_SET) != 0) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "fseeko(): %s", g_strerror(errno));
+        return CRE_IO;
+    }
+
+    while (to < 0 || from < to) {
+        size_t want = sizeof(buf);
+        if (to >= 0)
+            want = MIN(want, (size_t) (to - from));
+
+        size_t n = fread(buf, 1, want, src);
+        if (n == 0) {
+            if (ferror(src)) {
+                g_set_error(err, ERR_DOMAIN, CRE_IO,
+                            "fread(): %s", g_strerror(errno));
+                return CRE_IO;
+            }
+            if (to >= 0) {
+                g_set_error(err, ERR_DOMAIN, CRE_IO,
+                            "Unexpected end of file");
+                return CRE_IO;
+            }
+            break;
+        }
+
+        if (fwrite(buf, 1, n, dst) != n) {
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "fwrite(): %s", g_strerror(errno));
+            return CRE_IO;
+        }
+        from += n;
+    }
+
+    return CRE_OK;
+}
+
+/** Decompress the first gzip member of the file.
+ * @param f             Opened file
+ * @param max_len       Max allowed size of the decompressed data
+ * @param data          Decompressed data (output)
+ * @param end           Offset of the end of the member (output)
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+static int
+cr_gz_first_member(FILE *f,
+                   size_t max_len,
+                   GString **data,
+                   off_t *end,
+                   GError **err)
+{
+    unsigned char in[GZ_BUFFER_SIZE];
+    unsigned char out[GZ_BUFFER_SIZE];
+    z_stream strm;
+    int zret = Z_OK;
+    int ret = CRE_OK;
+    GString *str;
+
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK) {
+        g_set_error(err, ERR_DOMAIN, CRE_GZ, "inflateInit2() failed");
+        return CRE_GZ;
+    }
+
+    str = g_string_new(NULL);
+    while (zret != Z_STREAM_END) {
+        if (!strm.avail_in) {
+            size_t n = fread(in, 1, sizeof(in), f);
+            if (n == 0) {
+                ret = CRE_GZ;
+                g_set_error(err, ERR_DOMAIN, CRE_GZ,
+                            "Unexpected end of the gzip member");
+                break;
+            }
+            strm.next_in = in;
+            strm.avail_in = n;
+        }
+
+        strm.next_out = out;
+        strm.avail_out = sizeof(out);
+        zret = inflate(&strm, Z_NO_FLUSH);
+        if (zret != Z_OK && zret != Z_STREAM_END) {
+            ret = CRE_GZ;
+            g_set_error(err, ERR_DOMAIN, CRE_GZ,
+                        "inflate() error (%d): %s", zret, zError(zret));
+            break;
+        }
+
+        g_string_append_len(str, (gchar *) out, sizeof(out) - strm.avail_out);
+        if (str->len > max_len) {
+            ret = CRE_BADARG;
+            g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                        "The first gzip member is bigger than %zu bytes",
+                        max_len);
+            break;
+        }
+    }
+
+    *end = strm.total_in;
+    inflateEnd(&strm);
+
+    if (ret != CRE_OK) {
+        g_string_free(str, TRUE);
+        return ret;
+    }
+
+    *data = str;
+    return CRE_OK;
+}
+
+/** Decode the index of the xz file.
+ * Only files with a single stream without stream padding are supported.
+ * @param f             Opened file
+ * @param flags         Stream flags (output)
+ * @param index_offset  Offset of the index in the file (output)
+ * @param err           GError **
+ * @return              Index or NULL on error
+ */
+static lzma_index *
+cr_xz_read_index(FILE *f,
+                 lzma_stream_flags *flags,
+                 off_t *index_offset,
+                 GError **err)
+{
+    uint8_t header[LZMA_STREAM_HEADER_SIZE];
+    uint8_t footer[LZMA_STREAM_HEADER_SIZE];
+    lzma_stream_flags header_flags;
+    lzma_index *index = NULL;
+    uint64_t memlimit = XZ_MEMORY_USAGE_LIMIT;
+    uint8_t *buf;
+    size_t pos = 0;
+    off_t file_size;
+
+    if (fseeko(f, 0, SEEK_END) != 0
+        || (file_size = ftello(f)) < 2 * LZMA_STREAM_HEADER_SIZE
+        || fseeko(f, 0, SEEK_SET) != 0
+        || fread(header, 1, sizeof(header), f) != sizeof(header)
+        || fseeko(f, -LZMA_STREAM_HEADER_SIZE, SEEK_END) != 0
+        || fread(footer, 1, sizeof(footer), f) != sizeof(footer))
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot read the xz stream header and footer");
+        return NULL;
+    }
+
+    if (lzma_stream_header_decode(&header_flags, header) != LZMA_OK
+        || lzma_stream_footer_decode(flags, footer) != LZMA_OK
+        || lzma_stream_flags_compare(&header_flags, flags) != LZMA_OK
+        || flags->backward_size + 2 * LZMA_STREAM_HEADER_SIZE > (uint64_t) file_size)
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_XZ,
+                    "Not a single stream xz file");
+        return NULL;
+    }
+
+    *index_offset = file_size - LZMA_STREAM_HEADER_SIZE - flags->backward_size;
+    buf = g_malloc(flags->backward_size);
+    if (fseeko(f, *index_offset, SEEK_SET) != 0
+        || fread(buf, 1, flags->backward_size, f) != flags->backward_size)
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_IO, "Cannot read the xz index");
+        g_free(buf);
+        return NULL;
+    }
+
+    if (lzma_index_buffer_decode(&index, &memlimit, NULL, buf, &pos,
+                                 flags->backward_size) != LZMA_OK
+        || lzma_index_file_size(index) != (lzma_vli) file_size)
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_XZ,
+                    "Bad or unsupported xz index");
+        if (index)
+            lzma_index_end(index, NULL);
+        index = NULL;
+    }
+
+    g_free(buf);
+    return index;
+}
+
+ssize_t
+cr_get_first_chunk(const char *filename,
+                   cr_CompressionType type,
+                   size_t max_len,
+                   char **data,
+                   GError **err)
+{
+    ssize_t ret = CR_CW_ERR;
+    FILE *f;
+
+    assert(filename);
+    assert(data);
+    assert(!err || *err == NULL);
+
+    f = fopen(filename, "rb");
+    if (!f) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "fopen(): %s", g_strerror(errno));
+        return CR_CW_ERR;
+    }
+
+    switch (type) {
+        case (CR_CW_GZ_COMPRESSION): { // -------------------------------------
+            GString *str = NULL;
+            off_t end;
+
+            if (cr_gz_first_member(f, max_len, &str, &end, err) == CRE_OK) {
+                ret = str->len;
+                *data = g_string_free(str, FALSE);
+            }
+            break;
+        }
+
+        case (CR_CW_XZ_COMPRESSION): { // -------------------------------------
+            lzma_stream_flags flags;
+            lzma_index_iter iter;
+            off_t index_offset;
+            lzma_index *index;
+            CR_FILE *cr_file;
+
+            index = cr_xz_read_index(f, &flags, &index_offset, err);
+            if (!index)
+                break;
+
+            lzma_index_iter_init(&iter, index);
+            if (lzma_index_iter_next(&iter, LZMA_INDEX_ITER_BLOCK)) {
+                g_set_error(err, ERR_DOMAIN, CRE_XZ, "No block in xz file");
+            } else if (iter.block.uncompressed_size > max_len) {
+                g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                            "The first xz block is bigger than %zu bytes",
+                            max_len);
+            } else if ((cr_file = cr_open(filename, CR_CW_MODE_READ,
+                                          CR_CW_XZ_COMPRESSION, err))) {
+                // Blocks are decoded sequentially, the first one is at
+                // the beginning of the decompressed data
+                size_t len = iter.block.uncompressed_size;
+                char *buf = g_malloc(len + 1);
+                int rc = len ? cr_read(cr_file, buf, len, err) : 0;
+
+                cr_close(cr_file, NULL);
+                if (rc == (int) len) {
+                    buf[len] = '\0';
+                    *data = buf;
+                    ret = len;
+                } else {
+                    if (rc != CR_CW_ERR)
+                        g_set_error(err, ERR_DOMAIN, CRE_XZ,
+                                    "Unexpected end of the first xz block");
+                    g_free(buf);
+                }
+            }
+
+            lzma_index_end(index, NULL);
+            break;
+        }
+
+        default: // -----------------------------------------------------------
+            g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                        "Chunks of this compression type are not supported");
+            break;
+    }
+
+    fclose(f);
+    return ret;
+}
+
+/** Encode the data as a single xz block.
+ */
+static uint8_t *
+cr_xz_encode_block(const char *data,
+                   size_t len,
+                   lzma_check check,
+                   size_t *size,
+                   lzma_vli *unpadded_size,
+                   GError **err)
+{
+    lzma_options_lzma opt_lzma;
+    lzma_filter filters[2];
+    lzma_block block;
+    lzma_ret lret;
+    size_t out_size = lzma_block_buffer_bound(len);
+    uint8_t *out = g_malloc(out_size);
+
+    lzma_lzma_preset(&opt_lzma, CR_CW_XZ_COMPRESSION_LEVEL);
+    filters[0].id = LZMA_FILTER_LZMA2;
+    filters[0].options = &opt_lzma;
+    filters[1].id = LZMA_VLI_UNKNOWN;
+    filters[1].options = NULL;
+
+    memset(&block, 0, sizeof(block));
+    block.version = 0;
+    block.check = check;
+    block.filters = filters;
+
+    *size = 0;
+    lret = lzma_block_buffer_encode(&block, NULL, (const uint8_t *) data, len,
+                                    out, size, out_size);
+    if (lret != LZMA_OK) {
+        g_set_error(err, ERR_DOMAIN, CRE_XZ,
+                    "lzma_block_buffer_encode() error (%d)", lret);
+        g_free(out);
+        return NULL;
+    }
+
+    *unpadded_size = lzma_block_unpadded_size(&block);
+    return out;
+}
+
+/** Write the stream header, the new first block, the original other
+ * blocks and a new index into the dst.
+ */
+static int
+cr_xz_replace_first_block(FILE *src,
+                          FILE *dst,
+                          const char *data,
+                          size_t len,
+                          GError **err)
+{
+    int ret = CRE_XZ;
+    lzma_stream_flags flags;
+    lzma_index_iter iter;
+    lzma_index *index, *new_index = NULL;
+    lzma_vli unpadded_size;
+    off_t index_offset, blocks_offset;
+    uint8_t stream_header[LZMA_STREAM_HEADER_SIZE];
+    uint8_t stream_footer[LZMA_STREAM_HEADER_SIZE];
+    uint8_t *block = NULL, *index_buf = NULL;
+    size_t block_size, index_size, pos = 0;
+
+    index = cr_xz_read_index(src, &flags, &index_offset, err);
+    if (!index)
+        return CRE_XZ;
+
+    lzma_index_iter_init(&iter, index);
+    if (lzma_index_iter_next(&iter, LZMA_INDEX_ITER_BLOCK)) {
+        g_set_error(err, ERR_DOMAIN, CRE_XZ, "No block in xz file");
+        goto cleanup;
+    }
+    blocks_offset = iter.block.compressed_file_offset + iter.block.total_size;
+
+    block = cr_xz_encode_block(data, len, flags.check,
+                               &block_size, &unpadded_size, err);
+    if (!block)
+        goto cleanup;
+
+    // The index lists the new first block and the original rest
+    new_index = lzma_index_init(NULL);
+    if (!new_index
+        || lzma_index_append(new_index, NULL, unpadded_size, len) != LZMA_OK)
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_XZ, "Cannot create xz index");
+        goto cleanup;
+    }
+    while (!lzma_index_iter_next(&iter, LZMA_INDEX_ITER_BLOCK)) {
+        if (lzma_index_append(new_index, NULL,
+                              iter.block.unpadded_size,
+                              iter.block.uncompressed_size) != LZMA_OK)
+        {
+            g_set_error(err, ERR_DOMAIN, CRE_XZ, "Cannot create xz index");
+            goto cleanup;
+        }
+    }
+
+    index_size = lzma_index_size(new_index);
+    index_buf = g_malloc(index_size);
+    flags.backward_size = index_size;
+    if (lzma_index_buffer_encode(new_index, index_buf, &pos, index_size) != LZMA_OK
+        || lzma_stream_header_encode(&flags, stream_header) != LZMA_OK
+        || lzma_stream_footer_encode(&flags, stream_footer) != LZMA_OK)
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_XZ, "Cannot encode xz index");
+        goto cleanup;
+    }
+
+    if (fwrite(stream_header, 1, sizeof(stream_header), dst) != sizeof(stream_header)
+        || fwrite(block, 1, block_size, dst) != block_size)
+    {
+        ret = CRE_IO;
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "fwrite(): %s", g_strerror(errno));
+        goto cleanup;
+    }
+
+    ret = cr_copy_file_range(src, blocks_offset, index_offset, dst, err);
+    if (ret != CRE_OK)
+        goto cleanup;
+
+    if (fwrite(index_buf, 1, index_size, dst) != index_size
+        || fwrite(stream_footer, 1, sizeof(stream_footer), dst) != sizeof(stream_footer))
+    {
+        ret = CRE_IO;
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "fwrite(): %s", g_strerror(errno));
+        goto cleanup;
+    }
+
+    ret = CRE_OK;
+
+cleanup:
+    g_free(block);
+    g_free(index_buf);
+    if (new_index)
+        lzma_index_end(new_index, NULL);
+    lzma_index_end(index, NULL);
+    return ret;
+}
+
+/** Write a gzip member with the data and the original other members
+ * into the dst.
+ */
+static int
+cr_gz_replace_first_member(FILE *src,
+                           FILE *dst,
+                           const char *data,
+                           size_t len,
+                           GError **err)
+{
+    GString *old = NULL;
+    off_t end;
+    z_stream strm;
+    unsigned char *out;
+    size_t out_size;
+    int ret;
+
+    // Find the end of the original member
+    ret = cr_gz_first_member(src, G_MAXSIZE, &old, &end, err);
+    if (ret != CRE_OK)
+        return ret;
+    g_string_free(old, TRUE);
+
+    memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, CR_CW_GZ_COMPRESSION_LEVEL, Z_DEFLATED,
+                     16 + MAX_WBITS, MAX_MEM_LEVEL, GZ_STRATEGY) != Z_OK)
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_GZ, "deflateInit2() failed");
+        return CRE_GZ;
+    }
+
+    out_size = deflateBound(&strm, len);
+    out = g_malloc(out_size);
+    strm.next_in = (unsigned char *) data;
+    strm.avail_in = len;
+    strm.next_out = out;
+    strm.avail_out = out_size;
+    ret = deflate(&strm, Z_FINISH);
+    deflateEnd(&strm);
+
+    if (ret != Z_STREAM_END) {
+        g_set_error(err, ERR_DOMAIN, CRE_GZ,
+                    "deflate() error (%d): %s", ret, zError(ret));
+        g_free(out);
+        return CRE_GZ;
+    }
+
+    ret = CRE_OK;
+    if (fwrite(out, 1, out_size - strm.avail_out, dst) != out_size - strm.avail_out) {
+        ret = CRE_IO;
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "fwrite(): %s", g_strerror(errno));
+    }
+    g_free(out);
+
+    if (ret == CRE_OK)
+        ret = cr_copy_file_range(src, end, -1, dst, err);
+
+    return ret;
+}
+
+int
+cr_replace_first_chunk(const char *src_filename,
+                       const char *dst_filename,
+                       cr_CompressionType type,
+                       const char *data,
+                       size_t len,
+                       GError **err)
+{
+    int ret;
+    FILE *src, *dst;
+    GError *tmp_err = NULL;
+
+    assert(src_filename);
+    assert(dst_filename);
+    assert(data || len == 0);
+    assert(!err || *err == NULL);
+
+    if (type != CR_CW_GZ_COMPRESSION && type != CR_CW_XZ_COMPRESSION) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "Chunks of this compression type are not supported");
+        return CRE_BADARG;
+    }
+
+    src = fopen(src_filename, "rb");
+    if (!src) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "fopen(): %s", g_strerror(errno));
+        return CRE_IO;
+    }
+
+    dst = fopen(dst_filename, "wb");
+    if (!dst) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "fopen(): %s", g_strerror(errno));
+        fclose(src);
+        return CRE_IO;
+    }
+
+    if (type == CR_CW_GZ_COMPRESSION)
+        cr_gz_replace_first_member(src, dst, data, len, &tmp_err);
+    else
+        cr_xz_replace_first_block(src, dst, data, len, &tmp_err);
+
+    fclose(src);
+    if (fclose(dst) != 0 && !tmp_err)
+        g_set_error(&tmp_err, ERR_DOMAIN, CRE_IO,
+                    "fclose(): %s", g_strerror(errno));
+
+    if (tmp_err) {
+        ret = tmp_err->code;
+        g_propagate_error(err, tmp_err);
+        remove(dst_filename);
+        return ret;
+    }
+
+    return CRE_OK;
+}
@@ -42,6 +42,7 @@ typedef enum {
     CR_CW_BZ2_COMPRESSION,            /*!< BZip2 compression */
     CR_CW_XZ_COMPRESSION,             /*!< XZ compression */
     CR_CW_ZCK_COMPRESSION,            /*!< ZCK compression */
+    CR_CW_ZSTD_COMPRESSION,           /*!< Zstandard compression */
     CR_CW_COMPRESSION_SENTINEL,       /*!< Sentinel of the list */
 } cr_CompressionType;
 
@@ -62,6 +63,13 @@ typedef struct {
     gint64          hdr_size;           /*!< Size of content */
     cr_ChecksumType hdr_checksum_type;  /*!< Checksum type */
     char            *hdr_checksum;      /*!< Checksum */
+    gint64          compressed_size;    /*!< Size of the written (compressed)
+                                             file, valid only if the
+                                             compressed_checksum is set */
+    char            *compressed_checksum; /*!< Checksum (checksum_type) of
+                                             the written (compressed) file.
+                                             NULL if it wasn't computed
+                                             (see cr_sopen()) */
 } cr_ContentStat;
 
 /** Creates new cr_ContentStat object
@@ -87,10 +95,38 @@ typedef struct {
     cr_OpenMode         mode;           /*!< Mode */
     cr_ContentStat      *stat;          /*!< Content stats */
     cr_ChecksumCtx      *checksum_ctx;  /*!< Checksum contenxt */
+    int                 threads;        /*!< Compression threads (0 or 1 -
+                                             single threaded) */
+    void                *readahead;     /*!< Background decompression
+                                             (see cr_set_readahead()) */
+    void                *tee;           /*!< Checksum of the written
+                                             (compressed) data */
 } CR_FILE;
 
 #define CR_CW_ERR       -1      /*!< Return value - Error */
 
+/** Size of a single block decompressed in advance by the read-ahead
+ * thread (see cr_set_readahead()).
+ */
+#define CR_CW_READAHEAD_BLOCK_SIZE      (1024*1024)
+
+/** Number of blocks used by the read-ahead thread.
+ */
+#define CR_CW_READAHEAD_BLOCKS          4
+
+/** Set number of threads used for compression of files opened for
+ * writing afterwards. Multiple threads are used by the gzip, xz and zstd
+ * compression, xz uses at most 2 threads to keep memory usage lower.
+ * Default is 1 (single threaded compression).
+ * @param threads       Number of threads
+ */
+void cr_compression_set_threads(int threads);
+
+/** Get number of threads used for compression.
+ * @return              Number of threads
+ */
+int cr_compression_get_threads(void);
+
 /** Returns a common suffix for the specified cr_CompressionType.
  * @param comtype       compression type
  * @return              common file suffix
@@ -123,6 +159,10 @@ cr_CompressionType cr_compression_type(const char *name);
 /** Open/Create the specified file. If opened for writting, you can pass
  * a cr_ContentStat object and after cr_close() get stats of
  * an open content (stats of uncompressed content).
+ * The written compressed data are checksummed too (compressed_checksum
+ * and compressed_size of the stat), so the file doesn't have to be read
+ * again. This is not supported by the single threaded gzip and zchunk
+ * compression which write the file on their own.
  * @param filename      filename
  * @param mode          open mode
  * @param comtype       type of compression
@@ -154,6 +194,30 @@ int cr_set_dict(CR_FILE *cr_file, const void *dict, unsigned int len, GError **e
  */
 int cr_read(CR_FILE *cr_file, void *buffer, unsigned int len, GError **err);
 
+/** Start decompression of the file in a background thread. The thread
+ * fills a ring of CR_CW_READAHEAD_BLOCKS blocks (of
+ * CR_CW_READAHEAD_BLOCK_SIZE bytes) in advance, so the decompression
+ * overlaps with the processing of the already read data.
+ * The data could be then obtained by cr_read_block() (without copying)
+ * or by cr_read(). The thread is stopped by cr_close().
+ * Must be called before the first read.
+ * @param cr_file       CR_FILE pointer (opened in read mode)
+ * @param err           GError **
+ * @return              CRE_OK or CR_CW_ERR (-1)
+ */
+int cr_set_readahead(CR_FILE *cr_file, GError **err);
+
+/** Get the next block of data decompressed by the read-ahead thread.
+ * The block is valid until the next cr_read_block(), cr_read() or
+ * cr_close() call.
+ * @param cr_file       CR_FILE pointer (see cr_set_readahead())
+ * @param buffer        pointer to the block (output)
+ * @param err           GError **
+ * @return              size of the block (0 at the end of the file)
+ *                      or CR_CW_ERR (-1)
+ */
+int cr_read_block(CR_FILE *cr_file, const void **buffer, GError **err);
+
 /** Writes the array of len bytes from buffer to the cr_file.
  * @param cr_file       CR_FILE pointer
  * @param buffer        source buffer
@@ -175,7 +239,10 @@ int cr_write(CR_FILE *cr_file,
  */
 int cr_puts(CR_FILE *cr_file, const char *str, GError **err);
 
-/** If compression format allows ending of chunks, tell it to end chunk
+/** If compression format allows ending of chunks, tell it to end chunk.
+ * A zchunk chunk, a gzip member or a xz block is ended, so the data
+ * written so far could be decompressed (and replaced, see
+ * cr_replace_first_chunk()) independently of the following data.
  * @param cr_file       CR_FILE pointer
  * @param err           GError **
  * @return              CRE_OK or CR_CW_ERR
@@ -199,6 +266,40 @@ int cr_set_autochunk(CR_FILE *cr_file, gboolean auto_chunk, GError **err);
  */
 ssize_t cr_get_zchunk_with_index(CR_FILE *f, ssize_t zchunk_index, char **copy_buf, GError **err);
 
+/** Decompress the first chunk (the data written before the first
+ * cr_end_chunk() call) of a gzip or xz file.
+ * @param filename      Filename
+ * @param type          CR_CW_GZ_COMPRESSION or CR_CW_XZ_COMPRESSION
+ * @param max_len       Max allowed size of the decompressed chunk
+ * @param data          Output pointer, upon return contains malloced
+ *                      null terminated data of the chunk
+ * @param err           GError **
+ * @return              Size of the data or CR_CW_ERR
+ */
+ssize_t cr_get_first_chunk(const char *filename,
+                           cr_CompressionType type,
+                           size_t max_len,
+                           char **data,
+                           GError **err);
+
+/** Copy a gzip or xz file and replace its first chunk (see
+ * cr_get_first_chunk()) with the new data. Only the new data are
+ * compressed, the rest of the file is copied as is.
+ * @param src_filename  Original file
+ * @param dst_filename  New file
+ * @param type          CR_CW_GZ_COMPRESSION or CR_CW_XZ_COMPRESSION
+ * @param data          New content of the first chunk
+ * @param len           Size of the data
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+int cr_replace_first_chunk(const char *src_filename,
+                           const char *dst_filename,
+                           cr_CompressionType type,
+                           const char *data,
+                           size_t len,
+                           GError **err);
+
 /** Writes a formatted string into the cr_file.
  * @param err           GError **
  * @param cr_file       CR_FILE pointer
@@ -85,22 +85,155 @@ allowed_file(const gchar *filename, GSList *exclude_masks)
 /** Function used to sort pool tasks.
  * This function is responsible for order of packages in metadata.
  *
- * @param a_p           Pointer to first struct PoolTask
- * @param b_p           Pointer to second struct PoolTask
- * @param user_data     Unused (user data)
+ * @param a_p           Pointer to pointer to first struct PoolTask
+ * @param b_p           Pointer to pointer to second struct PoolTask
  */
 static int
-task_cmp(gconstpointer a_p, gconstpointer b_p, G_GNUC_UNUSED gpointer user_data)
+task_cmp(gconstpointer a_p, gconstpointer b_p)
 {
     int ret;
-    const struct PoolTask *a = a_p;
-    const struct PoolTask *b = b_p;
+    const struct PoolTask *a = *((struct PoolTask **) a_p);
+    const struct PoolTask *b = *((struct PoolTask **) b_p);
     ret = g_strcmp0(a->filename, b->filename);
     if (ret) return ret;
     return g_strcmp0(a->path, b->path);
 }
 
 
+/** Shared state of the parallel directory walk.
+ */
+struct DirWalk {
+    GThreadPool *pool;              // Pool of threads scanning directories
+    struct CmdOptions *cmd_options; // Options specified on command line
+    size_t in_dir_len;              // Length of the input dir path
+    GPtrArray *tasks;               // Found packages (struct PoolTask)
+    long pending;                   // Number of dirs queued or being scanned
+    GMutex mutex;                   // Mutex for tasks and pending
+    GCond cond;                     // Signaled when pending drops to zero
+};
+
+
+/** Scan a single directory. Packages found are appended to the
+ * walk->tasks, subdirectories are pushed back into the walk->pool.
+ * The type of an entry is taken from d_type, stat is called
+ * only when the type is unknown or the entry is a symlink.
+ */
+static void
+dir_walk_thread(gpointer data, gpointer user_data)
+{
+    gchar *dirname = data;
+    struct DirWalk *walk = user_data;
+    struct CmdOptions *cmd_options = walk->cmd_options;
+    GPtrArray *found = g_ptr_array_new();
+    GPtrArray *sub_dirs = g_ptr_array_new();
+    DIR *dirp;
+    struct dirent *entry;
+
+    dirp = opendir(dirname);
+    if (!dirp) {
+        g_warning("Cannot open directory: %s", dirname);
+        goto exit;
+    }
+
+    while ((entry = readdir(dirp))) {
+        const gchar *filename = entry->d_name;
+        gboolean is_reg = FALSE, is_dir = FALSE, is_lnk = FALSE;
+
+        if (!strcmp(filename, ".") || !strcmp(filename, ".."))
+            continue;
+
+        if (!allowed_file(filename, cmd_options->exclude_masks))
+            continue;
+
+#ifdef _DIRENT_HAVE_D_TYPE
+        if (entry->d_type == DT_REG) {
+            is_reg = TRUE;
+        } else if (entry->d_type == DT_DIR) {
+            is_dir = TRUE;
+        } else if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
+#endif
+        {
+            // Follow the symlink (or find out the unknown type)
+            struct stat st;
+#ifdef _DIRENT_HAVE_D_TYPE
+            is_lnk = (entry->d_type == DT_LNK);
+#endif
+            if (fstatat(dirfd(dirp), filename, &st, 0) == 0) {
+                is_reg = S_ISREG(st.st_mode);
+                is_dir = S_ISDIR(st.st_mode);
+            }
+            if (!is_lnk && is_reg && cmd_options->skip_symlinks) {
+                // d_type is unknown - check the link itself
+                if (fstatat(dirfd(dirp), filename, &st, AT_SYMLINK_NOFOLLOW) == 0)
+                    is_lnk = S_ISLNK(st.st_mode);
+            }
+        }
+
+        if (!is_reg) {
+            if (is_dir) {
+                // Directory
+                gchar *sub_dir = g_strconcat(dirname, "/", filename, NULL);
+                g_ptr_array_add(sub_dirs, sub_dir);
+                g_debug("Dir to scan: %s", sub_dir);
+            }
+            continue;
+        }
+
+        // Non .rpm files are ignored
+        if (!g_str_has_suffix (filename, ".rpm"))
+            continue;
+
+        gchar *full_path = g_strconcat(dirname, "/", filename, NULL);
+
+        // Skip symbolic links if --skip-symlinks arg is used
+        if (cmd_options->skip_symlinks && is_lnk) {
+            g_debug("Skipped symlink: %s", full_path);
+            g_free(full_path);
+            continue;
+        }
+
+        // Check filename against exclude glob masks
+        const gchar *repo_relative_path = filename;
+        if (walk->in_dir_len < strlen(full_path))
+            // This probably should be always true
+            repo_relative_path = full_path + walk->in_dir_len;
+
+        if (allowed_file(repo_relative_path, cmd_options->exclude_masks)) {
+            // FINALLY! Add file into pool
+            g_debug("Adding pkg: %s", full_path);
+            struct PoolTask *task = g_malloc(sizeof(struct PoolTask));
+            task->full_path = full_path;
+            task->filename = g_strdup(filename);
+            task->path = g_strdup(dirname);
+            g_ptr_array_add(found, task);
+        } else {
+            g_free(full_path);
+        }
+    }
+
+    closedir(dirp);
+
+exit:
+    g_mutex_lock(&(walk->mutex));
+    for (guint x = 0; x < found->len; x++)
+        g_ptr_array_add(walk->tasks, g_ptr_array_index(found, x));
+    // Subdirs are counted before this dir is done, so pending can
+    // drop to zero only when the whole tree is scanned
+    walk->pending += sub_dirs->len;
+    walk->pending--;
+    if (walk->pending == 0)
+        g_cond_signal(&(walk->cond));
+    g_mutex_unlock(&(walk->mutex));
+
+    for (guint x = 0; x < sub_dirs->len; x++)
+        g_thread_pool_push(walk->pool, g_ptr_array_index(sub_dirs, x), NULL);
+
+    g_ptr_array_free(found, TRUE);
+    g_ptr_array_free(sub_dirs, TRUE);
+    g_free(dirname);
+}
+
+
 /** Recursively walkt throught the input directory and add push the found
  * rpms to the thread pool (create a PoolTask and push it to the pool).
  * If the filelists is supplied then no recursive walk is done and only
@@ -108,6 +241,10 @@ task_cmp(gconstpointer a_p, gconstpointer b_p, G_GNUC_UNUSED gpointer user_data)
  * This function also filters out files that shoudn't be processed
  * (e.g. directories with .rpm suffix, files that match one of
  * the exclude masks, etc.).
+ * The directories are scanned in parallel (by cmd_options->workers
+ * threads), the found packages are sorted once at the end, so the
+ * order of the tasks (and thus the metadata) doesn't depend on the
+ * order of the scanning.
  *
  * @param pool              GThreadPool pool
  * @param in_dir            Directory to scan
@@ -124,7 +261,7 @@ fill_pool(GThreadPool *pool,
           long *task_count,
           int  media_id)
 {
-    GQueue queue = G_QUEUE_INIT;
+    GPtrArray *tasks = g_ptr_array_new();
     struct PoolTask *task;
 
     if ( ! cmd_options->split ) {
@@ -140,89 +277,32 @@ fill_pool(GThreadPool *pool,
 
         g_message("Directory walk started");
 
+        struct DirWalk walk;
         size_t in_dir_len = strlen(in_dir);
-        GStringChunk *sub_dirs_chunk = g_string_chunk_new(1024);
-        GQueue *sub_dirs = g_queue_new();
-        gchar *input_dir_stripped;
-
-        input_dir_stripped = g_string_chunk_insert_len(sub_dirs_chunk,
-                                                       in_dir,
-                                                       in_dir_len-1);
-        g_queue_push_head(sub_dirs, input_dir_stripped);
-
-        char *dirname;
-        while ((dirname = g_queue_pop_head(sub_dirs))) {
-            // Open dir
-            GDir *dirp;
-            dirp = g_dir_open (dirname, 0, NULL);
-            if (!dirp) {
-                g_warning("Cannot open directory: %s", dirname);
-                continue;
-            }
-
-            const gchar *filename;
-            while ((filename = g_dir_read_name(dirp))) {
-                if (!allowed_file(filename, cmd_options->exclude_masks)) {
-                    continue;
-                }
-
-                gchar *full_path = g_strconcat(dirname, "/", filename, NULL);
-
-                if (!g_file_test(full_path, G_FILE_TEST_IS_REGULAR)) {
-                    if (g_file_test(full_path, G_FILE_TEST_IS_DIR)) {
-                        // Directory
-                        gchar *sub_dir_in_chunk;
-                        sub_dir_in_chunk = g_string_chunk_insert(sub_dirs_chunk,
-                                                                 full_path);
-                        g_queue_push_head(sub_dirs, sub_dir_in_chunk);
-                        g_debug("Dir to scan: %s", sub_dir_in_chunk);
-                    }
-                    g_free(full_path);
-                    continue;
-                }
-
-                // Non .rpm files are ignored
-                if (!g_str_has_suffix (filename, ".rpm")) {
-                    g_free(full_path);
-                    continue;
-                }
 
-                // Skip symbolic links if --skip-symlinks arg is used
-                if (cmd_options->skip_symlinks
-                    && g_file_test(full_path, G_FILE_TEST_IS_SYMLINK))
-                {
-                    g_debug("Skipped symlink: %s", full_path);
-                    g_free(full_path);
-                    continue;
-                }
-
-                // Check filename against exclude glob masks
-                const gchar *repo_relative_path = filename;
-                if (in_dir_len < strlen(full_path))
-                    // This probably should be always true
-                    repo_relative_path = full_path + in_dir_len;
-
-                if (allowed_file(repo_relative_path, cmd_options->exclude_masks)) {
-                    // FINALLY! Add file into pool
-                    g_debug("Adding pkg: %s", full_path);
-                    task = g_malloc(sizeof(struct PoolTask));
-                    task->full_path = full_path;
-                    task->filename = g_strdup(filename);
-                    task->path = g_strdup(dirname);
-                    *current_pkglist = g_slist_prepend(*current_pkglist, task->filename);
-                    // TODO: One common path for all tasks with the same path?
-                    g_queue_insert_sorted(&queue, task, task_cmp, NULL);
-                } else {
-                    g_free(full_path);
-                }
-            }
-
-            // Cleanup
-            g_dir_close (dirp);
-        }
-
-        g_string_chunk_free (sub_dirs_chunk);
-        g_queue_free(sub_dirs);
+        walk.cmd_options = cmd_options;
+        walk.in_dir_len  = in_dir_len;
+        walk.tasks       = tasks;
+        walk.pending     = 1;
+        g_mutex_init(&(walk.mutex));
+        g_cond_init(&(walk.cond));
+        walk.pool = g_thread_pool_new(dir_walk_thread,
+                                      &walk,
+                                      cmd_options->workers,
+                                      TRUE,
+                                      NULL);
+
+        g_thread_pool_push(walk.pool, g_strndup(in_dir, in_dir_len-1), NULL);
+
+        // Wait until the whole tree is scanned
+        g_mutex_lock(&(walk.mutex));
+        while (walk.pending > 0)
+            g_cond_wait(&(walk.cond), &(walk.mutex));
+        g_mutex_unlock(&(walk.mutex));
+
+        g_thread_pool_free(walk.pool, FALSE, TRUE);
+        g_mutex_clear(&(walk.mutex));
+        g_cond_clear(&(walk.cond));
     } else {
         // pkglist is supplied - use only files in pkglist
 
@@ -253,20 +333,25 @@ fill_pool(GThreadPool *pool,
                 task->full_path = full_path;
                 task->filename  = g_strdup(filename);         // foobar.rpm
                 task->path      = strndup(relative_path, x);  // packages/i386/
-                *current_pkglist = g_slist_prepend(*current_pkglist, task->filename);
-                g_queue_insert_sorted(&queue, task, task_cmp, NULL);
+                g_ptr_array_add(tasks, task);
             }
         }
     }
 
-    // Push sorted tasks into the thread pool
-    while ((task = g_queue_pop_head(&queue)) != NULL) {
+    // Sort the tasks once and push them into the thread pool
+    g_ptr_array_sort(tasks, task_cmp);
+
+    for (guint x = 0; x < tasks->len; x++) {
+        task = g_ptr_array_index(tasks, x);
         task->id = *task_count;
         task->media_id = media_id;
+        *current_pkglist = g_slist_prepend(*current_pkglist, task->filename);
         g_thread_pool_push(pool, task, NULL);
         ++*task_count;
     }
 
+    g_ptr_array_free(tasks, TRUE);
+
     return *task_count;
 }
 
@@ -465,6 +550,11 @@ load_old_metadata(cr_Metadata **md,
 
     *md = cr_metadata_new(CR_HT_KEY_HREF, 1, current_pkglist);
     cr_metadata_set_dupaction(*md, CR_HT_DUPACT_REMOVEALL);
+    // Unchanged packages are written as they are in the old metadata
+    cr_metadata_set_keep_raw_xml(*md, TRUE);
+    // Filelists and changelogs are loaded only for the reused packages
+    cr_metadata_set_lazy_loading(*md, TRUE);
+    cr_metadata_set_parallel_loading(*md, TRUE);
 
     int ret;
 
@@ -810,6 +900,10 @@ main(int argc, char **argv)
     g_message("Temporary output repo path: %s", tmp_out_repo);
     g_debug("Creating .xml.gz files");
 
+    // Metadata files are compressed by the same number of threads
+    // as the packages are read by
+    cr_compression_set_threads(cmd_options->workers);
+
     pri_xml_filename = g_strconcat(tmp_out_repo, "/primary.xml", xml_compression_suffix, NULL);
     fil_xml_filename = g_strconcat(tmp_out_repo, "/filelists.xml", xml_compression_suffix, NULL);
     oth_xml_filename = g_strconcat(tmp_out_repo, "/other.xml", xml_compression_suffix, NULL);
@@ -1093,6 +1187,22 @@ main(int argc, char **argv)
         cr_xmlfile_set_num_of_pkgs(oth_cr_zck, task_count, NULL);
     }
 
+    // Open cache of checksums
+    cr_ChecksumCache *checksum_cache = NULL;
+    if (cmd_options->checksum_cachedir) {
+        _cleanup_free_ gchar *cache_path = NULL;
+        cache_path = g_build_filename(cmd_options->checksum_cachedir,
+                                      CR_CHECKSUM_CACHE_FILENAME, NULL);
+        checksum_cache = cr_checksum_cache_open(cache_path, &tmp_err);
+        if (!checksum_cache) {
+            g_critical("%s", tmp_err->message);
+            g_clear_error(&tmp_err);
+            exit(EXIT_FAILURE);
+        }
+        g_debug("Checksum cache %s loaded (%u records)", cache_path,
+                cr_checksum_cache_size(checksum_cache));
+    }
+
     // Thread pool - User data initialization
     user_data.pri_f             = pri_cr_file;
     user_data.fil_f             = fil_cr_file;
@@ -1111,7 +1221,7 @@ main(int argc, char **argv)
     user_data.location_base     = cmd_options->location_base;
     user_data.checksum_type_str = cr_checksum_name_str(cmd_options->checksum_type);
     user_data.checksum_type     = cmd_options->checksum_type;
-    user_data.checksum_cachedir = cmd_options->checksum_cachedir;
+    user_data.checksum_cache    = checksum_cache;
     user_data.skip_symlinks     = cmd_options->skip_symlinks;
     user_data.repodir_name_len  = strlen(in_dir);
     user_data.task_count        = task_count;
@@ -1121,7 +1231,9 @@ main(int argc, char **argv)
     user_data.id_pri            = 0;
     user_data.id_fil            = 0;
     user_data.id_oth            = 0;
-    user_data.buffer            = g_queue_new();
+    user_data.ring_len          = CR_DUMPER_RING_LEN;
+    user_data.ring              = g_new0(gpointer, user_data.ring_len);
+    user_data.ring_draining     = 0;
     user_data.deltas            = cmd_options->deltas;
     user_data.max_delta_rpm_size= cmd_options->max_delta_rpm_size;
     user_data.deltatargetpackages = NULL;
@@ -1129,6 +1241,9 @@ main(int argc, char **argv)
     user_data.location_prefix   = cmd_options->location_prefix;
     user_data.had_errors        = 0;
     user_data.output_pkg_list   = output_pkg_list;
+    user_data.db_shards         = 0;
+    if (cmd_options->sharded_sqlite)
+        user_data.db_shards     = MIN(cmd_options->workers, CR_DB_MAX_SHARDS);
 
     g_mutex_init(&(user_data.mutex_output_pkg_list));
     g_mutex_init(&(user_data.mutex_pri));
@@ -1137,12 +1252,17 @@ main(int argc, char **argv)
     g_cond_init(&(user_data.cond_pri));
     g_cond_init(&(user_data.cond_fil));
     g_cond_init(&(user_data.cond_oth));
-    g_mutex_init(&(user_data.mutex_buffer));
     g_mutex_init(&(user_data.mutex_old_md));
     g_mutex_init(&(user_data.mutex_deltatargetpackages));
 
+    // Sqlite inserts are done by dedicated threads
+    cr_dumper_db_writers_start(&user_data);
+
     g_debug("Thread pool user data ready");
 
+    cr_checksum_set_read_size(cmd_options->checksum_read_size);
+    cr_checksum_reset_stats();
+
     // Start pool
     g_thread_pool_set_max_threads(pool, cmd_options->workers, NULL);
     g_message("Pool started (with %d workers)", cmd_options->workers);
@@ -1150,6 +1270,20 @@ main(int argc, char **argv)
     // Wait until pool is finished
     g_thread_pool_free(pool, FALSE, TRUE);
 
+    // Wait until all packages are in the databases
+    cr_dumper_db_writers_finish(&user_data);
+
+    // Store new checksums into the cache (the cache stays opened
+    // for the checksums of drpms)
+    if (checksum_cache) {
+        cr_checksum_cache_flush(checksum_cache, &tmp_err);
+        if (tmp_err) {
+            g_warning("Cannot write checksum cache: %s", tmp_err->message);
+            g_clear_error(&tmp_err);
+        }
+        user_data.checksum_cache = NULL;
+    }
+
     // if there were any errors, exit nonzero
     if ( cmd_options->error_exit_val && user_data.had_errors ) {
 	exit_val = 2;
@@ -1157,6 +1291,17 @@ main(int argc, char **argv)
 
     g_message("Pool finished%s", (user_data.had_errors ? " with errors" : ""));
 
+    cr_ChecksumStats checksum_stats;
+    cr_checksum_get_stats(&checksum_stats);
+    if (checksum_stats.files) {
+        gdouble mib = checksum_stats.bytes / (1024.0 * 1024.0);
+        gdouble secs = checksum_stats.usecs / (gdouble) G_USEC_PER_SEC;
+        g_debug("Checksummed %"G_GINT64_FORMAT" files (%.1f MiB) "
+                "in %.2f thread-seconds (%.1f MiB/s per thread)",
+                checksum_stats.files, mib, secs,
+                secs > 0 ? mib / secs : 0.0);
+    }
+
     cr_xml_dump_cleanup();
 
     if (output_pkg_list)
@@ -1198,12 +1343,13 @@ main(int argc, char **argv)
     /* At the time of writing xml metadata headers we haven't yet parsed all
      * the packages and we don't know whether there were some invalid ones,
      * therefore we write the task count into the headers instead of the actual package count.
-     * If there actually were some invalid packages we have to correct this value
-     * that unfortunately means we have to decompress metadata files change package
-     * count value and compress them again.
+     * If there actually were some invalid packages we have to correct this value.
+     * The headers of gzip and xz files are separate members/blocks, so only
+     * the header is recompressed and the rest of the file is copied, other
+     * files have to be decompressed and compressed again.
      */
     if (user_data.package_count != user_data.task_count){
-        g_message("Warning: There were some invalid packages: we have to recompress other, filelists and primary xml metadata files in order to have correct package counts");
+        g_message("Warning: There were some invalid packages: we have to rewrite headers of other, filelists and primary xml metadata files in order to have correct package counts");
 
         GThreadPool *rewrite_pkg_count_pool = g_thread_pool_new(cr_rewrite_pkg_count_thread,
                                                                 &user_data, 3, FALSE, NULL);
@@ -1292,7 +1438,7 @@ main(int argc, char **argv)
         g_free(oth_dict_file);
     }
 
-    g_queue_free(user_data.buffer);
+    g_free(user_data.ring);
     g_mutex_clear(&(user_data.mutex_output_pkg_list));
     g_mutex_clear(&(user_data.mutex_pri));
     g_mutex_clear(&(user_data.mutex_fil));
@@ -1300,7 +1446,6 @@ main(int argc, char **argv)
     g_cond_clear(&(user_data.cond_pri));
     g_cond_clear(&(user_data.cond_fil));
     g_cond_clear(&(user_data.cond_oth));
-    g_mutex_clear(&(user_data.mutex_buffer));
     g_mutex_clear(&(user_data.mutex_old_md));
     g_mutex_clear(&(user_data.mutex_deltatargetpackages));
 
@@ -1697,12 +1842,13 @@ main(int argc, char **argv)
             }
         }
 
-        ret = cr_deltarpms_generate_prestodelta_file(
+        ret = cr_deltarpms_generate_prestodelta_file_with_cache(
                         outdeltadir,
                         prestodelta_cr_file,
                         prestodelta_cr_zck_file,
                         //cmd_options->checksum_type,
                         CR_CHECKSUM_SHA256, // Createrepo always uses SHA256
+                        checksum_cache,
                         cmd_options->workers,
                         out_dir,
                         &tmp_err);
@@ -1743,6 +1889,32 @@ deltaerror:
     }
 #endif
 
+    // Close the checksum cache
+    if (checksum_cache) {
+        if (cmd_options->cache_gc) {
+            // Keep checksums of drpms if no deltas were generated this time
+            if (!cmd_options->deltas)
+                cr_checksum_cache_touch_prefix(checksum_cache,
+                                               CR_CHECKSUM_CACHE_DRPM_PREFIX);
+
+            gint64 removed = cr_checksum_cache_gc(checksum_cache, &tmp_err);
+            if (removed < 0) {
+                g_warning("Cannot clean up checksum cache: %s", tmp_err->message);
+                g_clear_error(&tmp_err);
+            } else {
+                g_debug("%"G_GINT64_FORMAT" unused records removed from "
+                        "checksum cache", removed);
+            }
+        }
+
+        cr_checksum_cache_close(checksum_cache, &tmp_err);
+        if (tmp_err) {
+            g_warning("Cannot write checksum cache: %s", tmp_err->message);
+            g_clear_error(&tmp_err);
+        }
+        checksum_cache = NULL;
+    }
+
     // Add checksums into files names
     if (cmd_options->unique_md_filenames) {
         cr_repomd_record_rename_file(pri_xml_rec, NULL);
@@ -40,6 +40,7 @@ extern "C" {
 
 #include <glib.h>
 #include "checksum.h"
+#include "checksum_cache.h"
 #include "compression_wrapper.h"
 #include "deltarpms.h"
 #include "error.h"
@@ -57,6 +58,7 @@ extern "C" {
 #include "xml_dump.h"
 #include "xml_file.h"
 #include "xml_parser.h"
+#include "zck_dict.h"
 
 #ifdef __cplusplus
 }
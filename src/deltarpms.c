@@ -157,10 +157,29 @@ errexit:
 
 
 static void
-cr_free_gslist_of_strings(gpointer list)
+cr_free_gslist_of_deltatargetpackages(gpointer list)
 {
     if (!list) return;
-    cr_slist_free_full((GSList *) list, (GDestroyNotify) g_free);
+    cr_slist_free_full((GSList *) list,
+                       (GDestroyNotify) cr_deltatargetpackage_free);
+}
+
+/** Key of the old packages catalog */
+static gchar *
+cr_oldpackage_key(const char *name, const char *arch)
+{
+    // Slash is not allowed in the package name
+    return g_strconcat(name ? name : "", "/", arch ? arch : "", NULL);
+}
+
+static gint
+cmp_deltatargetpackage_evr_desc(gconstpointer aa, gconstpointer bb)
+{
+    const cr_DeltaTargetPackage *a = aa;
+    const cr_DeltaTargetPackage *b = bb;
+
+    return cr_cmp_evr(b->epoch, b->version, b->release,
+                      a->epoch, a->version, a->release);
 }
 
 /*
@@ -173,19 +192,20 @@ cr_deltarpms_scan_oldpackagedirs(GSList *oldpackagedirs,
                                  GError **err)
 {
     GHashTable *ht = NULL;
+    GHashTableIter iter;
+    gpointer value;
 
     assert(!err || *err == NULL);
 
     ht = g_hash_table_new_full(g_str_hash,
                                g_str_equal,
                                (GDestroyNotify) g_free,
-                               (GDestroyNotify) cr_free_gslist_of_strings);
+                               (GDestroyNotify) cr_free_gslist_of_deltatargetpackages);
 
     for (GSList *elem = oldpackagedirs; elem; elem = g_slist_next(elem)) {
         gchar *dirname = elem->data;
         const gchar *filename;
         GDir *dirp;
-        GSList *filenames = NULL;
 
         dirp = g_dir_open(dirname, 0, NULL);
         if (!dirp) {
@@ -196,6 +216,8 @@ cr_deltarpms_scan_oldpackagedirs(GSList *oldpackagedirs,
         while ((filename = g_dir_read_name(dirp))) {
             gchar *full_path;
             struct stat st;
+            cr_DeltaTargetPackage *tpkg;
+            GError *tmp_err = NULL;
 
             if (!g_str_has_suffix(filename, ".rpm"))
                 continue;  // Skip non rpm files
@@ -215,24 +237,164 @@ cr_deltarpms_scan_oldpackagedirs(GSList *oldpackagedirs,
                 continue;
             }
 
+            // Every old package is read only once, here
+            tpkg = cr_deltatargetpackage_from_rpm(full_path, &tmp_err);
+            if (!tpkg) {
+                g_warning("Cannot read %s: %s", full_path, tmp_err->message);
+                g_clear_error(&tmp_err);
+                g_free(full_path);
+                continue;
+            }
             g_free(full_path);
 
-            filenames = g_slist_prepend(filenames, g_strdup(filename));
-        }
-
-        if (filenames) {
-            g_hash_table_replace(ht,
-                                 (gpointer) g_strdup(dirname),
-                                 (gpointer) filenames);
+            gchar *pkg_key = cr_oldpackage_key(tpkg->name, tpkg->arch);
+            GSList *candidates = g_hash_table_lookup(ht, pkg_key);
+            if (candidates) {
+                // Keep the head of the list (the value in the table)
+                candidates->next = g_slist_prepend(candidates->next, tpkg);
+                g_free(pkg_key);
+            } else {
+                g_hash_table_insert(ht, pkg_key, g_slist_prepend(NULL, tpkg));
+            }
         }
 
         g_dir_close(dirp);
     }
 
+    // Sort candidates from the newest one and drop the same versions
+    // found in multiple directories
+    g_hash_table_iter_init(&iter, ht);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        GSList *candidates = g_slist_sort(value, cmp_deltatargetpackage_evr_desc);
+
+        for (GSList *elem = candidates; elem && elem->next;) {
+            if (cmp_deltatargetpackage_evr_desc(elem->data, elem->next->data)) {
+                elem = elem->next;
+                continue;
+            }
+            cr_deltatargetpackage_free(elem->next->data);
+            elem->next = g_slist_delete_link(elem->next, elem->next);
+        }
+
+        g_hash_table_iter_replace(&iter, candidates);
+    }
 
     return ht;
 }
 
+/*
+ * Index of generated deltas
+ *
+ * Text file in the output delta directory, one line per delta:
+ * "<old hdrid>\t<new hdrid>\t<size of drpm>\t<drpm filename>"
+ */
+
+typedef struct {
+    gchar *filename;    /*!< Basename of the drpm */
+    gint64 size;        /*!< Size of the drpm */
+} cr_DeltaIndexRecord;
+
+static void
+cr_deltaindexrecord_free(cr_DeltaIndexRecord *rec)
+{
+    if (!rec)
+        return;
+    g_free(rec->filename);
+    g_free(rec);
+}
+
+static GHashTable *
+cr_deltaindex_new(void)
+{
+    return g_hash_table_new_full(g_str_hash,
+                                 g_str_equal,
+                                 (GDestroyNotify) g_free,
+                                 (GDestroyNotify) cr_deltaindexrecord_free);
+}
+
+static gchar *
+cr_deltaindex_key(const cr_DeltaTargetPackage *old,
+                  const cr_DeltaTargetPackage *new)
+{
+    if (!old->hdrid || !new->hdrid)
+        return NULL;
+    return g_strconcat(old->hdrid, "\t", new->hdrid, NULL);
+}
+
+/** Load the index, a missing or broken index is an empty one.
+ */
+static GHashTable *
+cr_deltaindex_load(const char *outdeltadir)
+{
+    GHashTable *index = cr_deltaindex_new();
+    gchar *path = g_build_filename(outdeltadir, CR_DELTARPMS_INDEX_FILENAME, NULL);
+    gchar *content = NULL;
+
+    if (!g_file_get_contents(path, &content, NULL, NULL)) {
+        g_free(path);
+        return index;
+    }
+
+    gchar **lines = g_strsplit(content, "\n", 0);
+    for (gchar **line = lines; *line; line++) {
+        gchar **items = g_strsplit(*line, "\t", 4);
+        if (g_strv_length(items) == 4 && !strchr(items[3], '/')) {
+            cr_DeltaIndexRecord *rec = g_new0(cr_DeltaIndexRecord, 1);
+            rec->size = g_ascii_strtoll(items[2], NULL, 10);
+            rec->filename = g_strdup(items[3]);
+            g_hash_table_replace(index,
+                                 g_strconcat(items[0], "\t", items[1], NULL),
+                                 rec);
+        }
+        g_strfreev(items);
+    }
+
+    g_debug("%s: %u deltas in %s", __func__, g_hash_table_size(index), path);
+    g_strfreev(lines);
+    g_free(content);
+    g_free(path);
+    return index;
+}
+
+/** Write the index (atomically replace the old one).
+ */
+static gboolean
+cr_deltaindex_save(GHashTable *index, const char *outdeltadir, GError **err)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    GString *content = g_string_new(NULL);
+    gchar *path = g_build_filename(outdeltadir, CR_DELTARPMS_INDEX_FILENAME, NULL);
+    gboolean ret;
+
+    g_hash_table_iter_init(&iter, index);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        cr_DeltaIndexRecord *rec = value;
+        g_string_append_printf(content, "%s\t%"G_GINT64_FORMAT"\t%s\n",
+                               (gchar *) key, rec->size, rec->filename);
+    }
+
+    ret = g_file_set_contents(path, content->str, content->len, err);
+    g_string_free(content, TRUE);
+    g_free(path);
+    return ret;
+}
+
+/** Check that the drpm from the index is still there.
+ */
+static gboolean
+cr_deltaindex_record_valid(const cr_DeltaIndexRecord *rec,
+                           const char *outdeltadir)
+{
+    struct stat st;
+    gchar *path = g_build_filename(outdeltadir, rec->filename, NULL);
+    gboolean valid = (stat(path, &st) == 0
+                      && S_ISREG(st.st_mode)
+                      && st.st_size == rec->size);
+    g_free(path);
+    return valid;
+}
+
 /*
  * 2) Parallel delta generation
  */
@@ -240,6 +402,9 @@ cr_deltarpms_scan_oldpackagedirs(GSList *oldpackagedirs,
 
 typedef struct {
     cr_DeltaTargetPackage *tpkg;
+    GSList *candidates;     /*!< Old packages sorted from the newest */
+    gint64 work_size;       /*!< Memory needed to generate the deltas */
+    gint64 cost;            /*!< Estimated time to generate the deltas */
 } cr_DeltaTask;
 
 
@@ -247,104 +412,147 @@ typedef struct {
     const char *outdeltadir;
     gint num_deltas;
     GHashTable *oldpackages;
+    GHashTable *old_index;  /*!< Index loaded from the outdeltadir */
+    GHashTable *new_index;  /*!< Deltas generated or reused in this run */
     GMutex mutex;
     gint64 active_work_size;
     gint active_tasks;
     GCond cond_task_finished;
+    gint generated;         /*!< Number of generated deltas */
+    gint reused;            /*!< Number of reused deltas */
+    gint failed;            /*!< Number of failed deltas */
+    gdouble generating_time;/*!< Sum of times spent by generating */
 } cr_DeltaThreadUserData;
 
 
-static gint
-cmp_deltatargetpackage_evr(gconstpointer aa, gconstpointer bb)
+/** Select candidates for deltas (old packages older than the target).
+ */
+static GSList *
+cr_delta_candidates(cr_DeltaTargetPackage *tpkg, GHashTable *oldpackages)
 {
-    const cr_DeltaTargetPackage *a = aa;
-    const cr_DeltaTargetPackage *b = bb;
+    gchar *pkg_key = cr_oldpackage_key(tpkg->name, tpkg->arch);
+    GSList *candidates = g_hash_table_lookup(oldpackages, pkg_key);
+    g_free(pkg_key);
+
+    // Candidates are sorted from the newest one
+    while (candidates) {
+        cr_DeltaTargetPackage *old = candidates->data;
+        if (cr_cmp_evr(tpkg->epoch, tpkg->version, tpkg->release,
+                       old->epoch, old->version, old->release) > 0)
+            break;
+        candidates = g_slist_next(candidates);
+    }
 
-    return cr_cmp_evr(a->epoch, a->version, a->release,
-                      b->epoch, b->version, b->release);
+    return candidates;
 }
 
-
-static void
-cr_delta_thread(gpointer data, gpointer udata)
+/** Lookup a valid record for the delta in the old index.
+ */
+static cr_DeltaIndexRecord *
+cr_delta_lookup(cr_DeltaThreadUserData *user_data,
+                cr_DeltaTargetPackage *old,
+                cr_DeltaTargetPackage *new)
 {
-    cr_DeltaTask *task = data;
-    cr_DeltaThreadUserData *user_data = udata;
-    cr_DeltaTargetPackage *tpkg = task->tpkg;  // Shortcut
+    gchar *key = cr_deltaindex_key(old, new);
+    cr_DeltaIndexRecord *rec = NULL;
 
-    GHashTableIter iter;
-    gpointer key, value;
+    if (key)
+        rec = g_hash_table_lookup(user_data->old_index, key);
+    g_free(key);
 
-    // Iterate through specified oldpackage directories
-    g_hash_table_iter_init(&iter, user_data->oldpackages);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        gchar *dirname = key;
-        GSList *local_candidates = NULL;
-
-        // Select appropriate candidates from the directory
-        for (GSList *elem = value; elem; elem = g_slist_next(elem)) {
-            gchar *filename = elem->data;
-            if (g_str_has_prefix(filename, tpkg->name)) {
-                cr_DeltaTargetPackage *l_tpkg;
-                gchar *path = g_build_filename(dirname, filename, NULL);
-                l_tpkg = cr_deltatargetpackage_from_rpm(path, NULL);
-                g_free(path);
-                if (!l_tpkg)
-                    continue;
-
-                // Check the candidate more carefully
-
-                if (g_strcmp0(tpkg->name, l_tpkg->name)) {
-                    cr_deltatargetpackage_free(l_tpkg);
-                    continue;
-                }
+    if (rec && !cr_deltaindex_record_valid(rec, user_data->outdeltadir))
+        rec = NULL;
 
-                if (g_strcmp0(tpkg->arch, l_tpkg->arch)) {
-                    cr_deltatargetpackage_free(l_tpkg);
-                    continue;
-                }
+    return rec;
+}
 
-                if (cr_cmp_evr(tpkg->epoch, tpkg->version, tpkg->release,
-                        l_tpkg->epoch, l_tpkg->version, l_tpkg->release) <= 0)
-                {
-                    cr_deltatargetpackage_free(l_tpkg);
-                    continue;
-                }
+static void
+cr_delta_index_add(cr_DeltaThreadUserData *user_data,
+                   cr_DeltaTargetPackage *old,
+                   cr_DeltaTargetPackage *new,
+                   const char *filename,
+                   gint64 size)
+{
+    gchar *key = cr_deltaindex_key(old, new);
+    cr_DeltaIndexRecord *rec;
 
-                // This candidate looks good
-                local_candidates = g_slist_prepend(local_candidates, l_tpkg);
-            }
-        }
+    if (!key)
+        return;
 
-        // Sort the candidates
-        local_candidates = g_slist_sort(local_candidates,
-                                        cmp_deltatargetpackage_evr);
-        local_candidates = g_slist_reverse(local_candidates);
+    rec = g_new0(cr_DeltaIndexRecord, 1);
+    rec->filename = g_path_get_basename(filename);
+    rec->size = size;
 
-        // Generate deltas
-        int x = 0;
-        for (GSList *lelem = local_candidates; lelem; lelem = g_slist_next(lelem)){
-            GError *tmp_err = NULL;
-            cr_DeltaTargetPackage *old = lelem->data;
+    g_mutex_lock(&(user_data->mutex));
+    g_hash_table_replace(user_data->new_index, key, rec);
+    g_mutex_unlock(&(user_data->mutex));
+}
 
-            g_debug("Generating delta %s -> %s", old->path, tpkg->path);
-            cr_drpm_create(old, tpkg, user_data->outdeltadir, &tmp_err);
-            if (tmp_err) {
-                g_warning("Cannot generate delta %s -> %s : %s",
-                          old->path, tpkg->path, tmp_err->message);
-                g_error_free(tmp_err);
-                continue;
-            }
+
+static void
+cr_delta_thread(gpointer data, gpointer udata)
+{
+    cr_DeltaTask *task = data;
+    cr_DeltaThreadUserData *user_data = udata;
+    cr_DeltaTargetPackage *tpkg = task->tpkg;  // Shortcut
+    gint generated = 0, reused = 0, failed = 0;
+    gdouble generating_time = 0.0;
+    GTimer *timer = g_timer_new();
+
+    int x = 0;
+    for (GSList *elem = task->candidates; elem; elem = g_slist_next(elem)) {
+        GError *tmp_err = NULL;
+        cr_DeltaTargetPackage *old = elem->data;
+        cr_DeltaIndexRecord *rec;
+        gchar *drpmpath;
+        struct stat st;
+
+        rec = cr_delta_lookup(user_data, old, tpkg);
+        if (rec) {
+            g_debug("Reusing delta %s (%s -> %s)",
+                    rec->filename, old->path, tpkg->path);
+            cr_delta_index_add(user_data, old, tpkg, rec->filename, rec->size);
+            reused++;
             if (++x == user_data->num_deltas)
                 break;
+            continue;
+        }
+
+        g_debug("Generating delta %s -> %s", old->path, tpkg->path);
+        g_timer_start(timer);
+        drpmpath = cr_drpm_create(old, tpkg, user_data->outdeltadir, &tmp_err);
+        g_timer_stop(timer);
+        generating_time += g_timer_elapsed(timer, NULL);
+        if (tmp_err) {
+            g_warning("Cannot generate delta %s -> %s : %s",
+                      old->path, tpkg->path, tmp_err->message);
+            g_error_free(tmp_err);
+            failed++;
+            continue;
         }
+
+        g_debug("Delta %s generated in %.3f s",
+                drpmpath, g_timer_elapsed(timer, NULL));
+        if (stat(drpmpath, &st) == 0)
+            cr_delta_index_add(user_data, old, tpkg, drpmpath, st.st_size);
+        g_free(drpmpath);
+        generated++;
+
+        if (++x == user_data->num_deltas)
+            break;
     }
 
+    g_timer_destroy(timer);
+
     g_debug("Deltas for \"%s\" (%"G_GINT64_FORMAT") generated",
             tpkg->name, tpkg->size_installed);
 
     g_mutex_lock(&(user_data->mutex));
-    user_data->active_work_size -= tpkg->size_installed;
+    user_data->generated += generated;
+    user_data->reused += reused;
+    user_data->failed += failed;
+    user_data->generating_time += generating_time;
+    user_data->active_work_size -= task->work_size;
     user_data->active_tasks--;
     g_cond_signal(&(user_data->cond_task_finished));
     g_mutex_unlock(&(user_data->mutex));
@@ -352,15 +560,17 @@ cr_delta_thread(gpointer data, gpointer udata)
 }
 
 
+/** Longest estimated processing time first
+ */
 static gint
-cmp_deltatargetpackage_sizes(gconstpointer a, gconstpointer b)
+cmp_deltatask_cost_desc(gconstpointer a, gconstpointer b)
 {
-    const cr_DeltaTargetPackage *dtpk_a = a;
-    const cr_DeltaTargetPackage *dtpk_b = b;
+    const cr_DeltaTask *task_a = a;
+    const cr_DeltaTask *task_b = b;
 
-    if (dtpk_a->size_installed < dtpk_b->size_installed)
+    if (task_a->cost > task_b->cost)
         return -1;
-    else if (dtpk_a->size_installed == dtpk_b->size_installed)
+    else if (task_a->cost == task_b->cost)
         return 0;
     else
         return 1;
@@ -381,6 +591,7 @@ cr_deltarpms_parallel_deltas(GSList *targetpackages,
     cr_DeltaThreadUserData user_data;
     GList *targets = NULL;
     GError *tmp_err = NULL;
+    GTimer *timer;
 
     assert(!err || *err == NULL);
 
@@ -394,23 +605,48 @@ cr_deltarpms_parallel_deltas(GSList *targetpackages,
     }
 
     // Init user_data
+    memset(&user_data, 0, sizeof(user_data));
     user_data.outdeltadir           = outdeltadir;
     user_data.num_deltas            = num_deltas;
     user_data.oldpackages           = oldpackages;
+    user_data.old_index             = cr_deltaindex_load(outdeltadir);
+    user_data.new_index             = cr_deltaindex_new();
     user_data.active_work_size      = G_GINT64_CONSTANT(0);
     user_data.active_tasks          = 0;
 
     g_mutex_init(&(user_data.mutex));
     g_cond_init(&(user_data.cond_task_finished));
 
-    // Make sorted list of targets without packages
-    // that are bigger then max_delta_rpm_size
+    // Make list of targets without packages that are bigger then
+    // max_delta_rpm_size. Targets are sorted by the estimated time needed
+    // to generate their deltas (longest processing time first), targets
+    // with all deltas in the index need almost no time nor memory.
     for (GSList *elem = targetpackages; elem; elem = g_slist_next(elem)) {
         cr_DeltaTargetPackage *tpkg = elem->data;
-        if (tpkg->size_installed < max_delta_rpm_size)
-            targets = g_list_insert_sorted(targets, tpkg, cmp_deltatargetpackage_sizes);
+        cr_DeltaTask *task;
+        gint64 pending = 0;
+        gint x = 0;
+
+        if (tpkg->size_installed >= max_delta_rpm_size)
+            continue;
+
+        task = g_new0(cr_DeltaTask, 1);
+        task->tpkg = tpkg;
+        task->candidates = cr_delta_candidates(tpkg, oldpackages);
+        if (!task->candidates) {
+            g_free(task);
+            continue;
+        }
+
+        for (GSList *c = task->candidates; c && x < num_deltas; c = g_slist_next(c), x++)
+            if (!cr_delta_lookup(&user_data, c->data, tpkg))
+                pending++;
+
+        task->work_size = pending ? tpkg->size_installed : 0;
+        task->cost = pending * tpkg->size_installed;
+        targets = g_list_prepend(targets, task);
     }
-    targets = g_list_reverse(targets);
+    targets = g_list_sort(targets, cmp_deltatask_cost_desc);
 
     // Setup the pool of workers
     pool = g_thread_pool_new(cr_delta_thread,
@@ -420,9 +656,14 @@ cr_deltarpms_parallel_deltas(GSList *targetpackages,
                              &tmp_err);
     if (tmp_err) {
         g_propagate_prefixed_error(err, tmp_err, "Cannot create delta pool: ");
+        g_list_free_full(targets, g_free);
+        g_hash_table_destroy(user_data.old_index);
+        g_hash_table_destroy(user_data.new_index);
         return FALSE;
     }
 
+    timer = g_timer_new();
+
     // Push tasks into the pool
     while (targets) {
         gboolean inserted = FALSE;
@@ -438,13 +679,10 @@ cr_deltarpms_parallel_deltas(GSList *targetpackages,
         g_mutex_unlock(&(user_data.mutex));
 
         for (GList *elem = targets; elem; elem = g_list_next(elem)) {
-            cr_DeltaTargetPackage *tpkg = elem->data;
-            if ((active_work_size + tpkg->size_installed) <= max_work_size) {
-                cr_DeltaTask *task = g_new0(cr_DeltaTask, 1);
-                task->tpkg = tpkg;
-
+            cr_DeltaTask *task = elem->data;
+            if ((active_work_size + task->work_size) <= max_work_size) {
                 g_mutex_lock(&(user_data.mutex));
-                user_data.active_work_size += tpkg->size_installed;
+                user_data.active_work_size += task->work_size;
                 user_data.active_tasks++;
                 g_mutex_unlock(&(user_data.mutex));
 
@@ -470,6 +708,21 @@ cr_deltarpms_parallel_deltas(GSList *targetpackages,
     g_mutex_clear(&(user_data.mutex));
     g_cond_clear(&(user_data.cond_task_finished));
 
+    g_message("Deltas: %d generated, %d reused, %d failed "
+              "(%.2f s of generation, %.2f s wall clock)",
+              user_data.generated, user_data.reused, user_data.failed,
+              user_data.generating_time, g_timer_elapsed(timer, NULL));
+    g_timer_destroy(timer);
+
+    // Only deltas of this run are kept in the index
+    if (!cr_deltaindex_save(user_data.new_index, outdeltadir, &tmp_err)) {
+        g_warning("Cannot write index of deltas: %s", tmp_err->message);
+        g_clear_error(&tmp_err);
+    }
+
+    g_hash_table_destroy(user_data.old_index);
+    g_hash_table_destroy(user_data.new_index);
+
     return TRUE;
 }
 
@@ -494,6 +747,7 @@ cr_deltatargetpackage_from_package(cr_Package *pkg,
     tpkg->location_href = cr_safe_string_chunk_insert(tpkg->chunk, pkg->location_href);
     tpkg->size_installed = pkg->size_installed;
     tpkg->path = cr_safe_string_chunk_insert(tpkg->chunk, path);
+    tpkg->hdrid = cr_safe_string_chunk_insert(tpkg->chunk, pkg->hdrid);
 
     return tpkg;
 }
@@ -507,7 +761,7 @@ cr_deltatargetpackage_from_rpm(const char *path, GError **err)
 
     assert(!err || *err == NULL);
 
-    pkg = cr_package_from_rpm_base(path, 0, 0, err);
+    pkg = cr_package_from_rpm_base(path, 0, CR_HDRR_LOADHDRID, err);
     if (!pkg)
         return NULL;
 
@@ -608,12 +862,13 @@ cr_deltarpms_scan_targetdir(const char *path,
 
 typedef struct {
     gchar *full_path;
+    gchar *nevra;       /*!< Nevra of the target package (result) */
+    gchar *xml_chunk;   /*!< <delta> element (result) */
 } cr_PrestoDeltaTask;
 
 typedef struct {
-    GMutex mutex;
-    GHashTable *ht;
     cr_ChecksumType checksum_type;
+    cr_ChecksumCache *checksum_cache;
     const gchar *prefix_to_strip;
     size_t prefix_len;
 } cr_PrestoDeltaUserData;
@@ -624,6 +879,8 @@ cr_prestodeltatask_free(cr_PrestoDeltaTask *task)
     if (!task)
         return;
     g_free(task->full_path);
+    g_free(task->nevra);
+    g_free(task->xml_chunk);
     g_free(task);
 }
 
@@ -693,6 +950,24 @@ exit:
 }
 
 
+gchar *
+cr_deltarpms_cache_key(const gchar *full_path,
+                       cr_ChecksumType checksum_type,
+                       gint64 size,
+                       gint64 mtime)
+{
+    return g_strdup_printf(CR_CHECKSUM_CACHE_DRPM_PREFIX
+                           "%s-%s-%"G_GINT64_FORMAT"-%"G_GINT64_FORMAT,
+                           full_path,
+                           cr_checksum_name_str(checksum_type),
+                           size,
+                           mtime);
+}
+
+/** Every task is processed by exactly one worker and the results are
+ * stored directly into the task, so the workers share no state
+ * and never wait for each other.
+ */
 static void
 cr_prestodelta_thread(gpointer data, gpointer udata)
 {
@@ -701,10 +976,17 @@ cr_prestodelta_thread(gpointer data, gpointer udata)
 
     cr_DeltaPackage *dpkg = NULL;
     struct stat st;
-    gchar *xml_chunk = NULL, *key = NULL, *checksum = NULL;
+    gchar *cache_key = NULL, *checksum = NULL;
     GError *tmp_err = NULL;
 
-    printf("%s\n", task->full_path);
+    g_debug("Processing %s", task->full_path);
+
+    // Stat the package (to get the size)
+    if (stat(task->full_path, &st) == -1) {
+        g_warning("%s: stat(%s) error (%s)", __func__,
+                  task->full_path, g_strerror(errno));
+        goto exit;
+    }
 
     // Load delta package
     dpkg = cr_deltapackage_from_drpm_base(task->full_path, 0, 0, &tmp_err);
@@ -714,30 +996,43 @@ cr_prestodelta_thread(gpointer data, gpointer udata)
         goto exit;
     }
 
-    // Set the filename
+    // Set the filename and the size
     dpkg->package->location_href = cr_safe_string_chunk_insert(
                                     dpkg->package->chunk,
                                     task->full_path + user_data->prefix_len);
-
-    // Stat the package (to get the size)
-    if (stat(task->full_path, &st) == -1) {
-        g_warning("%s: stat(%s) error (%s)", __func__,
-                  task->full_path, g_strerror(errno));
-        goto exit;
-    } else {
-        dpkg->package->size_package = st.st_size;
+    dpkg->package->size_package = st.st_size;
+
+    // Get the checksum (from the cache if possible)
+    if (user_data->checksum_cache) {
+        cache_key = cr_deltarpms_cache_key(task->full_path,
+                                           user_data->checksum_type,
+                                           (gint64) st.st_size,
+                                           (gint64) st.st_mtime);
+        checksum = cr_checksum_cache_lookup(user_data->checksum_cache,
+                                            cache_key);
     }
 
-    // Calculate the checksum
-    checksum = cr_checksum_file(task->full_path,
-                                user_data->checksum_type,
-                                &tmp_err);
     if (!checksum) {
-        g_warning("Cannot calculate checksum for %s: %s",
-                  task->full_path, tmp_err->message);
-        g_error_free(tmp_err);
-        goto exit;
+        checksum = cr_checksum_file(task->full_path,
+                                    user_data->checksum_type,
+                                    &tmp_err);
+        if (!checksum) {
+            g_warning("Cannot calculate checksum for %s: %s",
+                      task->full_path, tmp_err->message);
+            g_error_free(tmp_err);
+            goto exit;
+        }
+
+        if (cache_key
+            && cr_checksum_cache_add(user_data->checksum_cache, cache_key,
+                                     checksum, &tmp_err) != CRE_OK)
+        {
+            g_warning("Cannot store checksum of %s into the cache: %s",
+                      task->full_path, tmp_err->message);
+            g_clear_error(&tmp_err);
+        }
     }
+
     dpkg->package->checksum_type = cr_safe_string_chunk_insert(
                                         dpkg->package->chunk,
                                         cr_checksum_name_str(
@@ -746,52 +1041,56 @@ cr_prestodelta_thread(gpointer data, gpointer udata)
                                                        checksum);
 
     // Generate XML
-    xml_chunk = cr_xml_dump_deltapackage(dpkg, &tmp_err);
+    task->xml_chunk = cr_xml_dump_deltapackage(dpkg, &tmp_err);
     if (tmp_err) {
         g_warning("Cannot generate xml for drpm %s: %s",
                   task->full_path, tmp_err->message);
         g_error_free(tmp_err);
+        g_clear_pointer(&task->xml_chunk, g_free);
         goto exit;
     }
 
-    // Put the XML into the shared hash table
-    gpointer pkey = NULL;
-    gpointer pval = NULL;
-    key = cr_package_nevra(dpkg->package);
-    g_mutex_lock(&(user_data->mutex));
-    if (g_hash_table_lookup_extended(user_data->ht, key, &pkey, &pval)) {
-        // Key exists in the table
-        // 1. Remove the key and value from the table without freeing them
-        g_hash_table_steal(user_data->ht, key);
-        // 2. Append to the list (the value from the hash table)
-        GSList *list = (GSList *) pval;
-        list = g_slist_append(pval, xml_chunk);
-        // 3. Insert the modified list again
-        g_hash_table_insert(user_data->ht, pkey, list);
-    } else {
-        // Key doesn't exist yet
-        GSList *list = g_slist_prepend(NULL, xml_chunk);
-        g_hash_table_insert(user_data->ht, g_strdup(key), list);
-    }
-    g_mutex_unlock(&(user_data->mutex));
+    task->nevra = cr_package_nevra(dpkg->package);
 
 exit:
     g_free(checksum);
-    g_free(key);
+    g_free(cache_key);
     cr_deltapackage_free(dpkg);
 }
 
+/** Order the processed tasks by nevra of their target package (and by
+ * path for a stable output). Failed tasks go to the end.
+ */
+static gint
+cmp_prestodeltatask(gconstpointer a, gconstpointer b)
+{
+    const cr_PrestoDeltaTask *task_a = *((cr_PrestoDeltaTask **) a);
+    const cr_PrestoDeltaTask *task_b = *((cr_PrestoDeltaTask **) b);
+
+    if (!task_a->nevra || !task_b->nevra)
+        return (task_a->nevra == NULL) - (task_b->nevra == NULL);
+
+    gint ret = g_strcmp0(task_a->nevra, task_b->nevra);
+    if (ret)
+        return ret;
+    return g_strcmp0(task_a->full_path, task_b->full_path);
+}
+
+/** Generate a <newpackage> element from the tasks[first] .. tasks[last-1]
+ * which all belong to the same target package.
+ */
 static gchar *
-gen_newpackage_xml_chunk(const char *strnevra,
-                         GSList *delta_chunks)
+gen_newpackage_xml_chunk(cr_PrestoDeltaTask **tasks,
+                         guint first,
+                         guint last)
 {
     cr_NEVRA *nevra;
     GString *chunk;
 
-    if (!delta_chunks)
+    if (first >= last)
         return NULL;
 
-    nevra = cr_str_to_nevra(strnevra);
+    nevra = cr_str_to_nevra(tasks[first]->nevra);
 
     chunk = g_string_new(NULL);
     g_string_printf(chunk, "  <newpackage name=\"%s\" epoch=\"%s\" "
@@ -801,10 +1100,8 @@ gen_newpackage_xml_chunk(const char *strnevra,
 
     cr_nevra_free(nevra);
 
-    for (GSList *elem = delta_chunks; elem; elem = g_slist_next(elem)) {
-        gchar *delta_chunk = elem->data;
-        g_string_append(chunk, delta_chunk);
-    }
+    for (guint i = first; i < last; i++)
+        g_string_append(chunk, tasks[i]->xml_chunk);
 
     g_string_append(chunk, "  </newpackage>\n");
 
@@ -819,14 +1116,32 @@ cr_deltarpms_generate_prestodelta_file(const gchar *drpmsdir,
                                        gint workers,
                                        const gchar *prefix_to_strip,
                                        GError **err)
+{
+    return cr_deltarpms_generate_prestodelta_file_with_cache(drpmsdir,
+                                                             f,
+                                                             zck_f,
+                                                             checksum_type,
+                                                             NULL,
+                                                             workers,
+                                                             prefix_to_strip,
+                                                             err);
+}
+
+gboolean
+cr_deltarpms_generate_prestodelta_file_with_cache(const gchar *drpmsdir,
+                                                  cr_XmlFile *f,
+                                                  cr_XmlFile *zck_f,
+                                                  cr_ChecksumType checksum_type,
+                                                  cr_ChecksumCache *checksum_cache,
+                                                  gint workers,
+                                                  const gchar *prefix_to_strip,
+                                                  GError **err)
 {
     gboolean ret = TRUE;
     GSList *candidates = NULL;
+    GPtrArray *tasks = NULL;
     GThreadPool *pool;
     cr_PrestoDeltaUserData user_data;
-    GHashTable *ht = NULL;
-    GHashTableIter iter;
-    gpointer key, value;
     GError *tmp_err = NULL;
 
     assert(drpmsdir);
@@ -841,18 +1156,19 @@ cr_deltarpms_generate_prestodelta_file(const gchar *drpmsdir,
         goto exit;
     }
 
-    // Setup pool of workers
+    tasks = g_ptr_array_new_with_free_func(
+                            (GDestroyNotify) cr_prestodeltatask_free);
+    for (GSList *elem = candidates; elem; elem = g_slist_next(elem))
+        g_ptr_array_add(tasks, elem->data);
+    g_slist_free(candidates);
+    candidates = NULL;
 
-    ht = g_hash_table_new_full(g_str_hash,
-                               g_str_equal,
-                               (GDestroyNotify) g_free,
-                               (GDestroyNotify) cr_free_gslist_of_strings);
+    // Setup pool of workers
 
-    user_data.ht                = ht;
     user_data.checksum_type     = checksum_type;
+    user_data.checksum_cache    = checksum_cache;
     user_data.prefix_to_strip   = prefix_to_strip,
     user_data.prefix_len        = prefix_to_strip ? strlen(prefix_to_strip) : 0;
-    g_mutex_init(&(user_data.mutex));
 
     pool = g_thread_pool_new(cr_prestodelta_thread,
                              &user_data,
@@ -868,24 +1184,45 @@ cr_deltarpms_generate_prestodelta_file(const gchar *drpmsdir,
 
     // Push tasks to the pool
 
-    for (GSList *elem = candidates; elem; elem = g_slist_next(elem)) {
-        g_thread_pool_push(pool, elem->data, NULL);
-    }
+    for (guint i = 0; i < tasks->len; i++)
+        g_thread_pool_push(pool, g_ptr_array_index(tasks, i), NULL);
 
     // Wait until the pool finishes
 
     g_thread_pool_free(pool, FALSE, TRUE);
 
-    // Write out the results
+    // Merge the results - group deltas of the same target package
 
+    g_ptr_array_sort(tasks, cmp_prestodeltatask);
 
-    g_hash_table_iter_init(&iter, user_data.ht);
-    while (g_hash_table_iter_next(&iter, &key, &value)) {
-        gchar *chunk = NULL;
-        gchar *nevra = key;
+    // Write out the results
 
-        chunk = gen_newpackage_xml_chunk(nevra, (GSList *) value);
-        cr_xmlfile_add_chunk(f, chunk, NULL);
+    cr_PrestoDeltaTask **pdata = (cr_PrestoDeltaTask **) tasks->pdata;
+    guint first = 0;
+    while (first < tasks->len && pdata[first]->nevra) {
+        guint last = first + 1;
+        while (last < tasks->len
+               && pdata[last]->nevra
+               && !strcmp(pdata[first]->nevra, pdata[last]->nevra))
+            last++;
+
+        gchar *chunk = gen_newpackage_xml_chunk(pdata, first, last);
+
+        // Results which were written are not needed anymore
+        for (guint i = first; i < last; i++) {
+            cr_prestodeltatask_free(pdata[i]);
+            pdata[i] = NULL;
+        }
+        first = last;
+
+        cr_xmlfile_add_chunk(f, chunk, &tmp_err);
+        if (tmp_err) {
+            g_free(chunk);
+            g_propagate_prefixed_error(err, tmp_err,
+                "Cannot write prestodelta file: ");
+            ret = FALSE;
+            goto exit;
+        }
 
         /* Write out zchunk file */
         if (zck_f) {
@@ -894,7 +1231,7 @@ cr_deltarpms_generate_prestodelta_file(const gchar *drpmsdir,
             if (tmp_err) {
                 g_free(chunk);
                 g_propagate_prefixed_error(err, tmp_err,
-                    "Cannot create pool for prestodelta file generation: ");
+                    "Cannot write prestodelta zchunk file: ");
                 ret = FALSE;
                 goto exit;
             }
@@ -904,8 +1241,8 @@ cr_deltarpms_generate_prestodelta_file(const gchar *drpmsdir,
 
 exit:
     g_slist_free_full(candidates, (GDestroyNotify) cr_prestodeltatask_free);
-    g_mutex_clear(&(user_data.mutex));
-    g_hash_table_destroy(ht);
+    if (tasks)
+        g_ptr_array_free(tasks, TRUE);
 
     return ret;
 }
@@ -27,6 +27,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include "checksum.h"
+#include "checksum_cache.h"
 #include "cleanup.h"
 #include "deltarpms.h"
 #include "dumper_thread.h"
@@ -36,33 +37,311 @@
 #include "xml_dump.h"
 #include <fcntl.h>
 
-#define MAX_TASK_BUFFER_LEN         20
-#define CACHEDCHKSUM_BUFFER_LEN     2048
+#define MAX_DB_QUEUE_LEN            64
 
 struct BufferedTask {
     long id;                        // ID of the task
     struct cr_XmlStruct res;        // XML for primary, filelists and other
-    cr_Package *pkg;                // Package structure
+    cr_Package *pkg;                // Package structure (NULL if the task
+                                    // failed and only gives up its turn)
     char *location_href;            // location_href path
     char *location_base;            // location_base path
-    int pkg_from_md;                // If true - package structure if from
-                                    // old metadata and must not be freed!
-                                    // If false - package is from file and
-                                    // it must be freed!
 };
 
 
-static gint
-buf_task_sort_func(gconstpointer a, gconstpointer b, G_GNUC_UNUSED gpointer data)
+/** Package shared by all the sqlite writer threads.
+ * The last writer which is done with the package frees it.
+ */
+struct DbTask {
+    cr_Package *pkg;                // Package structure (owned)
+    char *location_href;            // Own copy of the location_href
+    char *location_base;            // Own copy of the location_base
+    gint64 pkgKey;                  // Key of the package in the databases
+                                    // (set in the turn of primary metadata)
+    gint refcount;                  // Number of writers which still use it
+};
+
+struct DbWriter {
+    cr_SqliteDb *db;                // Database to write into
+    const char *name;               // Name of the db (for error messages)
+    struct UserData *udata;         // User data (for had_errors)
+    GThread *thread;                // Thread inserting the packages
+    GQueue *queue;                  // Queue of struct DbTask (in task order)
+    GMutex mutex;                   // Mutex for the queue
+    GCond cond_push;                // Signaled when a task was pushed
+    GCond cond_pop;                 // Signaled when a task was popped
+    gboolean finish;                // No more tasks will be pushed
+    struct DbWriter **shards;       // Writers of shards, if the db is
+                                    // sharded the writer has no thread
+    int shard_count;                // Number of shards
+    char **shard_paths;             // NULL terminated paths of shards
+};
+
+static struct DbTask *
+db_task_new(cr_Package *pkg, gint refcount)
+{
+    struct DbTask *task = g_new0(struct DbTask, 1);
+    task->pkg = pkg;
+    task->refcount = refcount;
+
+    // The locations of a package reused from old metadata point to
+    // strings owned by the dumper thread, which may be gone before
+    // the package gets into the database
+    task->location_href = g_strdup(pkg->location_href);
+    task->location_base = g_strdup(pkg->location_base);
+    pkg->location_href = task->location_href;
+    pkg->location_base = task->location_base;
+
+    return task;
+}
+
+static void
+db_task_unref(struct DbTask *task)
+{
+    if (!g_atomic_int_dec_and_test(&(task->refcount)))
+        return;
+
+    cr_package_free(task->pkg);
+    g_free(task->location_href);
+    g_free(task->location_base);
+    g_free(task);
+}
+
+static gpointer
+db_writer_thread(gpointer data)
 {
-    const struct BufferedTask *task_a = a;
-    const struct BufferedTask *task_b = b;
-    if (task_a->id < task_b->id)  return -1;
-    if (task_a->id == task_b->id) return 0;
-    return 1;
+    struct DbWriter *writer = data;
+    GError *tmp_err = NULL;
+
+    while (1) {
+        struct DbTask *task;
+
+        g_mutex_lock(&(writer->mutex));
+        while (g_queue_is_empty(writer->queue) && !writer->finish)
+            g_cond_wait(&(writer->cond_push), &(writer->mutex));
+        task = g_queue_pop_head(writer->queue);
+        g_cond_broadcast(&(writer->cond_pop));
+        g_mutex_unlock(&(writer->mutex));
+
+        if (!task)  // Finished and the queue is drained
+            break;
+
+        // All writers work with the same package at the same time,
+        // but cr_db_add_pkg() sets the pkgKey, so every writer uses
+        // its own shallow copy of the package structure
+        cr_Package pkg = *(task->pkg);
+        pkg.pkgKey = task->pkgKey;  // Used by shards, others assign their own
+        cr_db_add_pkg(writer->db, &pkg, &tmp_err);
+        if (tmp_err) {
+            g_critical("Cannot add record of %s (%s) to %s db: %s",
+                       pkg.name, pkg.pkgId, writer->name, tmp_err->message);
+            writer->udata->had_errors = TRUE;
+            g_clear_error(&tmp_err);
+        }
+
+        db_task_unref(task);
+    }
+
+    return NULL;
 }
 
+static struct DbWriter *db_writer_new(cr_SqliteDb *db,
+                                      const char *name,
+                                      struct UserData *udata,
+                                      int shards);
+
+static void db_writer_free(struct DbWriter *writer);
 
+/** Open the shards next to the db and start a writer for each of them.
+ * Packages are distributed among the shards by their pkgKey, which
+ * is assigned in order of the primary turn, so the shards merged in
+ * the pkgKey order give exactly the same db as a single writer.
+ */
+static gboolean
+db_writer_open_shards(struct DbWriter *writer, int shards)
+{
+    GError *tmp_err = NULL;
+    const char *db_path = sqlite3_db_filename(writer->db->db, "main");
+
+    writer->shards = g_new0(struct DbWriter *, shards);
+    writer->shard_paths = g_new0(char *, shards + 1);
+
+    for (int i = 0; i < shards; i++) {
+        char *path = g_strdup_printf("%s.shard%d", db_path, i);
+        remove(path);   // Leftover of an interrupted run
+        writer->shard_paths[i] = path;
+
+        cr_SqliteDb *shard_db = cr_db_open_shard(path, writer->db->type,
+                                                 &tmp_err);
+        if (!shard_db) {
+            g_warning("Cannot open %s db shard %s: %s - The db will be "
+                      "written without sharding",
+                      writer->name, path, tmp_err->message);
+            g_clear_error(&tmp_err);
+            break;
+        }
+
+        writer->shards[i] = db_writer_new(shard_db, writer->name,
+                                          writer->udata, 0);
+        writer->shard_count++;
+    }
+
+    if (writer->shard_count == shards)
+        return TRUE;
+
+    for (int i = 0; i < writer->shard_count; i++) {
+        cr_SqliteDb *shard_db = writer->shards[i]->db;
+        db_writer_free(writer->shards[i]);
+        cr_db_close(shard_db, NULL);
+    }
+    for (int i = 0; writer->shard_paths[i]; i++)
+        remove(writer->shard_paths[i]);
+    g_free(writer->shards);
+    g_strfreev(writer->shard_paths);
+    writer->shards = NULL;
+    writer->shard_paths = NULL;
+    writer->shard_count = 0;
+    return FALSE;
+}
+
+/** Close the shards and merge them into the db.
+ */
+static void
+db_writer_merge_shards(struct DbWriter *writer)
+{
+    GError *tmp_err = NULL;
+
+    for (int i = 0; i < writer->shard_count; i++) {
+        cr_SqliteDb *shard_db = writer->shards[i]->db;
+        db_writer_free(writer->shards[i]);
+        cr_db_close(shard_db, &tmp_err);
+        if (tmp_err) {
+            g_critical("Cannot close %s db shard: %s",
+                       writer->name, tmp_err->message);
+            writer->udata->had_errors = TRUE;
+            g_clear_error(&tmp_err);
+        }
+    }
+
+    cr_db_merge_shards(writer->db, writer->shard_paths, &tmp_err);
+    if (tmp_err) {
+        g_critical("Cannot merge shards of %s db: %s",
+                   writer->name, tmp_err->message);
+        writer->udata->had_errors = TRUE;
+        g_clear_error(&tmp_err);
+    }
+
+    for (int i = 0; writer->shard_paths[i]; i++)
+        remove(writer->shard_paths[i]);
+    g_free(writer->shards);
+    g_strfreev(writer->shard_paths);
+}
+
+static struct DbWriter *
+db_writer_new(cr_SqliteDb *db,
+              const char *name,
+              struct UserData *udata,
+              int shards)
+{
+    struct DbWriter *writer;
+
+    if (!db)
+        return NULL;
+
+    writer = g_new0(struct DbWriter, 1);
+    writer->db     = db;
+    writer->name   = name;
+    writer->udata  = udata;
+
+    if (shards > 1 && db_writer_open_shards(writer, shards))
+        return writer;
+
+    writer->queue  = g_queue_new();
+    writer->finish = FALSE;
+    g_mutex_init(&(writer->mutex));
+    g_cond_init(&(writer->cond_push));
+    g_cond_init(&(writer->cond_pop));
+    writer->thread = g_thread_new(name, db_writer_thread, writer);
+
+    return writer;
+}
+
+static void
+db_writer_free(struct DbWriter *writer)
+{
+    if (!writer)
+        return;
+
+    if (writer->shards) {
+        db_writer_merge_shards(writer);
+        g_free(writer);
+        return;
+    }
+
+    g_mutex_lock(&(writer->mutex));
+    writer->finish = TRUE;
+    g_cond_broadcast(&(writer->cond_push));
+    g_mutex_unlock(&(writer->mutex));
+
+    g_thread_join(writer->thread);
+
+    g_queue_free(writer->queue);
+    g_mutex_clear(&(writer->mutex));
+    g_cond_clear(&(writer->cond_push));
+    g_cond_clear(&(writer->cond_pop));
+    g_free(writer);
+}
+
+/** Append the task to the writer queue. The caller must hold the turn
+ * of the corresponding metadata, so the packages are queued (and get
+ * their pkgKeys) in the same order as they are written into the xml.
+ * Blocks while the queue is full.
+ */
+static void
+db_writer_push(struct DbWriter *writer, struct DbTask *task)
+{
+    if (writer->shards) {
+        writer = writer->shards[task->pkgKey % writer->shard_count];
+        assert(!writer->shards);
+    }
+
+    g_mutex_lock(&(writer->mutex));
+    while (g_queue_get_length(writer->queue) >= MAX_DB_QUEUE_LEN)
+        g_cond_wait(&(writer->cond_pop), &(writer->mutex));
+    g_queue_push_tail(writer->queue, task);
+    g_cond_signal(&(writer->cond_push));
+    g_mutex_unlock(&(writer->mutex));
+}
+
+void
+cr_dumper_db_writers_start(struct UserData *udata)
+{
+    udata->pri_db_writer = db_writer_new(udata->pri_db, "primary", udata,
+                                         udata->db_shards);
+    udata->fil_db_writer = db_writer_new(udata->fil_db, "filelists", udata,
+                                         udata->db_shards);
+    udata->oth_db_writer = db_writer_new(udata->oth_db, "other", udata,
+                                         udata->db_shards);
+    udata->db_writers_count = (udata->pri_db_writer ? 1 : 0)
+                              + (udata->fil_db_writer ? 1 : 0)
+                              + (udata->oth_db_writer ? 1 : 0);
+}
+
+void
+cr_dumper_db_writers_finish(struct UserData *udata)
+{
+    db_writer_free(udata->pri_db_writer);
+    db_writer_free(udata->fil_db_writer);
+    db_writer_free(udata->oth_db_writer);
+    udata->pri_db_writer = NULL;
+    udata->fil_db_writer = NULL;
+    udata->oth_db_writer = NULL;
+    udata->db_writers_count = 0;
+}
+
+/** Write the package into the xml files and queue it for the databases.
+ * The function takes ownership of the pkg.
+ */
 static void
 write_pkg(long id,
           struct cr_XmlStruct res,
@@ -70,6 +349,10 @@ write_pkg(long id,
           struct UserData *udata)
 {
     GError *tmp_err = NULL;
+    struct DbTask *db_task = NULL;
+
+    if (udata->db_writers_count)
+        db_task = db_task_new(pkg, udata->db_writers_count);
 
     // Write primary data
     g_mutex_lock(&(udata->mutex_pri));
@@ -77,6 +360,10 @@ write_pkg(long id,
         g_cond_wait (&(udata->cond_pri), &(udata->mutex_pri));
 
     udata->package_count++;
+    if (db_task)
+        // Same key as the one a single db assigns (packages are numbered
+        // from 1 in order of this turn)
+        db_task->pkgKey = udata->package_count;
     g_free(udata->prev_srpm);
     udata->prev_srpm = udata->cur_srpm;
     udata->cur_srpm = g_strdup(pkg->rpm_sourcerpm);
@@ -93,15 +380,8 @@ write_pkg(long id,
         g_clear_error(&tmp_err);
     }
 
-    if (udata->pri_db) {
-        cr_db_add_pkg(udata->pri_db, pkg, &tmp_err);
-        if (tmp_err) {
-            g_critical("Cannot add record of %s (%s) to primary db: %s",
-                       pkg->name, pkg->pkgId, tmp_err->message);
-            udata->had_errors = TRUE;
-            g_clear_error(&tmp_err);
-        }
-    }
+    if (udata->pri_db_writer)
+        db_writer_push(udata->pri_db_writer, db_task);
     if (udata->pri_zck) {
         if (new_pkg) {
             cr_end_chunk(udata->pri_zck->f, &tmp_err);
@@ -136,15 +416,8 @@ write_pkg(long id,
         g_clear_error(&tmp_err);
     }
 
-    if (udata->fil_db) {
-        cr_db_add_pkg(udata->fil_db, pkg, &tmp_err);
-        if (tmp_err) {
-            g_critical("Cannot add record of %s (%s) to filelists db: %s",
-                       pkg->name, pkg->pkgId, tmp_err->message);
-            udata->had_errors = TRUE;
-            g_clear_error(&tmp_err);
-        }
-    }
+    if (udata->fil_db_writer)
+        db_writer_push(udata->fil_db_writer, db_task);
     if (udata->fil_zck) {
         if (new_pkg) {
             cr_end_chunk(udata->fil_zck->f, &tmp_err);
@@ -179,15 +452,8 @@ write_pkg(long id,
         g_clear_error(&tmp_err);
     }
 
-    if (udata->oth_db) {
-        cr_db_add_pkg(udata->oth_db, pkg, NULL);
-        if (tmp_err) {
-            g_critical("Cannot add record of %s (%s) to other db: %s",
-                       pkg->name, pkg->pkgId, tmp_err->message);
-            udata->had_errors = TRUE;
-            g_clear_error(&tmp_err);
-        }
-    }
+    if (udata->oth_db_writer)
+        db_writer_push(udata->oth_db_writer, db_task);
     if (udata->oth_zck) {
         if (new_pkg) {
             cr_end_chunk(udata->oth_zck->f, &tmp_err);
@@ -207,89 +473,185 @@ write_pkg(long id,
     }
     g_cond_broadcast(&(udata->cond_oth));
     g_mutex_unlock(&(udata->mutex_oth));
+
+    // Without databases nobody else needs the package
+    if (!db_task)
+        cr_package_free(pkg);
 }
 
-static char *
-get_checksum(const char *filename,
-             cr_ChecksumType type,
-             cr_Package *pkg,
-             const char *cachedir,
-             GError **err)
+/** Give up the turn of the task without writing anything.
+ */
+static void
+skip_turn(long id, struct UserData *udata)
 {
-    GError *tmp_err = NULL;
-    char *checksum = NULL;
-    char *cachefn = NULL;
-
-    if (cachedir) {
-        // Prepare cache fn
-        char *key;
-        cr_ChecksumCtx *ctx = cr_checksum_new(type, err);
-        if (!ctx) return NULL;
-
-        if (pkg->siggpg)
-            cr_checksum_update(ctx, pkg->siggpg->data, pkg->siggpg->size, NULL);
-        if (pkg->sigpgp)
-            cr_checksum_update(ctx, pkg->sigpgp->data, pkg->sigpgp->size, NULL);
-        if (pkg->hdrid)
-            cr_checksum_update(ctx, pkg->hdrid, strlen(pkg->hdrid), NULL);
-
-        key = cr_checksum_final(ctx, err);
-        if (!key) return NULL;
-
-        cachefn = g_strdup_printf("%s%s-%s-%"G_GINT64_FORMAT"-%"G_GINT64_FORMAT,
-                                  cachedir,
-                                  cr_get_filename(pkg->location_href),
-                                  key, pkg->size_installed, pkg->time_file);
-        free(key);
-
-        // Try to load checksum
-        FILE *f = fopen(cachefn, "r");
-        if (f) {
-            char buf[CACHEDCHKSUM_BUFFER_LEN];
-            size_t readed = fread(buf, 1, CACHEDCHKSUM_BUFFER_LEN, f);
-            if (!ferror(f) && readed > 0) {
-                checksum = g_strndup(buf, readed);
+    g_mutex_lock(&(udata->mutex_pri));
+    while (udata->id_pri != id)
+        g_cond_wait (&(udata->cond_pri), &(udata->mutex_pri));
+    ++udata->id_pri;
+    g_cond_broadcast(&(udata->cond_pri));
+    g_mutex_unlock(&(udata->mutex_pri));
+
+    g_mutex_lock(&(udata->mutex_fil));
+    while (udata->id_fil != id)
+        g_cond_wait (&(udata->cond_fil), &(udata->mutex_fil));
+    ++udata->id_fil;
+    g_cond_broadcast(&(udata->cond_fil));
+    g_mutex_unlock(&(udata->mutex_fil));
+
+    g_mutex_lock(&(udata->mutex_oth));
+    while (udata->id_oth != id)
+        g_cond_wait (&(udata->cond_oth), &(udata->mutex_oth));
+    ++udata->id_oth;
+    g_cond_broadcast(&(udata->cond_oth));
+    g_mutex_unlock(&(udata->mutex_oth));
+}
+
+/** Id of the task which is on turn. The id_pri is incremented by
+ * write_pkg() under the mutex_pri, so it has to be read under it too.
+ */
+static long
+id_on_turn(struct UserData *udata)
+{
+    long id;
+
+    g_mutex_lock(&(udata->mutex_pri));
+    id = udata->id_pri;
+    g_mutex_unlock(&(udata->mutex_pri));
+
+    return id;
+}
+
+/** Store the finished task into its slot of the ring.
+ * Every task owns the slot (id % ring_len), the slot is free as soon
+ * as the task is less than ring_len ahead of the task on turn.
+ * Only tasks which are too far ahead have to wait.
+ */
+static void
+publish_task(struct UserData *udata, struct BufferedTask *buf_task)
+{
+    g_mutex_lock(&(udata->mutex_pri));
+    while (buf_task->id - udata->id_pri >= udata->ring_len)
+        g_cond_wait (&(udata->cond_pri), &(udata->mutex_pri));
+    g_mutex_unlock(&(udata->mutex_pri));
+
+    g_atomic_pointer_set(&(udata->ring[buf_task->id % udata->ring_len]),
+                         buf_task);
+}
+
+/** Write all the tasks from the ring which are on turn.
+ * At most one thread drains the ring at a time, the others just
+ * publish their results and leave.
+ */
+static void
+drain_ring(struct UserData *udata)
+{
+    while (g_atomic_int_compare_and_exchange(&(udata->ring_draining), 0, 1)) {
+        while (1) {
+            long id = id_on_turn(udata);
+            gpointer *slot = &(udata->ring[id % udata->ring_len]);
+            struct BufferedTask *buf_task = g_atomic_pointer_get(slot);
+            if (!buf_task)
+                break;
+            g_atomic_pointer_set(slot, NULL);
+
+            if (buf_task->pkg) {
+                // Dump XML and SQLite (the pkg is owned by write_pkg() now)
+                write_pkg(buf_task->id, buf_task->res, buf_task->pkg, udata);
+                g_free(buf_task->res.primary);
+                g_free(buf_task->res.filelists);
+                g_free(buf_task->res.other);
+            } else {
+                skip_turn(buf_task->id, udata);
             }
-            fclose(f);
-        }
 
-        if (checksum) {
-            g_debug("Cached checksum used: %s: \"%s\"", cachefn, checksum);
-            goto exit;
+            g_free(buf_task->location_href);
+            g_free(buf_task->location_base);
+            g_free(buf_task);
         }
-    }
 
-    // Calculate checksum
-    checksum = cr_checksum_file(filename, type, &tmp_err);
-    if (!checksum) {
-        g_propagate_prefixed_error(err, tmp_err,
-                                   "Error while checksum calculation: ");
-        goto exit;
+        g_atomic_int_set(&(udata->ring_draining), 0);
+
+        // The next task could be published after we looked at its
+        // slot but before we stopped draining - its thread saw us
+        // draining and left, so we have to check it again
+        if (!g_atomic_pointer_get(&(udata->ring[id_on_turn(udata) % udata->ring_len])))
+            break;
     }
+}
 
-    // Cache the checksum value
-    if (cachefn && !g_file_test(cachefn, G_FILE_TEST_EXISTS)) {
-        gchar *template = g_strconcat(cachefn, "-XXXXXX", NULL);
-        // Files should not be executable so use only 0666
-        gint fd = g_mkstemp_full(template, O_RDWR, 0666);
-        if (fd < 0) {
-            g_free(template);
-            goto exit;
-        }
+struct ChecksumCacheData {
+    cr_ChecksumType type;           // Type of checksum
+    cr_ChecksumCache *cache;        // Cache with checksums
+    const char *location_href;      // location_href of the package
+    char *cachekey;                 // Key of the cached checksum
+                                    // (filled by the cached_checksum_cb)
+};
 
-        write(fd, checksum, strlen(checksum));
-        close(fd);
-        if (g_rename(template, cachefn) == -1)
-            g_remove(template);
-        g_free(template);
-    }
+static char *
+get_cachekey(cr_Package *pkg,
+             struct ChecksumCacheData *cdata,
+             GError **err)
+{
+    char *key, *cachekey;
+    cr_ChecksumCtx *ctx = cr_checksum_new(cdata->type, err);
+    if (!ctx) return NULL;
+
+    if (pkg->siggpg)
+        cr_checksum_update(ctx, pkg->siggpg->data, pkg->siggpg->size, NULL);
+    if (pkg->sigpgp)
+        cr_checksum_update(ctx, pkg->sigpgp->data, pkg->sigpgp->size, NULL);
+    if (pkg->hdrid)
+        cr_checksum_update(ctx, pkg->hdrid, strlen(pkg->hdrid), NULL);
+
+    key = cr_checksum_final(ctx, err);
+    if (!key) return NULL;
+
+    cachekey = g_strdup_printf("%s-%s-%"G_GINT64_FORMAT"-%"G_GINT64_FORMAT,
+                               cr_get_filename(cdata->location_href),
+                               key, pkg->size_installed, pkg->time_file);
+    free(key);
+
+    return cachekey;
+}
 
-exit:
-    g_free(cachefn);
+/** Called by cr_package_from_rpm_single_pass() right after the header
+ * was parsed. If the checksum is cached, the payload is never read.
+ */
+static char *
+cached_checksum_cb(cr_Package *pkg, void *cbdata)
+{
+    struct ChecksumCacheData *cdata = cbdata;
+    char *checksum;
+
+    cdata->cachekey = get_cachekey(pkg, cdata, NULL);
+    if (!cdata->cachekey)
+        return NULL;
+
+    checksum = cr_checksum_cache_lookup(cdata->cache, cdata->cachekey);
+    if (checksum)
+        g_debug("Cached checksum used: %s: \"%s\"", cdata->cachekey, checksum);
 
     return checksum;
 }
 
+static void
+cache_checksum(cr_ChecksumCache *cache,
+               const char *cachekey,
+               const char *checksum)
+{
+    GError *tmp_err = NULL;
+
+    if (!cachekey)
+        return;
+
+    cr_checksum_cache_add(cache, cachekey, checksum, &tmp_err);
+    if (tmp_err) {
+        g_warning("Cannot store checksum %s into cache: %s",
+                  cachekey, tmp_err->message);
+        g_clear_error(&tmp_err);
+    }
+}
+
 gchar *
 prepare_split_media_baseurl(int media_id, const char *location_base)
 {
@@ -311,7 +673,7 @@ prepare_split_media_baseurl(int media_id, const char *location_base)
 static cr_Package *
 load_rpm(const char *fullpath,
          cr_ChecksumType checksum_type,
-         const char *checksum_cachedir,
+         cr_ChecksumCache *checksum_cache,
          const char *location_href,
          const char *location_base,
          int changelog_limit,
@@ -319,69 +681,41 @@ load_rpm(const char *fullpath,
          cr_HeaderReadingFlags hdrrflags,
          GError **err)
 {
-    cr_Package *pkg = NULL;
-    GError *tmp_err = NULL;
+    cr_Package *pkg;
+    struct ChecksumCacheData cdata;
 
     assert(fullpath);
     assert(!err || *err == NULL);
 
-    // Get a package object
-    pkg = cr_package_from_rpm_base(fullpath, changelog_limit, hdrrflags, err);
-    if (!pkg)
-        goto errexit;
+    cdata.type          = checksum_type;
+    cdata.cache         = checksum_cache;
+    cdata.location_href = location_href;
+    cdata.cachekey      = NULL;
+
+    // Get a package object - the file is opened and read only once,
+    // header, header range and checksum are all taken from the single pass
+    pkg = cr_package_from_rpm_single_pass(fullpath,
+                                          checksum_type,
+                                          changelog_limit,
+                                          stat_buf,
+                                          hdrrflags,
+                                          checksum_cache ? cached_checksum_cb : NULL,
+                                          &cdata,
+                                          err);
+    if (!pkg) {
+        g_free(cdata.cachekey);
+        return NULL;
+    }
 
     // Locations
     pkg->location_href = cr_safe_string_chunk_insert(pkg->chunk, location_href);
     pkg->location_base = cr_safe_string_chunk_insert(pkg->chunk, location_base);
 
-    // Get checksum type string
-    pkg->checksum_type = cr_safe_string_chunk_insert(pkg->chunk,
-                                        cr_checksum_name_str(checksum_type));
-
-    // Get file stat
-    if (!stat_buf) {
-        struct stat stat_buf_own;
-        if (stat(fullpath, &stat_buf_own) == -1) {
-            g_warning("%s: stat(%s) error (%s)", __func__,
-                      fullpath, g_strerror(errno));
-            g_set_error(err,  CREATEREPO_C_ERROR, CRE_IO, "stat(%s) failed: %s",
-                        fullpath, g_strerror(errno));
-            goto errexit;
-        }
-        pkg->time_file    = stat_buf_own.st_mtime;
-        pkg->size_package = stat_buf_own.st_size;
-    } else {
-        pkg->time_file    = stat_buf->st_mtime;
-        pkg->size_package = stat_buf->st_size;
-    }
-
-    // Compute checksum
-    char *checksum = get_checksum(fullpath, checksum_type, pkg,
-                                  checksum_cachedir, &tmp_err);
-    if (!checksum) {
-        g_propagate_error(err, tmp_err);
-        goto errexit;
-    }
-    pkg->pkgId = cr_safe_string_chunk_insert(pkg->chunk, checksum);
-    free(checksum);
-
-    // Get header range
-    struct cr_HeaderRangeStruct hdr_r = cr_get_header_byte_range(fullpath,
-                                                                 &tmp_err);
-    if (tmp_err) {
-        g_propagate_prefixed_error(err, tmp_err,
-                                   "Error while determining header range: ");
-        goto errexit;
-    }
-
-    pkg->rpm_header_start = hdr_r.start;
-    pkg->rpm_header_end = hdr_r.end;
+    // Cache the checksum value
+    cache_checksum(checksum_cache, cdata.cachekey, pkg->pkgId);
+    g_free(cdata.cachekey);
 
     return pkg;
-
-errexit:
-    cr_package_free(pkg);
-    return NULL;
 }
 
 void
@@ -393,7 +727,9 @@ cr_dumper_thread(gpointer data, gpointer user_data)
     cr_Package *pkg = NULL;     // Package from file
     struct stat stat_buf;       // Struct with info from stat() on file
     struct cr_XmlStruct res;    // Structure for generated XML
+    cr_MetadataRawXml *raw_xml = NULL; // Raw XML chunks of the md package
     cr_HeaderReadingFlags hdrrflags = CR_HDRR_NONE;
+    struct BufferedTask *buf_task = NULL; // Result parked in the ring
 
     struct UserData *udata = (struct UserData *) user_data;
     struct PoolTask *task  = (struct PoolTask *) data;
@@ -428,9 +764,13 @@ cr_dumper_thread(gpointer data, gpointer user_data)
     }
 
     // If --cachedir is used, load signatures and hdrid from packages too
-    if (udata->checksum_cachedir)
+    if (udata->checksum_cache)
         hdrrflags = CR_HDRR_LOADHDRID | CR_HDRR_LOADSIGNATURES;
 
+    // Generated deltas are identified by hdrids of the packages
+    if (udata->deltas)
+        hdrrflags |= CR_HDRR_LOADHDRID;
+
     // Get stat info about file
     if (udata->old_metadata && !(udata->skip_stat)) {
         if (stat(task->full_path, &stat_buf) == -1) {
@@ -452,8 +792,15 @@ cr_dumper_thread(gpointer data, gpointer user_data)
         // thread can use it as CACHE, because later we modify it destructively
         g_hash_table_steal(cr_metadata_hashtable(udata->old_metadata),
                                                  cache_key);
+        raw_xml = cr_metadata_steal_raw_xml(udata->old_metadata, md, &tmp_err);
         g_mutex_unlock(&(udata->mutex_old_md));
 
+        if (tmp_err) {
+            g_warning("Cannot get old XML of %s: %s",
+                      task->filename, tmp_err->message);
+            g_clear_error(&tmp_err);
+        }
+
         if (md) {
             g_debug("CACHE HIT %s", task->filename);
 
@@ -478,6 +825,12 @@ cr_dumper_thread(gpointer data, gpointer user_data)
                 // ^^^ The location_base not location_href are properly saved
                 // into pkg chunk this is intentional as after the metadata
                 // are written (dumped) none should use them again.
+
+                // The header isn't read, so the cache key is unknown, keep
+                // the cached checksum of the package alive for --cache-gc
+                if (udata->checksum_cache && md->pkgId)
+                    cr_checksum_cache_touch_checksum(udata->checksum_cache,
+                                                     md->pkgId);
             }
         }
     }
@@ -486,7 +839,7 @@ cr_dumper_thread(gpointer data, gpointer user_data)
     if (!old_used) {
         // Load package from file
         pkg = load_rpm(task->full_path, udata->checksum_type,
-                       udata->checksum_cachedir, location_href,
+                       udata->checksum_cache, location_href,
                        location_base, udata->changelog_limit,
                        NULL, hdrrflags, &tmp_err);
         assert(pkg || tmp_err);
@@ -514,9 +867,47 @@ cr_dumper_thread(gpointer data, gpointer user_data)
             g_mutex_unlock(&(udata->mutex_output_pkg_list));
         }
     } else {
-        // Just gen XML from old loaded metadata
+        gboolean reuse_raw = raw_xml && raw_xml->primary
+                             && raw_xml->filelists && raw_xml->other;
+
         pkg = md;
-        res = cr_xml_dump(md, &tmp_err);
+
+        // Lazily loaded packages have to be completed if they are dumped
+        // or inserted into databases
+        if (raw_xml && (!reuse_raw || udata->db_writers_count)) {
+            cr_metadata_fill_package(md, raw_xml, &tmp_err);
+            if (tmp_err) {
+                g_critical("Cannot load old metadata of %s (%s): %s",
+                           md->name, md->pkgId, tmp_err->message);
+                udata->had_errors = TRUE;
+                g_clear_error(&tmp_err);
+                goto task_cleanup;
+            }
+        }
+
+        if (reuse_raw) {
+            // Reuse the XML from old metadata as is, only the location
+            // of the package could be different
+            res.primary = cr_xml_relocate_primary(raw_xml->primary, md,
+                                                  &tmp_err);
+            if (!tmp_err) {
+                res.filelists = raw_xml->filelists;
+                res.other     = raw_xml->other;
+                raw_xml->filelists = NULL;
+                raw_xml->other     = NULL;
+            } else {
+                g_debug("Cannot reuse XML for %s (%s): %s",
+                        md->name, md->pkgId, tmp_err->message);
+                g_clear_error(&tmp_err);
+                reuse_raw = FALSE;
+                cr_metadata_fill_package(md, raw_xml, &tmp_err);
+            }
+        }
+
+        // Just gen XML from old loaded metadata
+        if (!reuse_raw && !tmp_err)
+            res = cr_xml_dump(md, &tmp_err);
+
         if (tmp_err) {
             g_critical("Cannot dump XML for %s (%s): %s",
                        md->name, md->pkgId, tmp_err->message);
@@ -549,81 +940,31 @@ cr_dumper_thread(gpointer data, gpointer user_data)
     }
 #endif
 
-    // Buffering stuff
-    g_mutex_lock(&(udata->mutex_buffer));
-
-    if (g_queue_get_length(udata->buffer) < MAX_TASK_BUFFER_LEN
-        && udata->id_pri != task->id
-        && udata->task_count > (task->id + 1))
-    {
-        // If:
-        //  * this isn't our turn
-        //  * the buffer isn't full
-        //  * this isn't the last task
-        // Then: save the task to the buffer
-
-        struct BufferedTask *buf_task = malloc(sizeof(struct BufferedTask));
-        buf_task->id  = task->id;
-        buf_task->res = res;
-        buf_task->pkg = pkg;
-        buf_task->location_href = NULL;
-        buf_task->location_base = NULL;
-        buf_task->pkg_from_md = (pkg == md) ? 1 : 0;
-
-        if (pkg == md) {
-            // We MUST store locations for reused packages who goes to the buffer
-            buf_task->location_href = g_strdup(location_href);
-            buf_task->pkg->location_href = buf_task->location_href;
-
-            buf_task->location_base = g_strdup(location_base);
-            buf_task->pkg->location_base = buf_task->location_base;
-        }
-
-        g_queue_insert_sorted(udata->buffer, buf_task, buf_task_sort_func, NULL);
-        g_mutex_unlock(&(udata->mutex_buffer));
-
-        g_free(task->full_path);
-        g_free(task->filename);
-        g_free(task->path);
-        g_free(task);
-
-        return;
+    // Park the result in the ring, the thread which is on turn writes it
+    buf_task = g_new0(struct BufferedTask, 1);
+    buf_task->id  = task->id;
+    buf_task->res = res;
+    buf_task->pkg = pkg;
+    buf_task->location_href = NULL;
+    buf_task->location_base = NULL;
+
+    if (pkg == md) {
+        // We MUST store locations for reused packages, the package
+        // could be written by another thread after this one returns
+        buf_task->location_href = g_strdup(location_href);
+        buf_task->pkg->location_href = buf_task->location_href;
+
+        buf_task->location_base = g_strdup(location_base);
+        buf_task->pkg->location_base = buf_task->location_base;
     }
 
-    g_mutex_unlock(&(udata->mutex_buffer));
-
-    // Dump XML and SQLite
-    write_pkg(task->id, res, pkg, udata);
-
-    // Clean up
-    cr_package_free(pkg);
-    g_free(res.primary);
-    g_free(res.filelists);
-    g_free(res.other);
-
 task_cleanup:
-    if (udata->id_pri <= task->id) {
-        // An error was encountered and we have to wait to increment counters
-        g_mutex_lock(&(udata->mutex_pri));
-        while (udata->id_pri != task->id)
-            g_cond_wait (&(udata->cond_pri), &(udata->mutex_pri));
-        ++udata->id_pri;
-        g_cond_broadcast(&(udata->cond_pri));
-        g_mutex_unlock(&(udata->mutex_pri));
-
-        g_mutex_lock(&(udata->mutex_fil));
-        while (udata->id_fil != task->id)
-            g_cond_wait (&(udata->cond_fil), &(udata->mutex_fil));
-        ++udata->id_fil;
-        g_cond_broadcast(&(udata->cond_fil));
-        g_mutex_unlock(&(udata->mutex_fil));
-
-        g_mutex_lock(&(udata->mutex_oth));
-        while (udata->id_oth != task->id)
-            g_cond_wait (&(udata->cond_oth), &(udata->mutex_oth));
-        ++udata->id_oth;
-        g_cond_broadcast(&(udata->cond_oth));
-        g_mutex_unlock(&(udata->mutex_oth));
+    cr_metadata_raw_xml_free(raw_xml);
+
+    if (!buf_task) {
+        // An error was encountered, the task only has to give up its turn
+        buf_task = g_new0(struct BufferedTask, 1);
+        buf_task->id = task->id;
     }
 
     g_free(task->full_path);
@@ -631,29 +972,10 @@ task_cleanup:
     g_free(task->path);
     g_free(task);
 
-    // Try to write all results from buffer which was waiting for us
-    while (1) {
-        struct BufferedTask *buf_task;
-        g_mutex_lock(&(udata->mutex_buffer));
-        buf_task = g_queue_peek_head(udata->buffer);
-        if (buf_task && buf_task->id == udata->id_pri) {
-            buf_task = g_queue_pop_head (udata->buffer);
-            g_mutex_unlock(&(udata->mutex_buffer));
-            // Dump XML and SQLite
-            write_pkg(buf_task->id, buf_task->res, buf_task->pkg, udata);
-            // Clean up
-            cr_package_free(buf_task->pkg);
-            g_free(buf_task->res.primary);
-            g_free(buf_task->res.filelists);
-            g_free(buf_task->res.other);
-            g_free(buf_task->location_href);
-            g_free(buf_task->location_base);
-            g_free(buf_task);
-        } else {
-            g_mutex_unlock(&(udata->mutex_buffer));
-            break;
-        }
-    }
+    publish_task(udata, buf_task);
+
+    // Write all results from the ring which are on turn
+    drain_ring(udata);
 
     return;
 }
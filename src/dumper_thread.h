@@ -26,6 +26,7 @@ extern "C" {
 
 #include <glib.h>
 #include <rpm/rpmlib.h>
+#include "checksum_cache.h"
 #include "load_metadata.h"
 #include "locate_metadata.h"
 #include "misc.h"
@@ -46,6 +47,10 @@ struct PoolTask {
     char* path;                     // Just path     - /foo/bar/packages
 };
 
+#define CR_DUMPER_RING_LEN          1024
+
+struct DbWriter;
+
 struct UserData {
     cr_XmlFile *pri_f;              // Opened compressed primary.xml.*
     cr_XmlFile *fil_f;              // Opened compressed filelists.xml.*
@@ -53,6 +58,12 @@ struct UserData {
     cr_SqliteDb *pri_db;            // Primary db
     cr_SqliteDb *fil_db;            // Filelists db
     cr_SqliteDb *oth_db;            // Other db
+    struct DbWriter *pri_db_writer; // Thread inserting into primary db
+    struct DbWriter *fil_db_writer; // Thread inserting into filelists db
+    struct DbWriter *oth_db_writer; // Thread inserting into other db
+    gint db_writers_count;          // Number of running db writers
+    int db_shards;                  // Number of shards written in parallel
+                                    // per db (0 or 1 - no sharding)
     cr_XmlFile *pri_zck;            // Opened compressed primary.xml.zck
     cr_XmlFile *fil_zck;            // Opened compressed filelists.xml.zck
     cr_XmlFile *oth_zck;            // Opened compressed other.xml.zck
@@ -64,7 +75,7 @@ struct UserData {
                                     //       This part     |<----->|
     const char *checksum_type_str;  // Name of selected checksum
     cr_ChecksumType checksum_type;  // Constant representing selected checksum
-    const char *checksum_cachedir;  // Dir with cached checksums
+    cr_ChecksumCache *checksum_cache; // Cache of checksums (--cachedir)
     gboolean skip_symlinks;         // Skip symlinks
     long task_count;                // Total number of task to process
     long package_count;             // Total number of packages processed
@@ -86,8 +97,10 @@ struct UserData {
     volatile long id_oth;           // ID of task on turn (write other metadata)
 
     // Buffering
-    GQueue *buffer;                 // Buffer for done tasks
-    GMutex mutex_buffer;           // Mutex for accessing the buffer
+    gpointer *ring;                 // Ring of done tasks, a task with
+                                    // id N is stored at N % ring_len
+    long ring_len;                  // Number of slots in the ring
+    gint ring_draining;             // Is a thread writing tasks from ring?
 
     // Delta generation
     gboolean deltas;                // Are deltas enabled?
@@ -111,6 +124,25 @@ struct UserData {
 void
 cr_dumper_thread(gpointer data, gpointer user_data);
 
+/** Start a writer thread for each of the opened databases (pri_db,
+ * fil_db, oth_db) in the user data. Dumper threads then only queue
+ * packages for the databases in order of their turn and don't wait
+ * for the sqlite inserts. If db_shards is set, every database is written
+ * by db_shards threads, each into its own shard, and the shards are
+ * merged into the database by cr_dumper_db_writers_finish().
+ * @param udata         User data of the dumper threads
+ */
+void
+cr_dumper_db_writers_start(struct UserData *udata);
+
+/** Wait until all queued packages are inserted into the databases
+ * and stop the writer threads. Must be called after all the dumper
+ * threads are finished and before the databases are closed.
+ * @param udata         User data of the dumper threads
+ */
+void
+cr_dumper_db_writers_finish(struct UserData *udata);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -105,9 +105,6 @@ koji_stuff_prepare(struct KojiMergedReposStuff **koji_stuff_ptr,
     int repoid;
     int result;
 
-    // Pointers to elements in the koji_stuff_ptr
-    GHashTable *include_srpms = NULL; // XXX
-
     koji_stuff = g_malloc0(sizeof(struct KojiMergedReposStuff));
     *koji_stuff_ptr = koji_stuff;
 
@@ -122,7 +119,6 @@ koji_stuff_prepare(struct KojiMergedReposStuff **koji_stuff_ptr,
                                                   g_str_equal,
                                                   g_free,
                                                   NULL);
-    include_srpms = koji_stuff->include_srpms;
 
     // Load list of blocked srpm packages
 
@@ -169,14 +165,15 @@ koji_stuff_prepare(struct KojiMergedReposStuff **koji_stuff_ptr,
 
     // Iterate over every repo and fill include_srpms hashtable
 
+    if (!repos)
+        return 0;  // Repos will be added by koji_stuff_add_repo_srpms()
+
     g_debug("Preparing list of allowed srpm builds");
 
     repoid = 0;
     for (element = repos; element; element = g_slist_next(element)) {
         struct cr_MetadataLocation *ml;
         cr_Metadata *metadata;
-        GHashTableIter iter;
-        gpointer key, void_pkg;
 
         ml = (struct cr_MetadataLocation *) element->data;
         if (!ml) {
@@ -195,80 +192,99 @@ koji_stuff_prepare(struct KojiMergedReposStuff **koji_stuff_ptr,
             break;
         }
 
-        // Iterate over every package in repo and what "builds"
-        // we're allowing into the repo
-        g_hash_table_iter_init(&iter, cr_metadata_hashtable(metadata));
-        while (g_hash_table_iter_next(&iter, &key, &void_pkg)) {
-            cr_Package *pkg = (cr_Package *) void_pkg;
-            cr_NEVRA *nevra;
-            gpointer data;
-            struct srpm_val *srpm_value_new;
-
-            if (!pkg->rpm_sourcerpm) {
-                g_warning("Package '%s' from '%s' doesn't have specified source srpm",
-                          pkg->location_href, ml->original_url);
-                continue;
-            }
+        koji_stuff_add_repo_srpms(koji_stuff,
+                                  cr_metadata_hashtable(metadata),
+                                  ml->original_url,
+                                  repoid);
+
+        cr_metadata_free(metadata);
+        repoid++;
+    }
+
+
+    return 0;  // All ok
+}
+
+void
+koji_stuff_add_repo_srpms(struct KojiMergedReposStuff *koji_stuff,
+                          GHashTable *packages,
+                          const gchar *repo_url,
+                          int repoid)
+{
+    GHashTable *include_srpms = koji_stuff->include_srpms;
+    GHashTableIter iter;
+    gpointer key, void_pkg;
+
+    if (!include_srpms)
+        return;
+
+    // Iterate over every package in repo and what "builds"
+    // we're allowing into the repo
+    g_hash_table_iter_init(&iter, packages);
+    while (g_hash_table_iter_next(&iter, &key, &void_pkg)) {
+        cr_Package *pkg = (cr_Package *) void_pkg;
+        cr_NEVRA *nevra;
+        gpointer data;
+        struct srpm_val *srpm_value_new;
+
+        if (!pkg->rpm_sourcerpm) {
+            g_warning("Package '%s' from '%s' doesn't have specified source srpm",
+                      pkg->location_href, repo_url);
+            continue;
+        }
+
+        nevra = cr_split_rpm_filename(pkg->rpm_sourcerpm);
+
+        if (!nevra) {
+            g_debug("Srpm name is invalid: %s", pkg->rpm_sourcerpm);
+            continue;
+        }
 
-            nevra = cr_split_rpm_filename(pkg->rpm_sourcerpm);
+        data = g_hash_table_lookup(include_srpms, nevra->name);
+        if (data) {
+            // We have already seen build with the same name
 
-            if (!nevra) {
-                g_debug("Srpm name is invalid: %s", pkg->rpm_sourcerpm);
+            int cmp;
+            cr_NEVRA *nevra_existing;
+            struct srpm_val *srpm_value_existing = data;
+
+            if (srpm_value_existing->repo_id != repoid) {
+                // We found a rpm built from an srpm with the same name in
+                // a previous repo. The previous repo takes precendence,
+                // so ignore the srpm found here.
+                cr_nevra_free(nevra);
+                g_debug("Srpm already loaded from previous repo %s",
+                        pkg->rpm_sourcerpm);
                 continue;
             }
 
-            data = g_hash_table_lookup(include_srpms, nevra->name);
-            if (data) {
-                // We have already seen build with the same name
-
-                int cmp;
-                cr_NEVRA *nevra_existing;
-                struct srpm_val *srpm_value_existing = data;
-
-                if (srpm_value_existing->repo_id != repoid) {
-                    // We found a rpm built from an srpm with the same name in
-                    // a previous repo. The previous repo takes precendence,
-                    // so ignore the srpm found here.
-                    cr_nevra_free(nevra);
-                    g_debug("Srpm already loaded from previous repo %s",
-                            pkg->rpm_sourcerpm);
-                    continue;
-                }
-
-                // We're in the same repo, so compare srpm NVRs
-                nevra_existing = cr_split_rpm_filename(srpm_value_existing->sourcerpm);
-                cmp = cr_cmp_nevra(nevra, nevra_existing);
-                cr_nevra_free(nevra_existing);
-                if (cmp < 1) {
-                    // Existing package is from the newer srpm
-                    cr_nevra_free(nevra);
-                    g_debug("Srpm already exists in newer version %s",
-                            pkg->rpm_sourcerpm);
-                    continue;
-                }
+            // We're in the same repo, so compare srpm NVRs
+            nevra_existing = cr_split_rpm_filename(srpm_value_existing->sourcerpm);
+            cmp = cr_cmp_nevra(nevra, nevra_existing);
+            cr_nevra_free(nevra_existing);
+            if (cmp < 1) {
+                // Existing package is from the newer srpm
+                cr_nevra_free(nevra);
+                g_debug("Srpm already exists in newer version %s",
+                        pkg->rpm_sourcerpm);
+                continue;
             }
-
-            // The current package we're processing is from a newer srpm
-            // than the existing srpm in the dict, so update the dict
-            // OR
-            // We found a new build so we add it to the dict
-
-            g_debug("Adding srpm: %s", pkg->rpm_sourcerpm);
-            srpm_value_new = g_malloc0(sizeof(struct srpm_val));
-            srpm_value_new->repo_id = repoid;
-            srpm_value_new->sourcerpm = g_strdup(pkg->rpm_sourcerpm);
-            g_hash_table_replace(include_srpms,
-                                 g_strdup(nevra->name),
-                                 srpm_value_new);
-            cr_nevra_free(nevra);
         }
 
-        cr_metadata_free(metadata);
-        repoid++;
+        // The current package we're processing is from a newer srpm
+        // than the existing srpm in the dict, so update the dict
+        // OR
+        // We found a new build so we add it to the dict
+
+        g_debug("Adding srpm: %s", pkg->rpm_sourcerpm);
+        srpm_value_new = g_malloc0(sizeof(struct srpm_val));
+        srpm_value_new->repo_id = repoid;
+        srpm_value_new->sourcerpm = g_strdup(pkg->rpm_sourcerpm);
+        g_hash_table_replace(include_srpms,
+                             g_strdup(nevra->name),
+                             srpm_value_new);
+        cr_nevra_free(nevra);
     }
-
-
-    return 0;  // All ok
 }
 
 gboolean
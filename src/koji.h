@@ -85,11 +85,26 @@ int
 pkgorigins_prepare(struct KojiMergedReposStuff **koji_stuff_ptr,
                    const gchar *tmpdir);
 
+/* Prepare koji stuff. If repos are passed, they are all loaded and
+ * the include_srpms table is filled right away. If repos is NULL, the
+ * caller is expected to call koji_stuff_add_repo_srpms() for every repo
+ * it loads (before its packages are passed to koji_allowed()), so each
+ * repo is parsed only once. */
 int
 koji_stuff_prepare(struct KojiMergedReposStuff **koji_stuff_ptr,
                    struct CmdOptions *cmd_options,
                    GSList *repos);
 
+/* Update include_srpms by packages of a single repo. Repos have to be
+ * added in order (with increasing repoid) - srpms seen in a previous repo
+ * take precedence, so once a repo is added, decisions about srpms which
+ * were first seen in it (or before it) are final. */
+void
+koji_stuff_add_repo_srpms(struct KojiMergedReposStuff *koji_stuff,
+                          GHashTable *packages,
+                          const gchar *repo_url,
+                          int repoid);
+
 void
 koji_stuff_destroy(struct KojiMergedReposStuff **koji_stuff_ptr);
 
@@ -18,11 +18,14 @@
  */
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <unistd.h>
 
 #ifdef WITH_LIBMODULEMD
 #include <modulemd.h>
@@ -34,9 +37,40 @@
 #include "load_metadata.h"
 #include "locate_metadata.h"
 #include "xml_parser.h"
+#include "xml_parser_internal.h"
 
 #define ERR_DOMAIN              CREATEREPO_C_ERROR
 #define STRINGCHUNK_SIZE        16384
+#define PKG_STRINGCHUNK_SIZE    1024
+
+/** Indexes of raw xml chunks (match the cr_ParsingState)
+ */
+typedef enum {
+    RAW_PRI,
+    RAW_FIL,
+    RAW_OTH,
+    RAW_SENTINEL,
+} cr_RawType;
+
+/** Raw xml chunks of a single package. Every chunk is either in memory
+ * or in the spool file.
+ */
+typedef struct {
+    char    *chunk[RAW_SENTINEL];   /*!< In memory chunks or NULL */
+    gint64  offset[RAW_SENTINEL];   /*!< Offsets of chunks in the spool */
+    gsize   len[RAW_SENTINEL];      /*!< Lengths of chunks (0 - no chunk) */
+} cr_RawRecord;
+
+/** Where and which raw xml chunks are stored.
+ */
+typedef struct {
+    gboolean    keep_raw;   /*!< Keep all chunks (see keep_raw_xml) */
+    gboolean    lazy;       /*!< Filelists and other are only spooled */
+    int         fd;         /*!< Spool file or -1 (chunks are in memory) */
+    gint64      size;       /*!< Size of the spool file */
+    GMutex      mutex;      /*!< Guards the size (filelists and other
+                                 could be spooled in parallel) */
+} cr_RawStore;
 
 /** Structure for loaded metadata
  */
@@ -47,6 +81,10 @@ struct _cr_Metadata {
     GHashTable *pkglist_ht; /*!< list of allowed package basenames to load */
     cr_HashTableKeyDupAction dupaction; /*!<
         How to behave in case of duplicated items */
+    GHashTable *raw_ht;     /*!< NULL or raw xml chunks of the packages
+                                 (key is cr_Package *) */
+    cr_RawStore raw_store;  /*!< Configuration of the raw_ht */
+    gboolean parallel;      /*!< Parse filelists and other in parallel */
 
 #ifdef WITH_LIBMODULEMD
     ModulemdModuleIndex *moduleindex; /*!< Module metadata */
@@ -129,6 +167,8 @@ cr_metadata_new(cr_HashTableKey key, int use_single_chunk, GSList *pkglist)
     }
 
     md->dupaction = CR_HT_DUPACT_KEEPFIRST;
+    md->raw_store.fd = -1;
+    g_mutex_init(&md->raw_store.mutex);
 
     return md;
 }
@@ -148,9 +188,248 @@ cr_metadata_free(cr_Metadata *md)
         g_string_chunk_free(md->chunk);
     if (md->pkglist_ht)
         g_hash_table_destroy(md->pkglist_ht);
+    if (md->raw_ht)
+        g_hash_table_destroy(md->raw_ht);
+    if (md->raw_store.fd >= 0)
+        close(md->raw_store.fd);
+    g_mutex_clear(&md->raw_store.mutex);
     g_free(md);
 }
 
+static void
+cr_raw_record_free(cr_RawRecord *rec)
+{
+    if (!rec)
+        return;
+    for (int x = 0; x < RAW_SENTINEL; x++)
+        g_free(rec->chunk[x]);
+    g_free(rec);
+}
+
+/** Store the chunk (a newline is appended) into the record.
+ */
+static int
+cr_raw_record_store(cr_RawStore *store,
+                    cr_RawRecord *rec,
+                    cr_RawType type,
+                    const char *raw,
+                    size_t len,
+                    GError **err)
+{
+    char *chunk = g_malloc(len + 2);
+
+    // Keep the chunk in the same form as cr_xml_dump() generates it
+    memcpy(chunk, raw, len);
+    chunk[len] = '\n';
+    chunk[len + 1] = '\0';
+
+    g_free(rec->chunk[type]);
+    rec->chunk[type] = NULL;
+    rec->len[type] = len + 1;
+
+    if (store->fd < 0) {
+        rec->chunk[type] = chunk;
+        return CRE_OK;
+    }
+
+    // Reserve a space in the spool file and write the chunk there
+    g_mutex_lock(&store->mutex);
+    rec->offset[type] = store->size;
+    store->size += len + 1;
+    g_mutex_unlock(&store->mutex);
+
+    for (size_t done = 0; done < len + 1;) {
+        ssize_t ret = pwrite(store->fd, chunk + done, len + 1 - done,
+                             rec->offset[type] + done);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "Cannot write to the spool file: %s",
+                        g_strerror(errno));
+            rec->len[type] = 0;
+            g_free(chunk);
+            return CRE_IO;
+        }
+        done += ret;
+    }
+
+    g_free(chunk);
+    return CRE_OK;
+}
+
+/** Return the chunk from the record (in memory chunks are stolen).
+ */
+static char *
+cr_raw_record_get(cr_RawStore *store,
+                  cr_RawRecord *rec,
+                  cr_RawType type,
+                  GError **err)
+{
+    char *chunk;
+
+    if (rec->chunk[type]) {
+        chunk = rec->chunk[type];
+        rec->chunk[type] = NULL;
+        return chunk;
+    }
+
+    if (!rec->len[type])
+        return NULL;
+
+    assert(store->fd >= 0);
+
+    chunk = g_malloc(rec->len[type] + 1);
+    for (gsize done = 0; done < rec->len[type];) {
+        ssize_t ret = pread(store->fd, chunk + done, rec->len[type] - done,
+                            rec->offset[type] + done);
+        if (ret <= 0) {
+            if (ret < 0 && errno == EINTR)
+                continue;
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "Cannot read from the spool file: %s",
+                        ret ? g_strerror(errno) : "Unexpected end of file");
+            g_free(chunk);
+            return NULL;
+        }
+        done += ret;
+    }
+    chunk[rec->len[type]] = '\0';
+
+    return chunk;
+}
+
+void
+cr_metadata_raw_xml_free(cr_MetadataRawXml *raw)
+{
+    if (!raw)
+        return;
+    g_free(raw->primary);
+    g_free(raw->filelists);
+    g_free(raw->other);
+    g_free(raw);
+}
+
+void
+cr_metadata_set_keep_raw_xml(cr_Metadata *md, gboolean keep)
+{
+    assert(md);
+    md->raw_store.keep_raw = keep;
+}
+
+void
+cr_metadata_set_lazy_loading(cr_Metadata *md, gboolean lazy)
+{
+    assert(md);
+    md->raw_store.lazy = lazy;
+}
+
+void
+cr_metadata_set_parallel_loading(cr_Metadata *md, gboolean parallel)
+{
+    assert(md);
+    md->parallel = parallel;
+}
+
+cr_MetadataRawXml *
+cr_metadata_steal_raw_xml(cr_Metadata *md, cr_Package *pkg, GError **err)
+{
+    cr_RawRecord *rec;
+    cr_MetadataRawXml *raw;
+    GError *tmp_err = NULL;
+
+    assert(md);
+    assert(!err || *err == NULL);
+
+    if (!md->raw_ht || !pkg)
+        return NULL;
+
+    rec = g_hash_table_lookup(md->raw_ht, pkg);
+    if (!rec)
+        return NULL;
+    g_hash_table_steal(md->raw_ht, pkg);
+
+    raw = g_new0(cr_MetadataRawXml, 1);
+    raw->primary = cr_raw_record_get(&md->raw_store, rec, RAW_PRI, &tmp_err);
+    if (!tmp_err)
+        raw->filelists = cr_raw_record_get(&md->raw_store, rec, RAW_FIL,
+                                           &tmp_err);
+    if (!tmp_err)
+        raw->other = cr_raw_record_get(&md->raw_store, rec, RAW_OTH,
+                                       &tmp_err);
+    cr_raw_record_free(rec);
+
+    if (tmp_err) {
+        g_propagate_error(err, tmp_err);
+        cr_metadata_raw_xml_free(raw);
+        return NULL;
+    }
+
+    return raw;
+}
+
+static int
+fill_newpkgcb(cr_Package **pkg,
+              const char *pkgId,
+              G_GNUC_UNUSED const char *name,
+              G_GNUC_UNUSED const char *arch,
+              void *cbdata,
+              G_GNUC_UNUSED GError **err)
+{
+    cr_Package *target = cbdata;
+
+    // Only the chunk of the package itself is expected
+    if (!g_strcmp0(target->pkgId, pkgId))
+        *pkg = target;
+
+    return CR_CB_RET_OK;
+}
+
+int
+cr_metadata_fill_package(cr_Package *pkg,
+                         const cr_MetadataRawXml *raw,
+                         GError **err)
+{
+    GError *tmp_err = NULL;
+
+    assert(pkg);
+    assert(!err || *err == NULL);
+
+    if (!raw)
+        return CRE_OK;
+
+    if (!pkg->chunk) {
+        // The package uses the string chunk of the whole cr_Metadata which
+        // must not be modified from multiple threads, use an own one
+        pkg->chunk = g_string_chunk_new(PKG_STRINGCHUNK_SIZE);
+        pkg->loadingflags &= ~CR_PACKAGE_SINGLE_CHUNK;
+    }
+
+    if (raw->filelists && !(pkg->loadingflags & CR_PACKAGE_LOADED_FIL)) {
+        cr_xml_parse_filelists_snippet(raw->filelists, fill_newpkgcb, pkg,
+                                       NULL, NULL, NULL, NULL, &tmp_err);
+        if (tmp_err) {
+            int code = tmp_err->code;
+            g_propagate_prefixed_error(err, tmp_err, "filelists.xml chunk: ");
+            return code;
+        }
+        pkg->loadingflags |= CR_PACKAGE_LOADED_FIL;
+    }
+
+    if (raw->other && !(pkg->loadingflags & CR_PACKAGE_LOADED_OTH)) {
+        cr_xml_parse_other_snippet(raw->other, fill_newpkgcb, pkg,
+                                   NULL, NULL, NULL, NULL, &tmp_err);
+        if (tmp_err) {
+            int code = tmp_err->code;
+            g_propagate_prefixed_error(err, tmp_err, "other.xml chunk: ");
+            return code;
+        }
+        pkg->loadingflags |= CR_PACKAGE_LOADED_OTH;
+    }
+
+    return CRE_OK;
+}
+
 gboolean
 cr_metadata_set_dupaction(cr_Metadata *md, cr_HashTableKeyDupAction dupaction)
 {
@@ -182,8 +461,54 @@ typedef struct {
         Key is pkgId and value is NULL. */
     cr_ParsingState state;
     gint64          pkgKey; /*!< basically order of the package */
+    GHashTable      *raw_ht; /*!< NULL or raw xml chunks of the packages.
+        Key is pkgId and value is cr_RawRecord. */
+    cr_RawStore     *raw_store;
+    cr_RawRecord    *raw_pending; /*!< Record of the currently parsed
+        primary package (waiting for the primary_pkgcb) */
+    cr_RawRecord    *raw_target; /*!< Record which should get the chunk of
+        the currently parsed filelists or other package */
+    GAsyncQueue     *detached; /*!< If not NULL, other.xml is parsed in
+        a separate thread, in parallel with filelists.xml. Packages from
+        the hashtable must not be modified by that thread, changelogs are
+        parsed into temporary packages which are passed through this
+        queue and attached to the real packages later. */
+    GHashTable      *detached_seen; /*!< pkgIds of the temporary packages
+        (only the first chunk of a package is used) */
+    gint            *interrupted; /*!< Set if the other thread failed */
 } cr_CbData;
 
+static int
+rawpkgcb(cr_Package *pkg,
+         const char *raw,
+         size_t len,
+         void *cbdata,
+         GError **err)
+{
+    cr_CbData *cb_data = cbdata;
+    cr_RawRecord *rec;
+
+    if (cb_data->state == PARSING_PRI) {
+        if (!pkg)
+            return CR_CB_RET_OK;
+        // The record is stored by the primary_pkgcb (if the pkg is used)
+        cr_raw_record_free(cb_data->raw_pending);
+        rec = cb_data->raw_pending = g_new0(cr_RawRecord, 1);
+    } else {
+        // The target was selected by the newpkgcb
+        rec = cb_data->raw_target;
+        cb_data->raw_target = NULL;
+        if (!rec)
+            return CR_CB_RET_OK;
+    }
+
+    if (cr_raw_record_store(cb_data->raw_store, rec,
+                            (cr_RawType) cb_data->state, raw, len, err))
+        return CR_CB_RET_ERR;
+
+    return CR_CB_RET_OK;
+}
+
 static int
 primary_newpkgcb(cr_Package **pkg,
                  G_GNUC_UNUSED const char *pkgId,
@@ -253,6 +578,14 @@ primary_pkgcb(cr_Package *pkg, void *cbdata, G_GNUC_UNUSED GError **err)
         pkg->loadingflags |= CR_PACKAGE_FROM_XML;
         pkg->loadingflags |= CR_PACKAGE_LOADED_PRI;
         g_hash_table_replace(cb_data->ht, pkg->pkgId, pkg);
+
+        if (cb_data->raw_ht) {
+            cr_RawRecord *rec = cb_data->raw_pending;
+            cb_data->raw_pending = NULL;
+            if (!rec)
+                rec = g_new0(cr_RawRecord, 1);
+            g_hash_table_replace(cb_data->raw_ht, g_strdup(pkg->pkgId), rec);
+        }
     } else {
         // Package with the same pkgId (hash) already exists
         if (epkg->time_file == pkg->time_file
@@ -276,6 +609,8 @@ primary_pkgcb(cr_Package *pkg, void *cbdata, G_GNUC_UNUSED GError **err)
                     "Ignoring all packages with the checksum.", pkg->pkgId);
             g_hash_table_remove(cb_data->ht, pkg->pkgId);
             g_hash_table_replace(cb_data->ignored_pkgIds, g_strdup(pkg->pkgId), NULL);
+            if (cb_data->raw_ht)
+                g_hash_table_remove(cb_data->raw_ht, pkg->pkgId);
         }
 
         // Drop the currently loaded package
@@ -302,8 +637,38 @@ newpkgcb(cr_Package **pkg,
     assert(*pkg == NULL);
     assert(pkgId);
 
+    if (cb_data->interrupted && g_atomic_int_get(cb_data->interrupted))
+        return CR_CB_RET_ERR;
+
     *pkg = g_hash_table_lookup(cb_data->ht, pkgId);
 
+    cb_data->raw_target = NULL;
+    if (*pkg && cb_data->raw_ht) {
+        // Only the first chunk of the package is used
+        cr_RawRecord *rec = g_hash_table_lookup(cb_data->raw_ht, pkgId);
+        if (rec && !rec->len[cb_data->state])
+            cb_data->raw_target = rec;
+    }
+
+    if (*pkg && cb_data->raw_store->lazy) {
+        // Only the raw chunk is kept, the package is filled on demand
+        // by cr_metadata_fill_package()
+        *pkg = NULL;
+        return CR_CB_RET_OK;
+    }
+
+    if (*pkg && cb_data->detached) {
+        // Parsed in a separate thread - the data go into a temporary
+        // package, see cr_attach_detached_package()
+        if (g_hash_table_contains(cb_data->detached_seen, pkgId)) {
+            *pkg = NULL;
+        } else {
+            g_hash_table_add(cb_data->detached_seen, g_strdup(pkgId));
+            *pkg = cr_package_new();
+        }
+        return CR_CB_RET_OK;
+    }
+
     if (*pkg) {
         // If package with the pkgId was parsed from primary.xml, then...
 
@@ -343,6 +708,11 @@ pkgcb(cr_Package *pkg, void *cbdata, G_GNUC_UNUSED GError **err)
 {
     cr_CbData *cb_data = cbdata;
 
+    if (cb_data->detached) {
+        g_async_queue_push(cb_data->detached, pkg);
+        return CR_CB_RET_OK;
+    }
+
     if (cb_data->chunk) {
         assert(pkg->chunk == cb_data->chunk);
         pkg->chunk = NULL;
@@ -351,6 +721,68 @@ pkgcb(cr_Package *pkg, void *cbdata, G_GNUC_UNUSED GError **err)
     return CR_CB_RET_OK;
 }
 
+/** Move changelogs from the temporary package parsed in the separate
+ * thread into the package from the hashtable. Strings have to be copied
+ * into the string chunk of the package.
+ */
+static void
+cr_attach_detached_package(GHashTable *ht,
+                           cr_Package *tmp_pkg,
+                           GStringChunk *chunk)
+{
+    cr_Package *pkg = g_hash_table_lookup(ht, tmp_pkg->pkgId);
+
+    if (pkg && !(pkg->loadingflags & CR_PACKAGE_LOADED_OTH)) {
+        GStringChunk *target = chunk ? chunk : pkg->chunk;
+
+        for (GSList *elem = tmp_pkg->changelogs; elem; elem = g_slist_next(elem)) {
+            cr_ChangelogEntry *entry = elem->data;
+            entry->author = cr_safe_string_chunk_insert(target, entry->author);
+            entry->changelog = cr_safe_string_chunk_insert(target,
+                                                           entry->changelog);
+        }
+        pkg->changelogs = g_slist_concat(pkg->changelogs,
+                                         tmp_pkg->changelogs);
+        tmp_pkg->changelogs = NULL;
+        pkg->loadingflags |= CR_PACKAGE_LOADED_OTH;
+    }
+
+    cr_package_free(tmp_pkg);
+}
+
+typedef struct {
+    cr_CbData           cb_data;
+    const char          *path;
+    cr_XmlParserRawPkgCb raw_cb;
+    GError              *err;
+} cr_OtherThreadData;
+
+static gpointer
+cr_other_thread(gpointer data)
+{
+    cr_OtherThreadData *td = data;
+
+    cr_xml_parse_other_internal(td->path,
+                                NULL,
+                                newpkgcb,
+                                &td->cb_data,
+                                pkgcb,
+                                &td->cb_data,
+                                td->raw_cb,
+                                &td->cb_data,
+                                cr_warning_cb,
+                                "Other XML parser",
+                                &td->err);
+
+    if (td->err)
+        g_atomic_int_set(td->cb_data.interrupted, 1);
+
+    // End of the queue
+    g_async_queue_push(td->cb_data.detached, td);
+
+    return NULL;
+}
+
 static int
 cr_load_xml_files(GHashTable *hashtable,
                   const char *primary_xml_path,
@@ -358,11 +790,25 @@ cr_load_xml_files(GHashTable *hashtable,
                   const char *other_xml_path,
                   GStringChunk *chunk,
                   GHashTable *pkglist_ht,
+                  GHashTable *raw_ht,
+                  cr_RawStore *raw_store,
+                  gboolean parallel,
                   GError **err)
 {
     cr_CbData cb_data;
+    cr_OtherThreadData other_td;
+    GThread *other_thread = NULL;
+    gint interrupted = 0;
+    cr_XmlParserRawPkgCb pri_raw_cb = NULL, raw_cb = NULL;
     GError *tmp_err = NULL;
 
+    if (raw_ht) {
+        // Primary chunks are needed only if they should be kept,
+        // filelists and other chunks also for the lazy loading
+        pri_raw_cb = raw_store->keep_raw ? rawpkgcb : NULL;
+        raw_cb = rawpkgcb;
+    }
+
     assert(hashtable);
 
     // Prepare cb data
@@ -373,19 +819,29 @@ cr_load_xml_files(GHashTable *hashtable,
     cb_data.ignored_pkgIds  = g_hash_table_new_full(g_str_hash, g_str_equal,
                                                     g_free, NULL);
     cb_data.pkgKey          = G_GINT64_CONSTANT(0);
-
-    cr_xml_parse_primary(primary_xml_path,
-                         primary_newpkgcb,
-                         &cb_data,
-                         primary_pkgcb,
-                         &cb_data,
-                         cr_warning_cb,
-                         "Primary XML parser",
-                         (filelists_xml_path) ? 0 : 1,
-                         &tmp_err);
+    cb_data.raw_ht          = raw_ht;
+    cb_data.raw_store       = raw_store;
+    cb_data.raw_pending     = NULL;
+    cb_data.raw_target      = NULL;
+    cb_data.detached        = NULL;
+    cb_data.detached_seen   = NULL;
+    cb_data.interrupted     = NULL;
+
+    cr_xml_parse_primary_internal(primary_xml_path,
+                                  primary_newpkgcb,
+                                  &cb_data,
+                                  primary_pkgcb,
+                                  &cb_data,
+                                  pri_raw_cb,
+                                  &cb_data,
+                                  cr_warning_cb,
+                                  "Primary XML parser",
+                                  (filelists_xml_path) ? 0 : 1,
+                                  &tmp_err);
 
     g_hash_table_destroy(cb_data.ignored_pkgIds);
     cb_data.ignored_pkgIds = NULL;
+    g_clear_pointer(&cb_data.raw_pending, cr_raw_record_free);
 
     if (tmp_err) {
         int code = tmp_err->code;
@@ -394,36 +850,108 @@ cr_load_xml_files(GHashTable *hashtable,
         return code;
     }
 
+    // Filelists and other only add data to the packages from primary.xml,
+    // so they could be parsed in parallel. The other.xml is parsed in
+    // a separate thread with its own copy of the callback data.
+    if (parallel && filelists_xml_path && other_xml_path) {
+        other_td.cb_data                = cb_data;
+        other_td.cb_data.state          = PARSING_OTH;
+        other_td.cb_data.interrupted    = &interrupted;
+        other_td.cb_data.detached       = g_async_queue_new();
+        other_td.cb_data.detached_seen  = g_hash_table_new_full(g_str_hash,
+                                                                g_str_equal,
+                                                                g_free,
+                                                                NULL);
+        other_td.path                   = other_xml_path;
+        other_td.raw_cb                 = raw_cb;
+        other_td.err                    = NULL;
+        cb_data.interrupted             = &interrupted;
+
+        other_thread = g_thread_try_new("other.xml parser",
+                                        cr_other_thread,
+                                        &other_td,
+                                        NULL);
+        if (other_thread) {
+            other_xml_path = NULL;
+        } else {
+            g_async_queue_unref(other_td.cb_data.detached);
+            g_hash_table_destroy(other_td.cb_data.detached_seen);
+            cb_data.interrupted = NULL;
+        }
+    }
+
     cb_data.state = PARSING_FIL;
 
     if (filelists_xml_path) {
-        cr_xml_parse_filelists(filelists_xml_path,
-                               newpkgcb,
-                               &cb_data,
-                               pkgcb,
-                               &cb_data,
-                               cr_warning_cb,
-                               "Filelists XML parser",
-                               &tmp_err);
-        if (tmp_err) {
-            int code = tmp_err->code;
-            g_debug("filelists.xml parsing error: %s", tmp_err->message);
-            g_propagate_prefixed_error(err, tmp_err, "filelists.xml parsing: ");
-            return code;
+        cr_xml_parse_filelists_internal(filelists_xml_path,
+                                        NULL,
+                                        newpkgcb,
+                                        &cb_data,
+                                        pkgcb,
+                                        &cb_data,
+                                        raw_cb,
+                                        &cb_data,
+                                        cr_warning_cb,
+                                        "Filelists XML parser",
+                                        &tmp_err);
+        if (tmp_err && other_thread)
+            g_atomic_int_set(&interrupted, 1);
+    }
+
+    if (other_thread) {
+        // Attach the changelogs parsed in the meantime (and wait for
+        // the rest of them)
+        gpointer item;
+        while ((item = g_async_queue_pop(other_td.cb_data.detached)) != &other_td) {
+            if (tmp_err || g_atomic_int_get(&interrupted))
+                cr_package_free(item);
+            else
+                cr_attach_detached_package(hashtable, item, chunk);
         }
+        g_thread_join(other_thread);
+        g_async_queue_unref(other_td.cb_data.detached);
+        g_hash_table_destroy(other_td.cb_data.detached_seen);
+    }
+
+    if (other_thread && other_td.err && tmp_err
+        && other_td.err->code == CRE_CBINTERRUPTED)
+    {
+        // The other.xml parsing was only interrupted because of the
+        // filelists.xml error, which is the one to report
+        g_clear_error(&other_td.err);
+    }
+
+    if (other_thread && other_td.err) {
+        // If the filelists parsing failed too, it was interrupted
+        // because of this error
+        int code = other_td.err->code;
+        g_debug("other.xml parsing error: %s", other_td.err->message);
+        g_propagate_prefixed_error(err, other_td.err, "other.xml parsing: ");
+        g_clear_error(&tmp_err);
+        return code;
+    }
+
+    if (tmp_err) {
+        int code = tmp_err->code;
+        g_debug("filelists.xml parsing error: %s", tmp_err->message);
+        g_propagate_prefixed_error(err, tmp_err, "filelists.xml parsing: ");
+        return code;
     }
 
     cb_data.state = PARSING_OTH;
 
     if (other_xml_path) {
-        cr_xml_parse_other(other_xml_path,
-                           newpkgcb,
-                           &cb_data,
-                           pkgcb,
-                           &cb_data,
-                           cr_warning_cb,
-                           "Other XML parser",
-                           &tmp_err);
+        cr_xml_parse_other_internal(other_xml_path,
+                                    NULL,
+                                    newpkgcb,
+                                    &cb_data,
+                                    pkgcb,
+                                    &cb_data,
+                                    raw_cb,
+                                    &cb_data,
+                                    cr_warning_cb,
+                                    "Other XML parser",
+                                    &tmp_err);
         if (tmp_err) {
             int code = tmp_err->code;
             g_debug("other.xml parsing error: %s", tmp_err->message);
@@ -525,6 +1053,7 @@ cr_metadata_load_xml(cr_Metadata *md,
     int result;
     GError *tmp_err = NULL;
     GHashTable *intern_hashtable;  // key is checksum (pkgId)
+    GHashTable *intern_raw_ht = NULL;  // key is checksum (pkgId)
     cr_HashTableKeyDupAction dupaction = md->dupaction;
 
     assert(md);
@@ -537,14 +1066,40 @@ cr_metadata_load_xml(cr_Metadata *md,
         return CRE_BADARG;
     }
 
+    if (md->raw_store.lazy && md->raw_store.fd < 0) {
+        // Chunks of lazily loaded packages are kept in an unlinked
+        // temporary file, so they disappear together with the process
+        gchar *spool_path = NULL;
+        md->raw_store.fd = g_file_open_tmp("createrepo_c_spool_XXXXXX",
+                                           &spool_path, &tmp_err);
+        if (md->raw_store.fd < 0) {
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "Cannot create a spool file: %s", tmp_err->message);
+            g_clear_error(&tmp_err);
+            return CRE_IO;
+        }
+        g_unlink(spool_path);
+        g_free(spool_path);
+    }
+
+    if ((md->raw_store.keep_raw || md->raw_store.lazy) && !md->raw_ht)
+        md->raw_ht = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                NULL, (GDestroyNotify) cr_raw_record_free);
+
     // Load metadata
     intern_hashtable = cr_new_metadata_hashtable();
+    if (md->raw_ht)
+        intern_raw_ht = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                (GDestroyNotify) cr_raw_record_free);
     result = cr_load_xml_files(intern_hashtable,
                                ml->pri_xml_href,
                                ml->fil_xml_href,
                                ml->oth_xml_href,
                                md->chunk,
                                md->pkglist_ht,
+                               intern_raw_ht,
+                               &md->raw_store,
+                               md->parallel,
                                &tmp_err);
 
     if (result != CRE_OK) {
@@ -552,6 +1107,8 @@ cr_metadata_load_xml(cr_Metadata *md,
         g_propagate_prefixed_error(err, tmp_err,
                                    "Error encountered while parsing:");
         cr_destroy_metadata_hashtable(intern_hashtable);
+        if (intern_raw_ht)
+            g_hash_table_destroy(intern_raw_ht);
         return result;
     }
 
@@ -631,6 +1188,17 @@ cr_metadata_load_xml(cr_Metadata *md,
         } else {
             g_hash_table_insert(md->ht, new_key, p_value);
             g_hash_table_iter_steal(&iter);
+
+            if (intern_raw_ht) {
+                // Raw chunks are accessible via the package itself
+                gpointer raw_key, raw;
+                if (g_hash_table_lookup_extended(intern_raw_ht, pkg->pkgId,
+                                                 &raw_key, &raw)) {
+                    g_hash_table_steal(intern_raw_ht, pkg->pkgId);
+                    g_free(raw_key);
+                    g_hash_table_replace(md->raw_ht, pkg, raw);
+                }
+            }
         }
     }
 
@@ -638,17 +1206,24 @@ cr_metadata_load_xml(cr_Metadata *md,
     g_hash_table_iter_init(&iter, ignored_keys);
     while (g_hash_table_iter_next(&iter, &p_key, &p_value)) {
         char *key = (gchar *) p_key;
+        if (md->raw_ht)
+            g_hash_table_remove(md->raw_ht, g_hash_table_lookup(md->ht, key));
         g_hash_table_remove(md->ht, key);
     }
 
     // How much items we really use
     g_debug("%s: Really usable items: %d", __func__,
             g_hash_table_size(md->ht));
+    if (md->raw_store.fd >= 0)
+        g_debug("%s: Raw xml spooled: %"G_GINT64_FORMAT" bytes", __func__,
+                md->raw_store.size);
 
     // Cleanup
 
     g_hash_table_destroy(ignored_keys);
     cr_destroy_metadata_hashtable(intern_hashtable);
+    if (intern_raw_ht)
+        g_hash_table_destroy(intern_raw_ht);
 
     result = CRE_OK;
 
@@ -22,6 +22,7 @@
 
 #include <glib.h>
 #include "locate_metadata.h"
+#include "package.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -85,6 +86,17 @@ typedef enum {
  */
 typedef struct _cr_Metadata cr_Metadata;
 
+/** Raw xml chunks of a loaded package, exactly as they were in the
+ * loaded primary.xml, filelists.xml and other.xml (in the same form
+ * as the chunks from cr_xml_dump() - terminated by a newline).
+ * Any of them could be NULL if the package wasn't present in the file.
+ */
+typedef struct {
+    char *primary;      /*!< package element from primary.xml */
+    char *filelists;    /*!< package element from filelists.xml */
+    char *other;        /*!< package element from other.xml */
+} cr_MetadataRawXml;
+
 /** Return cr_HashTableKey from a cr_Metadata
  * @param md        cr_Metadata object.
  * @return          Key type
@@ -120,6 +132,70 @@ cr_Metadata *cr_metadata_new(cr_HashTableKey key,
 gboolean
 cr_metadata_set_dupaction(cr_Metadata *md, cr_HashTableKeyDupAction dupaction);
 
+/** Keep the raw xml chunks of loaded packages (see cr_MetadataRawXml).
+ * This roughly doubles the memory used by the loaded metadata but allows
+ * to reuse the chunks without dumping the packages again.
+ * Must be set before the metadata are loaded. If a package is removed
+ * from the cr_metadata_hashtable(), its chunks have to be removed via
+ * cr_metadata_steal_raw_xml() as well.
+ * @param md            cr_Metadata object
+ * @param keep          Keep raw xml chunks?
+ */
+void cr_metadata_set_keep_raw_xml(cr_Metadata *md, gboolean keep);
+
+/** Do not keep filelists and changelogs of loaded packages in memory.
+ * Packages in the hashtable are loaded only from primary.xml and the raw
+ * chunks from filelists.xml and other.xml are written into an unlinked
+ * temporary file (the raw primary.xml chunks as well if they should
+ * be kept). A package could be completed later by
+ * cr_metadata_steal_raw_xml() and cr_metadata_fill_package().
+ * Must be set before the metadata are loaded.
+ * @param md            cr_Metadata object
+ * @param lazy          Load filelists and other lazily?
+ */
+void cr_metadata_set_lazy_loading(cr_Metadata *md, gboolean lazy);
+
+/** Parse other.xml in a separate thread, in parallel with filelists.xml.
+ * The primary.xml is always parsed first (it defines the set of loaded
+ * packages). Changelogs are parsed into temporary packages and attached
+ * to the loaded packages when the filelists.xml is parsed.
+ * Must be set before the metadata are loaded.
+ * @param md            cr_Metadata object
+ * @param parallel      Parse filelists and other in parallel?
+ */
+void cr_metadata_set_parallel_loading(cr_Metadata *md, gboolean parallel);
+
+/** Remove the raw xml chunks of the package from the metadata and
+ * return them. The caller takes the ownership.
+ * @param md            cr_Metadata object
+ * @param pkg           package from the cr_metadata_hashtable()
+ * @param err           GError **
+ * @return              cr_MetadataRawXml or NULL if not available
+ *                      (or on error)
+ */
+cr_MetadataRawXml *cr_metadata_steal_raw_xml(cr_Metadata *md,
+                                             cr_Package *pkg,
+                                             GError **err);
+
+/** Parse the filelists and other chunks into the package, if the package
+ * doesn't have them loaded yet (see cr_metadata_set_lazy_loading()).
+ * A package which shares the string chunk of the cr_Metadata gets its own
+ * string chunk, so different packages could be filled from different
+ * threads.
+ * @param pkg           package
+ * @param raw           raw xml chunks of the package or NULL
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+int cr_metadata_fill_package(cr_Package *pkg,
+                             const cr_MetadataRawXml *raw,
+                             GError **err);
+
+/** Free raw xml chunks.
+ * @param raw           cr_MetadataRawXml or NULL
+ */
+void cr_metadata_raw_xml_free(cr_MetadataRawXml *raw);
+
 /** Destroy metadata.
  * @param md            cr_Metadata object
  */
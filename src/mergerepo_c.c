@@ -46,6 +46,7 @@
 #include "koji.h"
 
 #define DEFAULT_OUTPUTDIR               "merged_repo/"
+#define DEFAULT_WORKERS                 5
 
 #include "mergerepo_c.h"
 
@@ -58,6 +59,7 @@ struct CmdOptions _cmd_options = {
 
         .zck_compression = FALSE,
         .zck_dict_dir = NULL,
+        .workers = DEFAULT_WORKERS,
     };
 
 // TODO:
@@ -111,6 +113,14 @@ static GOptionEntry cmd_entries[] =
       "Do not include the file's checksum in the metadata filename.", NULL },
     { "omit-baseurl", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.omit_baseurl),
       "Don't add a baseurl to packages that don't have one before." , NULL},
+    { "workers", 0, 0, G_OPTION_ARG_INT, &(_cmd_options.workers),
+      "Number of repos loaded in parallel (default 5). Repos are still "
+      "merged in the order in which they were specified. Up to this many "
+      "loaded repos are kept in memory besides the one being merged, use "
+      "a lower number to reduce the memory usage.", NULL },
+    { "low-memory", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.low_memory),
+      "Keep only a small index of packages in memory. Repos are read twice, "
+      "selected packages are written grouped by their repos.", NULL },
 
     // -- Options related to Koji-mergerepos behaviour
     { "koji", 'k', 0, G_OPTION_ARG_NONE, &(_cmd_options.koji),
@@ -270,7 +280,7 @@ check_arguments(struct CmdOptions *options)
 
         if (type == CR_CW_UNKNOWN_COMPRESSION) {
             g_critical("Compression %s not available: Please choose from: "
-                       "gz or bz2 or xz", options->compress_type);
+                       "gz or bz2 or xz or zstd", options->compress_type);
             ret = FALSE;
         } else {
             options->db_compression_type = type;
@@ -338,6 +348,12 @@ check_arguments(struct CmdOptions *options)
         }
     }
 
+    // Check workers
+    if ((options->workers < 1) || (options->workers > 100)) {
+        g_warning("Wrong number of workers - Using %d workers.", DEFAULT_WORKERS);
+        options->workers = DEFAULT_WORKERS;
+    }
+
     // Zchunk options
     if (options->zck_dict_dir && !options->zck_compression) {
         g_critical("Cannot use --zck-dict-dir without setting --zck");
@@ -642,6 +658,185 @@ add_package:
 }
 
 
+// Repos are loaded by a pool of workers, but they are processed one by one
+// in the order in which they were specified, so the result doesn't
+// depend on which repo was loaded first.
+
+struct RepoLoadTask {
+    struct cr_MetadataLocation *ml; // location of the repodata
+    GSList *pkglist;                // basenames of packages to load or NULL
+    cr_Metadata *metadata;          // loaded repodata or NULL on error
+    GError *err;                    // error from the loading
+    gboolean done;                  // loading finished
+};
+
+struct RepoLoader {
+    GThreadPool *pool;
+    struct RepoLoadTask *tasks;
+    guint count;                    // number of repos
+    guint pushed;                   // number of repos passed to the pool
+    guint ahead;                    // max number of repos loaded ahead
+    gboolean primary_only;          // load only primary.xml
+    GMutex mutex;
+    GCond cond;                     // signalled when a task is done
+};
+
+static void
+load_repo_thread(gpointer data, gpointer udata)
+{
+    struct RepoLoadTask *task = data;
+    struct RepoLoader *loader = udata;
+    cr_Metadata *metadata = NULL;
+    GError *tmp_err = NULL;
+
+    if (task->ml) {
+        struct cr_MetadataLocation ml = *task->ml;
+
+        if (loader->primary_only) {
+            // Without filelists.xml and other.xml only primary.xml is parsed
+            ml.fil_xml_href = NULL;
+            ml.oth_xml_href = NULL;
+        }
+        if (task->pkglist) {
+            // Only selected packages are loaded again, modules were
+            // already loaded together with the whole repo
+            ml.additional_metadata = NULL;
+        }
+
+        metadata = cr_metadata_new(CR_HT_KEY_HASH, 0, task->pkglist);
+        cr_metadata_set_parallel_loading(metadata, TRUE);
+        g_debug("Loading repo: %s", ml.original_url);
+        if (cr_metadata_load_xml(metadata, &ml, &tmp_err) != CRE_OK) {
+            cr_metadata_free(metadata);
+            metadata = NULL;
+        }
+    }
+
+    g_mutex_lock(&loader->mutex);
+    task->metadata = metadata;
+    task->err = tmp_err;
+    task->done = TRUE;
+    g_cond_broadcast(&loader->cond);
+    g_mutex_unlock(&loader->mutex);
+}
+
+// Start loading of the repos. If pkglists is not NULL, only packages
+// whose basenames are in the pkglists[repoid] are loaded and repos with
+// an empty pkglist are skipped (repo_loader_get() returns NULL for them).
+static struct RepoLoader *
+repo_loader_new(GSList *repo_list,
+                GSList **pkglists,
+                gboolean primary_only,
+                int workers)
+{
+    struct RepoLoader *loader = g_new0(struct RepoLoader, 1);
+
+    loader->count = g_slist_length(repo_list);
+    loader->tasks = g_new0(struct RepoLoadTask, loader->count);
+    loader->ahead = (workers < 1) ? 1 : workers;
+    loader->primary_only = primary_only;
+    g_mutex_init(&loader->mutex);
+    g_cond_init(&loader->cond);
+
+    guint x = 0;
+    for (GSList *elem = repo_list; elem; elem = g_slist_next(elem), x++) {
+        struct RepoLoadTask *task = &loader->tasks[x];
+        task->ml = (struct cr_MetadataLocation *) elem->data;
+        if (pkglists) {
+            task->pkglist = pkglists[x];
+            if (!task->pkglist)
+                task->ml = NULL;
+        }
+    }
+
+    loader->pool = g_thread_pool_new(load_repo_thread, loader,
+                                     loader->ahead, TRUE, NULL);
+
+    // Only a limited number of repos is loaded ahead of the one which
+    // is being processed (the loaded repos have to be kept in memory)
+    for (; loader->pushed < loader->count
+           && loader->pushed < loader->ahead; loader->pushed++)
+        g_thread_pool_push(loader->pool, &loader->tasks[loader->pushed], NULL);
+
+    return loader;
+}
+
+// Wait until the repo is loaded and take it. Returns NULL if the repo
+// couldn't be loaded (err is set) or was skipped.
+static cr_Metadata *
+repo_loader_get(struct RepoLoader *loader, guint repoid, GError **err)
+{
+    struct RepoLoadTask *task = &loader->tasks[repoid];
+    cr_Metadata *metadata;
+
+    assert(repoid < loader->count);
+
+    g_mutex_lock(&loader->mutex);
+    while (!task->done)
+        g_cond_wait(&loader->cond, &loader->mutex);
+    g_mutex_unlock(&loader->mutex);
+
+    // Start loading of the next repo
+    if (loader->pushed < loader->count)
+        g_thread_pool_push(loader->pool,
+                           &loader->tasks[loader->pushed++],
+                           NULL);
+
+    metadata = task->metadata;
+    task->metadata = NULL;
+    if (task->err) {
+        g_propagate_error(err, task->err);
+        task->err = NULL;
+    }
+
+    return metadata;
+}
+
+// Wait for the repos which are still being loaded (if the processing
+// was interrupted) and free them
+static void
+repo_loader_free(struct RepoLoader *loader)
+{
+    if (!loader)
+        return;
+
+    g_thread_pool_free(loader->pool, TRUE, TRUE);
+    for (guint x = 0; x < loader->count; x++) {
+        cr_metadata_free(loader->tasks[x].metadata);
+        g_clear_error(&loader->tasks[x].err);
+    }
+    g_free(loader->tasks);
+    g_mutex_clear(&loader->mutex);
+    g_cond_clear(&loader->cond);
+    g_free(loader);
+}
+
+// Copy of the package with only the values which are needed to select
+// packages (see add_package() and koji_allowed()). Strings are stored
+// in the shared chunk and the repoid is stored in the pkgKey.
+static cr_Package *
+light_package_copy(cr_Package *pkg, GStringChunk *chunk, int repoid)
+{
+    cr_Package *light = cr_package_new_without_chunk();
+
+    light->chunk            = chunk;
+    light->loadingflags    |= CR_PACKAGE_SINGLE_CHUNK;
+    light->pkgKey           = repoid;
+    light->pkgId            = cr_safe_string_chunk_insert(chunk, pkg->pkgId);
+    light->name             = cr_safe_string_chunk_insert(chunk, pkg->name);
+    light->arch             = cr_safe_string_chunk_insert_const(chunk, pkg->arch);
+    light->epoch            = cr_safe_string_chunk_insert_const(chunk, pkg->epoch);
+    light->version          = cr_safe_string_chunk_insert(chunk, pkg->version);
+    light->release          = cr_safe_string_chunk_insert(chunk, pkg->release);
+    light->rpm_sourcerpm    = cr_safe_string_chunk_insert_const(chunk, pkg->rpm_sourcerpm);
+    light->location_href    = cr_safe_string_chunk_insert(chunk, pkg->location_href);
+    light->location_base    = cr_safe_string_chunk_insert_const(chunk, pkg->location_base);
+    light->time_file        = pkg->time_file;
+    light->size_package     = pkg->size_package;
+
+    return light;
+}
+
 long
 merge_repos(GHashTable *merged,
 #ifdef WITH_LIBMODULEMD
@@ -654,10 +849,16 @@ merge_repos(GHashTable *merged,
             struct KojiMergedReposStuff *koji_stuff,
             gboolean omit_baseurl,
             gchar *repo_prefix_search,
-            gchar *repo_prefix_replace)
+            gchar *repo_prefix_replace,
+            int workers,
+            GStringChunk *light_chunk)
 {
     long loaded_packages = 0;
     GSList *used_noarch_keys = NULL;
+    guint repos_count = g_slist_length(repo_list);
+    struct RepoLoader *loader;
+    GSList *element = NULL;
+    int repoid;
 
 #ifdef WITH_LIBMODULEMD
     g_autoptr(ModulemdModuleIndexMerger) merger = NULL;
@@ -666,22 +867,25 @@ merge_repos(GHashTable *merged,
     merger = modulemd_module_index_merger_new();
 #endif /* WITH_LIBMODULEMD */
 
-    // Load all repos
+    // Start loading of the repos
+    // (with the light_chunk only primary.xml is needed)
 
-    int repoid = 0;
-    GSList *element = NULL;
-    for (element = repo_list; element; element = g_slist_next(element), repoid++) {
+    loader = repo_loader_new(repo_list, NULL, light_chunk != NULL, workers);
+
+    // Merge the repos in their original order
+
+    for (repoid = 0; repoid < (int) repos_count; repoid++) {
         gchar *repopath;                    // base url of current repodata
         cr_Metadata *metadata;              // current repodata
         struct cr_MetadataLocation *ml;     // location of current repodata
+        GError *tmp_err = NULL;
 
-        ml = (struct cr_MetadataLocation *) element->data;
+        ml = loader->tasks[repoid].ml;
         if (!ml) {
             g_critical("Bad location!");
             break;
         }
 
-        metadata = cr_metadata_new(CR_HT_KEY_HASH, 0, NULL);
         repopath = cr_normalize_dir_path(ml->original_url);
 
         // Base paths in output of original createrepo doesn't have trailing '/'
@@ -701,9 +905,12 @@ merge_repos(GHashTable *merged,
 
         g_debug("Processing: %s", repopath);
 
-        if (cr_metadata_load_xml(metadata, ml, NULL) != CRE_OK) {
-            cr_metadata_free(metadata);
-            g_critical("Cannot load repo: \"%s\"", ml->repomd);
+        metadata = repo_loader_get(loader, repoid, &tmp_err);
+        if (!metadata) {
+            g_critical("Cannot load repo: \"%s\": %s", ml->repomd,
+                       tmp_err ? tmp_err->message : "Unknown error");
+            g_clear_error(&tmp_err);
+            g_free(repopath);
             break;
         }
 
@@ -721,6 +928,15 @@ merge_repos(GHashTable *merged,
 
         original_size = g_hash_table_size(cr_metadata_hashtable(metadata));
 
+        // Koji-mergerepos specific behaviour -----------
+        // Select allowed srpm builds from the already loaded repo
+        if (koji_stuff && !koji_stuff->simple)
+            koji_stuff_add_repo_srpms(koji_stuff,
+                                      cr_metadata_hashtable(metadata),
+                                      ml->original_url,
+                                      repoid);
+        // Koji-mergerepos specific behaviour - end -----
+
         g_hash_table_iter_init (&iter, cr_metadata_hashtable(metadata));
         while (g_hash_table_iter_next (&iter, &key, &value)) {
             int ret;
@@ -740,6 +956,11 @@ merge_repos(GHashTable *merged,
             g_debug("Reading metadata for %s (%s-%s.%s)",
                     pkg->name, pkg->version, pkg->release, pkg->arch);
 
+            // Only a light copy of the package is merged with the
+            // light_chunk, full metadata are loaded again when dumped
+            if (light_chunk && !noarch_pkg_used)
+                pkg = light_package_copy(pkg, light_chunk, repoid);
+
             // Add package
             ret = add_package(pkg,
                               repopath,
@@ -751,7 +972,10 @@ merge_repos(GHashTable *merged,
                               repoid);
 
             if (ret > 0) {
-                if (!noarch_pkg_used) {
+                if (light_chunk && !noarch_pkg_used) {
+                    // Light copy of the package was added
+                    // => the original one is freed with the repo
+                } else if (!noarch_pkg_used) {
                     // Original package was added
                     // => remove only record from hashtable
                     g_hash_table_iter_steal(&iter);
@@ -778,6 +1002,8 @@ merge_repos(GHashTable *merged,
                     }
                     // Koji-mergerepos specific behaviour - end -----
                 }
+            } else if (light_chunk && !noarch_pkg_used) {
+                cr_package_free(pkg);
             }
         }
 
@@ -788,6 +1014,8 @@ merge_repos(GHashTable *merged,
         g_free(repopath);
     }
 
+    repo_loader_free(loader);
+
 #ifdef WITH_LIBMODULEMD
     g_autoptr(ModulemdModuleIndex) moduleindex =
         modulemd_module_index_merger_resolve (merger, &err);
@@ -848,6 +1076,169 @@ modulemd_write_handler (void          *data,
 }
 #endif /* WITH_LIBMODULEMD */
 
+// Opened output files and databases of the merged repo
+struct MergedOutput {
+    cr_XmlFile *pri_f;
+    cr_XmlFile *fil_f;
+    cr_XmlFile *oth_f;
+    cr_XmlFile *pri_cr_zck;     // NULL without --zck
+    cr_XmlFile *fil_cr_zck;
+    cr_XmlFile *oth_cr_zck;
+    cr_SqliteDb *pri_db;        // NULL with --no-database
+    cr_SqliteDb *fil_db;
+    cr_SqliteDb *oth_db;
+    char *prev_srpm;            // srpm of the previous package (zchunk)
+};
+
+static void
+dump_merged_package(struct MergedOutput *out, cr_Package *pkg)
+{
+    struct cr_XmlStruct res;
+
+    res = cr_xml_dump(pkg, NULL);
+
+    g_debug("Writing metadata for %s (%s-%s.%s)",
+            pkg->name, pkg->version, pkg->release, pkg->arch);
+
+    if (out->pri_cr_zck &&
+       (!out->prev_srpm || !pkg->rpm_sourcerpm ||
+        strlen(out->prev_srpm) != strlen(pkg->rpm_sourcerpm) ||
+        strncmp(pkg->rpm_sourcerpm, out->prev_srpm, strlen(out->prev_srpm)) != 0)) {
+        cr_end_chunk(out->pri_cr_zck->f, NULL);
+        cr_end_chunk(out->fil_cr_zck->f, NULL);
+        cr_end_chunk(out->oth_cr_zck->f, NULL);
+        g_free(out->prev_srpm);
+        if (pkg->rpm_sourcerpm)
+            out->prev_srpm = g_strdup(pkg->rpm_sourcerpm);
+        else
+            out->prev_srpm = NULL;
+    }
+    cr_xmlfile_add_chunk(out->pri_f, (const char *) res.primary, NULL);
+    cr_xmlfile_add_chunk(out->fil_f, (const char *) res.filelists, NULL);
+    cr_xmlfile_add_chunk(out->oth_f, (const char *) res.other, NULL);
+    if (out->pri_cr_zck) {
+        cr_xmlfile_add_chunk(out->pri_cr_zck, (const char *) res.primary, NULL);
+        cr_xmlfile_add_chunk(out->fil_cr_zck, (const char *) res.filelists, NULL);
+        cr_xmlfile_add_chunk(out->oth_cr_zck, (const char *) res.other, NULL);
+    }
+
+    if (out->pri_db) {
+        cr_db_add_pkg(out->pri_db, pkg, NULL);
+        cr_db_add_pkg(out->fil_db, pkg, NULL);
+        cr_db_add_pkg(out->oth_db, pkg, NULL);
+    }
+
+    free(res.primary);
+    free(res.filelists);
+    free(res.other);
+}
+
+// Dump packages of the merged_hashtable which contains only light copies
+// of packages (see light_package_copy()). Full metadata of the selected
+// packages are loaded again repo by repo and dumped right away, so only
+// a single repo is in the memory at a time. Packages are written grouped
+// by their repos (in the order of the repos).
+// If a repo cannot be loaded again or a selected package is missing from it,
+// FALSE is returned and err is set, the written metadata are incomplete.
+static gboolean
+dump_merged_packages_by_repo(GHashTable *merged_hashtable,
+                             GSList *repo_list,
+                             struct MergedOutput *out,
+                             struct CmdOptions *cmd_options,
+                             GError **err)
+{
+    gboolean ret = TRUE;
+    guint repos_count = g_slist_length(repo_list);
+    GSList **selected = g_new0(GSList *, repos_count);
+    GSList **pkglists = g_new0(GSList *, repos_count);
+    struct RepoLoader *loader;
+    GList *keys, *key;
+
+    // Split the selected packages by their repos. Packages from the noarch
+    // repo are not light copies, they are already complete.
+
+    keys = g_hash_table_get_keys(merged_hashtable);
+    keys = g_list_sort(keys, (GCompareFunc) g_strcmp0);
+
+    for (key = keys; key; key = g_list_next(key)) {
+        GSList *element = g_hash_table_lookup(merged_hashtable, key->data);
+        element = g_slist_sort(element, package_cmp);
+        for (; element; element = g_slist_next(element)) {
+            cr_Package *pkg = element->data;
+
+            if (pkg->loadingflags & CR_PACKAGE_LOADED_PRI) {
+                dump_merged_package(out, pkg);
+                continue;
+            }
+
+            assert(pkg->pkgKey >= 0 && (guint64) pkg->pkgKey < repos_count);
+            selected[pkg->pkgKey] = g_slist_prepend(selected[pkg->pkgKey], pkg);
+            pkglists[pkg->pkgKey] = g_slist_prepend(pkglists[pkg->pkgKey],
+                                        cr_get_filename(pkg->location_href));
+        }
+    }
+    g_list_free(keys);
+
+    // Load the selected packages and dump them
+
+    loader = repo_loader_new(repo_list, pkglists, FALSE, cmd_options->workers);
+
+    for (guint repoid = 0; ret && repoid < repos_count; repoid++) {
+        cr_Metadata *metadata;
+        GError *tmp_err = NULL;
+
+        // Repos without selected packages are skipped by the loader
+        metadata = repo_loader_get(loader, repoid, &tmp_err);
+        if (!selected[repoid])
+            continue;
+        if (!metadata) {
+            g_set_error(err, CREATEREPO_C_ERROR,
+                        tmp_err ? tmp_err->code : CRE_ERROR,
+                        "Cannot load repo again: \"%s\": %s",
+                        loader->tasks[repoid].ml->repomd,
+                        tmp_err ? tmp_err->message : "Unknown error");
+            g_clear_error(&tmp_err);
+            ret = FALSE;
+            break;
+        }
+
+        selected[repoid] = g_slist_reverse(selected[repoid]);
+        for (GSList *elem = selected[repoid]; elem; elem = g_slist_next(elem)) {
+            cr_Package *light = elem->data;
+            cr_Package *pkg;
+
+            pkg = g_hash_table_lookup(cr_metadata_hashtable(metadata),
+                                      light->pkgId);
+            if (!pkg) {
+                g_set_error(err, CREATEREPO_C_ERROR, CRE_XMLDATA,
+                            "Package %s (%s) disappeared from the repo %s",
+                            light->location_href, light->pkgId,
+                            loader->tasks[repoid].ml->original_url);
+                ret = FALSE;
+                break;
+            }
+
+            // Use the location base selected during the merge
+            pkg->location_base = cr_safe_string_chunk_insert(pkg->chunk,
+                                                    light->location_base);
+            dump_merged_package(out, pkg);
+        }
+
+        cr_metadata_free(metadata);
+    }
+
+    repo_loader_free(loader);
+
+    for (guint repoid = 0; repoid < repos_count; repoid++) {
+        g_slist_free(selected[repoid]);
+        g_slist_free(pkglists[repoid]);
+    }
+    g_free(selected);
+    g_free(pkglists);
+
+    return ret;
+}
+
 int
 dump_merged_metadata(GHashTable *merged_hashtable,
                      long packages,
@@ -855,6 +1246,7 @@ dump_merged_metadata(GHashTable *merged_hashtable,
 #ifdef WITH_LIBMODULEMD
                      ModulemdModuleIndex *module_index,
 #endif /* WITH_LIBMODULEMD */
+                     GSList *repo_list,
                      struct CmdOptions *cmd_options)
 {
     GError *tmp_err = NULL;
@@ -1127,61 +1519,57 @@ dump_merged_metadata(GHashTable *merged_hashtable,
 
     // Dump hashtable
 
-    GList *keys, *key;
-    keys = g_hash_table_get_keys(merged_hashtable);
-    keys = g_list_sort(keys, (GCompareFunc) g_strcmp0);
-
-    char *prev_srpm = NULL;
-
-    for (key = keys; key; key = g_list_next(key)) {
-        gpointer value = g_hash_table_lookup(merged_hashtable, key->data);
-        GSList *element = (GSList *) value;
-        element = g_slist_sort(element, package_cmp);
-        for (; element; element=g_slist_next(element)) {
-            struct cr_XmlStruct res;
-            cr_Package *pkg;
-
-            pkg = (cr_Package *) element->data;
-            res = cr_xml_dump(pkg, NULL);
-
-            g_debug("Writing metadata for %s (%s-%s.%s)",
-                    pkg->name, pkg->version, pkg->release, pkg->arch);
+    struct MergedOutput out = {
+        .pri_f = pri_f,
+        .fil_f = fil_f,
+        .oth_f = oth_f,
+        .pri_cr_zck = cmd_options->zck_compression ? pri_cr_zck : NULL,
+        .fil_cr_zck = cmd_options->zck_compression ? fil_cr_zck : NULL,
+        .oth_cr_zck = cmd_options->zck_compression ? oth_cr_zck : NULL,
+        .pri_db = cmd_options->no_database ? NULL : pri_db,
+        .fil_db = cmd_options->no_database ? NULL : fil_db,
+        .oth_db = cmd_options->no_database ? NULL : oth_db,
+        .prev_srpm = NULL,
+    };
 
-            if (cmd_options->zck_compression &&
-               (!prev_srpm || !pkg->rpm_sourcerpm ||
-                strlen(prev_srpm) != strlen(pkg->rpm_sourcerpm) ||
-                strncmp(pkg->rpm_sourcerpm, prev_srpm, strlen(prev_srpm)) != 0)) {
-                cr_end_chunk(pri_cr_zck->f, NULL);
-                cr_end_chunk(fil_cr_zck->f, NULL);
-                cr_end_chunk(oth_cr_zck->f, NULL);
-                g_free(prev_srpm);
-                if (pkg->rpm_sourcerpm)
-                    prev_srpm = g_strdup(pkg->rpm_sourcerpm);
-                else
-                    prev_srpm = NULL;
-            }
-            cr_xmlfile_add_chunk(pri_f, (const char *) res.primary, NULL);
-            cr_xmlfile_add_chunk(fil_f, (const char *) res.filelists, NULL);
-            cr_xmlfile_add_chunk(oth_f, (const char *) res.other, NULL);
+    if (cmd_options->low_memory) {
+        if (!dump_merged_packages_by_repo(merged_hashtable, repo_list,
+                                          &out, cmd_options, &tmp_err)) {
+            // The packages count in the headers would be wrong and
+            // packages would be missing, don't leave such repodata behind
+            g_critical("%s", tmp_err->message);
+            g_clear_error(&tmp_err);
+            cr_xmlfile_close(pri_f, NULL);
+            cr_xmlfile_close(fil_f, NULL);
+            cr_xmlfile_close(oth_f, NULL);
             if (cmd_options->zck_compression) {
-                cr_xmlfile_add_chunk(pri_cr_zck, (const char *) res.primary, NULL);
-                cr_xmlfile_add_chunk(fil_cr_zck, (const char *) res.filelists, NULL);
-                cr_xmlfile_add_chunk(oth_cr_zck, (const char *) res.other, NULL);
+                cr_xmlfile_close(pri_cr_zck, NULL);
+                cr_xmlfile_close(fil_cr_zck, NULL);
+                cr_xmlfile_close(oth_cr_zck, NULL);
             }
-
             if (!cmd_options->no_database) {
-                cr_db_add_pkg(pri_db, pkg, NULL);
-                cr_db_add_pkg(fil_db, pkg, NULL);
-                cr_db_add_pkg(oth_db, pkg, NULL);
+                cr_db_close(pri_db, NULL);
+                cr_db_close(fil_db, NULL);
+                cr_db_close(oth_db, NULL);
             }
-
-            free(res.primary);
-            free(res.filelists);
-            free(res.other);
+            cr_remove_dir(cmd_options->tmp_out_repo, NULL);
+            exit(EXIT_FAILURE);
         }
+    } else {
+        GList *keys, *key;
+        keys = g_hash_table_get_keys(merged_hashtable);
+        keys = g_list_sort(keys, (GCompareFunc) g_strcmp0);
+
+        for (key = keys; key; key = g_list_next(key)) {
+            gpointer value = g_hash_table_lookup(merged_hashtable, key->data);
+            GSList *element = (GSList *) value;
+            element = g_slist_sort(element, package_cmp);
+            for (; element; element=g_slist_next(element))
+                dump_merged_package(&out, (cr_Package *) element->data);
+        }
+        g_list_free(keys);
     }
-    g_free(prev_srpm);
-    g_list_free(keys);
+    g_free(out.prev_srpm);
 
 
     // Close files
@@ -1848,6 +2236,7 @@ main(int argc, char **argv)
         }
 
         noarch_metadata = cr_metadata_new(CR_HT_KEY_FILENAME, 0, NULL);
+        cr_metadata_set_parallel_loading(noarch_metadata, TRUE);
 
         // Base paths in output of original createrepo doesn't have trailing '/'
         gchar *noarch_repopath = cr_normalize_dir_path(noarch_ml->original_url);
@@ -1886,7 +2275,9 @@ main(int argc, char **argv)
 
     struct KojiMergedReposStuff *koji_stuff = NULL;
     if (cmd_options->koji)
-        koji_stuff_prepare(&koji_stuff, cmd_options, local_repos);
+        // The srpm selection is done in merge_repos(), while each repo
+        // is loaded, so the repos don't have to be loaded twice
+        koji_stuff_prepare(&koji_stuff, cmd_options, NULL);
     else if (cmd_options->pkgorigins)
         pkgorigins_prepare(&koji_stuff, cmd_options->tmp_out_repo);
 
@@ -1894,6 +2285,7 @@ main(int argc, char **argv)
     // Load metadata
 
     long loaded_packages;
+    GStringChunk *light_chunk = NULL;
     GHashTable *merged_hashtable = new_merged_metadata_hashtable();
     // merged_hashtable:
     //   Key: pkg->name
@@ -1902,6 +2294,11 @@ main(int argc, char **argv)
     g_autoptr(ModulemdModuleIndex) merged_index = NULL;
 #endif
 
+    // With --low-memory only light copies of the packages are merged
+    // (their strings are in the light_chunk)
+    if (cmd_options->low_memory)
+        light_chunk = g_string_chunk_new(64 * 1024);
+
     loaded_packages = merge_repos(merged_hashtable,
 #ifdef WITH_LIBMODULEMD
                                   &merged_index,
@@ -1915,7 +2312,9 @@ main(int argc, char **argv)
                                   koji_stuff,
                                   cmd_options->omit_baseurl,
                                   cmd_options->repo_prefix_search,
-                                  cmd_options->repo_prefix_replace
+                                  cmd_options->repo_prefix_replace,
+                                  cmd_options->workers,
+                                  light_chunk
                                  );
 
 
@@ -1932,6 +2331,7 @@ main(int argc, char **argv)
 #ifdef WITH_LIBMODULEMD
                          merged_index,
 #endif
+                         local_repos,
                          cmd_options);
 
 
@@ -1949,6 +2349,8 @@ main(int argc, char **argv)
     g_free(groupfile);
     cr_metadata_free(noarch_metadata);
     destroy_merged_metadata_hashtable(merged_hashtable);
+    if (light_chunk)
+        g_string_chunk_free(light_chunk);
     free_options(cmd_options);
     return 0;
 }
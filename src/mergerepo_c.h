@@ -65,6 +65,8 @@ struct CmdOptions {
     gboolean unique_md_filenames;
     gboolean simple_md_filenames;
     gboolean omit_baseurl;
+    int workers;
+    gboolean low_memory;
 
     // Koji mergerepos specific options
     gboolean koji;
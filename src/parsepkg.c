@@ -20,11 +20,14 @@
 #include <glib.h>
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <arpa/inet.h>
 #include <rpm/rpmts.h>
+#include <rpm/rpmtd.h>
 #include <rpm/rpmfi.h>
 #include <rpm/rpmlib.h>
 #include <rpm/rpmmacro.h>
@@ -37,6 +40,15 @@
 
 #define ERR_DOMAIN      CREATEREPO_C_ERROR
 
+#define RPM_LEAD_SIZE           96
+#define RPM_LEAD_TYPE_SOURCE    1
+#define RPM_HDR_INTRO_SIZE      16  // magic (8 bytes) + il + dl
+#define RPM_HDR_MAX_TAGS        0x0000ffff
+#define RPM_HDR_MAX_DATA        0x0fffffff
+
+static const unsigned char rpm_lead_magic[] = { 0xed, 0xab, 0xee, 0xdb };
+static const unsigned char rpm_hdr_magic[]  = { 0x8e, 0xad, 0xe8, 0x01 };
+
 
 rpmts cr_ts = NULL;
 
@@ -124,61 +136,234 @@ read_header(const char *filename, Header *hdr, GError **err)
     return TRUE;
 }
 
-cr_Package *
-cr_package_from_rpm_base(const char *filename,
-                         int changelog_limit,
-                         cr_HeaderReadingFlags flags,
-                         GError **err)
+/** Read exactly len bytes from the fd and feed them into the checksum.
+ */
+static gboolean
+stream_read(int fd,
+            void *buf,
+            size_t len,
+            cr_ChecksumCtx *ctx,
+            const char *filename,
+            GError **err)
 {
-    Header hdr;
-    cr_Package *pkg;
+    size_t total = 0;
+
+    while (total < len) {
+        ssize_t readed = read(fd, (char *) buf + total, len - total);
+        if (readed < 0) {
+            if (errno == EINTR)
+                continue;
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "read() error on %s: %s", filename, g_strerror(errno));
+            return FALSE;
+        }
+        if (readed == 0) {
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "Unexpected end of file %s", filename);
+            return FALSE;
+        }
+        total += readed;
+    }
 
-    assert(filename);
-    assert(!err || *err == NULL);
+    if (ctx && cr_checksum_update(ctx, buf, len, err) != CRE_OK)
+        return FALSE;
 
-    if (!read_header(filename, &hdr, err))
+    return TRUE;
+}
+
+/** Read a header structure (signature or the main header) from the stream.
+ * Returns a malloced blob in the format expected by headerImport()
+ * (the header without its magic) and its size.
+ */
+static unsigned char *
+stream_read_header_blob(int fd,
+                        cr_ChecksumCtx *ctx,
+                        const char *filename,
+                        size_t *blob_size,
+                        GError **err)
+{
+    unsigned char intro[RPM_HDR_INTRO_SIZE];
+    guint32 il, dl;
+    unsigned char *blob;
+
+    if (!stream_read(fd, intro, RPM_HDR_INTRO_SIZE, ctx, filename, err))
         return NULL;
 
-    pkg = cr_package_from_header(hdr, changelog_limit, flags, err);
-    headerFree(hdr);
-    return pkg;
+    if (memcmp(intro, rpm_hdr_magic, sizeof(rpm_hdr_magic))) {
+        g_set_error(err, ERR_DOMAIN, CRE_ERROR,
+                    "Bad header magic in %s", filename);
+        return NULL;
+    }
+
+    memcpy(&il, intro + 8, sizeof(il));
+    memcpy(&dl, intro + 12, sizeof(dl));
+    il = ntohl(il);
+    dl = ntohl(dl);
+
+    if (il > RPM_HDR_MAX_TAGS || dl > RPM_HDR_MAX_DATA) {
+        g_set_error(err, ERR_DOMAIN, CRE_ERROR,
+                    "Header size out of bounds in %s (tags: %u, data: %u)",
+                    filename, il, dl);
+        return NULL;
+    }
+
+    *blob_size = 8 + (size_t) il * 16 + dl;
+    blob = g_malloc(*blob_size);
+    memcpy(blob, intro + 8, 8);
+    if (!stream_read(fd, blob + 8, *blob_size - 8, ctx, filename, err)) {
+        g_free(blob);
+        return NULL;
+    }
+
+    return blob;
+}
+
+/** Merge tags from the signature header into the main header
+ * the same way as rpmReadPackageFile() does it.
+ */
+static void
+merge_signature_tags(Header hdr, Header sigh)
+{
+    struct rpmtd_s td;
+    HeaderIterator hi = headerInitIterator(sigh);
+
+    while (headerNext(hi, &td)) {
+        switch (td.tag) {
+            case RPMSIGTAG_SIZE:        td.tag = RPMTAG_SIGSIZE;     break;
+            case RPMSIGTAG_PGP:         td.tag = RPMTAG_SIGPGP;      break;
+            case RPMSIGTAG_MD5:         td.tag = RPMTAG_SIGMD5;      break;
+            case RPMSIGTAG_GPG:         td.tag = RPMTAG_SIGGPG;      break;
+            case RPMSIGTAG_PGP5:        td.tag = RPMTAG_SIGPGP5;     break;
+            case RPMSIGTAG_PAYLOADSIZE: td.tag = RPMTAG_ARCHIVESIZE; break;
+            default:
+                // Tags like SHA1 (hdrid), DSA, RSA, LONGSIZE, ...
+                // have the same number in both headers
+                if (td.tag < HEADER_SIGBASE || td.tag >= HEADER_TAGBASE) {
+                    rpmtdFreeData(&td);
+                    continue;
+                }
+                break;
+        }
+
+        if (td.data && !headerIsEntry(hdr, td.tag))
+            headerPut(hdr, &td, HEADERPUT_DEFAULT);
+        rpmtdFreeData(&td);
+    }
+
+    headerFreeIterator(hi);
 }
 
 cr_Package *
-cr_package_from_rpm(const char *filename,
-                    cr_ChecksumType checksum_type,
-                    const char *location_href,
-                    const char *location_base,
-                    int changelog_limit,
-                    struct stat *stat_buf,
-                    cr_HeaderReadingFlags flags,
-                    GError **err)
+cr_package_from_rpm_single_pass(const char *filename,
+                                cr_ChecksumType checksum_type,
+                                int changelog_limit,
+                                struct stat *stat_buf,
+                                cr_HeaderReadingFlags flags,
+                                cr_PkgIdLookupCb lookup_cb,
+                                void *lookup_cbdata,
+                                GError **err)
 {
+    int fd;
+    cr_ChecksumCtx *ctx = NULL;
     cr_Package *pkg = NULL;
+    Header hdr = NULL, sigh = NULL;
+    unsigned char *sigblob = NULL, *hdrblob = NULL;
+    size_t sigblob_size = 0, hdrblob_size = 0;
+    unsigned char lead[RPM_LEAD_SIZE];
+    char *checksum = NULL;
     GError *tmp_err = NULL;
 
     assert(filename);
     assert(!err || *err == NULL);
 
-    // Get a package object
-    pkg = cr_package_from_rpm_base(filename, changelog_limit, flags, err);
-    if (!pkg)
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        g_warning("%s: open of %s failed %s",
+                  __func__, filename, g_strerror(errno));
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot open %s: %s", filename, g_strerror(errno));
+        return NULL;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    ctx = cr_checksum_new(checksum_type, &tmp_err);
+    if (!ctx) {
+        g_propagate_prefixed_error(err, tmp_err,
+                                   "Error while checksum calculation: ");
         goto errexit;
+    }
 
-    pkg->location_href = cr_safe_string_chunk_insert(pkg->chunk, location_href);
-    pkg->location_base = cr_safe_string_chunk_insert(pkg->chunk, location_base);
+    // Lead
+    if (!stream_read(fd, lead, RPM_LEAD_SIZE, ctx, filename, err))
+        goto errexit;
+
+    if (memcmp(lead, rpm_lead_magic, sizeof(rpm_lead_magic))) {
+        g_set_error(err, ERR_DOMAIN, CRE_ERROR,
+                    "%s is not a rpm package (bad lead magic)", filename);
+        goto errexit;
+    }
+
+    // Signature (padded to 8 bytes)
+    sigblob = stream_read_header_blob(fd, ctx, filename, &sigblob_size, err);
+    if (!sigblob)
+        goto errexit;
+
+    size_t sigsize = sigblob_size - 8;
+    size_t pad = (8 - (sigsize % 8)) % 8;
+    if (pad) {
+        unsigned char padbuf[8];
+        if (!stream_read(fd, padbuf, pad, ctx, filename, err))
+            goto errexit;
+    }
+
+    // Header
+    guint64 hdrstart = RPM_LEAD_SIZE + RPM_HDR_INTRO_SIZE + sigsize + pad;
+    hdrblob = stream_read_header_blob(fd, ctx, filename, &hdrblob_size, err);
+    if (!hdrblob)
+        goto errexit;
+    guint64 hdrend = hdrstart + RPM_HDR_INTRO_SIZE + hdrblob_size - 8;
+
+    sigh = headerImport(sigblob, sigblob_size, HEADERIMPORT_COPY);
+    hdr  = headerImport(hdrblob, hdrblob_size, HEADERIMPORT_COPY);
+    if (!sigh || !hdr) {
+        g_set_error(err, ERR_DOMAIN, CRE_ERROR,
+                    "Cannot import %s header of %s",
+                    sigh ? "main" : "signature", filename);
+        goto errexit;
+    }
+
+    merge_signature_tags(hdr, sigh);
+
+    if (lead[7] == RPM_LEAD_TYPE_SOURCE
+        && !headerIsEntry(hdr, RPMTAG_SOURCERPM)
+        && !headerIsEntry(hdr, RPMTAG_SOURCEPACKAGE))
+    {
+        guint32 one = 1;
+        headerPutUint32(hdr, RPMTAG_SOURCEPACKAGE, &one, 1);
+    }
+
+    if (!headerIsEntry(hdr, RPMTAG_HEADERIMMUTABLE))
+        headerConvert(hdr, HEADERCONV_RETROFIT_V3);
+
+    pkg = cr_package_from_header(hdr, changelog_limit, flags, err);
+    if (!pkg)
+        goto errexit;
 
-    // Get checksum type string
     pkg->checksum_type = cr_safe_string_chunk_insert(pkg->chunk,
                                         cr_checksum_name_str(checksum_type));
+    pkg->rpm_header_start = hdrstart;
+    pkg->rpm_header_end = hdrend;
 
     // Get file stat
     if (!stat_buf) {
         struct stat stat_buf_own;
-        if (stat(filename, &stat_buf_own) == -1) {
-            g_warning("%s: stat(%s) error (%s)", __func__,
+        if (fstat(fd, &stat_buf_own) == -1) {
+            g_warning("%s: fstat(%s) error (%s)", __func__,
                       filename, g_strerror(errno));
-            g_set_error(err,  ERR_DOMAIN, CRE_IO, "stat(%s) failed: %s",
+            g_set_error(err,  ERR_DOMAIN, CRE_IO, "fstat(%s) failed: %s",
                         filename, g_strerror(errno));
             goto errexit;
         }
@@ -189,35 +374,98 @@ cr_package_from_rpm(const char *filename,
         pkg->size_package = stat_buf->st_size;
     }
 
-    // Compute checksum
-    char *checksum = cr_checksum_file(filename, checksum_type, &tmp_err);
+    // Try to get checksum without reading the payload
+    if (lookup_cb)
+        checksum = lookup_cb(pkg, lookup_cbdata);
+
     if (!checksum) {
-        g_propagate_prefixed_error(err, tmp_err,
-                                   "Error while checksum calculation: ");
-        goto errexit;
-    }
-    pkg->pkgId = cr_safe_string_chunk_insert(pkg->chunk, checksum);
-    free(checksum);
+        // Stream the rest of the file through the checksum
+        if (cr_checksum_update_fd(ctx, fd, filename, err) != CRE_OK)
+            goto errexit;
 
-    // Get header range
-    struct cr_HeaderRangeStruct hdr_r = cr_get_header_byte_range(filename,
-                                                                 &tmp_err);
-    if (tmp_err) {
-        g_propagate_prefixed_error(err, tmp_err,
-                                   "Error while determinig header range: ");
-        goto errexit;
+        checksum = cr_checksum_final(ctx, &tmp_err);
+        ctx = NULL;
+        if (!checksum) {
+            g_propagate_prefixed_error(err, tmp_err,
+                                       "Error while checksum calculation: ");
+            goto errexit;
+        }
     }
 
-    pkg->rpm_header_start = hdr_r.start;
-    pkg->rpm_header_end = hdr_r.end;
+    pkg->pkgId = cr_safe_string_chunk_insert(pkg->chunk, checksum);
+    g_free(checksum);
 
+    if (ctx)
+        g_free(cr_checksum_final(ctx, NULL));
+    headerFree(hdr);
+    headerFree(sigh);
+    g_free(hdrblob);
+    g_free(sigblob);
+    close(fd);
     return pkg;
 
 errexit:
+    if (ctx)
+        g_free(cr_checksum_final(ctx, NULL));
+    if (hdr)
+        headerFree(hdr);
+    if (sigh)
+        headerFree(sigh);
+    g_free(hdrblob);
+    g_free(sigblob);
     cr_package_free(pkg);
+    close(fd);
     return NULL;
 }
 
+cr_Package *
+cr_package_from_rpm_base(const char *filename,
+                         int changelog_limit,
+                         cr_HeaderReadingFlags flags,
+                         GError **err)
+{
+    Header hdr;
+    cr_Package *pkg;
+
+    assert(filename);
+    assert(!err || *err == NULL);
+
+    if (!read_header(filename, &hdr, err))
+        return NULL;
+
+    pkg = cr_package_from_header(hdr, changelog_limit, flags, err);
+    headerFree(hdr);
+    return pkg;
+}
+
+cr_Package *
+cr_package_from_rpm(const char *filename,
+                    cr_ChecksumType checksum_type,
+                    const char *location_href,
+                    const char *location_base,
+                    int changelog_limit,
+                    struct stat *stat_buf,
+                    cr_HeaderReadingFlags flags,
+                    GError **err)
+{
+    cr_Package *pkg;
+
+    assert(filename);
+    assert(!err || *err == NULL);
+
+    // Get a package object
+    pkg = cr_package_from_rpm_single_pass(filename, checksum_type,
+                                          changelog_limit, stat_buf, flags,
+                                          NULL, NULL, err);
+    if (!pkg)
+        return NULL;
+
+    pkg->location_href = cr_safe_string_chunk_insert(pkg->chunk, location_href);
+    pkg->location_base = cr_safe_string_chunk_insert(pkg->chunk, location_base);
+
+    return pkg;
+}
+
 
 
 struct cr_XmlStruct
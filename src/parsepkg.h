@@ -61,6 +61,45 @@ cr_package_from_rpm_base(const char *filename,
                          cr_HeaderReadingFlags flags,
                          GError **err);
 
+/** Callback called by cr_package_from_rpm_single_pass() when the header
+ * of the package was parsed but the payload wasn't read yet.
+ * It could provide an already known (e.g. cached) checksum of the file.
+ * @param pkg                   Package object filled from the header
+ *                              (time_file and size_package are set too)
+ * @param cbdata                user data
+ * @return                      Malloced checksum of the whole package file
+ *                              (the rest of the file is not read then) or
+ *                              NULL if the checksum should be calculated.
+ */
+typedef char *(*cr_PkgIdLookupCb)(cr_Package *pkg, void *cbdata);
+
+/** Generate a package object from a package file. The file is opened and
+ * read only once. The lead, the signature and the header are parsed out
+ * of the same stream of bytes which is fed into the checksum and the
+ * header byte range is determined during the very same pass.
+ * Attributes location_href and location_base are not filled.
+ * @param filename              filename
+ * @param checksum_type         type of checksum to be used
+ * @param changelog_limit       number of changelogs that will be loaded
+ * @param stat_buf              struct stat of the filename
+ *                              (optional - could be NULL)
+ * @param flags                 Flags for header reading
+ * @param lookup_cb             Callback that could provide pkgId
+ *                              (optional - could be NULL)
+ * @param lookup_cbdata         User data for the lookup_cb
+ * @param err                   GError **
+ * @return                      cr_Package or NULL on error
+ */
+cr_Package *
+cr_package_from_rpm_single_pass(const char *filename,
+                                cr_ChecksumType checksum_type,
+                                int changelog_limit,
+                                struct stat *stat_buf,
+                                cr_HeaderReadingFlags flags,
+                                cr_PkgIdLookupCb lookup_cb,
+                                void *lookup_cbdata,
+                                GError **err);
+
 /** Generate a package object from a package file.
  * @param filename              filename
  * @param checksum_type         type of checksum to be used
@@ -213,6 +213,12 @@ static PyGetSetDef contentstat_getsetters[] = {
         "Type of used checksum", OFFSET(checksum_type)},
     {"checksum",        (getter)get_str, (setter)set_str,
         "Calculated checksum", OFFSET(checksum)},
+    {"compressed_size", (getter)get_num, (setter)set_num,
+        "Number of compressed bytes written (valid only if "
+        "the compressed_checksum is set)", OFFSET(compressed_size)},
+    {"compressed_checksum", (getter)get_str, (setter)set_str,
+        "Checksum of the written compressed file or None",
+        OFFSET(compressed_checksum)},
     {NULL, NULL, NULL, NULL, NULL} /* sentinel */
 };
 
@@ -265,6 +265,7 @@ init_createrepo_c(void)
     PyModule_AddIntConstant(m, "BZ2_COMPRESSION", CR_CW_BZ2_COMPRESSION);
     PyModule_AddIntConstant(m, "XZ_COMPRESSION", CR_CW_XZ_COMPRESSION);
     PyModule_AddIntConstant(m, "ZCK_COMPRESSION", CR_CW_ZCK_COMPRESSION);
+    PyModule_AddIntConstant(m, "ZSTD_COMPRESSION", CR_CW_ZSTD_COMPRESSION);
 
     /* Zchunk support */
 #ifdef WITH_ZCHUNK
@@ -273,6 +274,13 @@ init_createrepo_c(void)
     PyModule_AddIntConstant(m, "HAS_ZCK", 0);
 #endif // WITH_ZCHUNK
 
+    /* Zstd support */
+#ifdef WITH_ZSTD
+    PyModule_AddIntConstant(m, "HAS_ZSTD", 1);
+#else
+    PyModule_AddIntConstant(m, "HAS_ZSTD", 0);
+#endif // WITH_ZSTD
+
     /* Load Metadata key values */
     PyModule_AddIntConstant(m, "HT_KEY_DEFAULT", CR_HT_KEY_DEFAULT);
     PyModule_AddIntConstant(m, "HT_KEY_HASH", CR_HT_KEY_HASH);
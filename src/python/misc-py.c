@@ -49,7 +49,9 @@ py_compress_file_with_stat(G_GNUC_UNUSED PyObject *self, PyObject *args)
             return NULL;
     }
 
+    Py_BEGIN_ALLOW_THREADS
     cr_compress_file_with_stat(src, &dst, type, contentstat, NULL, FALSE, &tmp_err);
+    Py_END_ALLOW_THREADS
     if (tmp_err) {
         nice_exception(&tmp_err, NULL);
         return NULL;
@@ -79,7 +81,9 @@ py_decompress_file_with_stat(G_GNUC_UNUSED PyObject *self, PyObject *args)
             return NULL;
     }
 
+    Py_BEGIN_ALLOW_THREADS
     cr_decompress_file_with_stat(src, dst, type, contentstat, &tmp_err);
+    Py_END_ALLOW_THREADS
     if (tmp_err) {
         nice_exception(&tmp_err, NULL);
         return NULL;
@@ -29,6 +29,8 @@
 typedef struct {
     PyObject_HEAD
     cr_RepomdRecord *record;
+    GMutex lock;    /*!< Serializes access to the record (fill() and
+                         compress_and_fill() run without the GIL) */
 } _RepomdRecordObject;
 
 PyObject *
@@ -80,6 +82,7 @@ repomdrecord_new(PyTypeObject *type,
     _RepomdRecordObject *self = (_RepomdRecordObject *)type->tp_alloc(type, 0);
     if (self) {
         self->record = NULL;
+        g_mutex_init(&self->lock);
     }
     return (PyObject *)self;
 }
@@ -118,6 +121,7 @@ repomdrecord_dealloc(_RepomdRecordObject *self)
 {
     if (self->record)
         cr_repomd_record_free(self->record);
+    g_mutex_clear(&self->lock);
     Py_TYPE(self)->tp_free(self);
 }
 
@@ -140,9 +144,14 @@ PyDoc_STRVAR(copy__doc__,
 static PyObject *
 copy_repomdrecord(_RepomdRecordObject *self, G_GNUC_UNUSED void *nothing)
 {
+    cr_RepomdRecord *copy;
+
     if (check_RepomdRecordStatus(self))
         return NULL;
-    return Object_FromRepomdRecord(cr_repomd_record_copy(self->record));
+    g_mutex_lock(&self->lock);
+    copy = cr_repomd_record_copy(self->record);
+    g_mutex_unlock(&self->lock);
+    return Object_FromRepomdRecord(copy);
 }
 
 PyDoc_STRVAR(fill__doc__,
@@ -161,7 +170,11 @@ fill(_RepomdRecordObject *self, PyObject *args)
     if (check_RepomdRecordStatus(self))
         return NULL;
 
+    Py_BEGIN_ALLOW_THREADS
+    g_mutex_lock(&self->lock);
     cr_repomd_record_fill(self->record, checksum_type, &err);
+    g_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS
     if (err) {
         nice_exception(&err, NULL);
         return NULL;
@@ -182,6 +195,7 @@ compress_and_fill(_RepomdRecordObject *self, PyObject *args)
 {
     int checksum_type, compression_type;
     PyObject *compressed_repomdrecord;
+    cr_RepomdRecord *compressed_record;
     gchar *zck_dict_dir = NULL;
     GError *err = NULL;
 
@@ -196,12 +210,20 @@ compress_and_fill(_RepomdRecordObject *self, PyObject *args)
     if (check_RepomdRecordStatus(self))
         return NULL;
 
+    compressed_record = RepomdRecord_FromPyObject(compressed_repomdrecord);
+
+    // Only self is locked, the compressed record must not be used
+    // by another thread in the meantime
+    Py_BEGIN_ALLOW_THREADS
+    g_mutex_lock(&self->lock);
     cr_repomd_record_compress_and_fill(self->record,
-                                       RepomdRecord_FromPyObject(compressed_repomdrecord),
+                                       compressed_record,
                                        checksum_type,
                                        compression_type,
                                        zck_dict_dir,
                                        &err);
+    g_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS
     if (err) {
         nice_exception(&err, NULL);
         return NULL;
@@ -219,7 +241,12 @@ rename_file(_RepomdRecordObject *self, G_GNUC_UNUSED void *nothing)
 {
     GError *err = NULL;
 
+    if (check_RepomdRecordStatus(self))
+        return NULL;
+
+    g_mutex_lock(&self->lock);
     cr_repomd_record_rename_file(self->record, &err);
+    g_mutex_unlock(&self->lock);
     if (err) {
         nice_exception(&err, NULL);
         return NULL;
@@ -245,10 +272,9 @@ set_timestamp(_RepomdRecordObject *self, PyObject *args)
     if (check_RepomdRecordStatus(self))
         return NULL;
 
-    if (check_RepomdRecordStatus(self))
-        return NULL;
-
+    g_mutex_lock(&self->lock);
     cr_repomd_record_set_timestamp(self->record, timestamp);
+    g_mutex_unlock(&self->lock);
     Py_RETURN_NONE;
 }
 
@@ -271,8 +297,10 @@ load_contentstat(_RepomdRecordObject *self, PyObject *args)
     if (check_RepomdRecordStatus(self))
         return NULL;
 
+    g_mutex_lock(&self->lock);
     cr_repomd_record_load_contentstat(self->record,
                                       ContentStat_FromPyObject(contentstat));
+    g_mutex_unlock(&self->lock);
     Py_RETURN_NONE;
 }
 
@@ -302,7 +330,9 @@ get_num(_RepomdRecordObject *self, void *member_offset)
     if (check_RepomdRecordStatus(self))
         return NULL;
     cr_RepomdRecord *rec = self->record;
+    g_mutex_lock(&self->lock);
     gint64 val = (gint64) *((gint64 *) ((size_t)rec + (size_t) member_offset));
+    g_mutex_unlock(&self->lock);
     return PyLong_FromLongLong((long long) val);
 }
 
@@ -312,7 +342,9 @@ get_int(_RepomdRecordObject *self, void *member_offset)
     if (check_RepomdRecordStatus(self))
         return NULL;
     cr_RepomdRecord *rec = self->record;
+    g_mutex_lock(&self->lock);
     gint64 val = (gint64) *((int *) ((size_t)rec + (size_t) member_offset));
+    g_mutex_unlock(&self->lock);
     return PyLong_FromLongLong((long long) val);
 }
 
@@ -321,11 +353,18 @@ get_str(_RepomdRecordObject *self, void *member_offset)
 {
     if (check_RepomdRecordStatus(self))
         return NULL;
+    PyObject *py_str;
     cr_RepomdRecord *rec = self->record;
+    g_mutex_lock(&self->lock);
     char *str = *((char **) ((size_t) rec + (size_t) member_offset));
-    if (str == NULL)
-        Py_RETURN_NONE;
-    return PyUnicode_FromString(str);
+    if (str == NULL) {
+        Py_INCREF(Py_None);
+        py_str = Py_None;
+    } else {
+        py_str = PyUnicode_FromString(str);
+    }
+    g_mutex_unlock(&self->lock);
+    return py_str;
 }
 
 static int
@@ -347,7 +386,9 @@ set_num(_RepomdRecordObject *self, PyObject *value, void *member_offset)
         return -1;
     }
     cr_RepomdRecord *rec = self->record;
+    g_mutex_lock(&self->lock);
     *((gint64 *) ((size_t) rec + (size_t) member_offset)) = val;
+    g_mutex_unlock(&self->lock);
     return 0;
 }
 
@@ -370,7 +411,9 @@ set_int(_RepomdRecordObject *self, PyObject *value, void *member_offset)
         return -1;
     }
     cr_RepomdRecord *rec = self->record;
+    g_mutex_lock(&self->lock);
     *((int *) ((size_t) rec + (size_t) member_offset)) = (int) val;
+    g_mutex_unlock(&self->lock);
     return 0;
 }
 
@@ -384,9 +427,11 @@ set_str(_RepomdRecordObject *self, PyObject *value, void *member_offset)
         return -1;
     }
     cr_RepomdRecord *rec = self->record;
+    g_mutex_lock(&self->lock);
     char *str = cr_safe_string_chunk_insert(rec->chunk,
                                             PyObject_ToStrOrNull(value));
     *((char **) ((size_t) rec + (size_t) member_offset)) = str;
+    g_mutex_unlock(&self->lock);
     return 0;
 }
 
@@ -29,6 +29,8 @@
 typedef struct {
     PyObject_HEAD
     cr_SqliteDb *db;
+    GMutex lock;    /*!< Serializes access to the db (add_pkg() runs
+                         without the GIL) */
 } _SqliteObject;
 
 // Forward declaration
@@ -56,8 +58,10 @@ sqlite_new(PyTypeObject *type,
            G_GNUC_UNUSED PyObject *kwds)
 {
     _SqliteObject *self = (_SqliteObject *)type->tp_alloc(type, 0);
-    if (self)
+    if (self) {
         self->db = NULL;
+        g_mutex_init(&self->lock);
+    }
     return (PyObject *)self;
 }
 
@@ -107,6 +111,7 @@ sqlite_dealloc(_SqliteObject *self)
 {
     if (self->db)
         cr_db_close(self->db, NULL);
+    g_mutex_clear(&self->lock);
 
     Py_TYPE(self)->tp_free(self);
 }
@@ -132,6 +137,8 @@ static PyObject *
 add_pkg(_SqliteObject *self, PyObject *args)
 {
     PyObject *py_pkg;
+    cr_Package *pkg;
+    gboolean closed = FALSE;
     GError *err = NULL;
 
     if (!PyArg_ParseTuple(args, "O!:add_pkg", &Package_Type, &py_pkg))
@@ -140,7 +147,22 @@ add_pkg(_SqliteObject *self, PyObject *args)
     if (check_SqliteStatus(self))
         return NULL;
 
-    cr_db_add_pkg(self->db, Package_FromPyObject(py_pkg), &err);
+    pkg = Package_FromPyObject(py_pkg);
+
+    Py_BEGIN_ALLOW_THREADS
+    g_mutex_lock(&self->lock);
+    if (self->db)
+        cr_db_add_pkg(self->db, pkg, &err);
+    else
+        closed = TRUE;  // Closed by another thread in the meantime
+    g_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS
+
+    if (closed) {
+        check_SqliteStatus(self);
+        return NULL;
+    }
+
     if (err) {
         nice_exception(&err, NULL);
         return NULL;
@@ -157,6 +179,7 @@ static PyObject *
 dbinfo_update(_SqliteObject *self, PyObject *args)
 {
     char *checksum;
+    gboolean closed = FALSE;
     GError *err = NULL;
 
     if (!PyArg_ParseTuple(args, "s:dbinfo_update", &checksum))
@@ -165,7 +188,18 @@ dbinfo_update(_SqliteObject *self, PyObject *args)
     if (check_SqliteStatus(self))
         return NULL;
 
-    cr_db_dbinfo_update(self->db, checksum, &err);
+    g_mutex_lock(&self->lock);
+    if (self->db)
+        cr_db_dbinfo_update(self->db, checksum, &err);
+    else
+        closed = TRUE;  // Closed by another thread in the meantime
+    g_mutex_unlock(&self->lock);
+
+    if (closed) {
+        check_SqliteStatus(self);
+        return NULL;
+    }
+
     if (err) {
         nice_exception(&err, NULL);
         return NULL;
@@ -184,8 +218,13 @@ close_db(_SqliteObject *self, G_GNUC_UNUSED void *nothing)
     GError *err = NULL;
 
     if (self->db) {
-        cr_db_close(self->db, &err);
+        Py_BEGIN_ALLOW_THREADS
+        g_mutex_lock(&self->lock);
+        if (self->db)
+            cr_db_close(self->db, &err);
         self->db = NULL;
+        g_mutex_unlock(&self->lock);
+        Py_END_ALLOW_THREADS
         if (err) {
             nice_exception(&err, NULL);
             return NULL;
@@ -35,15 +35,17 @@ typedef struct {
     PyObject *py_pkgcb;
     PyObject *py_warningcb;
     PyObject *py_pkg;       /*!< Current processed package */
+    PyThreadState *thread_state; /*!< The GIL is released during the parsing
+                                      and acquired only by the callbacks */
 } CbData;
 
 static int
-c_newpkgcb(cr_Package **pkg,
-           const char *pkgId,
-           const char *name,
-           const char *arch,
-           void *cbdata,
-           GError **err)
+c_newpkgcb_gil(cr_Package **pkg,
+               const char *pkgId,
+               const char *name,
+               const char *arch,
+               void *cbdata,
+               GError **err)
 {
     PyObject *arglist, *result;
     CbData *data = cbdata;
@@ -84,9 +86,9 @@ c_newpkgcb(cr_Package **pkg,
 }
 
 static int
-c_pkgcb(cr_Package *pkg,
-        void *cbdata,
-        GError **err)
+c_pkgcb_gil(cr_Package *pkg,
+            void *cbdata,
+            GError **err)
 {
     PyObject *arglist, *result, *py_pkg;
     CbData *data = cbdata;
@@ -113,10 +115,10 @@ c_pkgcb(cr_Package *pkg,
 }
 
 static int
-c_warningcb(cr_XmlParserWarningType type,
-            char *msg,
-            void *cbdata,
-            GError **err)
+c_warningcb_gil(cr_XmlParserWarningType type,
+                char *msg,
+                void *cbdata,
+                GError **err)
 {
     PyObject *arglist, *result;
     CbData *data = cbdata;
@@ -135,6 +137,54 @@ c_warningcb(cr_XmlParserWarningType type,
     return CR_CB_RET_OK;
 }
 
+/* Callbacks called by the parser (without the GIL) */
+
+static int
+c_newpkgcb(cr_Package **pkg,
+           const char *pkgId,
+           const char *name,
+           const char *arch,
+           void *cbdata,
+           GError **err)
+{
+    int ret;
+    CbData *data = cbdata;
+
+    PyEval_RestoreThread(data->thread_state);
+    ret = c_newpkgcb_gil(pkg, pkgId, name, arch, cbdata, err);
+    data->thread_state = PyEval_SaveThread();
+    return ret;
+}
+
+static int
+c_pkgcb(cr_Package *pkg,
+        void *cbdata,
+        GError **err)
+{
+    int ret;
+    CbData *data = cbdata;
+
+    PyEval_RestoreThread(data->thread_state);
+    ret = c_pkgcb_gil(pkg, cbdata, err);
+    data->thread_state = PyEval_SaveThread();
+    return ret;
+}
+
+static int
+c_warningcb(cr_XmlParserWarningType type,
+            char *msg,
+            void *cbdata,
+            GError **err)
+{
+    int ret;
+    CbData *data = cbdata;
+
+    PyEval_RestoreThread(data->thread_state);
+    ret = c_warningcb_gil(type, msg, cbdata, err);
+    data->thread_state = PyEval_SaveThread();
+    return ret;
+}
+
 PyObject *
 py_xml_parse_primary(G_GNUC_UNUSED PyObject *self, PyObject *args)
 {
@@ -192,7 +242,9 @@ py_xml_parse_primary(G_GNUC_UNUSED PyObject *self, PyObject *args)
     cbdata.py_pkgcb     = py_pkgcb;
     cbdata.py_warningcb = py_warningcb;
     cbdata.py_pkg       = NULL;
+    cbdata.thread_state = NULL;
 
+    cbdata.thread_state = PyEval_SaveThread();
     cr_xml_parse_primary(filename,
                          ptr_c_newpkgcb,
                          &cbdata,
@@ -202,6 +254,7 @@ py_xml_parse_primary(G_GNUC_UNUSED PyObject *self, PyObject *args)
                          &cbdata,
                          do_files,
                          &tmp_err);
+    PyEval_RestoreThread(cbdata.thread_state);
 
     Py_XDECREF(py_newpkgcb);
     Py_XDECREF(py_pkgcb);
@@ -271,7 +324,9 @@ py_xml_parse_filelists(G_GNUC_UNUSED PyObject *self, PyObject *args)
     cbdata.py_pkgcb     = py_pkgcb;
     cbdata.py_warningcb = py_warningcb;
     cbdata.py_pkg       = NULL;
+    cbdata.thread_state = NULL;
 
+    cbdata.thread_state = PyEval_SaveThread();
     cr_xml_parse_filelists(filename,
                            ptr_c_newpkgcb,
                            &cbdata,
@@ -280,6 +335,7 @@ py_xml_parse_filelists(G_GNUC_UNUSED PyObject *self, PyObject *args)
                            ptr_c_warningcb,
                            &cbdata,
                            &tmp_err);
+    PyEval_RestoreThread(cbdata.thread_state);
 
     Py_XDECREF(py_newpkgcb);
     Py_XDECREF(py_pkgcb);
@@ -349,7 +405,9 @@ py_xml_parse_other(G_GNUC_UNUSED PyObject *self, PyObject *args)
     cbdata.py_pkgcb     = py_pkgcb;
     cbdata.py_warningcb = py_warningcb;
     cbdata.py_pkg       = NULL;
+    cbdata.thread_state = NULL;
 
+    cbdata.thread_state = PyEval_SaveThread();
     cr_xml_parse_other(filename,
                        ptr_c_newpkgcb,
                        &cbdata,
@@ -358,6 +416,7 @@ py_xml_parse_other(G_GNUC_UNUSED PyObject *self, PyObject *args)
                        ptr_c_warningcb,
                        &cbdata,
                        &tmp_err);
+    PyEval_RestoreThread(cbdata.thread_state);
 
     Py_XDECREF(py_newpkgcb);
     Py_XDECREF(py_pkgcb);
@@ -406,14 +465,17 @@ py_xml_parse_repomd(G_GNUC_UNUSED PyObject *self, PyObject *args)
     cbdata.py_pkgcb     = NULL;
     cbdata.py_warningcb = py_warningcb;
     cbdata.py_pkg       = NULL;
+    cbdata.thread_state = NULL;
 
     repomd = Repomd_FromPyObject(py_repomd);
 
+    cbdata.thread_state = PyEval_SaveThread();
     cr_xml_parse_repomd(filename,
                        repomd,
                        ptr_c_warningcb,
                        &cbdata,
                        &tmp_err);
+    PyEval_RestoreThread(cbdata.thread_state);
 
     Py_XDECREF(py_repomd);
     Py_XDECREF(py_warningcb);
@@ -460,14 +522,17 @@ py_xml_parse_updateinfo(G_GNUC_UNUSED PyObject *self, PyObject *args)
     cbdata.py_pkgcb     = NULL;
     cbdata.py_warningcb = py_warningcb;
     cbdata.py_pkg       = NULL;
+    cbdata.thread_state = NULL;
 
     updateinfo = UpdateInfo_FromPyObject(py_updateinfo);
 
+    cbdata.thread_state = PyEval_SaveThread();
     cr_xml_parse_updateinfo(filename,
                             updateinfo,
                             ptr_c_warningcb,
                             &cbdata,
                             &tmp_err);
+    PyEval_RestoreThread(cbdata.thread_state);
 
     Py_XDECREF(py_updateinfo);
     Py_XDECREF(py_warningcb);
@@ -435,7 +435,10 @@ cr_repomd_record_compress_and_fill(cr_RepomdRecord *record,
         }
     }
 
+    // Checksums of both the plain and the compressed data are computed
+    // while compressing
     _cleanup_free_ cr_ContentStat *out_stat = g_malloc0(sizeof(cr_ContentStat));
+    out_stat->checksum_type = checksum_type;
     cw_compressed = cr_sopen(cpath,
                              CR_CW_MODE_WRITE,
                              record_compression,
@@ -471,6 +474,8 @@ cr_repomd_record_compress_and_fill(cr_RepomdRecord *record,
     if (tmp_err) {
         ret = tmp_err->code;
         cr_close(cw_compressed, NULL);
+        g_free(out_stat->checksum);
+        g_free(out_stat->compressed_checksum);
         g_debug("%s: Error while repomd record compression: %s", __func__,
                 tmp_err->message);
         g_propagate_prefixed_error(err, tmp_err,
@@ -481,14 +486,27 @@ cr_repomd_record_compress_and_fill(cr_RepomdRecord *record,
     cr_close(cw_compressed, &tmp_err);
     if (tmp_err) {
         ret = tmp_err->code;
+        g_free(out_stat->checksum);
         g_propagate_prefixed_error(err, tmp_err,
                 "Error while closing %s: ", path);
         return ret;
     }
 
-    // Compute checksums
+    // Compute checksums (if they were not computed during the compression)
 
-    checksum  = cr_checksum_file(path, checksum_type, &tmp_err);
+    if (mode == CR_CW_NO_COMPRESSION) {
+        // The plain file was copied as is
+        checksum = out_stat->checksum;
+        out_stat->checksum = NULL;
+    } else {
+        g_free(out_stat->checksum);
+        out_stat->checksum = NULL;
+    }
+    cchecksum = out_stat->compressed_checksum;
+    out_stat->compressed_checksum = NULL;
+
+    if (!checksum)
+        checksum = cr_checksum_file(path, checksum_type, &tmp_err);
     if (!checksum) {
         ret = tmp_err->code;
         g_propagate_prefixed_error(err, tmp_err,
@@ -496,7 +514,8 @@ cr_repomd_record_compress_and_fill(cr_RepomdRecord *record,
         goto end;
     }
 
-    cchecksum = cr_checksum_file(cpath, checksum_type, &tmp_err);
+    if (!cchecksum)
+        cchecksum = cr_checksum_file(cpath, checksum_type, &tmp_err);
     if (!cchecksum) {
         ret = tmp_err->code;
         g_propagate_prefixed_error(err, tmp_err,
@@ -727,6 +746,16 @@ cr_repomd_record_load_contentstat(cr_RepomdRecord *record,
     record->checksum_open_type = cr_safe_string_chunk_insert(record->chunk,
                                 cr_checksum_name_str(stats->checksum_type));
     record->size_open = stats->size;
+
+    // Stats of the compressed file itself, if they were computed
+    // while writing, so cr_repomd_record_fill() doesn't read it again
+    if (stats->compressed_checksum) {
+        record->checksum = cr_safe_string_chunk_insert(record->chunk,
+                                                stats->compressed_checksum);
+        record->checksum_type = cr_safe_string_chunk_insert(record->chunk,
+                                cr_checksum_name_str(stats->checksum_type));
+        record->size = stats->compressed_size;
+    }
 }
 
 void
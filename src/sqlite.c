@@ -39,6 +39,7 @@
 
 struct _DbPrimaryStatements {
     sqlite3 *db;
+    gboolean shard;
     sqlite3_stmt *pkg_handle;
     sqlite3_stmt *provides_handle;
     sqlite3_stmt *conflicts_handle;
@@ -53,12 +54,14 @@ struct _DbPrimaryStatements {
 
 struct _DbFilelistsStatements {
     sqlite3 *db;
+    gboolean shard;
     sqlite3_stmt *package_id_handle;
     sqlite3_stmt *filelists_handle;
 };
 
 struct _DbOtherStatements {
     sqlite3 *db;
+    gboolean shard;
     sqlite3_stmt *package_id_handle;
     sqlite3_stmt *changelog_handle;
 };
@@ -590,7 +593,7 @@ cr_db_dbinfo_update(cr_SqliteDb *sqlitedb, const char *checksum, GError **err)
 
 
 static sqlite3_stmt *
-db_package_prepare (sqlite3 *db, GError **err)
+db_package_prepare (sqlite3 *db, gboolean shard, GError **err)
 {
     int rc;
     sqlite3_stmt *handle = NULL;
@@ -598,15 +601,27 @@ db_package_prepare (sqlite3 *db, GError **err)
 
     assert(!err || *err == NULL);
 
-    query =
-        "INSERT INTO packages ("
-        "  pkgId, name, arch, version, epoch, release, summary, description,"
-        "  url, time_file, time_build, rpm_license, rpm_vendor, rpm_group,"
-        "  rpm_buildhost, rpm_sourcerpm, rpm_header_start, rpm_header_end,"
-        "  rpm_packager, size_package, size_installed, size_archive,"
-        "  location_href, location_base, checksum_type) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?,"
-        "  ?, ?, ?, ?, ?, ?, ?)";
+    if (shard)
+        // pkgKey is assigned by the caller to keep keys unique across shards
+        query =
+            "INSERT INTO packages ("
+            "  pkgId, name, arch, version, epoch, release, summary, description,"
+            "  url, time_file, time_build, rpm_license, rpm_vendor, rpm_group,"
+            "  rpm_buildhost, rpm_sourcerpm, rpm_header_start, rpm_header_end,"
+            "  rpm_packager, size_package, size_installed, size_archive,"
+            "  location_href, location_base, checksum_type, pkgKey) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?,"
+            "  ?, ?, ?, ?, ?, ?, ?, ?)";
+    else
+        query =
+            "INSERT INTO packages ("
+            "  pkgId, name, arch, version, epoch, release, summary, description,"
+            "  url, time_file, time_build, rpm_license, rpm_vendor, rpm_group,"
+            "  rpm_buildhost, rpm_sourcerpm, rpm_header_start, rpm_header_end,"
+            "  rpm_packager, size_package, size_installed, size_archive,"
+            "  location_href, location_base, checksum_type) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?,"
+            "  ?, ?, ?, ?, ?, ?, ?)";
 
     rc = sqlite3_prepare_v2 (db, query, -1, &handle, NULL);
     if (rc != SQLITE_OK) {
@@ -642,6 +657,7 @@ force_null(const char *str)
 static void
 db_package_write (sqlite3 *db,
                   sqlite3_stmt *handle,
+                  gboolean shard,
                   cr_Package *p,
                   GError **err)
 {
@@ -674,6 +690,8 @@ db_package_write (sqlite3 *db,
     cr_sqlite3_bind_text (handle, 23, p->location_href, -1, SQLITE_STATIC);
     cr_sqlite3_bind_text (handle, 24, force_null(p->location_base), -1, SQLITE_STATIC);  // {null}
     cr_sqlite3_bind_text (handle, 25, p->checksum_type, -1, SQLITE_STATIC);
+    if (shard)
+        sqlite3_bind_int64(handle, 26, p->pkgKey);
 
     rc = sqlite3_step (handle);
     sqlite3_reset (handle);
@@ -1021,7 +1039,7 @@ db_changelog_prepare (sqlite3 *db, GError **err)
 
 
 static sqlite3_stmt *
-db_package_ids_prepare(sqlite3 *db, GError **err)
+db_package_ids_prepare(sqlite3 *db, gboolean shard, GError **err)
 {
     int rc;
     sqlite3_stmt *handle = NULL;
@@ -1029,7 +1047,10 @@ db_package_ids_prepare(sqlite3 *db, GError **err)
 
     assert(!err || *err == NULL);
 
-    query = "INSERT INTO packages (pkgId) VALUES (?)";
+    if (shard)
+        query = "INSERT INTO packages (pkgId, pkgKey) VALUES (?, ?)";
+    else
+        query = "INSERT INTO packages (pkgId) VALUES (?)";
     rc = sqlite3_prepare_v2 (db, query, -1, &handle, NULL);
     if (rc != SQLITE_OK) {
         g_set_error(err, ERR_DOMAIN, CRE_DB,
@@ -1045,6 +1066,7 @@ db_package_ids_prepare(sqlite3 *db, GError **err)
 static void
 db_package_ids_write(sqlite3 *db,
                      sqlite3_stmt *handle,
+                     gboolean shard,
                      cr_Package *pkg,
                      GError **err)
 {
@@ -1053,6 +1075,8 @@ db_package_ids_write(sqlite3 *db,
     assert(!err || *err == NULL);
 
     cr_sqlite3_bind_text (handle, 1,  pkg->pkgId, -1, SQLITE_STATIC);
+    if (shard)
+        sqlite3_bind_int64(handle, 2, pkg->pkgKey);
     rc = sqlite3_step (handle);
     sqlite3_reset (handle);
 
@@ -1105,7 +1129,7 @@ cr_db_destroy_primary_statements(cr_DbPrimaryStatements stmts)
 
 
 cr_DbPrimaryStatements
-cr_db_prepare_primary_statements(sqlite3 *db, GError **err)
+cr_db_prepare_primary_statements(sqlite3 *db, gboolean shard, GError **err)
 {
     assert(!err || *err == NULL);
 
@@ -1113,6 +1137,7 @@ cr_db_prepare_primary_statements(sqlite3 *db, GError **err)
     cr_DbPrimaryStatements ret = malloc(sizeof(*ret));
 
     ret->db                 = db;
+    ret->shard              = shard;
     ret->pkg_handle         = NULL;
     ret->provides_handle    = NULL;
     ret->conflicts_handle   = NULL;
@@ -1124,7 +1149,7 @@ cr_db_prepare_primary_statements(sqlite3 *db, GError **err)
     ret->supplements_handle = NULL;
     ret->files_handle       = NULL;
 
-    ret->pkg_handle = db_package_prepare(db, &tmp_err);
+    ret->pkg_handle = db_package_prepare(db, shard, &tmp_err);
     if (tmp_err) {
         g_propagate_error(err, tmp_err);
         goto error;
@@ -1202,7 +1227,7 @@ cr_db_add_primary_pkg(cr_DbPrimaryStatements stmts,
 
     assert(!err || *err == NULL);
 
-    db_package_write(stmts->db, stmts->pkg_handle, pkg, &tmp_err);
+    db_package_write(stmts->db, stmts->pkg_handle, stmts->shard, pkg, &tmp_err);
     if (tmp_err) {
         g_propagate_error(err, tmp_err);
         return;
@@ -1341,7 +1366,7 @@ cr_db_destroy_filelists_statements(cr_DbFilelistsStatements stmts)
 
 
 cr_DbFilelistsStatements
-cr_db_prepare_filelists_statements(sqlite3 *db, GError **err)
+cr_db_prepare_filelists_statements(sqlite3 *db, gboolean shard, GError **err)
 {
     GError *tmp_err = NULL;
     cr_DbFilelistsStatements ret = malloc(sizeof(*ret));
@@ -1349,10 +1374,11 @@ cr_db_prepare_filelists_statements(sqlite3 *db, GError **err)
     assert(!err || *err == NULL);
 
     ret->db                = db;
+    ret->shard             = shard;
     ret->package_id_handle = NULL;
     ret->filelists_handle  = NULL;
 
-    ret->package_id_handle = db_package_ids_prepare(db, &tmp_err);
+    ret->package_id_handle = db_package_ids_prepare(db, shard, &tmp_err);
     if (tmp_err) {
         g_propagate_error(err, tmp_err);
         goto error;
@@ -1382,7 +1408,8 @@ cr_db_add_filelists_pkg(cr_DbFilelistsStatements stmts,
     assert(!err || *err == NULL);
 
     // Add record into the package table
-    db_package_ids_write(stmts->db, stmts->package_id_handle, pkg, &tmp_err);
+    db_package_ids_write(stmts->db, stmts->package_id_handle, stmts->shard,
+                         pkg, &tmp_err);
     if (tmp_err) {
         g_propagate_error(err, tmp_err);
         return;
@@ -1428,7 +1455,7 @@ cr_db_destroy_other_statements(cr_DbOtherStatements stmts)
 
 
 cr_DbOtherStatements
-cr_db_prepare_other_statements(sqlite3 *db, GError **err)
+cr_db_prepare_other_statements(sqlite3 *db, gboolean shard, GError **err)
 {
     GError *tmp_err = NULL;
     cr_DbOtherStatements ret = malloc(sizeof(*ret));
@@ -1436,10 +1463,11 @@ cr_db_prepare_other_statements(sqlite3 *db, GError **err)
     assert(!err || *err == NULL);
 
     ret->db                = db;
+    ret->shard             = shard;
     ret->package_id_handle = NULL;
     ret->changelog_handle  = NULL;
 
-    ret->package_id_handle = db_package_ids_prepare(db, &tmp_err);
+    ret->package_id_handle = db_package_ids_prepare(db, shard, &tmp_err);
     if (tmp_err) {
         g_propagate_error(err, tmp_err);
         goto error;
@@ -1472,7 +1500,8 @@ cr_db_add_other_pkg(cr_DbOtherStatements stmts, cr_Package *pkg, GError **err)
     sqlite3_stmt *handle = stmts->changelog_handle;
 
     // Add package record into the packages table
-    db_package_ids_write(stmts->db, stmts->package_id_handle, pkg, &tmp_err);
+    db_package_ids_write(stmts->db, stmts->package_id_handle, stmts->shard,
+                         pkg, &tmp_err);
     if (tmp_err) {
         g_propagate_error(err, tmp_err);
         return;
@@ -1505,8 +1534,8 @@ cr_db_add_other_pkg(cr_DbOtherStatements stmts, cr_Package *pkg, GError **err)
 // Function from header file (Public interface of the module)
 
 
-cr_SqliteDb *
-cr_db_open(const char *path, cr_DatabaseType db_type, GError **err)
+static cr_SqliteDb *
+db_open(const char *path, cr_DatabaseType db_type, gboolean shard, GError **err)
 {
     cr_SqliteDb *sqlitedb = NULL;
     int exists;
@@ -1591,13 +1620,13 @@ cr_db_open(const char *path, cr_DatabaseType db_type, GError **err)
     // Compile SQL statements
     switch (db_type) {
         case CR_DB_PRIMARY:
-            statements = cr_db_prepare_primary_statements(db, &tmp_err);
+            statements = cr_db_prepare_primary_statements(db, shard, &tmp_err);
             break;
         case CR_DB_FILELISTS:
-            statements = cr_db_prepare_filelists_statements(db, &tmp_err);
+            statements = cr_db_prepare_filelists_statements(db, shard, &tmp_err);
             break;
         case CR_DB_OTHER:
-            statements = cr_db_prepare_other_statements(db, &tmp_err);
+            statements = cr_db_prepare_other_statements(db, shard, &tmp_err);
             break;
         default:
             g_critical("%s: Bad db_type", __func__);
@@ -1615,6 +1644,7 @@ cr_db_open(const char *path, cr_DatabaseType db_type, GError **err)
     sqlitedb       = g_new0(cr_SqliteDb, 1);
     sqlitedb->db   = db;
     sqlitedb->type = db_type;
+    sqlitedb->shard = shard;
 
     switch (db_type) {
         case CR_DB_PRIMARY:
@@ -1637,6 +1667,20 @@ cr_db_open(const char *path, cr_DatabaseType db_type, GError **err)
 }
 
 
+cr_SqliteDb *
+cr_db_open(const char *path, cr_DatabaseType db_type, GError **err)
+{
+    return db_open(path, db_type, FALSE, err);
+}
+
+
+cr_SqliteDb *
+cr_db_open_shard(const char *path, cr_DatabaseType db_type, GError **err)
+{
+    return db_open(path, db_type, TRUE, err);
+}
+
+
 int
 cr_db_close(cr_SqliteDb *sqlitedb, GError **err)
 {
@@ -1647,17 +1691,21 @@ cr_db_close(cr_SqliteDb *sqlitedb, GError **err)
     if (!sqlitedb)
         return CRE_OK;
 
+    // Shards are not indexed, indexes are built once on the merged db
     switch (sqlitedb->type) {
         case CR_DB_PRIMARY:
-            db_index_primary_tables(sqlitedb->db, &tmp_err);
+            if (!sqlitedb->shard)
+                db_index_primary_tables(sqlitedb->db, &tmp_err);
             cr_db_destroy_primary_statements(sqlitedb->statements.pri);
             break;
         case CR_DB_FILELISTS:
-            db_index_filelists_tables(sqlitedb->db, &tmp_err);
+            if (!sqlitedb->shard)
+                db_index_filelists_tables(sqlitedb->db, &tmp_err);
             cr_db_destroy_filelists_statements(sqlitedb->statements.fil);
             break;
         case CR_DB_OTHER:
-            db_index_other_tables(sqlitedb->db, &tmp_err);
+            if (!sqlitedb->shard)
+                db_index_other_tables(sqlitedb->db, &tmp_err);
             cr_db_destroy_other_statements(sqlitedb->statements.oth);
             break;
         default:
@@ -1719,3 +1767,155 @@ cr_db_add_pkg(cr_SqliteDb *sqlitedb, cr_Package *pkg, GError **err)
 
     return CRE_OK;
 }
+
+
+// Merging of shards
+
+
+static const char *db_primary_tables[] = { "packages", "files", "requires",
+    "provides", "conflicts", "obsoletes", "suggests", "enhances",
+    "recommends", "supplements", NULL };
+
+static const char *db_filelists_tables[] = { "packages", "filelist", NULL };
+
+static const char *db_other_tables[] = { "packages", "changelog", NULL };
+
+
+static void
+db_merge_table(sqlite3 *db, const char *table, int shards, GError **err)
+{
+    int rc;
+    char *query;
+    sqlite3_stmt *handle = NULL;
+    GString *columns, *select;
+
+    assert(!err || *err == NULL);
+
+    // Get the column list of the table
+    query = g_strdup_printf("SELECT * FROM main.%s LIMIT 0", table);
+    rc = sqlite3_prepare_v2(db, query, -1, &handle, NULL);
+    g_free(query);
+    if (rc != SQLITE_OK) {
+        g_set_error(err, ERR_DOMAIN, CRE_DB,
+                    "Cannot get columns of table %s: %s",
+                    table, sqlite3_errmsg(db));
+        sqlite3_finalize(handle);
+        return;
+    }
+
+    columns = g_string_new(NULL);
+    for (int i = 0; i < sqlite3_column_count(handle); i++) {
+        if (i > 0)
+            g_string_append(columns, ", ");
+        g_string_append(columns, sqlite3_column_name(handle, i));
+    }
+    sqlite3_finalize(handle);
+
+    // Rows are inserted ordered by the package and by their order
+    // in the shard, which is the order of insertion into a single db
+    select = g_string_new(NULL);
+    g_string_printf(select, "INSERT INTO main.%s (%s) SELECT %s FROM (",
+                    table, columns->str, columns->str);
+    for (int i = 0; i < shards; i++)
+        g_string_append_printf(select,
+                    "%sSELECT %s, rowid AS cr_shard_rowid FROM shard%d.%s",
+                    i ? " UNION ALL " : "", columns->str, i, table);
+    g_string_append(select, ") ORDER BY pkgKey, cr_shard_rowid");
+
+    rc = sqlite3_exec(db, select->str, NULL, NULL, NULL);
+    if (rc != SQLITE_OK)
+        g_set_error(err, ERR_DOMAIN, CRE_DB,
+                    "Cannot merge table %s: %s", table, sqlite3_errmsg(db));
+
+    g_string_free(columns, TRUE);
+    g_string_free(select, TRUE);
+}
+
+
+int
+cr_db_merge_shards(cr_SqliteDb *sqlitedb, char **shard_paths, GError **err)
+{
+    int rc, shards, attached = 0;
+    const char **tables;
+    GError *tmp_err = NULL;
+
+    assert(sqlitedb);
+    assert(!sqlitedb->shard);
+    assert(shard_paths);
+    assert(!err || *err == NULL);
+
+    shards = g_strv_length(shard_paths);
+    if (shards == 0)
+        return CRE_OK;
+
+    if (shards > sqlite3_limit(sqlitedb->db, SQLITE_LIMIT_ATTACHED, -1)) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "Cannot merge %d shards, sqlite supports only %d "
+                    "attached databases", shards,
+                    sqlite3_limit(sqlitedb->db, SQLITE_LIMIT_ATTACHED, -1));
+        return CRE_BADARG;
+    }
+
+    switch (sqlitedb->type) {
+        case CR_DB_PRIMARY:     tables = db_primary_tables;     break;
+        case CR_DB_FILELISTS:   tables = db_filelists_tables;   break;
+        case CR_DB_OTHER:       tables = db_other_tables;       break;
+        default:
+            g_critical("%s: Bad db type", __func__);
+            assert(0);
+            g_set_error(err, ERR_DOMAIN, CRE_ASSERT, "Bad db type");
+            return CRE_ASSERT;
+    }
+
+    // A database cannot be attached inside of a transaction
+    sqlite3_exec(sqlitedb->db, "COMMIT", NULL, NULL, NULL);
+
+    for (; attached < shards; attached++) {
+        sqlite3_stmt *handle = NULL;
+        char *query = g_strdup_printf("ATTACH DATABASE ? AS shard%d", attached);
+        rc = sqlite3_prepare_v2(sqlitedb->db, query, -1, &handle, NULL);
+        g_free(query);
+        if (rc == SQLITE_OK) {
+            sqlite3_bind_text(handle, 1, shard_paths[attached], -1,
+                              SQLITE_STATIC);
+            rc = sqlite3_step(handle);
+        }
+        sqlite3_finalize(handle);
+
+        if (rc != SQLITE_OK && rc != SQLITE_DONE) {
+            g_set_error(&tmp_err, ERR_DOMAIN, CRE_DB,
+                        "Cannot attach shard %s: %s", shard_paths[attached],
+                        sqlite3_errmsg(sqlitedb->db));
+            goto cleanup;
+        }
+    }
+
+    sqlite3_exec(sqlitedb->db, "BEGIN", NULL, NULL, NULL);
+
+    for (int i = 0; tables[i]; i++) {
+        db_merge_table(sqlitedb->db, tables[i], shards, &tmp_err);
+        if (tmp_err)
+            break;
+    }
+
+    sqlite3_exec(sqlitedb->db, tmp_err ? "ROLLBACK" : "COMMIT",
+                 NULL, NULL, NULL);
+
+cleanup:
+    for (int i = 0; i < attached; i++) {
+        char *query = g_strdup_printf("DETACH DATABASE shard%d", i);
+        sqlite3_exec(sqlitedb->db, query, NULL, NULL, NULL);
+        g_free(query);
+    }
+
+    // cr_db_close() expects an open transaction
+    sqlite3_exec(sqlitedb->db, "BEGIN", NULL, NULL, NULL);
+
+    if (tmp_err) {
+        int code = tmp_err->code;
+        g_propagate_error(err, tmp_err);
+        return code;
+    }
+
+    return CRE_OK;
+}
@@ -57,6 +57,8 @@ extern "C" {
  */
 
 #define CR_DB_CACHE_DBVERSION       10      /*!< Version of DB api */
+#define CR_DB_MAX_SHARDS            8       /*!< Max number of shards merged
+                                                 by cr_db_merge_shards() */
 
 /** Database type.
  */
@@ -91,6 +93,8 @@ typedef struct {
         Type of Sqlite database. */
     cr_Statements statements; /*!<
         Compiled SQL statements */
+    gboolean shard; /*!<
+        Database is a shard which will be merged by cr_db_merge_shards() */
 } cr_SqliteDb;
 
 /** Macro over cr_db_open function. Open (create new) primary sqlite sqlite db.
@@ -142,6 +146,20 @@ cr_SqliteDb *cr_db_open(const char *path,
                         cr_DatabaseType db_type,
                         GError **err);
 
+/** Open (create new) a shard of sqlite db.
+ * Shard is a database of the given type without indexes. Packages are
+ * inserted with their pkgKey (it must be set by the caller and be unique
+ * across all shards of the database). Shards are merged into the final
+ * database by cr_db_merge_shards().
+ * @param path                  Path to the db file.
+ * @param db_type               Type of database (primary, filelists, other)
+ * @param err                   **GError
+ * @return                      Opened db or NULL on error
+ */
+cr_SqliteDb *cr_db_open_shard(const char *path,
+                              cr_DatabaseType db_type,
+                              GError **err);
+
 /** Add package into the database.
  * @param sqlitedb              open db connection
  * @param pkg                   package object
@@ -162,6 +180,20 @@ int cr_db_dbinfo_update(cr_SqliteDb *sqlitedb,
                         const char *checksum,
                         GError **err);
 
+/** Merge closed shards into the (empty) database.
+ * Rows of all shards are inserted ordered by pkgKey, so the result
+ * is the same as if all the packages were added into the database
+ * directly in the pkgKey order. Indexes are created by cr_db_close().
+ * @param sqlitedb              open db connection
+ * @param shard_paths           NULL terminated list of paths to the shards
+ *                              (max CR_DB_MAX_SHARDS)
+ * @param err                   **GError
+ * @return                      cr_Error code
+ */
+int cr_db_merge_shards(cr_SqliteDb *sqlitedb,
+                       char **shard_paths,
+                       GError **err);
+
 /** Close db.
  *  - creates indexes on tables
  *  - commits transaction
@@ -277,201 +277,125 @@ other_to_sqlite(const gchar *oth_xml_path,
 
 // Main
 
-static gboolean
-xml_to_sqlite(const gchar *pri_xml_path,
-              const gchar *fil_xml_path,
-              const gchar *oth_xml_path,
-              cr_SqliteDb *pri_db,
-              cr_SqliteDb *fil_db,
-              cr_SqliteDb *oth_db,
-              GError **err)
+/** All the work for one of the databases. The databases are completely
+ * independent, so the tasks run in parallel and every database is
+ * compressed as soon as its own XML is processed.
+ */
+typedef struct {
+    const gchar         *name;          /*!< "primary", "filelists", "other" */
+    gboolean            (*to_sqlite)(const gchar *, cr_SqliteDb *, GError **);
+    const gchar         *xml_path;      /*!< Input XML or NULL */
+    cr_SqliteDb         *db;            /*!< Opened DB (closed by the task) */
+    const gchar         *db_filename;   /*!< Path to the uncompressed DB */
+    const gchar         *xml_checksum;  /*!< Checksum of the XML (from the
+                                             repomd.xml) or NULL */
+    gchar               *out_filename;  /*!< Path to the compressed DB */
+    cr_CompressionType  compression_type;
+    cr_ChecksumType     checksum_type;
+    cr_RepomdRecord     *rec;           /*!< Record of the compressed DB */
+    GError              *err;           /*!< Error */
+} SqliteDbTask;
+
+static void
+sqlite_db_thread(gpointer data, G_GNUC_UNUSED gpointer user_data)
 {
-    gboolean ret;
+    SqliteDbTask *task = data;
+    cr_ContentStat *stat;
+    gchar *rec_type;
 
-    if (pri_xml_path && pri_db) {
-        ret = primary_to_sqlite(pri_xml_path,
-                                pri_db,
-                                err);
-        if (!ret)
-            return FALSE;
-        g_debug("Primary sqlite done");
+    // XML to Sqlite
+    if (task->xml_path) {
+        if (!task->to_sqlite(task->xml_path, task->db, &task->err))
+            goto close_db;
+        g_debug("%s sqlite done", task->name);
     }
 
-    if (fil_xml_path && fil_db) {
-        ret = filelists_to_sqlite(fil_xml_path,
-                                  fil_db,
-                                  err);
-        if (!ret)
-            return FALSE;
-        g_debug("Filelists sqlite done");
+    // Put checksum of the XML file into Sqlite
+    if (task->xml_checksum)
+        cr_db_dbinfo_update(task->db, task->xml_checksum, &task->err);
+
+close_db:
+    cr_db_close(task->db, task->err ? NULL : &task->err);
+    task->db = NULL;
+    if (task->err)
+        return;
+
+    // Compress the DB
+    stat = cr_contentstat_new(task->checksum_type, &task->err);
+    if (!stat)
+        return;
+
+    cr_compress_file_with_stat(task->db_filename,
+                               &task->out_filename,
+                               task->compression_type,
+                               stat,
+                               NULL,
+                               FALSE,
+                               &task->err);
+
+    // Remove the uncompressed DB
+    cr_rm(task->db_filename, CR_RM_FORCE, NULL, NULL);
+
+    if (task->err) {
+        cr_contentstat_free(stat, NULL);
+        return;
     }
 
-    if (oth_xml_path && oth_db) {
-        ret = other_to_sqlite(oth_xml_path,
-                              oth_db,
-                              err);
-        if (!ret)
-            return FALSE;
-        g_debug("Other sqlite done");
-    }
+    // Fill the repomd record from stats gathered during compression
+    rec_type = g_strconcat(task->name, "_db", NULL);
+    task->rec = cr_repomd_record_new(rec_type, task->out_filename);
+    g_free(rec_type);
+    cr_repomd_record_load_contentstat(task->rec, stat);
+    cr_contentstat_free(stat, NULL);
 
-    return TRUE;
+    cr_repomd_record_fill(task->rec, task->checksum_type, &task->err);
+    g_debug("%s sqlite compressed", task->name);
 }
 
 static gboolean
-sqlite_dbinfo_update(cr_Repomd *repomd,
-                     cr_SqliteDb *pri_db,
-                     cr_SqliteDb *fil_db,
-                     cr_SqliteDb *oth_db,
-                     GError **err)
+xml_to_compressed_sqlite(const gchar *tmp_out_repo,
+                         cr_Repomd *repomd,
+                         SqliteDbTask *tasks,
+                         int task_count,
+                         cr_CompressionType compression_type,
+                         cr_ChecksumType checksum_type,
+                         GError **err)
 {
-    cr_RepomdRecord *rec = NULL;
+    GThreadPool *pool;
+    gboolean ret = TRUE;
 
-    // Parse repomd.xml
-    // Get files checksums and insert them into sqlite dbs
-    if (pri_db) {
-        rec = cr_repomd_get_record(repomd, "primary");
-        if (rec && rec->checksum)
-            if (cr_db_dbinfo_update(pri_db, rec->checksum, err) != CRE_OK)
-                return FALSE;
-    }
+    pool = g_thread_pool_new(sqlite_db_thread, NULL, task_count, FALSE, NULL);
 
-    if (fil_db) {
-        rec = cr_repomd_get_record(repomd, "filelists");
-        if (rec && rec->checksum)
-            if (cr_db_dbinfo_update(fil_db, rec->checksum, err) != CRE_OK)
-                return FALSE;
-    }
+    for (int i = 0; i < task_count; i++) {
+        SqliteDbTask *task = &tasks[i];
+        cr_RepomdRecord *rec = cr_repomd_get_record(repomd, task->name);
 
-    if (oth_db) {
-        rec = cr_repomd_get_record(repomd, "other");
-        if (rec && rec->checksum)
-            if (cr_db_dbinfo_update(oth_db, rec->checksum, err) != CRE_OK)
-                return FALSE;
+        task->xml_checksum = rec ? rec->checksum : NULL;
+        task->out_filename = g_strconcat(tmp_out_repo, "/", task->name,
+                                         ".sqlite",
+                                         cr_compression_suffix(compression_type),
+                                         NULL);
+        task->compression_type = compression_type;
+        task->checksum_type = checksum_type;
+        g_thread_pool_push(pool, task, NULL);
     }
 
-    return TRUE;
-}
-
-static gboolean
-compress_sqlite_dbs(const gchar *tmp_out_repo,
-                    const gchar *pri_db_filename,
-                    cr_RepomdRecord **in_pri_db_rec,
-                    const gchar *fil_db_filename,
-                    cr_RepomdRecord **in_fil_db_rec,
-                    const gchar *oth_db_filename,
-                    cr_RepomdRecord **in_oth_db_rec,
-                    cr_CompressionType compression_type,
-                    cr_ChecksumType checksum_type)
-{
-    cr_CompressionTask *pri_db_task;
-    cr_CompressionTask *fil_db_task;
-    cr_CompressionTask *oth_db_task;
-    const char *sqlite_compression_suffix;
-    cr_RepomdRecord *pri_db_rec = NULL;
-    cr_RepomdRecord *fil_db_rec = NULL;
-    cr_RepomdRecord *oth_db_rec = NULL;
-
-    // Prepare thread pool for compression tasks
-    GThreadPool *compress_pool =  g_thread_pool_new(cr_compressing_thread,
-                                                    NULL, 3, FALSE, NULL);
-
-    // Prepare output filenames
-    sqlite_compression_suffix = cr_compression_suffix(compression_type);
-    gchar *pri_db_name = g_strconcat(tmp_out_repo, "/primary.sqlite",
-                                     sqlite_compression_suffix, NULL);
-    gchar *fil_db_name = g_strconcat(tmp_out_repo, "/filelists.sqlite",
-                                     sqlite_compression_suffix, NULL);
-    gchar *oth_db_name = g_strconcat(tmp_out_repo, "/other.sqlite",
-                                     sqlite_compression_suffix, NULL);
-
-    // Prepare compression tasks
-    pri_db_task = cr_compressiontask_new(pri_db_filename,
-                                         pri_db_name,
-                                         compression_type,
-                                         checksum_type,
-                                         NULL, FALSE, 1, NULL);
-    g_thread_pool_push(compress_pool, pri_db_task, NULL);
-
-    fil_db_task = cr_compressiontask_new(fil_db_filename,
-                                         fil_db_name,
-                                         compression_type,
-                                         checksum_type,
-                                         NULL, FALSE, 1, NULL);
-    g_thread_pool_push(compress_pool, fil_db_task, NULL);
-
-    oth_db_task = cr_compressiontask_new(oth_db_filename,
-                                         oth_db_name,
-                                         compression_type,
-                                         checksum_type,
-                                         NULL, FALSE, 1, NULL);
-    g_thread_pool_push(compress_pool, oth_db_task, NULL);
-
     // Wait till all tasks are complete and free the thread pool
-    g_thread_pool_free(compress_pool, FALSE, TRUE);
-
-    // Remove uncompressed DBs
-    cr_rm(pri_db_filename, CR_RM_FORCE, NULL, NULL);
-    cr_rm(fil_db_filename, CR_RM_FORCE, NULL, NULL);
-    cr_rm(oth_db_filename, CR_RM_FORCE, NULL, NULL);
-
-    // Prepare repomd records
-    pri_db_rec = cr_repomd_record_new("primary_db", pri_db_name);
-    fil_db_rec = cr_repomd_record_new("filelists_db", fil_db_name);
-    oth_db_rec = cr_repomd_record_new("other_db", oth_db_name);
-
-    *in_pri_db_rec = pri_db_rec;
-    *in_fil_db_rec = fil_db_rec;
-    *in_oth_db_rec = oth_db_rec;
-
-    // Free paths to compressed files
-    g_free(pri_db_name);
-    g_free(fil_db_name);
-    g_free(oth_db_name);
-
-    // Fill repomd records from stats gathered during compression
-    cr_repomd_record_load_contentstat(pri_db_rec, pri_db_task->stat);
-    cr_repomd_record_load_contentstat(fil_db_rec, fil_db_task->stat);
-    cr_repomd_record_load_contentstat(oth_db_rec, oth_db_task->stat);
-
-    // Free the compression tasks
-    cr_compressiontask_free(pri_db_task, NULL);
-    cr_compressiontask_free(fil_db_task, NULL);
-    cr_compressiontask_free(oth_db_task, NULL);
-
-    // Prepare thread pool for repomd record filling tasks
-    GThreadPool *fill_pool = g_thread_pool_new(cr_repomd_record_fill_thread,
-                                               NULL, 3, FALSE, NULL);
-
-    // Prepare the tasks themselves
-    cr_RepomdRecordFillTask *pri_db_fill_task;
-    cr_RepomdRecordFillTask *fil_db_fill_task;
-    cr_RepomdRecordFillTask *oth_db_fill_task;
-
-    pri_db_fill_task = cr_repomdrecordfilltask_new(pri_db_rec,
-                                                   checksum_type,
-                                                   NULL);
-    g_thread_pool_push(fill_pool, pri_db_fill_task, NULL);
-
-    fil_db_fill_task = cr_repomdrecordfilltask_new(fil_db_rec,
-                                                   checksum_type,
-                                                   NULL);
-    g_thread_pool_push(fill_pool, fil_db_fill_task, NULL);
-
-    oth_db_fill_task = cr_repomdrecordfilltask_new(oth_db_rec,
-                                                   checksum_type,
-                                                   NULL);
-    g_thread_pool_push(fill_pool, oth_db_fill_task, NULL);
-
-    // Wait till the all tasks are finished and free the pool
-    g_thread_pool_free(fill_pool, FALSE, TRUE);
-
-    // Clear the tasks
-    cr_repomdrecordfilltask_free(pri_db_fill_task, NULL);
-    cr_repomdrecordfilltask_free(fil_db_fill_task, NULL);
-    cr_repomdrecordfilltask_free(oth_db_fill_task, NULL);
+    g_thread_pool_free(pool, FALSE, TRUE);
+
+    for (int i = 0; i < task_count; i++) {
+        if (tasks[i].err && ret) {
+            g_propagate_prefixed_error(err, tasks[i].err, "%s: ",
+                                       tasks[i].name);
+            tasks[i].err = NULL;
+            ret = FALSE;
+        }
+        g_clear_error(&tasks[i].err);
+        g_free(tasks[i].out_filename);
+        tasks[i].out_filename = NULL;
+    }
 
-    return TRUE;
+    return ret;
 }
 
 static gboolean
@@ -884,48 +808,38 @@ generate_sqlite_from_xml(const gchar *path,
     if (!oth_db)
         return FALSE;
 
-    // XML to Sqlite
-    ret = xml_to_sqlite(pri_xml_path,
-                        fil_xml_path,
-                        oth_xml_path,
-                        pri_db,
-                        fil_db,
-                        oth_db,
-                        err);
-    if (!ret)
-        return FALSE;
-
-    // Put checksums of XML files into Sqlite
-    ret = sqlite_dbinfo_update(repomd,
-                               pri_db,
-                               fil_db,
-                               oth_db,
-                               err);
-    if (!ret)
-        return FALSE;
+    // XML to Sqlite, compress DB files and fill records
+    SqliteDbTask tasks[] = {
+        { .name = "primary", .to_sqlite = primary_to_sqlite,
+          .xml_path = pri_xml_path, .db = pri_db,
+          .db_filename = pri_db_filename },
+        { .name = "filelists", .to_sqlite = filelists_to_sqlite,
+          .xml_path = fil_xml_path, .db = fil_db,
+          .db_filename = fil_db_filename },
+        { .name = "other", .to_sqlite = other_to_sqlite,
+          .xml_path = oth_xml_path, .db = oth_db,
+          .db_filename = oth_db_filename },
+    };
 
-    // Close dbs
-    cr_db_close(pri_db, NULL);
-    cr_db_close(fil_db, NULL);
-    cr_db_close(oth_db, NULL);
+    ret = xml_to_compressed_sqlite(tmp_out_repo,
+                                   repomd,
+                                   tasks,
+                                   G_N_ELEMENTS(tasks),
+                                   compression_type,
+                                   checksum_type,
+                                   err);
 
     // Repomd records
-    cr_RepomdRecord *pri_db_rec = NULL;
-    cr_RepomdRecord *fil_db_rec = NULL;
-    cr_RepomdRecord *oth_db_rec = NULL;
+    cr_RepomdRecord *pri_db_rec = tasks[0].rec;
+    cr_RepomdRecord *fil_db_rec = tasks[1].rec;
+    cr_RepomdRecord *oth_db_rec = tasks[2].rec;
 
-    // Compress DB files and fill records
-    ret = compress_sqlite_dbs(tmp_out_repo,
-                              pri_db_filename,
-                              &pri_db_rec,
-                              fil_db_filename,
-                              &fil_db_rec,
-                              oth_db_filename,
-                              &oth_db_rec,
-                              compression_type,
-                              checksum_type);
-    if (!ret)
+    if (!ret) {
+        cr_repomd_record_free(pri_db_rec);
+        cr_repomd_record_free(fil_db_rec);
+        cr_repomd_record_free(oth_db_rec);
         return FALSE;
+    }
 
     // Prepare new repomd.xml
     ret = gen_new_repomd(tmp_out_repo,
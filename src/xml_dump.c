@@ -198,6 +198,257 @@ cr_xml_dump_files(xmlNodePtr node, cr_Package *package, int primary)
     }
 }
 
+static void
+cr_xml_dump_buffer_free(gpointer buf)
+{
+    g_string_free((GString *) buf, TRUE);
+}
+
+static GPrivate dump_buffer = G_PRIVATE_INIT(cr_xml_dump_buffer_free);
+
+GString *
+cr_xml_dump_buffer_get(void)
+{
+    GString *buf = g_private_get(&dump_buffer);
+    if (!buf) {
+        buf = g_string_sized_new(4096);
+        g_private_set(&dump_buffer, buf);
+    }
+    g_string_truncate(buf, 0);
+    return buf;
+}
+
+char *
+cr_xml_dump_buffer_finish(GString *buf)
+{
+    char *result;
+
+    g_string_append_c(buf, '\n');
+    result = g_strndup(buf->str, buf->len);
+
+    // Do not keep huge buffers (e.g. after a package with a giant filelist)
+    if (buf->allocated_len > CR_XML_DUMP_BUFFER_KEEP_SIZE)
+        g_private_replace(&dump_buffer, NULL);
+
+    return result;
+}
+
+/** Return content in UTF-8. If the conversion was needed, the *tofree
+ * is set to the newly allocated string.
+ */
+static const unsigned char *
+cr_xml_utf8_content(const char *orig_content, unsigned char **tofree)
+{
+    unsigned char *content;
+
+    *tofree = NULL;
+    if (!orig_content)
+        return BAD_CAST "";
+    if (xmlCheckUTF8(BAD_CAST orig_content))
+        return BAD_CAST orig_content;
+
+    content = g_malloc(sizeof(unsigned char) * strlen(orig_content) * 2 + 1);
+    cr_latin1_to_utf8(BAD_CAST orig_content, content);
+    *tofree = content;
+    return content;
+}
+
+/** Escape text content the same way as libxml2 does it for text nodes
+ * serialized with UTF-8 encoding.
+ */
+static void
+cr_xml_append_escaped_text(GString *buf, const unsigned char *str)
+{
+    const unsigned char *base = str;
+
+    for (; *str; str++) {
+        const char *repl;
+        switch (*str) {
+            case '<':  repl = "&lt;";  break;
+            case '>':  repl = "&gt;";  break;
+            case '&':  repl = "&amp;"; break;
+            case '\r': repl = "&#13;"; break;
+            default:   continue;
+        }
+        g_string_append_len(buf, (const char *) base, str - base);
+        g_string_append(buf, repl);
+        base = str + 1;
+    }
+
+    g_string_append_len(buf, (const char *) base, str - base);
+}
+
+static inline gboolean
+cr_xml_is_char(int val)
+{
+    if (val < 0x100)
+        return (val >= 0x9 && val <= 0xa) || val == 0xd || val >= 0x20;
+    return (val <= 0xd7ff)
+           || (val >= 0xe000 && val <= 0xfffd)
+           || (val >= 0x10000 && val <= 0x10ffff);
+}
+
+/** Escape attribute value the same way as libxml2 does it for attributes
+ * of nodes without a document (non ASCII chars are serialized
+ * as hexadecimal character references).
+ */
+static void
+cr_xml_append_escaped_attr(GString *buf, const unsigned char *str)
+{
+    const unsigned char *base = str;
+
+    while (*str) {
+        const char *repl = NULL;
+        switch (*str) {
+            case '\n': repl = "&#10;";  break;
+            case '\r': repl = "&#13;";  break;
+            case '\t': repl = "&#9;";   break;
+            case '"':  repl = "&quot;"; break;
+            case '<':  repl = "&lt;";   break;
+            case '>':  repl = "&gt;";   break;
+            case '&':  repl = "&amp;";  break;
+            default:   break;
+        }
+
+        if (repl) {
+            g_string_append_len(buf, (const char *) base, str - base);
+            g_string_append(buf, repl);
+            base = ++str;
+            continue;
+        }
+
+        if (*str < 0x80 || str[1] == 0) {
+            str++;
+            continue;
+        }
+
+        // Non ASCII char - decode (UTF-8 is expected) and write a char ref
+        int val = 0, len = 1;
+
+        g_string_append_len(buf, (const char *) base, str - base);
+        if (*str < 0xC0) {
+            len = 1;
+        } else if (*str < 0xE0) {
+            val = ((str[0] & 0x1F) << 6) | (str[1] & 0x3F);
+            len = 2;
+        } else if (*str < 0xF0 && str[2] != 0) {
+            val = ((str[0] & 0x0F) << 12) | ((str[1] & 0x3F) << 6)
+                  | (str[2] & 0x3F);
+            len = 3;
+        } else if (*str < 0xF8 && str[2] != 0 && str[3] != 0) {
+            val = ((str[0] & 0x07) << 18) | ((str[1] & 0x3F) << 12)
+                  | ((str[2] & 0x3F) << 6) | (str[3] & 0x3F);
+            len = 4;
+        }
+
+        if (len == 1 || !cr_xml_is_char(val)) {
+            g_string_append_printf(buf, "&#x%X;", *str);
+            len = 1;
+        } else {
+            g_string_append_printf(buf, "&#x%X;", val);
+        }
+
+        str += len;
+        base = str;
+    }
+
+    g_string_append_len(buf, (const char *) base, str - base);
+}
+
+void
+cr_xml_append_text(GString *buf, const char *orig_content)
+{
+    unsigned char *tofree;
+    const unsigned char *content = cr_xml_utf8_content(orig_content, &tofree);
+    cr_xml_append_escaped_text(buf, content);
+    g_free(tofree);
+}
+
+void
+cr_xml_append_prop(GString *buf, const char *name, const char *orig_content)
+{
+    unsigned char *tofree;
+    const unsigned char *content = cr_xml_utf8_content(orig_content, &tofree);
+    g_string_append_c(buf, ' ');
+    g_string_append(buf, name);
+    g_string_append(buf, "=\"");
+    cr_xml_append_escaped_attr(buf, content);
+    g_string_append_c(buf, '"');
+    g_free(tofree);
+}
+
+void
+cr_xml_append_prop_raw(GString *buf, const char *name, const char *value)
+{
+    g_string_append_c(buf, ' ');
+    g_string_append(buf, name);
+    g_string_append(buf, "=\"");
+    if (value)
+        cr_xml_append_escaped_attr(buf, BAD_CAST value);
+    g_string_append_c(buf, '"');
+}
+
+void
+cr_xml_append_prop_int(GString *buf, const char *name, gint64 value)
+{
+    g_string_append_c(buf, ' ');
+    g_string_append(buf, name);
+    g_string_append_printf(buf, "=\"%"G_GINT64_FORMAT"\"", value);
+}
+
+void
+cr_xml_append_text_child(GString *buf,
+                         int level,
+                         const char *name,
+                         const char *content)
+{
+    cr_xml_append_indent(buf, level);
+    g_string_append_c(buf, '<');
+    g_string_append(buf, name);
+    g_string_append_c(buf, '>');
+    cr_xml_append_text(buf, content);
+    g_string_append(buf, "</");
+    g_string_append(buf, name);
+    g_string_append(buf, ">\n");
+}
+
+void
+cr_xml_stream_files(GString *buf, cr_Package *package, int primary, int level)
+{
+    if (!package->files)
+        return;
+
+    // Reused for all files of the package (path + basename)
+    GString *fullname = g_string_sized_new(256);
+
+    GSList *element = NULL;
+    for(element = package->files; element; element=element->next) {
+        cr_PackageFile *entry = (cr_PackageFile*) element->data;
+
+        // File without name or path is suspicious => Skip it
+        if (!(entry->path) || !(entry->name))
+            continue;
+
+        g_string_assign(fullname, entry->path);
+        g_string_append(fullname, entry->name);
+
+        // Skip a file if we want primary files and the file is not one
+        if (primary && !cr_is_primary(fullname->str))
+            continue;
+
+        cr_xml_append_indent(buf, level);
+        g_string_append(buf, "<file");
+        // Write type (skip type if type value is empty of "file")
+        if (entry->type && entry->type[0] != '\0' && strcmp(entry->type, "file"))
+            cr_xml_append_prop(buf, "type", entry->type);
+        g_string_append_c(buf, '>');
+        cr_xml_append_text(buf, fullname->str);
+        g_string_append(buf, "</file>\n");
+    }
+
+    g_string_free(fullname, TRUE);
+}
+
 gboolean
 cr_GSList_of_cr_Dependency_contains_forbidden_control_chars(GSList *dep)
 {
@@ -97,6 +97,19 @@ void cr_xml_dump_cleanup();
  */
 char *cr_xml_dump_primary(cr_Package *package, GError **err);
 
+/** Take an already generated primary xml chunk (e.g. copied from
+ * an existing primary.xml) and replace its location element with the
+ * location_href and location_base of the package. The rest of the chunk
+ * is copied as is.
+ * @param chunk         primary xml chunk of the package
+ * @param package       cr_Package with the new locations
+ * @param err           **GError
+ * @return              xml chunk string or NULL on error
+ */
+char *cr_xml_relocate_primary(const char *chunk,
+                              cr_Package *package,
+                              GError **err);
+
 /** Generate filelists xml chunk from cr_Package.
  * @param package       cr_Package
  * @param err           **GError
@@ -73,11 +73,32 @@ cr_xml_dump_filelists_items(xmlNodePtr root, cr_Package *package)
 }
 
 
+static void
+cr_xml_stream_filelists_items(GString *buf, cr_Package *package)
+{
+    g_string_append(buf, "<package");
+    cr_xml_append_prop(buf, "pkgid", package->pkgId);
+    cr_xml_append_prop(buf, "name", package->name);
+    cr_xml_append_prop(buf, "arch", package->arch);
+    g_string_append(buf, ">\n");
+
+    cr_xml_append_indent(buf, 1);
+    g_string_append(buf, "<version");
+    cr_xml_append_prop(buf, "epoch", package->epoch);
+    cr_xml_append_prop(buf, "ver", package->version);
+    cr_xml_append_prop(buf, "rel", package->release);
+    g_string_append(buf, "/>\n");
+
+    cr_xml_stream_files(buf, package, 0, 1);
+
+    g_string_append(buf, "</package>");
+}
+
+
 char *
 cr_xml_dump_filelists(cr_Package *package, GError **err)
 {
-    xmlNodePtr root;
-    char *result;
+    GString *buf;
 
     assert(!err || *err == NULL);
 
@@ -90,28 +111,7 @@ cr_xml_dump_filelists(cr_Package *package, GError **err)
 
     // Dump IT!
 
-    xmlBufferPtr buf = xmlBufferCreate();
-    if (buf == NULL) {
-        g_critical("%s: Error creating the xml buffer", __func__);
-        g_set_error(err, ERR_DOMAIN, CRE_MEMORY,
-                    "Cannot create an xml buffer");
-        return NULL;
-    }
-
-    root = xmlNewNode(NULL, BAD_CAST "package");
-    cr_xml_dump_filelists_items(root, package);
-    // xmlNodeDump seems to be a little bit faster than xmlDocDumpFormatMemory
-    xmlNodeDump(buf, NULL, root, FORMAT_LEVEL, FORMAT_XML);
-    assert(buf->content);
-    result = g_strndup((char *) buf->content, (buf->use+1));
-    result[buf->use]     = '\n';
-    result[buf->use+1]   = '\0';
-
-
-    // Cleanup
-
-    xmlBufferFree(buf);
-    xmlFreeNode(root);
-
-    return result;
+    buf = cr_xml_dump_buffer_get();
+    cr_xml_stream_filelists_items(buf, package);
+    return cr_xml_dump_buffer_finish(buf);
 }
@@ -42,6 +42,87 @@ extern "C" {
 #define DATESIZE_STR_MAX_LEN    SIZE_STR_MAX_LEN
 #endif
 
+/** Number of spaces used by libxml2 for one level of indentation.
+ */
+#define CR_XML_INDENT_SIZE      2
+
+/** Max allocated size of the per-thread dump buffer which is kept
+ * for the next package. Bigger buffers are released after use.
+ */
+#define CR_XML_DUMP_BUFFER_KEEP_SIZE    (1024*1024)
+
+/*
+ * Streaming XML emitter
+ *
+ * The functions below append XML directly into a GString and produce
+ * exactly the same output as the libxml2 tree build by the cr_xmlNew*
+ * functions serialized by xmlNodeDump(buf, NULL, node, 0, 1).
+ */
+
+/** Return the (emptied) per-thread dump buffer.
+ */
+GString *cr_xml_dump_buffer_get(void);
+
+/** Append a trailing newline to the buffer and return a malloced copy
+ * of its content. The buffer must not be used anymore after this call.
+ */
+char *cr_xml_dump_buffer_finish(GString *buf);
+
+/** Append indentation for the specified level.
+ */
+static inline void
+cr_xml_append_indent(GString *buf, int level)
+{
+    for (int x = 0; x < level * CR_XML_INDENT_SIZE; x++)
+        g_string_append_c(buf, ' ');
+}
+
+/** Append escaped text content. Equivalent of the text node created
+ * by cr_xmlNewTextChild() (NULL is allowed, non UTF-8 content is
+ * converted from iso-8859-1).
+ */
+void cr_xml_append_text(GString *buf, const char *content);
+
+/** Append an attribute. Equivalent of cr_xmlNewProp()
+ * (NULL is allowed, non UTF-8 value is converted from iso-8859-1).
+ */
+void cr_xml_append_prop(GString *buf, const char *name, const char *value);
+
+/** Append an attribute. Equivalent of plain xmlNewProp()
+ * (value is used as is).
+ */
+void cr_xml_append_prop_raw(GString *buf, const char *name, const char *value);
+
+/** Append a numeric attribute.
+ */
+void cr_xml_append_prop_int(GString *buf, const char *name, gint64 value);
+
+/** Append a whole element with a text content and the trailing newline
+ * (e.g. "  <name>foo</name>\n"). Equivalent of cr_xmlNewTextChild().
+ */
+void cr_xml_append_text_child(GString *buf,
+                              int level,
+                              const char *name,
+                              const char *content);
+
+/** Stream version of cr_xml_dump_files().
+ * @param buf           output buffer
+ * @param package       cr_Package
+ * @param primary       process only primary files
+ * @param level         indentation level of the file elements
+ */
+void cr_xml_stream_files(GString *buf,
+                         cr_Package *package,
+                         int primary,
+                         int level);
+
+/** Libxml2 tree builders of the package elements. The dump functions use
+ * the streaming emitter, these are kept as the reference implementation.
+ */
+void cr_xml_dump_primary_base_items(xmlNodePtr root, cr_Package *package);
+void cr_xml_dump_filelists_items(xmlNodePtr root, cr_Package *package);
+void cr_xml_dump_other_items(xmlNodePtr root, cr_Package *package);
+
 /** Dump files from the package and append them to the node as childrens.
  * @param node          parent xml node
  * @param package       cr_Package
@@ -112,11 +112,46 @@ cr_xml_dump_other_items(xmlNodePtr root, cr_Package *package)
 }
 
 
+static void
+cr_xml_stream_other_items(GString *buf, cr_Package *package)
+{
+    g_string_append(buf, "<package");
+    cr_xml_append_prop(buf, "pkgid", package->pkgId);
+    cr_xml_append_prop(buf, "name", package->name);
+    cr_xml_append_prop(buf, "arch", package->arch);
+    g_string_append(buf, ">\n");
+
+    cr_xml_append_indent(buf, 1);
+    g_string_append(buf, "<version");
+    cr_xml_append_prop_raw(buf, "epoch", package->epoch);
+    cr_xml_append_prop_raw(buf, "ver", package->version);
+    cr_xml_append_prop_raw(buf, "rel", package->release);
+    g_string_append(buf, "/>\n");
+
+    GSList *element = NULL;
+    for(element = package->changelogs; element; element=element->next) {
+
+        cr_ChangelogEntry *entry = (cr_ChangelogEntry*) element->data;
+
+        assert(entry);
+
+        cr_xml_append_indent(buf, 1);
+        g_string_append(buf, "<changelog");
+        cr_xml_append_prop(buf, "author", entry->author);
+        cr_xml_append_prop_int(buf, "date", entry->date);
+        g_string_append_c(buf, '>');
+        cr_xml_append_text(buf, entry->changelog);
+        g_string_append(buf, "</changelog>\n");
+    }
+
+    g_string_append(buf, "</package>");
+}
+
+
 char *
 cr_xml_dump_other(cr_Package *package, GError **err)
 {
-    xmlNodePtr root;
-    char *result;
+    GString *buf;
 
     assert(!err || *err == NULL);
 
@@ -129,28 +164,7 @@ cr_xml_dump_other(cr_Package *package, GError **err)
 
     // Dump IT!
 
-    xmlBufferPtr buf = xmlBufferCreate();
-    if (buf == NULL) {
-        g_critical("%s: Error creating the xml buffer", __func__);
-        g_set_error(err, ERR_DOMAIN, CRE_MEMORY,
-                    "Cannot create an xml buffer");
-        return NULL;
-    }
-
-    root = xmlNewNode(NULL, BAD_CAST "package");
-    cr_xml_dump_other_items(root, package);
-    // xmlNodeDump seems to be a little bit faster than xmlDocDumpFormatMemory
-    xmlNodeDump(buf, NULL, root, FORMAT_LEVEL, FORMAT_XML);
-    assert(buf->content);
-    result = g_strndup((char *) buf->content, (buf->use+1));
-    result[buf->use]     = '\n';
-    result[buf->use+1]   = '\0';
-
-
-    // Cleanup
-
-    xmlBufferFree(buf);
-    xmlFreeNode(root);
-
-    return result;
+    buf = cr_xml_dump_buffer_get();
+    cr_xml_stream_other_items(buf, package);
+    return cr_xml_dump_buffer_finish(buf);
 }
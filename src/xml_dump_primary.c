@@ -377,11 +377,168 @@ cr_xml_dump_primary_base_items(xmlNodePtr root, cr_Package *package)
 
 
 
+static void
+cr_xml_stream_primary_pco(GString *buf, cr_Package *package, PcoType pcotype)
+{
+    const char *elem_name;
+    GSList *list = NULL;
+    gboolean has_entries = FALSE;
+
+    if (pcotype >= PCO_TYPE_SENTINEL)
+        return;
+
+    elem_name = pco_info[pcotype].elemname;
+    list = *((GSList **) ((size_t) package + pco_info[pcotype].listoffset));
+
+    if (!list)
+        return;
+
+    cr_xml_append_indent(buf, 2);
+    g_string_append_c(buf, '<');
+    g_string_append(buf, elem_name);
+
+    GSList *element = NULL;
+    for(element = list; element; element=element->next) {
+
+        cr_Dependency *entry = (cr_Dependency*) element->data;
+
+        assert(entry);
+
+        if (!entry->name || entry->name[0] == '\0') {
+            continue;
+        }
+
+        if (!has_entries) {
+            g_string_append(buf, ">\n");
+            has_entries = TRUE;
+        }
+
+        cr_xml_append_indent(buf, 3);
+        g_string_append(buf, "<rpm:entry");
+        cr_xml_append_prop(buf, "name", entry->name);
+
+        if (entry->flags && entry->flags[0] != '\0') {
+            cr_xml_append_prop(buf, "flags", entry->flags);
+
+            if (entry->epoch && entry->epoch[0] != '\0')
+                cr_xml_append_prop(buf, "epoch", entry->epoch);
+
+            if (entry->version && entry->version[0] != '\0')
+                cr_xml_append_prop(buf, "ver", entry->version);
+
+            if (entry->release && entry->release[0] != '\0')
+                cr_xml_append_prop(buf, "rel", entry->release);
+        }
+
+        if (pcotype == PCO_TYPE_REQUIRES && entry->pre)
+            g_string_append(buf, " pre=\"1\"");
+
+        g_string_append(buf, "/>\n");
+    }
+
+    if (has_entries) {
+        cr_xml_append_indent(buf, 2);
+        g_string_append(buf, "</");
+        g_string_append(buf, elem_name);
+        g_string_append(buf, ">\n");
+    } else {
+        // Element without any child
+        g_string_append(buf, "/>\n");
+    }
+}
+
+static void
+cr_xml_stream_primary_location(GString *buf, cr_Package *package)
+{
+    g_string_append(buf, "<location");
+    if (package->location_base && package->location_base[0] != '\0') {
+        gchar *location_base_with_protocol = NULL;
+        location_base_with_protocol = cr_prepend_protocol(package->location_base);
+        cr_xml_append_prop(buf, "xml:base", location_base_with_protocol);
+        g_free(location_base_with_protocol);
+    }
+    cr_xml_append_prop(buf, "href", package->location_href);
+    g_string_append(buf, "/>");
+}
+
+static void
+cr_xml_stream_primary_items(GString *buf, cr_Package *package)
+{
+    g_string_append(buf, "<package type=\"rpm\">\n");
+
+    cr_xml_append_text_child(buf, 1, "name", package->name);
+    cr_xml_append_text_child(buf, 1, "arch", package->arch);
+
+    cr_xml_append_indent(buf, 1);
+    g_string_append(buf, "<version");
+    cr_xml_append_prop(buf, "epoch", package->epoch);
+    cr_xml_append_prop(buf, "ver", package->version);
+    cr_xml_append_prop(buf, "rel", package->release);
+    g_string_append(buf, "/>\n");
+
+    cr_xml_append_indent(buf, 1);
+    g_string_append(buf, "<checksum");
+    cr_xml_append_prop(buf, "type", package->checksum_type);
+    g_string_append(buf, " pkgid=\"YES\">");
+    cr_xml_append_text(buf, package->pkgId);
+    g_string_append(buf, "</checksum>\n");
+
+    cr_xml_append_text_child(buf, 1, "summary", package->summary);
+    cr_xml_append_text_child(buf, 1, "description", package->description);
+    cr_xml_append_text_child(buf, 1, "packager", package->rpm_packager);
+    cr_xml_append_text_child(buf, 1, "url", package->url);
+
+    cr_xml_append_indent(buf, 1);
+    g_string_append(buf, "<time");
+    cr_xml_append_prop_int(buf, "file", package->time_file);
+    cr_xml_append_prop_int(buf, "build", package->time_build);
+    g_string_append(buf, "/>\n");
+
+    cr_xml_append_indent(buf, 1);
+    g_string_append(buf, "<size");
+    cr_xml_append_prop_int(buf, "package", package->size_package);
+    cr_xml_append_prop_int(buf, "installed", package->size_installed);
+    cr_xml_append_prop_int(buf, "archive", package->size_archive);
+    g_string_append(buf, "/>\n");
+
+    cr_xml_append_indent(buf, 1);
+    cr_xml_stream_primary_location(buf, package);
+    g_string_append_c(buf, '\n');
+
+    cr_xml_append_indent(buf, 1);
+    g_string_append(buf, "<format>\n");
+
+    cr_xml_append_text_child(buf, 2, "rpm:license", package->rpm_license);
+    cr_xml_append_text_child(buf, 2, "rpm:vendor", package->rpm_vendor);
+    cr_xml_append_text_child(buf, 2, "rpm:group", package->rpm_group);
+    cr_xml_append_text_child(buf, 2, "rpm:buildhost", package->rpm_buildhost);
+    cr_xml_append_text_child(buf, 2, "rpm:sourcerpm", package->rpm_sourcerpm);
+
+    cr_xml_append_indent(buf, 2);
+    g_string_append(buf, "<rpm:header-range");
+    cr_xml_append_prop_int(buf, "start", package->rpm_header_start);
+    cr_xml_append_prop_int(buf, "end", package->rpm_header_end);
+    g_string_append(buf, "/>\n");
+
+    cr_xml_stream_primary_pco(buf, package, PCO_TYPE_PROVIDES);
+    cr_xml_stream_primary_pco(buf, package, PCO_TYPE_REQUIRES);
+    cr_xml_stream_primary_pco(buf, package, PCO_TYPE_CONFLICTS);
+    cr_xml_stream_primary_pco(buf, package, PCO_TYPE_OBSOLETES);
+    cr_xml_stream_primary_pco(buf, package, PCO_TYPE_SUGGESTS);
+    cr_xml_stream_primary_pco(buf, package, PCO_TYPE_ENHANCES);
+    cr_xml_stream_primary_pco(buf, package, PCO_TYPE_RECOMMENDS);
+    cr_xml_stream_primary_pco(buf, package, PCO_TYPE_SUPPLEMENTS);
+    cr_xml_stream_files(buf, package, 1, 2);
+
+    cr_xml_append_indent(buf, 1);
+    g_string_append(buf, "</format>\n");
+    g_string_append(buf, "</package>");
+}
+
 char *
 cr_xml_dump_primary(cr_Package *package, GError **err)
 {
-    xmlNodePtr root;
-    char *result;
+    GString *buf;
 
     assert(!err || *err == NULL);
 
@@ -393,29 +550,80 @@ cr_xml_dump_primary(cr_Package *package, GError **err)
 
     // Dump IT!
 
-    xmlBufferPtr buf = xmlBufferCreate();
-    if (buf == NULL) {
-        g_critical("%s: Error creating the xml buffer", __func__);
-        g_set_error(err, ERR_DOMAIN, CRE_MEMORY,
-                    "Cannot create an xml buffer");
-        return NULL;
+    buf = cr_xml_dump_buffer_get();
+    cr_xml_stream_primary_items(buf, package);
+    return cr_xml_dump_buffer_finish(buf);
+}
+
+/** Find the <location .../> element in the xml chunk.
+ * Attribute values could contain '>' so quotes have to be respected.
+ * @return          TRUE if a single empty location element was found
+ */
+static gboolean
+cr_xml_find_location(const char *chunk, const char **start, const char **end)
+{
+    const char *loc = chunk;
+    char quote = '\0';
+
+    while ((loc = strstr(loc, "<location")) != NULL) {
+        char c = loc[sizeof("<location") - 1];
+        if (c == ' ' || c == '\t' || c == '\n' || c == '/')
+            break;
+        loc++;
     }
 
-    root = xmlNewNode(NULL, BAD_CAST "package");
-    cr_xml_dump_primary_base_items(root, package);
-    // xmlNodeDump seems to be a little bit faster than xmlDocDumpFormatMemory
-    xmlNodeDump(buf, NULL, root, FORMAT_LEVEL, FORMAT_XML);
-    assert(buf->content);
-    result = g_strndup((char *) buf->content, (buf->use+1));
-    result[buf->use]     = '\n';
-    result[buf->use+1]   = '\0';
+    if (!loc)
+        return FALSE;
+
+    for (const char *p = loc + 1; *p; p++) {
+        if (quote) {
+            if (*p == quote)
+                quote = '\0';
+        } else if (*p == '"' || *p == '\'') {
+            quote = *p;
+        } else if (*p == '>') {
+            if (*(p - 1) != '/')
+                return FALSE; // Not an empty element
+            *start = loc;
+            *end = p + 1;
+            return TRUE;
+        }
+    }
 
+    return FALSE;
+}
+
+char *
+cr_xml_relocate_primary(const char *chunk, cr_Package *package, GError **err)
+{
+    GString *buf;
+    const char *loc_start, *loc_end;
+    size_t rest_len;
 
-    // Cleanup
+    assert(!err || *err == NULL);
+
+    if (!chunk || !package) {
+        g_set_error(err, CREATEREPO_C_ERROR, CRE_BADARG,
+                    "No xml chunk or package specified");
+        return NULL;
+    }
+
+    if (!cr_xml_find_location(chunk, &loc_start, &loc_end)) {
+        g_set_error(err, CREATEREPO_C_ERROR, CRE_XMLDATA,
+                    "No location element found in the primary xml chunk "
+                    "of %s", package->pkgId);
+        return NULL;
+    }
 
-    xmlBufferFree(buf);
-    xmlFreeNode(root);
+    buf = cr_xml_dump_buffer_get();
+    g_string_append_len(buf, chunk, loc_start - chunk);
+    cr_xml_stream_primary_location(buf, package);
 
-    return result;
+    // The trailing newline is appended by cr_xml_dump_buffer_finish()
+    rest_len = strlen(loc_end);
+    if (rest_len && loc_end[rest_len - 1] == '\n')
+        rest_len--;
+    g_string_append_len(buf, loc_end, rest_len);
 
+    return cr_xml_dump_buffer_finish(buf);
 }
@@ -20,6 +20,7 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <assert.h>
+#include <string.h>
 #include "xml_file.h"
 #include <errno.h>
 #include "error.h"
@@ -323,7 +324,34 @@ cr_xmlfile_close(cr_XmlFile *f, GError **err)
     return CRE_OK;
 }
 
-static int 
+/** Replace the task count in the header by the package count.
+ * @return      Malloced new header or NULL if the task count was not found
+ */
+static gchar *
+modified_header(int task_count,
+                int package_count,
+                const gchar *header_buf,
+                int header_len,
+                int *new_len)
+{
+    gchar *task_count_string = g_strdup_printf("packages=\"%i\"", task_count);
+    gchar *pointer_to_pkgs = g_strstr_len(header_buf, header_len, task_count_string);
+    GString *new_header = NULL;
+
+    if (pointer_to_pkgs) {
+        const gchar *pointer_to_pkgs_end = pointer_to_pkgs + strlen(task_count_string);
+        new_header = g_string_new_len(header_buf, pointer_to_pkgs - header_buf);
+        g_string_append_printf(new_header, "packages=\"%i\"", package_count);
+        g_string_append_len(new_header, pointer_to_pkgs_end,
+                            header_len - (pointer_to_pkgs_end - header_buf));
+        *new_len = new_header->len;
+    }
+
+    g_free(task_count_string);
+    return new_header ? g_string_free(new_header, FALSE) : NULL;
+}
+
+static int
 write_modified_header(int task_count,
                       int package_count,
                       cr_XmlFile *cr_file,
@@ -332,36 +360,97 @@ write_modified_header(int task_count,
                       GError **err)
 {
     GError *tmp_err = NULL;
-    gchar *package_count_string;
-    gchar *task_count_string;
+    int new_len = 0;
     int bytes_written = 0;
-    int package_count_string_len = rasprintf(&package_count_string, "packages=\"%i\"", package_count);
-    int task_count_string_len = rasprintf(&task_count_string, "packages=\"%i\"", task_count);
+    gchar *new_header = modified_header(task_count, package_count,
+                                        header_buf, header_len, &new_len);
 
-    gchar *pointer_to_pkgs = g_strstr_len(header_buf, header_len, task_count_string);
-    if (!pointer_to_pkgs){
-        g_free(package_count_string);
-        g_free(task_count_string);
+    if (!new_header)
         return 0;
-    }
-    gchar *pointer_to_pkgs_end = pointer_to_pkgs + task_count_string_len;
 
-    bytes_written += cr_write(cr_file->f, header_buf, pointer_to_pkgs - header_buf, &tmp_err);
-    if (!tmp_err)
-        bytes_written += cr_write(cr_file->f, package_count_string, package_count_string_len, &tmp_err);
-    if (!tmp_err)
-        bytes_written += cr_write(cr_file->f, pointer_to_pkgs_end, header_len - (pointer_to_pkgs_end - header_buf), &tmp_err);
+    bytes_written = cr_write(cr_file->f, new_header, new_len, &tmp_err);
+    g_free(new_header);
     if (tmp_err) {
         g_propagate_prefixed_error(err, tmp_err, "Error encountered while writing header part:");
-        g_free(package_count_string);
-        g_free(task_count_string);
         return 0;
     }
-    g_free(package_count_string);
-    g_free(task_count_string);
     return bytes_written;
 }
 
+/** Replace only the header of a gzip or xz file. The header is written
+ * as a separate gzip member or xz block (see cr_xmlfile_write_xml_header()),
+ * so the rest of the file is copied without recompression.
+ * The file is read once more to get its content stats.
+ * @return      TRUE if the header was replaced, FALSE if the file has to
+ *              be recompressed
+ */
+static gboolean
+rewrite_header_chunk(gchar *original_filename,
+                     cr_CompressionType xml_compression,
+                     int package_count,
+                     int task_count,
+                     cr_ContentStat *file_stat,
+                     GError **err)
+{
+    GError *tmp_err = NULL;
+    gchar *header = NULL, *new_header = NULL;
+    int new_len = 0;
+    ssize_t len;
+
+    len = cr_get_first_chunk(original_filename, xml_compression,
+                             XML_MAX_HEADER_SIZE, &header, &tmp_err);
+    if (len != CR_CW_ERR)
+        new_header = modified_header(task_count, package_count,
+                                     header, len, &new_len);
+    g_free(header);
+
+    if (!new_header) {
+        g_debug("%s: Header of %s is not a separate chunk: %s", __func__,
+                original_filename,
+                tmp_err ? tmp_err->message : "no package count");
+        g_clear_error(&tmp_err);
+        return FALSE;
+    }
+
+    gchar *tmp_xml_filename = g_strconcat(original_filename, ".tmp", NULL);
+    cr_replace_first_chunk(original_filename, tmp_xml_filename,
+                           xml_compression, new_header, new_len, &tmp_err);
+    g_free(new_header);
+    if (tmp_err) {
+        g_debug("%s: Cannot replace header of %s: %s", __func__,
+                original_filename, tmp_err->message);
+        g_clear_error(&tmp_err);
+        g_free(tmp_xml_filename);
+        return FALSE;
+    }
+
+    // Content stats (size and open checksum) of the new file
+    CR_FILE *new_file = cr_sopen(tmp_xml_filename, CR_CW_MODE_READ,
+                                 xml_compression, file_stat, &tmp_err);
+    if (new_file) {
+        gchar buf[XML_RECOMPRESS_BUFFER_SIZE];
+        while (cr_read(new_file, buf, sizeof(buf), &tmp_err) > 0)
+            ;
+        if (tmp_err)
+            cr_close(new_file, NULL);
+        else
+            cr_close(new_file, &tmp_err);
+    }
+
+    if (!tmp_err && g_rename(tmp_xml_filename, original_filename) == -1)
+        g_set_error(&tmp_err, ERR_DOMAIN, CRE_IO,
+                    "Cannot rename %s: %s", tmp_xml_filename, g_strerror(errno));
+
+    if (tmp_err) {
+        g_propagate_prefixed_error(err, tmp_err,
+                                   "Error encountered while rewriting header:");
+        remove(tmp_xml_filename);
+    }
+
+    g_free(tmp_xml_filename);
+    return TRUE;
+}
+
 void
 cr_rewrite_header_package_count(gchar *original_filename,
                                 cr_CompressionType xml_compression,
@@ -372,6 +461,13 @@ cr_rewrite_header_package_count(gchar *original_filename,
                                 GError **err)
 {
     GError *tmp_err = NULL;
+
+    if ((xml_compression == CR_CW_GZ_COMPRESSION
+         || xml_compression == CR_CW_XZ_COMPRESSION)
+        && rewrite_header_chunk(original_filename, xml_compression,
+                                package_count, task_count, file_stat, err))
+        return;
+
     CR_FILE *original_file = cr_open(original_filename, CR_CW_MODE_READ, CR_CW_AUTO_DETECT_COMPRESSION, &tmp_err);
     if (tmp_err) {
         g_propagate_prefixed_error(err, tmp_err, "Error encountered while reopening for reading:");
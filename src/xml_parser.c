@@ -47,9 +47,57 @@ cr_xml_parser_data_free(cr_ParserData *pd)
     g_free(pd->content);
     g_free(pd->swtab);
     g_free(pd->sbtab);
+    if (pd->raw)
+        g_string_free(pd->raw, TRUE);
     g_free(pd);
 }
 
+void
+cr_xml_parser_raw_pkg_start(cr_ParserData *pd)
+{
+    if (!pd->raw)
+        return;
+
+    pd->raw_pkg_start = XML_GetCurrentByteIndex(*(pd->parser));
+}
+
+void
+cr_xml_parser_raw_pkg_end(cr_ParserData *pd)
+{
+    gint64 end;
+    GError *tmp_err = NULL;
+
+    if (!pd->raw)
+        return;
+
+    // Byte index of the end tag + its length = end of the package element
+    end = XML_GetCurrentByteIndex(*(pd->parser))
+          + XML_GetCurrentByteCount(*(pd->parser));
+
+    assert(pd->raw_pkg_start >= pd->raw_offset);
+    assert(end <= pd->raw_offset + (gint64) pd->raw->len);
+
+    if (!pd->err
+        && pd->rawpkgcb(pd->pkg,
+                        pd->raw->str + (pd->raw_pkg_start - pd->raw_offset),
+                        (size_t) (end - pd->raw_pkg_start),
+                        pd->rawpkgcb_data,
+                        &tmp_err))
+    {
+        if (tmp_err)
+            g_propagate_prefixed_error(&pd->err,
+                                       tmp_err,
+                                       "Parsing interrupted: ");
+        else
+            g_set_error(&pd->err, ERR_DOMAIN, CRE_CBINTERRUPTED,
+                        "Parsing interrupted");
+    }
+
+    // Everything up to the end of the package is not needed anymore
+    g_string_erase(pd->raw, 0, (gssize) (end - pd->raw_offset));
+    pd->raw_offset = end;
+}
+
 void XMLCALL
 cr_char_handler(void *pdata, const XML_Char *s, int len)
 {
@@ -181,18 +229,35 @@ cr_xml_parser_generic(XML_Parser parser,
         return code;
     }
 
+    if (f->type != CR_CW_NO_COMPRESSION) {
+        // Decompress in a separate thread, in parallel with the parsing
+        if (cr_set_readahead(f, &tmp_err) != CRE_OK) {
+            g_debug("%s: Cannot use read-ahead for '%s': %s",
+                    __func__, path, tmp_err->message);
+            g_clear_error(&tmp_err);
+        }
+    }
+
     while (1) {
         int len;
-        void *buf = XML_GetBuffer(parser, XML_BUFFER_SIZE);
-        if (!buf) {
-            ret = CRE_MEMORY;
-            g_set_error(err, ERR_DOMAIN, CRE_MEMORY,
-                        "Out of memory: Cannot allocate buffer for xml parser '%s'",
-                        path);
-            break;
+        const void *buf;
+
+        if (f->readahead) {
+            // Blocks of the read-ahead thread are parsed without copying
+            len = cr_read_block(f, &buf, &tmp_err);
+        } else {
+            void *parser_buf = XML_GetBuffer(parser, XML_BUFFER_SIZE);
+            if (!parser_buf) {
+                ret = CRE_MEMORY;
+                g_set_error(err, ERR_DOMAIN, CRE_MEMORY,
+                            "Out of memory: Cannot allocate buffer for xml parser '%s'",
+                            path);
+                break;
+            }
+            len = cr_read(f, parser_buf, XML_BUFFER_SIZE, &tmp_err);
+            buf = parser_buf;
         }
 
-        len = cr_read(f, buf, XML_BUFFER_SIZE, &tmp_err);
         if (tmp_err) {
             ret = tmp_err->code;
             g_critical("%s: Error while reading xml '%s': %s",
@@ -201,7 +266,12 @@ cr_xml_parser_generic(XML_Parser parser,
             break;
         }
 
-        if (!XML_ParseBuffer(parser, len, len == 0)) {
+        if (pd->raw)
+            // Keep a copy of the input for the raw package content
+            g_string_append_len(pd->raw, buf, len);
+
+        if (!(f->readahead ? XML_Parse(parser, buf, len, len == 0)
+                           : XML_ParseBuffer(parser, len, len == 0))) {
             ret = CRE_XMLPARSER;
             g_critical("%s: parsing error '%s': %s",
                        __func__,
@@ -240,3 +310,35 @@ cr_xml_parser_generic(XML_Parser parser,
 
     return ret;
 }
+
+int
+cr_xml_parser_generic_from_string(XML_Parser parser,
+                                  cr_ParserData *pd,
+                                  const char *target,
+                                  GError **err)
+{
+    /* Note: This function uses .err members of cr_ParserData! */
+
+    int ret = CRE_OK;
+
+    assert(parser);
+    assert(pd);
+    assert(target);
+    assert(!err || *err == NULL);
+
+    if (!XML_Parse(parser, target, strlen(target), 1)) {
+        ret = CRE_XMLPARSER;
+        g_set_error(err, ERR_DOMAIN, CRE_XMLPARSER,
+                    "Parse error at line: %d (%s)",
+                    (int) XML_GetCurrentLineNumber(parser),
+                    (char *) XML_ErrorString(XML_GetErrorCode(parser)));
+        return ret;
+    }
+
+    if (pd->err) {
+        ret = pd->err->code;
+        g_propagate_error(err, pd->err);
+    }
+
+    return ret;
+}
@@ -147,6 +147,30 @@ int cr_xml_parse_filelists(const char *path,
                            void *warningcb_data,
                            GError **err);
 
+/** Parse a single package element (or several of them) from filelists.xml
+ * which is already in memory.
+ * @param target         Xml chunk(s) of package element(s) without
+ *                       the <filelists> root element
+ * @param newpkgcb       Callback for new package. If NULL cr_newpkgcb
+ *                       is used.
+ * @param newpkgcb_data  User data for the newpkgcb.
+ * @param pkgcb          Package callback. Could be NULL if newpkgcb is
+ *                       not NULL.
+ * @param pkgcb_data     User data for the pkgcb.
+ * @param warningcb      Callback for warning messages.
+ * @param warningcb_data User data for the warningcb.
+ * @param err            GError **
+ * @return               cr_Error code.
+ */
+int cr_xml_parse_filelists_snippet(const char *target,
+                                   cr_XmlParserNewPkgCb newpkgcb,
+                                   void *newpkgcb_data,
+                                   cr_XmlParserPkgCb pkgcb,
+                                   void *pkgcb_data,
+                                   cr_XmlParserWarningCb warningcb,
+                                   void *warningcb_data,
+                                   GError **err);
+
 /** Parse other.xml. File could be compressed.
  * @param path           Path to other.xml
  * @param newpkgcb       Callback for new package (Called when new package
@@ -171,6 +195,30 @@ int cr_xml_parse_other(const char *path,
                        void *warningcb_data,
                        GError **err);
 
+/** Parse a single package element (or several of them) from other.xml
+ * which is already in memory.
+ * @param target         Xml chunk(s) of package element(s) without
+ *                       the <otherdata> root element
+ * @param newpkgcb       Callback for new package. If NULL cr_newpkgcb
+ *                       is used.
+ * @param newpkgcb_data  User data for the newpkgcb.
+ * @param pkgcb          Package callback. Could be NULL if newpkgcb is
+ *                       not NULL.
+ * @param pkgcb_data     User data for the pkgcb.
+ * @param warningcb      Callback for warning messages.
+ * @param warningcb_data User data for the warningcb.
+ * @param err            GError **
+ * @return               cr_Error code.
+ */
+int cr_xml_parse_other_snippet(const char *target,
+                               cr_XmlParserNewPkgCb newpkgcb,
+                               void *newpkgcb_data,
+                               cr_XmlParserPkgCb pkgcb,
+                               void *pkgcb_data,
+                               cr_XmlParserWarningCb warningcb,
+                               void *warningcb_data,
+                               GError **err);
+
 /** Parse repomd.xml. File could be compressed.
  * @param path           Path to repomd.xml
  * @param repomd         cr_Repomd object.
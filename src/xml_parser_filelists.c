@@ -113,6 +113,8 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         const char *name  = cr_find_attr("name", attr);
         const char *arch  = cr_find_attr("arch", attr);
 
+        cr_xml_parser_raw_pkg_start(pd);
+
 
         if (!pkgId) {
             // Package without a pkgid attr is error
@@ -228,7 +230,9 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_PACKAGE:
-        if (!pd->pkg)
+        cr_xml_parser_raw_pkg_end(pd);
+
+        if (!pd->pkg || pd->err)
             return;
 
         // Reverse list of files
@@ -280,21 +284,25 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
 }
 
 int
-cr_xml_parse_filelists(const char *path,
-                       cr_XmlParserNewPkgCb newpkgcb,
-                       void *newpkgcb_data,
-                       cr_XmlParserPkgCb pkgcb,
-                       void *pkgcb_data,
-                       cr_XmlParserWarningCb warningcb,
-                       void *warningcb_data,
-                       GError **err)
+cr_xml_parse_filelists_internal(const char *path,
+                                const char *target,
+                                cr_XmlParserNewPkgCb newpkgcb,
+                                void *newpkgcb_data,
+                                cr_XmlParserPkgCb pkgcb,
+                                void *pkgcb_data,
+                                cr_XmlParserRawPkgCb rawpkgcb,
+                                void *rawpkgcb_data,
+                                cr_XmlParserWarningCb warningcb,
+                                void *warningcb_data,
+                                GError **err)
 {
     int ret = CRE_OK;
     cr_ParserData *pd;
     XML_Parser parser;
     GError *tmp_err = NULL;
 
-    assert(path);
+    assert(path || target);
+    assert(!(target && rawpkgcb));
     assert(newpkgcb || pkgcb);
     assert(!err || *err == NULL);
 
@@ -314,6 +322,10 @@ cr_xml_parse_filelists(const char *path,
     pd->newpkgcb = newpkgcb;
     pd->pkgcb_data = pkgcb_data;
     pd->pkgcb = pkgcb;
+    pd->rawpkgcb_data = rawpkgcb_data;
+    pd->rawpkgcb = rawpkgcb;
+    if (rawpkgcb)
+        pd->raw = g_string_sized_new(2 * XML_BUFFER_SIZE);
     pd->warningcb = warningcb;
     pd->warningcb_data = warningcb_data;
     for (cr_StatesSwitch *sw = stateswitches; sw->from != NUMSTATES; sw++) {
@@ -326,7 +338,10 @@ cr_xml_parse_filelists(const char *path,
 
     // Parsing
 
-    ret = cr_xml_parser_generic(parser, pd, path, &tmp_err);
+    if (target)
+        ret = cr_xml_parser_generic_from_string(parser, pd, target, &tmp_err);
+    else
+        ret = cr_xml_parser_generic(parser, pd, path, &tmp_err);
     if (tmp_err)
         g_propagate_error(err, tmp_err);
 
@@ -355,3 +370,59 @@ cr_xml_parse_filelists(const char *path,
 
     return ret;
 }
+
+int
+cr_xml_parse_filelists(const char *path,
+                       cr_XmlParserNewPkgCb newpkgcb,
+                       void *newpkgcb_data,
+                       cr_XmlParserPkgCb pkgcb,
+                       void *pkgcb_data,
+                       cr_XmlParserWarningCb warningcb,
+                       void *warningcb_data,
+                       GError **err)
+{
+    return cr_xml_parse_filelists_internal(path,
+                                           NULL,
+                                           newpkgcb,
+                                           newpkgcb_data,
+                                           pkgcb,
+                                           pkgcb_data,
+                                           NULL,
+                                           NULL,
+                                           warningcb,
+                                           warningcb_data,
+                                           err);
+}
+
+int
+cr_xml_parse_filelists_snippet(const char *target,
+                               cr_XmlParserNewPkgCb newpkgcb,
+                               void *newpkgcb_data,
+                               cr_XmlParserPkgCb pkgcb,
+                               void *pkgcb_data,
+                               cr_XmlParserWarningCb warningcb,
+                               void *warningcb_data,
+                               GError **err)
+{
+    int ret;
+    gchar *wrapped;
+
+    assert(target);
+
+    // The package elements are expected inside of the root element
+    wrapped = g_strconcat("<filelists>", target, "</filelists>", NULL);
+    ret = cr_xml_parse_filelists_internal(NULL,
+                                          wrapped,
+                                          newpkgcb,
+                                          newpkgcb_data,
+                                          pkgcb,
+                                          pkgcb_data,
+                                          NULL,
+                                          NULL,
+                                          warningcb,
+                                          warningcb_data,
+                                          err);
+    g_free(wrapped);
+
+    return ret;
+}
@@ -53,6 +53,24 @@ typedef enum {
     FILE_SENTINEL,
 } cr_FileType;
 
+/** Callback called with the raw (unparsed) content of a package element.
+ * It is called right before the pkgcb of the package. It is called even
+ * for packages which were skipped (newpkgcb returned NULL package).
+ * @param pkg           Currently parsed package or NULL if skipped
+ * @param raw           The package element exactly as it is in the file
+ *                      (from "<package" to "</package>", not terminated)
+ * @param len           Length of the raw content
+ * @param cbdata        User data
+ * @param err           GError **
+ * @return              CR_CB_RET_OK (0) or CR_CB_RET_ERR (1) - stops
+ *                      the parsing
+ */
+typedef int (*cr_XmlParserRawPkgCb)(cr_Package *pkg,
+                                    const char *raw,
+                                    size_t len,
+                                    void *cbdata,
+                                    GError **err);
+
 /** Structure used for elements in the state switches in XML parsers
  */
 typedef struct {
@@ -112,6 +130,18 @@ typedef struct _cr_ParserData {
         Warning callback */
     cr_Package              *pkg;               /*!<
         The package which is currently loaded. */
+    void                    *rawpkgcb_data;     /*!<
+        User data for the rawpkgcb. */
+    cr_XmlParserRawPkgCb    rawpkgcb;           /*!<
+        Callback called with the raw content of a package element. */
+    GString                 *raw;               /*!<
+        Copy of the input starting at raw_offset (only if rawpkgcb is set).
+        It is trimmed after every package element, so it holds at most
+        the currently parsed package and the last read chunk. */
+    gint64                  raw_offset;         /*!<
+        Offset of the raw buffer in the input. */
+    gint64                  raw_pkg_start;      /*!<
+        Offset of the currently parsed package element in the input. */
 
     /* Primary related stuff */
 
@@ -183,6 +213,18 @@ cr_find_attr(const char *name, const char **attr)
     return NULL;
 }
 
+/** Remember the position of the package element which is just started.
+ * No-op if the raw content of packages is not requested.
+ */
+void cr_xml_parser_raw_pkg_start(cr_ParserData *pd);
+
+/** Pass the raw content of the just finished package element to the
+ * rawpkgcb and drop it from the raw buffer.
+ * No-op if the raw content of packages is not requested.
+ * Errors are reported via pd->err.
+ */
+void cr_xml_parser_raw_pkg_end(cr_ParserData *pd);
+
 /** XML character handler
  */
 void XMLCALL cr_char_handler(void *pdata, const XML_Char *s, int len);
@@ -219,6 +261,57 @@ cr_xml_parser_generic(XML_Parser parser,
                       const char *path,
                       GError **err);
 
+/** Generic parser of an xml document which is already in memory.
+ */
+int
+cr_xml_parser_generic_from_string(XML_Parser parser,
+                                  cr_ParserData *pd,
+                                  const char *target,
+                                  GError **err);
+
+/** Variants of cr_xml_parse_primary(), cr_xml_parse_filelists() and
+ * cr_xml_parse_other() which are able to pass the raw content of every
+ * package element to the rawpkgcb (if it is not NULL).
+ * The filelists and other variants parse the in-memory document target
+ * instead of the file if the target is not NULL (rawpkgcb is not
+ * supported in such case).
+ */
+int cr_xml_parse_primary_internal(const char *path,
+                                  cr_XmlParserNewPkgCb newpkgcb,
+                                  void *newpkgcb_data,
+                                  cr_XmlParserPkgCb pkgcb,
+                                  void *pkgcb_data,
+                                  cr_XmlParserRawPkgCb rawpkgcb,
+                                  void *rawpkgcb_data,
+                                  cr_XmlParserWarningCb warningcb,
+                                  void *warningcb_data,
+                                  int do_files,
+                                  GError **err);
+
+int cr_xml_parse_filelists_internal(const char *path,
+                                    const char *target,
+                                    cr_XmlParserNewPkgCb newpkgcb,
+                                    void *newpkgcb_data,
+                                    cr_XmlParserPkgCb pkgcb,
+                                    void *pkgcb_data,
+                                    cr_XmlParserRawPkgCb rawpkgcb,
+                                    void *rawpkgcb_data,
+                                    cr_XmlParserWarningCb warningcb,
+                                    void *warningcb_data,
+                                    GError **err);
+
+int cr_xml_parse_other_internal(const char *path,
+                                const char *target,
+                                cr_XmlParserNewPkgCb newpkgcb,
+                                void *newpkgcb_data,
+                                cr_XmlParserPkgCb pkgcb,
+                                void *pkgcb_data,
+                                cr_XmlParserRawPkgCb rawpkgcb,
+                                void *rawpkgcb_data,
+                                cr_XmlParserWarningCb warningcb,
+                                void *warningcb_data,
+                                GError **err);
+
 #ifdef __cplusplus
 }
 #endif
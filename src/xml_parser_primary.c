@@ -177,6 +177,8 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
     case STATE_PACKAGE:
         assert(!pd->pkg);
 
+        cr_xml_parser_raw_pkg_start(pd);
+
         val = cr_find_attr("type", attr);
 
         if (!val)
@@ -474,7 +476,9 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_PACKAGE:
-        if (!pd->pkg)
+        cr_xml_parser_raw_pkg_end(pd);
+
+        if (!pd->pkg || pd->err)
             return;
 
         if (!pd->pkg->pkgId) {
@@ -654,15 +658,17 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
 }
 
 int
-cr_xml_parse_primary(const char *path,
-                     cr_XmlParserNewPkgCb newpkgcb,
-                     void *newpkgcb_data,
-                     cr_XmlParserPkgCb pkgcb,
-                     void *pkgcb_data,
-                     cr_XmlParserWarningCb warningcb,
-                     void *warningcb_data,
-                     int do_files,
-                     GError **err)
+cr_xml_parse_primary_internal(const char *path,
+                              cr_XmlParserNewPkgCb newpkgcb,
+                              void *newpkgcb_data,
+                              cr_XmlParserPkgCb pkgcb,
+                              void *pkgcb_data,
+                              cr_XmlParserRawPkgCb rawpkgcb,
+                              void *rawpkgcb_data,
+                              cr_XmlParserWarningCb warningcb,
+                              void *warningcb_data,
+                              int do_files,
+                              GError **err)
 {
     int ret = CRE_OK;
     cr_ParserData *pd;
@@ -689,6 +695,10 @@ cr_xml_parse_primary(const char *path,
     pd->newpkgcb = newpkgcb;
     pd->pkgcb_data = pkgcb_data;
     pd->pkgcb = pkgcb;
+    pd->rawpkgcb_data = rawpkgcb_data;
+    pd->rawpkgcb = rawpkgcb;
+    if (rawpkgcb)
+        pd->raw = g_string_sized_new(2 * XML_BUFFER_SIZE);
     pd->do_files = do_files;
     pd->warningcb = warningcb;
     pd->warningcb_data = warningcb_data;
@@ -731,3 +741,27 @@ cr_xml_parse_primary(const char *path,
 
     return ret;
 }
+
+int
+cr_xml_parse_primary(const char *path,
+                     cr_XmlParserNewPkgCb newpkgcb,
+                     void *newpkgcb_data,
+                     cr_XmlParserPkgCb pkgcb,
+                     void *pkgcb_data,
+                     cr_XmlParserWarningCb warningcb,
+                     void *warningcb_data,
+                     int do_files,
+                     GError **err)
+{
+    return cr_xml_parse_primary_internal(path,
+                                         newpkgcb,
+                                         newpkgcb_data,
+                                         pkgcb,
+                                         pkgcb_data,
+                                         NULL,
+                                         NULL,
+                                         warningcb,
+                                         warningcb_data,
+                                         do_files,
+                                         err);
+}
@@ -0,0 +1,535 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <assert.h>
+#include <string.h>
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif  // WITH_ZSTD
+#include "error.h"
+#include "locate_metadata.h"
+#include "package.h"
+#include "xml_dump.h"
+#include "xml_parser.h"
+#include "zck_dict.h"
+
+#define ERR_DOMAIN              CREATEREPO_C_ERROR
+
+/* Zstd level used to compress the chunks during the evaluation */
+#define ZCK_DICT_EVAL_LEVEL     9
+
+struct _cr_ZckDictSamples {
+    GString *data[CR_ZCK_DICT_SENTINEL];    /*!< All chunks concatenated */
+    GArray *sizes[CR_ZCK_DICT_SENTINEL];    /*!< Sizes (size_t) of chunks */
+};
+
+typedef struct {
+    GPtrArray *pkgs;        // Packages in order of primary.xml
+    GHashTable *ht;         // pkgId -> package from pkgs
+    cr_PackageLoadingFlags flag;
+} ZckDictCbData;
+
+const char *
+cr_zck_dict_filename(cr_ZckDictType type)
+{
+    switch (type) {
+        case CR_ZCK_DICT_PRIMARY:
+            return "primary.xml.zdict";
+        case CR_ZCK_DICT_FILELISTS:
+            return "filelists.xml.zdict";
+        case CR_ZCK_DICT_OTHER:
+            return "other.xml.zdict";
+        default:
+            return NULL;
+    }
+}
+
+cr_ZckDictSamples *
+cr_zck_dict_samples_new(void)
+{
+    cr_ZckDictSamples *samples = g_new0(cr_ZckDictSamples, 1);
+
+    for (int i = 0; i < CR_ZCK_DICT_SENTINEL; i++) {
+        samples->data[i] = g_string_new(NULL);
+        samples->sizes[i] = g_array_new(FALSE, FALSE, sizeof(size_t));
+    }
+
+    return samples;
+}
+
+void
+cr_zck_dict_samples_free(cr_ZckDictSamples *samples)
+{
+    if (!samples)
+        return;
+
+    for (int i = 0; i < CR_ZCK_DICT_SENTINEL; i++) {
+        g_string_free(samples->data[i], TRUE);
+        g_array_free(samples->sizes[i], TRUE);
+    }
+
+    g_free(samples);
+}
+
+guint
+cr_zck_dict_samples_count(cr_ZckDictSamples *samples, cr_ZckDictType type)
+{
+    assert(samples);
+    assert(type < CR_ZCK_DICT_SENTINEL);
+
+    return samples->sizes[type]->len;
+}
+
+static int
+warningcb(G_GNUC_UNUSED cr_XmlParserWarningType type,
+          char *msg,
+          void *cbdata,
+          G_GNUC_UNUSED GError **err)
+{
+    g_warning("XML parser warning (%s): %s", (gchar *) cbdata, msg);
+    return CR_CB_RET_OK;
+}
+
+static int
+primary_pkgcb(cr_Package *pkg, void *cbdata, G_GNUC_UNUSED GError **err)
+{
+    ZckDictCbData *cb_data = cbdata;
+
+    g_ptr_array_add(cb_data->pkgs, pkg);
+    if (pkg->pkgId && !g_hash_table_contains(cb_data->ht, pkg->pkgId))
+        g_hash_table_insert(cb_data->ht, pkg->pkgId, pkg);
+
+    return CR_CB_RET_OK;
+}
+
+static int
+newpkgcb(cr_Package **pkg,
+         const char *pkgId,
+         G_GNUC_UNUSED const char *name,
+         G_GNUC_UNUSED const char *arch,
+         void *cbdata,
+         G_GNUC_UNUSED GError **err)
+{
+    ZckDictCbData *cb_data = cbdata;
+
+    *pkg = g_hash_table_lookup(cb_data->ht, pkgId);
+    if (*pkg) {
+        if ((*pkg)->loadingflags & cb_data->flag)
+            // Duplicate package element, use only the first one
+            *pkg = NULL;
+        else
+            (*pkg)->loadingflags |= cb_data->flag;
+    }
+
+    return CR_CB_RET_OK;
+}
+
+/** Append the xml of the package to the current chunk.
+ */
+static int
+samples_append(cr_ZckDictSamples *samples,
+               cr_ZckDictType type,
+               cr_Package *pkg,
+               GError **err)
+{
+    char *xml = NULL;
+
+    switch (type) {
+        case CR_ZCK_DICT_PRIMARY:
+            xml = cr_xml_dump_primary(pkg, err);
+            break;
+        case CR_ZCK_DICT_FILELISTS:
+            xml = cr_xml_dump_filelists(pkg, err);
+            break;
+        case CR_ZCK_DICT_OTHER:
+            xml = cr_xml_dump_other(pkg, err);
+            break;
+        default:
+            break;
+    }
+
+    if (!xml)
+        return CRE_XMLDATA;
+
+    g_string_append(samples->data[type], xml);
+    g_free(xml);
+    return CRE_OK;
+}
+
+/** End the chunk which started at the offset (if it isn't empty).
+ */
+static void
+samples_end_chunk(cr_ZckDictSamples *samples,
+                  cr_ZckDictType type,
+                  gsize start)
+{
+    size_t size = samples->data[type]->len - start;
+
+    if (size)
+        g_array_append_val(samples->sizes[type], size);
+}
+
+int
+cr_zck_dict_samples_add_repo(cr_ZckDictSamples *samples,
+                             const char *repopath,
+                             GError **err)
+{
+    int ret = CRE_OK;
+    GError *tmp_err = NULL;
+    struct cr_MetadataLocation *ml;
+    ZckDictCbData cb_data;
+    gsize start[CR_ZCK_DICT_SENTINEL];
+    const char *prev_srpm = NULL;
+
+    assert(samples);
+    assert(repopath);
+    assert(!err || *err == NULL);
+
+    ml = cr_locate_metadata(repopath, TRUE, &tmp_err);
+    if (tmp_err) {
+        ret = tmp_err->code;
+        g_propagate_error(err, tmp_err);
+        cr_metadatalocation_free(ml);
+        return ret;
+    }
+
+    if (!ml->pri_xml_href || !ml->fil_xml_href || !ml->oth_xml_href) {
+        g_set_error(err, ERR_DOMAIN, CRE_NOFILE,
+                    "Repository %s doesn't contain primary, filelists "
+                    "and other xml", repopath);
+        cr_metadatalocation_free(ml);
+        return CRE_NOFILE;
+    }
+
+    cb_data.pkgs = g_ptr_array_new_with_free_func(
+                            (GDestroyNotify) cr_package_free);
+    cb_data.ht = g_hash_table_new(g_str_hash, g_str_equal);
+
+    // Packages are kept in order of primary.xml, filelists and other
+    // are filled into them
+
+    ret = cr_xml_parse_primary(ml->pri_xml_href, NULL, NULL,
+                               primary_pkgcb, &cb_data,
+                               warningcb, ml->pri_xml_href, 0, err);
+    if (ret != CRE_OK)
+        goto cleanup;
+
+    cb_data.flag = CR_PACKAGE_LOADED_FIL;
+    ret = cr_xml_parse_filelists(ml->fil_xml_href, newpkgcb, &cb_data,
+                                 NULL, NULL, warningcb, ml->fil_xml_href,
+                                 err);
+    if (ret != CRE_OK)
+        goto cleanup;
+
+    cb_data.flag = CR_PACKAGE_LOADED_OTH;
+    ret = cr_xml_parse_other(ml->oth_xml_href, newpkgcb, &cb_data,
+                             NULL, NULL, warningcb, ml->oth_xml_href, err);
+    if (ret != CRE_OK)
+        goto cleanup;
+
+    // Split packages to chunks the same way as write_pkg() in
+    // dumper_thread.c does - a new chunk starts when srpm changes
+
+    for (int t = 0; t < CR_ZCK_DICT_SENTINEL; t++)
+        start[t] = samples->data[t]->len;
+
+    for (guint i = 0; i < cb_data.pkgs->len; i++) {
+        cr_Package *pkg = g_ptr_array_index(cb_data.pkgs, i);
+
+        if (i == 0 || g_strcmp0(prev_srpm, pkg->rpm_sourcerpm) != 0) {
+            for (int t = 0; t < CR_ZCK_DICT_SENTINEL; t++) {
+                samples_end_chunk(samples, t, start[t]);
+                start[t] = samples->data[t]->len;
+            }
+        }
+        prev_srpm = pkg->rpm_sourcerpm;
+
+        for (int t = 0; t < CR_ZCK_DICT_SENTINEL; t++) {
+            ret = samples_append(samples, t, pkg, &tmp_err);
+            if (ret != CRE_OK) {
+                g_propagate_prefixed_error(err, tmp_err,
+                                           "Cannot dump %s: ", pkg->name);
+                // Drop the unfinished chunks
+                for (int u = 0; u < CR_ZCK_DICT_SENTINEL; u++)
+                    g_string_truncate(samples->data[u], start[u]);
+                goto cleanup;
+            }
+        }
+    }
+
+    for (int t = 0; t < CR_ZCK_DICT_SENTINEL; t++)
+        samples_end_chunk(samples, t, start[t]);
+
+    g_debug("%s: %u packages from %s sampled", __func__,
+            cb_data.pkgs->len, repopath);
+
+cleanup:
+    g_hash_table_destroy(cb_data.ht);
+    g_ptr_array_free(cb_data.pkgs, TRUE);
+    cr_metadatalocation_free(ml);
+    return ret;
+}
+
+cr_ZckDictSamples *
+cr_zck_dict_samples_split(cr_ZckDictSamples *samples)
+{
+    assert(samples);
+
+    cr_ZckDictSamples *held_out = cr_zck_dict_samples_new();
+
+    for (int type = 0; type < CR_ZCK_DICT_SENTINEL; type++) {
+        GString *data = samples->data[type];
+        GArray *sizes = samples->sizes[type];
+        GString *kept = g_string_sized_new(data->len / 2 + 1);
+        GArray *kept_sizes = g_array_new(FALSE, FALSE, sizeof(size_t));
+        gsize offset = 0;
+
+        for (guint i = 0; i < sizes->len; i++) {
+            size_t size = g_array_index(sizes, size_t, i);
+            if (i % 2) {
+                g_string_append_len(held_out->data[type],
+                                    data->str + offset, size);
+                g_array_append_val(held_out->sizes[type], size);
+            } else {
+                g_string_append_len(kept, data->str + offset, size);
+                g_array_append_val(kept_sizes, size);
+            }
+            offset += size;
+        }
+
+        g_string_free(data, TRUE);
+        g_array_free(sizes, TRUE);
+        samples->data[type] = kept;
+        samples->sizes[type] = kept_sizes;
+    }
+
+    return held_out;
+}
+
+char *
+cr_zck_dict_train(cr_ZckDictSamples *samples,
+                  cr_ZckDictType type,
+                  size_t dict_size,
+                  size_t max_samples,
+                  size_t *len,
+                  GError **err)
+{
+    assert(samples);
+    assert(type < CR_ZCK_DICT_SENTINEL);
+    assert(len);
+    assert(!err || *err == NULL);
+
+#ifdef WITH_ZSTD
+    GString *data = samples->data[type];
+    GArray *sizes = samples->sizes[type];
+    const char *buf = data->str;
+    GString *subset = NULL;
+    GArray *subset_sizes = NULL;
+    char *dict;
+    size_t ret;
+
+    if (sizes->len == 0) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "No chunks to train the dictionary from");
+        return NULL;
+    }
+
+    if (data->len > max_samples) {
+        // Use every n-th chunk to keep the samples representative. The
+        // chunks differ in size, so the subset can still be too big,
+        // stop at max_samples then.
+        gsize step = (data->len + max_samples - 1) / max_samples;
+        gsize offset = 0, subset_len = 0;
+        GArray *offsets = g_array_new(FALSE, FALSE, sizeof(gsize));
+
+        subset_sizes = g_array_new(FALSE, FALSE, sizeof(size_t));
+        for (guint i = 0; i < sizes->len; i++) {
+            size_t size = g_array_index(sizes, size_t, i);
+            if (i % step == 0) {
+                if (subset_len + size > max_samples)
+                    break;
+                g_array_append_val(offsets, offset);
+                g_array_append_val(subset_sizes, size);
+                subset_len += size;
+            }
+            offset += size;
+        }
+
+        subset = g_string_sized_new(subset_len);
+        for (guint i = 0; i < subset_sizes->len; i++)
+            g_string_append_len(subset,
+                                data->str + g_array_index(offsets, gsize, i),
+                                g_array_index(subset_sizes, size_t, i));
+        g_array_free(offsets, TRUE);
+
+        if (subset_sizes->len == 0) {
+            g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                        "The first chunk is bigger than the maximal size "
+                        "of the samples");
+            g_string_free(subset, TRUE);
+            g_array_free(subset_sizes, TRUE);
+            return NULL;
+        }
+
+        buf = subset->str;
+        sizes = subset_sizes;
+    }
+
+    dict = g_malloc(dict_size);
+    ret = ZDICT_trainFromBuffer(dict, dict_size, buf,
+                                (const size_t *) sizes->data, sizes->len);
+
+    if (subset) {
+        g_string_free(subset, TRUE);
+        g_array_free(subset_sizes, TRUE);
+    }
+
+    if (ZDICT_isError(ret)) {
+        g_set_error(err, ERR_DOMAIN, CRE_ZSTD,
+                    "Cannot train the dictionary: %s",
+                    ZDICT_getErrorName(ret));
+        g_free(dict);
+        return NULL;
+    }
+
+    *len = ret;
+    return dict;
+#else
+    g_set_error(err, ERR_DOMAIN, CRE_IO, "createrepo_c wasn't compiled "
+                "with zstd support");
+    return NULL;
+#endif // WITH_ZSTD
+}
+
+int
+cr_zck_dict_evaluate(cr_ZckDictSamples *samples,
+                     cr_ZckDictSamples *old_samples,
+                     cr_ZckDictType type,
+                     const void *dict,
+                     size_t dict_len,
+                     cr_ZckDictStats *stats,
+                     GError **err)
+{
+    assert(samples);
+    assert(type < CR_ZCK_DICT_SENTINEL);
+    assert(dict || dict_len == 0);
+    assert(stats);
+    assert(!err || *err == NULL);
+
+    memset(stats, 0, sizeof(cr_ZckDictStats));
+
+#ifdef WITH_ZSTD
+    int ret = CRE_OK;
+    GString *data = samples->data[type];
+    GArray *sizes = samples->sizes[type];
+    GHashTable *old_chunks = NULL;
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    ZSTD_CDict *cdict = NULL;
+    size_t max_size = 0, out_size;
+    gsize offset = 0;
+    char *out;
+
+    if (dict_len)
+        cdict = ZSTD_createCDict(dict, dict_len, ZCK_DICT_EVAL_LEVEL);
+
+    if (!cctx || (dict_len && !cdict)) {
+        g_set_error(err, ERR_DOMAIN, CRE_ZSTD,
+                    "Cannot initialize the zstd compressor");
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeCDict(cdict);
+        return CRE_ZSTD;
+    }
+
+    // zchunk identifies chunks by checksum, a chunk is downloaded only
+    // if the old file doesn't contain the same one
+    if (old_samples) {
+        GString *old_data = old_samples->data[type];
+        GArray *old_sizes = old_samples->sizes[type];
+        gsize old_offset = 0;
+
+        old_chunks = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           g_free, NULL);
+        for (guint i = 0; i < old_sizes->len; i++) {
+            size_t size = g_array_index(old_sizes, size_t, i);
+            g_hash_table_add(old_chunks,
+                g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+                        (const guchar *) old_data->str + old_offset, size));
+            old_offset += size;
+        }
+    }
+
+    for (guint i = 0; i < sizes->len; i++)
+        max_size = MAX(max_size, g_array_index(sizes, size_t, i));
+    out_size = ZSTD_compressBound(max_size);
+    out = g_malloc(out_size);
+
+    for (guint i = 0; i < sizes->len; i++) {
+        size_t size = g_array_index(sizes, size_t, i);
+        const char *chunk = data->str + offset;
+        size_t csize, dsize;
+        gboolean changed = TRUE;
+
+        offset += size;
+
+        csize = ZSTD_compressCCtx(cctx, out, out_size, chunk, size,
+                                  ZCK_DICT_EVAL_LEVEL);
+        dsize = cdict ? ZSTD_compress_usingCDict(cctx, out, out_size,
+                                                 chunk, size, cdict)
+                      : csize;
+        if (ZSTD_isError(csize) || ZSTD_isError(dsize)) {
+            g_set_error(err, ERR_DOMAIN, CRE_ZSTD,
+                        "Cannot compress chunk: %s",
+                        ZSTD_getErrorName(ZSTD_isError(csize) ? csize
+                                                              : dsize));
+            ret = CRE_ZSTD;
+            break;
+        }
+
+        if (old_chunks) {
+            gchar *checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+                                            (const guchar *) chunk, size);
+            changed = !g_hash_table_contains(old_chunks, checksum);
+            g_free(checksum);
+        }
+
+        stats->chunks++;
+        stats->size += size;
+        stats->compressed_size += csize;
+        stats->dict_compressed_size += dsize;
+        if (changed) {
+            stats->changed_chunks++;
+            stats->changed_compressed_size += csize;
+            stats->changed_dict_compressed_size += dsize;
+        }
+    }
+
+    g_free(out);
+    if (old_chunks)
+        g_hash_table_destroy(old_chunks);
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeCCtx(cctx);
+    return ret;
+#else
+    g_set_error(err, ERR_DOMAIN, CRE_IO, "createrepo_c wasn't compiled "
+                "with zstd support");
+    return CRE_IO;
+#endif // WITH_ZSTD
+}
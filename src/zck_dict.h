@@ -0,0 +1,164 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef __C_CREATEREPOLIB_ZCK_DICT_H__
+#define __C_CREATEREPOLIB_ZCK_DICT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <glib.h>
+
+/** \defgroup   zck_dict  Training of zchunk dictionaries from repodata.
+ *  \addtogroup zck_dict
+ *  @{
+ */
+
+/** Default size of a trained dictionary (the zstd default).
+ */
+#define CR_ZCK_DICT_DEFAULT_SIZE            (110*1024)
+
+/** Default maximal size of the samples used for training. If there
+ * are more chunks, an evenly spaced subset of them is used.
+ */
+#define CR_ZCK_DICT_DEFAULT_MAX_SAMPLES     (128*1024*1024)
+
+/** Metadata for which a dictionary is trained.
+ */
+typedef enum {
+    CR_ZCK_DICT_PRIMARY,        /*!< primary.xml */
+    CR_ZCK_DICT_FILELISTS,      /*!< filelists.xml */
+    CR_ZCK_DICT_OTHER,          /*!< other.xml */
+    CR_ZCK_DICT_SENTINEL,       /*!< Sentinel of the list */
+} cr_ZckDictType;
+
+/** Chunks sampled from repodata. A chunk contains the xml of all
+ * consecutive packages built from the same srpm, exactly as
+ * createrepo_c splits the zchunk metadata.
+ */
+typedef struct _cr_ZckDictSamples cr_ZckDictSamples;
+
+/** Statistics of the chunks compressed with and without a dictionary.
+ */
+typedef struct {
+    guint64 chunks;                 /*!< Number of chunks */
+    guint64 size;                   /*!< Uncompressed size of the chunks */
+    guint64 compressed_size;        /*!< Compressed size without dict */
+    guint64 dict_compressed_size;   /*!< Compressed size with the dict */
+    guint64 changed_chunks;         /*!< Number of chunks which would be
+                                         downloaded by a delta update */
+    guint64 changed_compressed_size; /*!< Download size without dict */
+    guint64 changed_dict_compressed_size; /*!< Download size with dict */
+} cr_ZckDictStats;
+
+/** Name of the dictionary file for the metadata type, as expected in
+ * the directory passed by --zck-dict-dir (e.g. "primary.xml.zdict").
+ * @param type          Metadata type
+ * @return              Static string
+ */
+const char *cr_zck_dict_filename(cr_ZckDictType type);
+
+/** Create an empty set of samples.
+ * @return              cr_ZckDictSamples
+ */
+cr_ZckDictSamples *cr_zck_dict_samples_new(void);
+
+/** Free the samples.
+ * @param samples       cr_ZckDictSamples
+ */
+void cr_zck_dict_samples_free(cr_ZckDictSamples *samples);
+
+/** Load primary, filelists and other of the repository and add their
+ * per-srpm chunks to the samples.
+ * @param samples       cr_ZckDictSamples
+ * @param repopath      Path (or url) of the repository
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+int cr_zck_dict_samples_add_repo(cr_ZckDictSamples *samples,
+                                 const char *repopath,
+                                 GError **err);
+
+/** Number of the sampled chunks.
+ * @param samples       cr_ZckDictSamples
+ * @param type          Metadata type
+ * @return              Number of chunks
+ */
+guint cr_zck_dict_samples_count(cr_ZckDictSamples *samples,
+                                cr_ZckDictType type);
+
+/** Move every second chunk (the odd-indexed ones) of every metadata
+ * type from the samples into new samples. A dictionary trained on the
+ * remaining chunks can be evaluated on the moved ones, a dictionary
+ * evaluated on its own training chunks looks better than it is.
+ * @param samples       cr_ZckDictSamples
+ * @return              Samples with the moved chunks
+ */
+cr_ZckDictSamples *cr_zck_dict_samples_split(cr_ZckDictSamples *samples);
+
+/** Train a zstd dictionary from the chunks of the metadata type.
+ * @param samples       cr_ZckDictSamples
+ * @param type          Metadata type
+ * @param dict_size     Maximal size of the dictionary
+ * @param max_samples   Maximal size of the chunks used for training,
+ *                      evenly spaced chunks are used up to this size
+ *                      if there are more
+ * @param len           Size of the trained dictionary (output)
+ * @param err           GError **
+ * @return              Malloced dictionary or NULL on error
+ */
+char *cr_zck_dict_train(cr_ZckDictSamples *samples,
+                        cr_ZckDictType type,
+                        size_t dict_size,
+                        size_t max_samples,
+                        size_t *len,
+                        GError **err);
+
+/** Compress every chunk separately (as zchunk does) with and without
+ * the dictionary and fill the statistics. Chunks which are not present
+ * in the old samples are counted as changed (downloaded by a delta
+ * update). Without the old samples all chunks are changed.
+ * The samples shouldn't contain the chunks the dictionary was trained
+ * on (see cr_zck_dict_samples_split()).
+ * @param samples       cr_ZckDictSamples
+ * @param old_samples   Samples of the previous version of the repo
+ *                      or NULL
+ * @param type          Metadata type
+ * @param dict          Dictionary or NULL
+ * @param dict_len      Size of the dictionary
+ * @param stats         Statistics (output)
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+int cr_zck_dict_evaluate(cr_ZckDictSamples *samples,
+                         cr_ZckDictSamples *old_samples,
+                         cr_ZckDictType type,
+                         const void *dict,
+                         size_t dict_len,
+                         cr_ZckDictStats *stats,
+                         GError **err);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __C_CREATEREPOLIB_ZCK_DICT_H__ */
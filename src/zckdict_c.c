@@ -0,0 +1,336 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "cleanup.h"
+#include "version.h"
+#include "createrepo_shared.h"
+#include "xml_dump.h"
+#include "zck_dict.h"
+
+/**
+ * Command line options
+ */
+typedef struct {
+
+    /* Items filled by cmd option parser */
+
+    gboolean version;           /*!< print program version */
+    gboolean quiet;             /*!< quiet mode */
+    gboolean verbose;           /*!< verbose mode */
+    gchar *outputdir;           /*!< where to write the dictionaries */
+    gchar **old_repos;          /*!< previous versions of the repos */
+    gint64 dict_size;           /*!< maximal size of a dictionary */
+    gint64 max_samples;         /*!< maximal size of training samples */
+    gboolean dry_run;           /*!< only print the statistics */
+
+} ZckdictCmdOptions;
+
+static ZckdictCmdOptions *
+zckdictcmdoptions_new(void)
+{
+    ZckdictCmdOptions *options;
+
+    options = g_new0(ZckdictCmdOptions, 1);
+    options->dict_size = CR_ZCK_DICT_DEFAULT_SIZE;
+    options->max_samples = CR_ZCK_DICT_DEFAULT_MAX_SAMPLES;
+
+    return options;
+}
+
+static void
+zckdictcmdoptions_free(ZckdictCmdOptions *options)
+{
+    g_free(options->outputdir);
+    g_strfreev(options->old_repos);
+    g_free(options);
+}
+
+CR_DEFINE_CLEANUP_FUNCTION0(ZckdictCmdOptions*, cr_local_zckdictcmdoptions_free, zckdictcmdoptions_free)
+#define _cleanup_zckdictcmdoptions_free_ __attribute__ ((cleanup(cr_local_zckdictcmdoptions_free)))
+
+/**
+ * Parse commandline arguments for zckdict utility
+ */
+static gboolean
+parse_zckdict_arguments(int *argc,
+                        char ***argv,
+                        ZckdictCmdOptions *options,
+                        GError **err)
+{
+    const GOptionEntry cmd_entries[] = {
+
+        { "version", 'V', 0, G_OPTION_ARG_NONE, &(options->version),
+          "Show program's version number and exit.", NULL},
+        { "quiet", 'q', 0, G_OPTION_ARG_NONE, &(options->quiet),
+          "Run quietly.", NULL },
+        { "verbose", 'v', 0, G_OPTION_ARG_NONE, &(options->verbose),
+          "Run verbosely.", NULL },
+        { "outputdir", 'o', 0, G_OPTION_ARG_FILENAME, &(options->outputdir),
+          "Directory where the dictionaries are written (current directory "
+          "by default). Use it as --zck-dict-dir of createrepo_c.", "<dir>" },
+        { "old-repo", '\0', 0, G_OPTION_ARG_FILENAME_ARRAY, &(options->old_repos),
+          "Previous version of the repository. Used to estimate the size of "
+          "a delta download of the zchunk metadata. Can be specified "
+          "multiple times.", "<repo>" },
+        { "dict-size", '\0', 0, G_OPTION_ARG_INT64, &(options->dict_size),
+          "Maximal size of a dictionary in bytes (default 112640).", "<bytes>" },
+        { "max-samples-size", '\0', 0, G_OPTION_ARG_INT64, &(options->max_samples),
+          "Maximal size of the metadata used for training in bytes "
+          "(default 134217728). Evenly spaced chunks are used if the "
+          "training chunks are bigger.", "<bytes>" },
+        { "dry-run", '\0', 0, G_OPTION_ARG_NONE, &(options->dry_run),
+          "Do not write the dictionaries, only print the statistics.", NULL },
+        { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL },
+    };
+
+    // Parse cmd arguments
+    GOptionContext *context;
+    context = g_option_context_new("<repo> [<repo>...]");
+    g_option_context_set_summary(context, "Train zchunk dictionaries for "
+            "primary, filelists and other xml from existing repodata and "
+            "show how much they save. The dictionaries are trained on every "
+            "second chunk of the metadata and evaluated on the other ones.");
+    g_option_context_add_main_entries(context, cmd_entries, NULL);
+    gboolean ret = g_option_context_parse(context, argc, argv, err);
+    g_option_context_free(context);
+    return ret;
+}
+
+/**
+ * Check parsed arguments and fill some other attributes
+ * of option struct accordingly.
+ */
+static gboolean
+check_arguments(ZckdictCmdOptions *options, GError **err)
+{
+    // --dict-size
+    if (options->dict_size <= 0) {
+        g_set_error(err, CREATEREPO_C_ERROR, CRE_BADARG,
+                    "Dictionary size must be a positive number");
+        return FALSE;
+    }
+
+    // --max-samples-size
+    if (options->max_samples < options->dict_size) {
+        g_set_error(err, CREATEREPO_C_ERROR, CRE_BADARG,
+                    "Size of the samples must be at least the dictionary size");
+        return FALSE;
+    }
+
+    // --outputdir
+    if (!options->outputdir)
+        options->outputdir = g_strdup(".");
+
+    if (!options->dry_run
+        && !g_file_test(options->outputdir, G_FILE_TEST_IS_DIR))
+    {
+        g_set_error(err, CREATEREPO_C_ERROR, CRE_NODIR,
+                    "Directory %s doesn't exist", options->outputdir);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static double
+percent(guint64 part, guint64 total)
+{
+    return total ? 100.0 * part / total : 0.0;
+}
+
+static double
+saved(guint64 with_dict, guint64 without_dict)
+{
+    return without_dict ? 100.0 - percent(with_dict, without_dict) : 0.0;
+}
+
+/**
+ * Print the statistics of the dictionary.
+ */
+static void
+print_stats(cr_ZckDictType type,
+            size_t dict_len,
+            guint training_chunks,
+            cr_ZckDictStats *stats,
+            gboolean delta)
+{
+    guint64 chunks = MAX(stats->chunks, 1);
+
+    printf("%s\n", cr_zck_dict_filename(type));
+    printf("  Dictionary size:           %zu bytes\n", dict_len);
+    printf("  Training chunks:           %u\n", training_chunks);
+    printf("  Held-out chunks:           %"G_GUINT64_FORMAT" "
+           "(not used for training, the figures below are for them)\n",
+           stats->chunks);
+    printf("  Average chunk size:        %"G_GUINT64_FORMAT" bytes\n",
+           stats->size / chunks);
+    printf("  Average compressed chunk:  %"G_GUINT64_FORMAT" bytes "
+           "(%"G_GUINT64_FORMAT" with dictionary, %.1f %% saved)\n",
+           stats->compressed_size / chunks,
+           stats->dict_compressed_size / chunks,
+           saved(stats->dict_compressed_size, stats->compressed_size));
+    printf("  Compressed size:           %"G_GUINT64_FORMAT" bytes "
+           "(%"G_GUINT64_FORMAT" with dictionary)\n",
+           stats->compressed_size, stats->dict_compressed_size);
+
+    if (!delta)
+        return;
+
+    printf("  Changed chunks:            %"G_GUINT64_FORMAT" (%.1f %%)\n",
+           stats->changed_chunks,
+           percent(stats->changed_chunks, stats->chunks));
+    printf("  Delta download:            %"G_GUINT64_FORMAT" bytes "
+           "(%"G_GUINT64_FORMAT" with dictionary, %.1f %% saved; "
+           "the dictionary itself is downloaded only once)\n",
+           stats->changed_compressed_size,
+           stats->changed_dict_compressed_size,
+           saved(stats->changed_dict_compressed_size,
+                 stats->changed_compressed_size));
+}
+
+/**
+ * Train and write the dictionary for the metadata type and evaluate it
+ * on the held-out chunks.
+ */
+static gboolean
+process_type(ZckdictCmdOptions *options,
+             cr_ZckDictType type,
+             cr_ZckDictSamples *samples,
+             cr_ZckDictSamples *held_out,
+             cr_ZckDictSamples *old_samples,
+             GError **err)
+{
+    _cleanup_free_ gchar *dict = NULL;
+    size_t dict_len = 0;
+    cr_ZckDictStats stats;
+
+    g_debug("Training %s from %u chunks", cr_zck_dict_filename(type),
+            cr_zck_dict_samples_count(samples, type));
+
+    dict = cr_zck_dict_train(samples, type, options->dict_size,
+                             options->max_samples, &dict_len, err);
+    if (!dict)
+        return FALSE;
+
+    if (!options->dry_run) {
+        _cleanup_free_ gchar *path = g_build_filename(options->outputdir,
+                                            cr_zck_dict_filename(type), NULL);
+        g_debug("Writing %s", path);
+        if (!g_file_set_contents(path, dict, dict_len, err))
+            return FALSE;
+    }
+
+    if (cr_zck_dict_evaluate(held_out, old_samples, type, dict, dict_len,
+                             &stats, err) != CRE_OK)
+        return FALSE;
+
+    if (!options->quiet)
+        print_stats(type, dict_len, cr_zck_dict_samples_count(samples, type),
+                    &stats, old_samples != NULL);
+
+    return TRUE;
+}
+
+int
+main(int argc, char **argv)
+{
+    int ret = EXIT_SUCCESS;
+    _cleanup_zckdictcmdoptions_free_ ZckdictCmdOptions *options = NULL;
+    _cleanup_error_free_ GError *tmp_err = NULL;
+    cr_ZckDictSamples *samples = NULL, *held_out = NULL, *old_samples = NULL;
+
+    // Parse arguments
+    options = zckdictcmdoptions_new();
+    if (!parse_zckdict_arguments(&argc, &argv, options, &tmp_err)) {
+        g_printerr("%s\n", tmp_err->message);
+        exit(EXIT_FAILURE);
+    }
+
+    // Set logging
+    cr_setup_logging(FALSE, options->verbose);
+
+    // Print version if required
+    if (options->version) {
+        printf("Version: %s\n", cr_version_string_with_features());
+        exit(EXIT_SUCCESS);
+    }
+
+    // Check arguments
+    if (!check_arguments(options, &tmp_err)) {
+        g_printerr("%s\n", tmp_err->message);
+        exit(EXIT_FAILURE);
+    }
+
+    if (argc < 2) {
+        g_printerr("Must specify at least one repository\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Emit debug message with version
+    g_debug("Version: %s", cr_version_string_with_features());
+
+    cr_xml_dump_init();
+
+    // Load the chunks
+    samples = cr_zck_dict_samples_new();
+    for (int i = 1; i < argc; i++) {
+        g_debug("Loading %s", argv[i]);
+        if (cr_zck_dict_samples_add_repo(samples, argv[i], &tmp_err) != CRE_OK)
+            goto exit;
+    }
+
+    if (options->old_repos) {
+        old_samples = cr_zck_dict_samples_new();
+        for (gchar **repo = options->old_repos; *repo; repo++) {
+            g_debug("Loading %s", *repo);
+            if (cr_zck_dict_samples_add_repo(old_samples, *repo,
+                                             &tmp_err) != CRE_OK)
+                goto exit;
+        }
+    }
+
+    // Keep every second chunk out of the training, a dictionary evaluated
+    // on its training data would look better than it is
+    held_out = cr_zck_dict_samples_split(samples);
+
+    // Train the dictionaries
+    for (int type = 0; type < CR_ZCK_DICT_SENTINEL; type++)
+        if (!process_type(options, type, samples, held_out, old_samples,
+                          &tmp_err))
+            goto exit;
+
+exit:
+    if (tmp_err) {
+        g_printerr("%s\n", tmp_err->message);
+        ret = EXIT_FAILURE;
+    }
+
+    cr_zck_dict_samples_free(old_samples);
+    cr_zck_dict_samples_free(held_out);
+    cr_zck_dict_samples_free(samples);
+    cr_xml_dump_cleanup();
+
+    exit(ret);
+}
@@ -1,10 +1,19 @@
 import unittest
 import os.path
+import shutil
+import tempfile
 import createrepo_c as cr
 
 from .fixtures import *
 
 class TestCaseCompressionWrapper(unittest.TestCase):
+
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp(prefix="createrepo_ctest-")
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir, True)
+
     def test_compression_suffix(self):
         self.assertEqual(cr.compression_suffix(cr.AUTO_DETECT_COMPRESSION), None)
         self.assertEqual(cr.compression_suffix(cr.UNKNOWN_COMPRESSION), None)
@@ -15,6 +24,7 @@ class TestCaseCompressionWrapper(unittest.TestCase):
         self.assertEqual(cr.compression_suffix(cr.BZ2), ".bz2")
         self.assertEqual(cr.compression_suffix(cr.XZ), ".xz")
         self.assertEqual(cr.compression_suffix(cr.ZCK), ".zck")
+        self.assertEqual(cr.compression_suffix(cr.ZSTD), ".zst")
 
     def test_detect_compression(self):
 
@@ -43,6 +53,11 @@ class TestCaseCompressionWrapper(unittest.TestCase):
         comtype = cr.detect_compression(path)
         self.assertEqual(comtype, cr.ZCK)
 
+        # zstd compression
+        path = os.path.join(COMPRESSED_FILES_PATH, "01_plain.txt.zst")
+        comtype = cr.detect_compression(path)
+        self.assertEqual(comtype, cr.ZSTD)
+
         # Bad suffix - no compression
         path = os.path.join(COMPRESSED_FILES_PATH, "01_plain.foo0")
         comtype = cr.detect_compression(path)
@@ -69,6 +84,11 @@ class TestCaseCompressionWrapper(unittest.TestCase):
         #comtype = cr.detect_compression(path)
         #self.assertEqual(comtype, cr.ZCK)
 
+        # Bad suffix - zstd compression
+        path = os.path.join(COMPRESSED_FILES_PATH, "01_plain.foo5")
+        comtype = cr.detect_compression(path)
+        self.assertEqual(comtype, cr.ZSTD)
+
     def test_compression_type(self):
         self.assertEqual(cr.compression_type(None), cr.UNKNOWN_COMPRESSION)
         self.assertEqual(cr.compression_type(""), cr.UNKNOWN_COMPRESSION)
@@ -77,4 +97,19 @@ class TestCaseCompressionWrapper(unittest.TestCase):
         self.assertEqual(cr.compression_type("xz"), cr.XZ)
         self.assertEqual(cr.compression_type("XZ"), cr.XZ)
         self.assertEqual(cr.compression_type("zck"), cr.ZCK)
-
+        self.assertEqual(cr.compression_type("zstd"), cr.ZSTD)
+
+    def test_compress_file_zstd(self):
+        if cr.HAS_ZSTD == 0:
+            return
+
+        compressed = os.path.join(self.tmpdir, "primary.xml.zst")
+        decompressed = os.path.join(self.tmpdir, "primary.xml")
+        cr.compress_file(REPO_02_PRIXML, compressed, cr.ZSTD)
+        self.assertEqual(cr.detect_compression(compressed), cr.ZSTD)
+        cr.decompress_file(compressed, decompressed, cr.ZSTD)
+
+        original = os.path.join(self.tmpdir, "original.xml")
+        cr.decompress_file(REPO_02_PRIXML, original, cr.AUTO_DETECT_COMPRESSION)
+        with open(original, "rb") as f_orig, open(decompressed, "rb") as f_dec:
+            self.assertEqual(f_orig.read(), f_dec.read())
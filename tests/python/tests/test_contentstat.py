@@ -1,3 +1,4 @@
+import hashlib
 import unittest
 import shutil
 import tempfile
@@ -84,3 +85,23 @@ class TestCaseContentStat(unittest.TestCase):
         f.close()
 
         self.assertTrue(os.path.isfile(path))
+
+    def test_contentstat_compressed(self):
+        """Checksum of the compressed file is computed while writing"""
+
+        for compression, suffix in ((cr.BZ2_COMPRESSION, ".bz2"),
+                                    (cr.XZ_COMPRESSION, ".xz"),
+                                    (cr.NO_COMPRESSION, "")):
+            cs = cr.ContentStat(cr.SHA256)
+            self.assertEqual(cs.compressed_checksum, None)
+
+            path = os.path.join(self.tmpdir, "foofile" + suffix)
+            f = cr.CrFile(path, cr.MODE_WRITE, compression, cs)
+            f.write("foobar" * 1000)
+            f.close()
+
+            self.assertEqual(cs.size, 6000)
+            self.assertEqual(cs.compressed_size, os.path.getsize(path))
+            with open(path, "rb") as f:
+                checksum = hashlib.sha256(f.read()).hexdigest()
+            self.assertEqual(cs.compressed_checksum, checksum)
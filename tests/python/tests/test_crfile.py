@@ -105,6 +105,22 @@ class TestCaseCrFile(unittest.TestCase):
         content = p.stdout.read().decode('utf-8')
         self.assertEqual(content, "foobar")
 
+    def test_crfile_zstd_compression(self):
+        if cr.HAS_ZSTD == 0:
+            return
+
+        path = os.path.join(self.tmpdir, "foo.zst")
+        f = cr.CrFile(path, cr.MODE_WRITE, cr.ZSTD_COMPRESSION)
+        self.assertTrue(f)
+        self.assertTrue(os.path.isfile(path))
+        f.write("foobar")
+        f.close()
+
+        dst = os.path.join(self.tmpdir, "foo")
+        cr.decompress_file(path, dst, cr.AUTO_DETECT_COMPRESSION)
+        with open(dst) as plain:
+            self.assertEqual(plain.read(), "foobar")
+
     def test_crfile_zck_compression(self):
         if cr.HAS_ZCK == 0:
             return
@@ -0,0 +1,142 @@
+import os
+import time
+import shutil
+import sqlite3
+import tempfile
+import threading
+import unittest
+import createrepo_c as cr
+
+from .fixtures import *
+
+# Heavy functions release the GIL while doing the C work, so they
+# could be called from multiple Python threads in parallel
+
+PACKAGES = [PKG_ARCHER_PATH, PKG_BALICEK_UTF8_PATH, PKG_EMPTY_PATH,
+            PKG_FAKE_BASH_PATH, PKG_SUPER_KERNEL_PATH]
+
+BENCHMARK_ROUNDS = 200
+
+# The benchmark only prints timings, run it only when asked for
+BENCHMARK = os.environ.get("CR_BENCHMARK", "OFF").upper() != "OFF"
+
+
+def run_in_threads(func, items, threads):
+    """Call func for every item from the given number of threads and
+    return the list of results (in the order of items)."""
+    results = [None] * len(items)
+    errors = []
+    lock = threading.Lock()
+    indexes = iter(range(len(items)))
+
+    def worker():
+        while True:
+            with lock:
+                try:
+                    i = next(indexes)
+                except StopIteration:
+                    return
+            try:
+                results[i] = func(items[i])
+            except Exception as e:
+                with lock:
+                    errors.append(e)
+                return
+
+    workers = [threading.Thread(target=worker) for _ in range(threads)]
+    for w in workers:
+        w.start()
+    for w in workers:
+        w.join()
+
+    if errors:
+        raise errors[0]
+    return results
+
+
+def parse_primary(path):
+    pkgs = []
+    cr.xml_parse_primary(path, None, pkgs.append, None, 1)
+    return [pkg.nevra() for pkg in pkgs]
+
+
+class TestCaseThreads(unittest.TestCase):
+
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp(prefix="createrepo_ctest-")
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir, True)
+
+    def test_package_from_rpm_threads(self):
+        items = PACKAGES * 20
+        expected = [cr.package_from_rpm(path).nevra() for path in items]
+        results = run_in_threads(lambda path: cr.package_from_rpm(path).nevra(),
+                                 items, 4)
+        self.assertEqual(results, expected)
+
+    def test_xml_from_rpm_threads(self):
+        items = PACKAGES * 20
+        expected = [cr.xml_from_rpm(path) for path in items]
+        results = run_in_threads(cr.xml_from_rpm, items, 4)
+        self.assertEqual(results, expected)
+
+    def test_xml_parse_primary_threads(self):
+        items = [REPO_01_PRIXML, REPO_02_PRIXML] * 20
+        expected = [parse_primary(path) for path in items]
+        results = run_in_threads(parse_primary, items, 4)
+        self.assertEqual(results, expected)
+
+    def test_xml_parse_primary_threads_error(self):
+        # Exception raised in a callback is propagated from its thread
+        def parse(path):
+            def pkgcb(pkg):
+                raise ValueError("stop")
+            cr.xml_parse_primary(path, None, pkgcb, None, 1)
+
+        self.assertRaises(cr.CreaterepoCError, run_in_threads, parse,
+                          [REPO_01_PRIXML] * 8, 4)
+
+    def test_compress_file_threads(self):
+        def compress(i):
+            dst = os.path.join(self.tmpdir, "primary_%d.xml.gz" % i)
+            stat = cr.ContentStat(cr.SHA256)
+            cr.compress_file(REPO_02_PRIXML, dst,
+                             cr.GZ_COMPRESSION, stat)
+            return stat.checksum
+
+        results = run_in_threads(compress, list(range(16)), 4)
+        self.assertEqual(len(set(results)), 1)
+
+    def test_sqlite_add_pkg_threads(self):
+        path = os.path.join(self.tmpdir, "primary.sqlite")
+        db = cr.PrimarySqlite(path)
+        pkgs = [cr.package_from_rpm(p) for p in PACKAGES] * 10
+        run_in_threads(db.add_pkg, pkgs, 4)
+        db.close()
+
+        con = sqlite3.connect(path)
+        count, = con.execute("SELECT COUNT(*) FROM packages").fetchone()
+        con.close()
+        self.assertEqual(count, len(pkgs))
+
+    def test_sqlite_closed_db(self):
+        path = os.path.join(self.tmpdir, "primary.sqlite")
+        db = cr.PrimarySqlite(path)
+        db.close()
+        pkg = cr.package_from_rpm(PKG_ARCHER_PATH)
+        self.assertRaises(cr.CreaterepoCError, db.add_pkg, pkg)
+        self.assertRaises(cr.CreaterepoCError, db.dbinfo_update, "foo")
+
+    @unittest.skipUnless(BENCHMARK, "Set CR_BENCHMARK=ON to run benchmarks")
+    def test_benchmark_xml_from_rpm(self):
+        # Not a real test, it only shows how the loading scales
+        items = PACKAGES * (BENCHMARK_ROUNDS // len(PACKAGES))
+        print("")
+        for threads in (1, 2, 4):
+            start = time.time()
+            run_in_threads(cr.xml_from_rpm, items, threads)
+            elapsed = time.time() - start
+            print("xml_from_rpm: %d threads: %d packages in %.3f s "
+                  "(%.0f pkgs/s)" % (threads, len(items), elapsed,
+                                      len(items) / max(elapsed, 1e-6)))
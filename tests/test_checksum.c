@@ -24,6 +24,7 @@
 #include <unistd.h>
 #include "fixtures.h"
 #include "createrepo/checksum.h"
+#include "createrepo/error.h"
 
 static void
 test_cr_checksum_file(void)
@@ -99,6 +100,68 @@ test_cr_checksum_file(void)
 }
 
 
+static void
+test_cr_checksum_read_size(void)
+{
+    char *checksum;
+    cr_ChecksumStats stats;
+
+    // Rounded up to the whole pages
+    cr_checksum_set_read_size(1);
+    g_assert_cmpuint(cr_checksum_get_read_size(), ==, 4096);
+
+    cr_checksum_reset_stats();
+    checksum = cr_checksum_file(TEST_BINARY_FILE, CR_CHECKSUM_SHA256, NULL);
+    g_assert_cmpstr(checksum, ==, "bf68e32ad78cea8287be0f35b74fa3fecd0eaa91770"
+            "b48f1a7282b015d6d883e");
+    g_free(checksum);
+
+    cr_checksum_get_stats(&stats);
+    g_assert_cmpint(stats.files, ==, 1);
+    g_assert_cmpint(stats.bytes, >, 0);
+
+    cr_checksum_set_read_size(0);
+    g_assert_cmpuint(cr_checksum_get_read_size(), ==,
+                     CR_CHECKSUM_DEFAULT_READ_SIZE);
+}
+
+
+static void
+test_cr_checksum_file_big(void)
+{
+    // Big (sparse) file is checksummed by several reads
+    gint64 size = 40*1024*1024;
+    char *tmpfn = NULL;
+    char *checksum, *expected;
+    cr_ChecksumCtx *ctx;
+    char *zeros = g_malloc0(1024*1024);
+
+    int fd = g_file_open_tmp("createrepo_c_test_checksum_XXXXXX", &tmpfn, NULL);
+    g_assert_cmpint(fd, >=, 0);
+    g_assert_cmpint(ftruncate(fd, size), ==, 0);
+    close(fd);
+
+    ctx = cr_checksum_new(CR_CHECKSUM_SHA256, NULL);
+    for (gint64 x = 0; x < size; x += 1024*1024)
+        cr_checksum_update(ctx, zeros, 1024*1024, NULL);
+    expected = cr_checksum_final(ctx, NULL);
+
+    cr_checksum_reset_stats();
+    checksum = cr_checksum_file(tmpfn, CR_CHECKSUM_SHA256, NULL);
+    g_assert_cmpstr(checksum, ==, expected);
+
+    cr_ChecksumStats stats;
+    cr_checksum_get_stats(&stats);
+    g_assert_cmpint(stats.bytes, ==, size);
+
+    g_remove(tmpfn);
+    g_free(tmpfn);
+    g_free(zeros);
+    g_free(checksum);
+    g_free(expected);
+}
+
+
 static void
 test_cr_checksum_name_str(void)
 {
@@ -136,6 +199,10 @@ main(int argc, char *argv[])
 
     g_test_add_func("/checksum/test_cr_checksum_file",
             test_cr_checksum_file);
+    g_test_add_func("/checksum/test_cr_checksum_read_size",
+            test_cr_checksum_read_size);
+    g_test_add_func("/checksum/test_cr_checksum_file_big",
+            test_cr_checksum_file_big);
     g_test_add_func("/checksum/test_cr_checksum_name_str",
             test_cr_checksum_name_str);
 
@@ -0,0 +1,237 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "fixtures.h"
+#include "createrepo/checksum_cache.h"
+#include "createrepo/error.h"
+#include "createrepo/misc.h"
+
+
+typedef struct {
+    gchar *tmp_dir;
+    gchar *path;
+} TestData;
+
+
+static void
+testdata_setup(TestData *testdata,
+               G_GNUC_UNUSED gconstpointer test_data)
+{
+    testdata->tmp_dir = g_strdup(TMPDIR_TEMPLATE);
+    mkdtemp(testdata->tmp_dir);
+    testdata->path = g_build_filename(testdata->tmp_dir,
+                                      CR_CHECKSUM_CACHE_FILENAME, NULL);
+}
+
+
+static void
+testdata_teardown(TestData *testdata,
+                  G_GNUC_UNUSED gconstpointer test_data)
+{
+    cr_remove_dir(testdata->tmp_dir, NULL);
+    g_free(testdata->tmp_dir);
+    g_free(testdata->path);
+}
+
+
+static void
+test_cr_checksum_cache_add_lookup(TestData *testdata,
+                                  G_GNUC_UNUSED gconstpointer test_data)
+{
+    int rc;
+    char *checksum;
+    GError *err = NULL;
+    cr_ChecksumCache *cache;
+
+    cache = cr_checksum_cache_open(testdata->path, &err);
+    g_assert(cache);
+    g_assert(!err);
+    g_assert(g_file_test(testdata->path, G_FILE_TEST_EXISTS));
+    g_assert_cmpuint(cr_checksum_cache_size(cache), ==, 0);
+
+    g_assert(!cr_checksum_cache_lookup(cache, "foo-abc-10-20"));
+
+    rc = cr_checksum_cache_add(cache, "foo-abc-10-20", "1234", &err);
+    g_assert_cmpint(rc, ==, CRE_OK);
+    g_assert(!err);
+
+    checksum = cr_checksum_cache_lookup(cache, "foo-abc-10-20");
+    g_assert_cmpstr(checksum, ==, "1234");
+    g_free(checksum);
+
+    rc = cr_checksum_cache_close(cache, &err);
+    g_assert_cmpint(rc, ==, CRE_OK);
+    g_assert(!err);
+
+    // Records are persistent
+
+    cache = cr_checksum_cache_open(testdata->path, &err);
+    g_assert(cache);
+    g_assert(!err);
+    g_assert_cmpuint(cr_checksum_cache_size(cache), ==, 1);
+
+    checksum = cr_checksum_cache_lookup(cache, "foo-abc-10-20");
+    g_assert_cmpstr(checksum, ==, "1234");
+    g_free(checksum);
+
+    cr_checksum_cache_close(cache, NULL);
+}
+
+
+static void
+test_cr_checksum_cache_batches(TestData *testdata,
+                               G_GNUC_UNUSED gconstpointer test_data)
+{
+    GError *err = NULL;
+    cr_ChecksumCache *cache;
+    guint count = CR_CHECKSUM_CACHE_BATCH_SIZE * 2 + 1;
+
+    cache = cr_checksum_cache_open(testdata->path, &err);
+    g_assert(cache);
+
+    for (guint x = 0; x < count; x++) {
+        gchar *key = g_strdup_printf("pkg%u-key-1-1", x);
+        gchar *sum = g_strdup_printf("%u", x);
+        g_assert_cmpint(cr_checksum_cache_add(cache, key, sum, &err), ==, CRE_OK);
+        g_free(key);
+        g_free(sum);
+    }
+
+    g_assert_cmpint(cr_checksum_cache_flush(cache, &err), ==, CRE_OK);
+    g_assert(!err);
+
+    // Other instance sees all the flushed records
+    cr_ChecksumCache *cache2 = cr_checksum_cache_open(testdata->path, &err);
+    g_assert(cache2);
+    g_assert_cmpuint(cr_checksum_cache_size(cache2), ==, count);
+    cr_checksum_cache_close(cache2, NULL);
+
+    cr_checksum_cache_close(cache, NULL);
+}
+
+
+static void
+test_cr_checksum_cache_gc(TestData *testdata,
+                          G_GNUC_UNUSED gconstpointer test_data)
+{
+    char *checksum;
+    GError *err = NULL;
+    cr_ChecksumCache *cache;
+
+    cache = cr_checksum_cache_open(testdata->path, &err);
+    g_assert(cache);
+    cr_checksum_cache_add(cache, "used-a-1-1", "aaa", NULL);
+    cr_checksum_cache_add(cache, "unused-b-1-1", "bbb", NULL);
+    cr_checksum_cache_close(cache, NULL);
+
+    // Only the looked up record survives
+    cache = cr_checksum_cache_open(testdata->path, &err);
+    g_assert(cache);
+    checksum = cr_checksum_cache_lookup(cache, "used-a-1-1");
+    g_assert_cmpstr(checksum, ==, "aaa");
+    g_free(checksum);
+    cr_checksum_cache_add(cache, "new-c-1-1", "ccc", NULL);
+
+    g_assert_cmpint(cr_checksum_cache_gc(cache, &err), ==, 1);
+    g_assert(!err);
+    g_assert_cmpuint(cr_checksum_cache_size(cache), ==, 2);
+    g_assert(!cr_checksum_cache_lookup(cache, "unused-b-1-1"));
+    cr_checksum_cache_close(cache, NULL);
+
+    cache = cr_checksum_cache_open(testdata->path, &err);
+    g_assert(cache);
+    g_assert_cmpuint(cr_checksum_cache_size(cache), ==, 2);
+    g_assert(!cr_checksum_cache_lookup(cache, "unused-b-1-1"));
+    cr_checksum_cache_close(cache, NULL);
+}
+
+
+static void
+test_cr_checksum_cache_gc_touched(TestData *testdata,
+                                  G_GNUC_UNUSED gconstpointer test_data)
+{
+    char *checksum;
+    GError *err = NULL;
+    cr_ChecksumCache *cache;
+
+    // The first run reads all the packages and drpms
+    cache = cr_checksum_cache_open(testdata->path, &err);
+    g_assert(cache);
+    cr_checksum_cache_add(cache, "reused.rpm-a-1-1", "aaa", NULL);
+    cr_checksum_cache_add(cache, "removed.rpm-b-1-1", "bbb", NULL);
+    cr_checksum_cache_add(cache, CR_CHECKSUM_CACHE_DRPM_PREFIX"x.drpm-1-1",
+                          "ddd", NULL);
+    cr_checksum_cache_close(cache, NULL);
+
+    // The --update run with --cache-gc but without --deltas reuses
+    // the old metadata of reused.rpm, so its header isn't read
+    cache = cr_checksum_cache_open(testdata->path, &err);
+    g_assert(cache);
+    g_assert_cmpuint(cr_checksum_cache_touch_checksum(cache, "aaa"), ==, 1);
+    g_assert_cmpuint(cr_checksum_cache_touch_checksum(cache, "zzz"), ==, 0);
+    cr_checksum_cache_add(cache, "new.rpm-c-1-1", "ccc", NULL);
+    g_assert_cmpuint(cr_checksum_cache_touch_checksum(cache, "ccc"), ==, 1);
+    g_assert_cmpuint(cr_checksum_cache_touch_prefix(cache,
+                            CR_CHECKSUM_CACHE_DRPM_PREFIX), ==, 1);
+
+    g_assert_cmpint(cr_checksum_cache_gc(cache, &err), ==, 1);
+    g_assert(!err);
+    cr_checksum_cache_close(cache, NULL);
+
+    // Only the checksum of the removed package is gone
+    cache = cr_checksum_cache_open(testdata->path, &err);
+    g_assert(cache);
+    g_assert_cmpuint(cr_checksum_cache_size(cache), ==, 3);
+    checksum = cr_checksum_cache_lookup(cache, "reused.rpm-a-1-1");
+    g_assert_cmpstr(checksum, ==, "aaa");
+    g_free(checksum);
+    checksum = cr_checksum_cache_lookup(cache,
+                            CR_CHECKSUM_CACHE_DRPM_PREFIX"x.drpm-1-1");
+    g_assert_cmpstr(checksum, ==, "ddd");
+    g_free(checksum);
+    g_assert(!cr_checksum_cache_lookup(cache, "removed.rpm-b-1-1"));
+    cr_checksum_cache_close(cache, NULL);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/checksum_cache/test_cr_checksum_cache_add_lookup",
+               TestData, NULL, testdata_setup,
+               test_cr_checksum_cache_add_lookup, testdata_teardown);
+    g_test_add("/checksum_cache/test_cr_checksum_cache_batches",
+               TestData, NULL, testdata_setup,
+               test_cr_checksum_cache_batches, testdata_teardown);
+    g_test_add("/checksum_cache/test_cr_checksum_cache_gc",
+               TestData, NULL, testdata_setup,
+               test_cr_checksum_cache_gc, testdata_teardown);
+    g_test_add("/checksum_cache/test_cr_checksum_cache_gc_touched",
+               TestData, NULL, testdata_setup,
+               test_cr_checksum_cache_gc_touched, testdata_teardown);
+
+    return g_test_run();
+}
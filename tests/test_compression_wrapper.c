@@ -21,6 +21,7 @@
 #include <glib/gstdio.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include "fixtures.h"
 #include "createrepo/error.h"
@@ -37,6 +38,7 @@
 #define FILE_COMPRESSED_0_GZ                    TEST_COMPRESSED_FILES_PATH"/00_plain.txt.gz"
 #define FILE_COMPRESSED_0_BZ2                   TEST_COMPRESSED_FILES_PATH"/00_plain.txt.bz2"
 #define FILE_COMPRESSED_0_XZ                    TEST_COMPRESSED_FILES_PATH"/00_plain.txt.xz"
+#define FILE_COMPRESSED_0_ZSTD                  TEST_COMPRESSED_FILES_PATH"/00_plain.txt.zst"
 #define FILE_COMPRESSED_0_PLAIN_BAD_SUFFIX      TEST_COMPRESSED_FILES_PATH"/00_plain.foo0"
 #define FILE_COMPRESSED_0_GZ_BAD_SUFFIX         TEST_COMPRESSED_FILES_PATH"/00_plain.foo1"
 #define FILE_COMPRESSED_0_BZ2_BAD_SUFFIX        TEST_COMPRESSED_FILES_PATH"/00_plain.foo2"
@@ -49,10 +51,12 @@
 #define FILE_COMPRESSED_1_BZ2                   TEST_COMPRESSED_FILES_PATH"/01_plain.txt.bz2"
 #define FILE_COMPRESSED_1_XZ                    TEST_COMPRESSED_FILES_PATH"/01_plain.txt.xz"
 #define FILE_COMPRESSED_1_ZCK                   TEST_COMPRESSED_FILES_PATH"/01_plain.txt.zck"
+#define FILE_COMPRESSED_1_ZSTD                  TEST_COMPRESSED_FILES_PATH"/01_plain.txt.zst"
 #define FILE_COMPRESSED_1_PLAIN_BAD_SUFFIX      TEST_COMPRESSED_FILES_PATH"/01_plain.foo0"
 #define FILE_COMPRESSED_1_GZ_BAD_SUFFIX         TEST_COMPRESSED_FILES_PATH"/01_plain.foo1"
 #define FILE_COMPRESSED_1_BZ2_BAD_SUFFIX        TEST_COMPRESSED_FILES_PATH"/01_plain.foo2"
 #define FILE_COMPRESSED_1_XZ_BAD_SUFFIX         TEST_COMPRESSED_FILES_PATH"/01_plain.foo3"
+#define FILE_COMPRESSED_1_ZSTD_BAD_SUFFIX       TEST_COMPRESSED_FILES_PATH"/01_plain.foo5"
 
 
 static void
@@ -98,6 +102,9 @@ test_cr_compression_suffix(void)
 
     suffix = cr_compression_suffix(CR_CW_XZ_COMPRESSION);
     g_assert_cmpstr(suffix, ==, ".xz");
+
+    suffix = cr_compression_suffix(CR_CW_ZSTD_COMPRESSION);
+    g_assert_cmpstr(suffix, ==, ".zst");
 }
 
 static void
@@ -134,6 +141,12 @@ test_cr_compression_type(void)
 
     type = cr_compression_type("xz");
     g_assert_cmpint(type, ==, CR_CW_XZ_COMPRESSION);
+
+    type = cr_compression_type("zstd");
+    g_assert_cmpint(type, ==, CR_CW_ZSTD_COMPRESSION);
+
+    type = cr_compression_type("zst");
+    g_assert_cmpint(type, ==, CR_CW_ZSTD_COMPRESSION);
 }
 
 static void
@@ -177,6 +190,15 @@ test_cr_detect_compression(void)
     ret = cr_detect_compression(FILE_COMPRESSED_1_XZ, &tmp_err);
     g_assert_cmpint(ret, ==, CR_CW_XZ_COMPRESSION);
     g_assert(!tmp_err);
+
+    // Zstd
+
+    ret = cr_detect_compression(FILE_COMPRESSED_0_ZSTD, &tmp_err);
+    g_assert_cmpint(ret, ==, CR_CW_ZSTD_COMPRESSION);
+    g_assert(!tmp_err);
+    ret = cr_detect_compression(FILE_COMPRESSED_1_ZSTD, &tmp_err);
+    g_assert_cmpint(ret, ==, CR_CW_ZSTD_COMPRESSION);
+    g_assert(!tmp_err);
 }
 
 
@@ -221,6 +243,12 @@ test_cr_detect_compression_bad_suffix(void)
     ret = cr_detect_compression(FILE_COMPRESSED_1_XZ_BAD_SUFFIX, &tmp_err);
     g_assert_cmpint(ret, ==, CR_CW_XZ_COMPRESSION);
     g_assert(!tmp_err);
+
+    // Zstd
+
+    ret = cr_detect_compression(FILE_COMPRESSED_1_ZSTD_BAD_SUFFIX, &tmp_err);
+    g_assert_cmpint(ret, ==, CR_CW_ZSTD_COMPRESSION);
+    g_assert(!tmp_err);
 }
 
 
@@ -450,6 +478,192 @@ outputtest_cw_output(Outputtest *outputtest,
 }
 
 
+static void
+test_helper_cw_threaded(const char *filename,
+                        cr_CompressionType ctype,
+                        size_t len)
+{
+    int ret;
+    CR_FILE *file;
+    GError *tmp_err = NULL;
+    char *content = g_malloc(len + 1);
+    char *buffer = g_malloc(len + 1);
+    size_t written = 0, readed = 0;
+
+    // Compressible, but not trivial content
+    for (size_t x = 0; x < len; x++)
+        content[x] = 'a' + (x * x / 7 + x / 1000) % 26;
+
+    file = cr_open(filename, CR_CW_MODE_WRITE, ctype, &tmp_err);
+    g_assert(file);
+    g_assert(!tmp_err);
+
+    // Odd sized writes cross the block boundaries
+    while (written < len) {
+        int chunk = MIN(len - written, 10007);
+        ret = cr_write(file, content + written, chunk, &tmp_err);
+        g_assert_cmpint(ret, ==, chunk);
+        g_assert(!tmp_err);
+        written += chunk;
+    }
+
+    ret = cr_close(file, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+
+    // Read and compare
+
+    file = cr_open(filename, CR_CW_MODE_READ, ctype, &tmp_err);
+    g_assert(file);
+    g_assert(!tmp_err);
+
+    while ((ret = cr_read(file, buffer + readed, len + 1 - readed, &tmp_err)) > 0)
+        readed += ret;
+    g_assert_cmpint(ret, ==, 0);
+    g_assert(!tmp_err);
+    g_assert_cmpint(readed, ==, len);
+    g_assert(!memcmp(buffer, content, len));
+
+    ret = cr_close(file, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+
+    g_free(content);
+    g_free(buffer);
+}
+
+
+static void
+outputtest_cw_output_threaded(Outputtest *outputtest,
+                              G_GNUC_UNUSED gconstpointer test_data)
+{
+    cr_compression_set_threads(4);
+    g_assert_cmpint(cr_compression_get_threads(), ==, 4);
+
+    test_helper_cw_threaded(outputtest->tmp_filename,
+                            CR_CW_GZ_COMPRESSION, 0);
+    test_helper_cw_threaded(outputtest->tmp_filename,
+                            CR_CW_GZ_COMPRESSION, 100);
+    test_helper_cw_threaded(outputtest->tmp_filename,
+                            CR_CW_GZ_COMPRESSION, 2*1024*1024 + 13);
+    test_helper_cw_threaded(outputtest->tmp_filename,
+                            CR_CW_XZ_COMPRESSION, 100);
+    test_helper_cw_threaded(outputtest->tmp_filename,
+                            CR_CW_XZ_COMPRESSION, 2*1024*1024 + 13);
+
+    // Content written by cr_puts() is readable as well
+    test_helper_cw_output(OUTPUT_TYPE_PUTS, outputtest->tmp_filename,
+                          CR_CW_GZ_COMPRESSION, FILE_COMPRESSED_1_CONTENT,
+                          FILE_COMPRESSED_1_CONTENT_LEN);
+
+    cr_compression_set_threads(1);
+}
+
+
+static void
+test_helper_cw_readahead(const char *filename,
+                         cr_CompressionType ctype,
+                         size_t len)
+{
+    int ret;
+    CR_FILE *file;
+    const void *block;
+    GError *tmp_err = NULL;
+    char *content = g_malloc(len + 1);
+    char *buffer = g_malloc(len + 1);
+    size_t readed = 0;
+
+    for (size_t x = 0; x < len; x++)
+        content[x] = 'a' + (x * x / 7 + x / 1000) % 26;
+
+    file = cr_open(filename, CR_CW_MODE_WRITE, ctype, &tmp_err);
+    g_assert(file);
+    g_assert(!tmp_err);
+    ret = cr_write(file, content, len, &tmp_err);
+    g_assert_cmpint(ret, ==, len);
+    g_assert(!tmp_err);
+    ret = cr_close(file, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+
+    // Read by blocks
+
+    file = cr_open(filename, CR_CW_MODE_READ, ctype, &tmp_err);
+    g_assert(file);
+    ret = cr_set_readahead(file, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+
+    while ((ret = cr_read_block(file, &block, &tmp_err)) > 0) {
+        g_assert_cmpint(ret, <=, CR_CW_READAHEAD_BLOCK_SIZE);
+        g_assert_cmpint(readed + ret, <=, len);
+        memcpy(buffer + readed, block, ret);
+        readed += ret;
+    }
+    g_assert_cmpint(ret, ==, 0);
+    g_assert(!tmp_err);
+    g_assert_cmpint(readed, ==, len);
+    g_assert(!memcmp(buffer, content, len));
+
+    // The end of file is reported repeatedly
+    g_assert_cmpint(cr_read_block(file, &block, &tmp_err), ==, 0);
+
+    ret = cr_close(file, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+
+    // Read by cr_read() with odd sizes
+
+    file = cr_open(filename, CR_CW_MODE_READ, ctype, &tmp_err);
+    g_assert(file);
+    ret = cr_set_readahead(file, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+
+    readed = 0;
+    while ((ret = cr_read(file, buffer + readed,
+                          MIN(len + 1 - readed, 10007), &tmp_err)) > 0)
+        readed += ret;
+    g_assert_cmpint(ret, ==, 0);
+    g_assert(!tmp_err);
+    g_assert_cmpint(readed, ==, len);
+    g_assert(!memcmp(buffer, content, len));
+
+    ret = cr_close(file, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+
+    // Close before the whole file is read
+
+    file = cr_open(filename, CR_CW_MODE_READ, ctype, &tmp_err);
+    g_assert(file);
+    ret = cr_set_readahead(file, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    ret = cr_read_block(file, &block, &tmp_err);
+    g_assert_cmpint(ret, ==, MIN(len, CR_CW_READAHEAD_BLOCK_SIZE));
+    cr_close(file, NULL);
+
+    g_free(content);
+    g_free(buffer);
+}
+
+
+static void
+outputtest_cw_readahead(Outputtest *outputtest,
+                        G_GNUC_UNUSED gconstpointer test_data)
+{
+    size_t big = CR_CW_READAHEAD_BLOCKS * CR_CW_READAHEAD_BLOCK_SIZE * 2 + 13;
+
+    test_helper_cw_readahead(outputtest->tmp_filename,
+                             CR_CW_GZ_COMPRESSION, 100);
+    test_helper_cw_readahead(outputtest->tmp_filename,
+                             CR_CW_GZ_COMPRESSION, big);
+    test_helper_cw_readahead(outputtest->tmp_filename,
+                             CR_CW_BZ2_COMPRESSION, 100);
+    test_helper_cw_readahead(outputtest->tmp_filename,
+                             CR_CW_XZ_COMPRESSION, big);
+}
+
+
 static void
 test_cr_error_handling(void)
 {
@@ -717,6 +931,79 @@ test_contentstating_multiwrite(Outputtest *outputtest,
     g_assert(!tmp_err);
 }
 
+static void
+test_contentstating_compressed(Outputtest *outputtest,
+                               G_GNUC_UNUSED gconstpointer test_data)
+{
+    CR_FILE *f;
+    int ret;
+    cr_ContentStat *stat;
+    GError *tmp_err = NULL;
+
+    const char *content = "sdlkjowykjnhsadyhfsoaf\nasoiuyseahlndsf\n";
+    const int content_len = 39;
+    const cr_CompressionType types[] = { CR_CW_NO_COMPRESSION,
+                                         CR_CW_GZ_COMPRESSION,
+                                         CR_CW_BZ2_COMPRESSION,
+                                         CR_CW_XZ_COMPRESSION };
+
+    // Checksum of the compressed file is computed while writing
+    // (gzip only by the threaded compression)
+
+    cr_compression_set_threads(2);
+
+    for (size_t i = 0; i < G_N_ELEMENTS(types); i++) {
+        stat = cr_contentstat_new(CR_CHECKSUM_SHA256, &tmp_err);
+        g_assert(stat);
+        g_assert(!tmp_err);
+
+        f = cr_sopen(outputtest->tmp_filename,
+                     CR_CW_MODE_WRITE,
+                     types[i],
+                     stat,
+                     &tmp_err);
+        g_assert(f);
+        g_assert(!tmp_err);
+
+        ret = cr_write(f, content, content_len, &tmp_err);
+        g_assert_cmpint(ret, ==, content_len);
+        g_assert(!tmp_err);
+
+        cr_close(f, &tmp_err);
+        g_assert(!tmp_err);
+
+        char *checksum = cr_checksum_file(outputtest->tmp_filename,
+                                          CR_CHECKSUM_SHA256, &tmp_err);
+        g_assert(!tmp_err);
+
+        GStatBuf st;
+        g_assert_cmpint(g_stat(outputtest->tmp_filename, &st), ==, 0);
+
+        g_assert_cmpstr(stat->compressed_checksum, ==, checksum);
+        g_assert_cmpint(stat->compressed_size, ==, st.st_size);
+        g_free(checksum);
+        cr_contentstat_free(stat, &tmp_err);
+        g_assert(!tmp_err);
+    }
+
+    cr_compression_set_threads(1);
+
+    // Single threaded gzip writes the file on its own
+
+    stat = cr_contentstat_new(CR_CHECKSUM_SHA256, &tmp_err);
+    f = cr_sopen(outputtest->tmp_filename,
+                 CR_CW_MODE_WRITE,
+                 CR_CW_GZ_COMPRESSION,
+                 stat,
+                 &tmp_err);
+    g_assert(f);
+    cr_write(f, content, content_len, &tmp_err);
+    cr_close(f, &tmp_err);
+    g_assert(!tmp_err);
+    g_assert(!stat->compressed_checksum);
+    cr_contentstat_free(stat, &tmp_err);
+}
+
 static void
 test_cr_get_zchunk_with_index(void)
 {
@@ -759,6 +1046,108 @@ test_cr_get_zchunk_with_index(void)
 
 }
 
+static void
+outputtest_cw_zstd(Outputtest *outputtest,
+                   G_GNUC_UNUSED gconstpointer test_data)
+{
+#ifdef WITH_ZSTD
+    int ret;
+    CR_FILE *f;
+    char buf[COMPRESSED_BUFFER_LEN+1];
+    GError *tmp_err = NULL;
+
+    // Files compressed by the zstd tool
+
+    test_helper_cw_input(FILE_COMPRESSED_0_ZSTD, CR_CW_AUTO_DETECT_COMPRESSION,
+            FILE_COMPRESSED_0_CONTENT, FILE_COMPRESSED_0_CONTENT_LEN);
+    test_helper_cw_input(FILE_COMPRESSED_1_ZSTD, CR_CW_AUTO_DETECT_COMPRESSION,
+            FILE_COMPRESSED_1_CONTENT, FILE_COMPRESSED_1_CONTENT_LEN);
+    test_helper_cw_input(FILE_COMPRESSED_1_ZSTD_BAD_SUFFIX,
+            CR_CW_AUTO_DETECT_COMPRESSION,
+            FILE_COMPRESSED_1_CONTENT, FILE_COMPRESSED_1_CONTENT_LEN);
+
+    // Write and read back
+
+    test_helper_cw_output(OUTPUT_TYPE_WRITE,  outputtest->tmp_filename,
+                          CR_CW_ZSTD_COMPRESSION, FILE_COMPRESSED_0_CONTENT,
+                          FILE_COMPRESSED_0_CONTENT_LEN);
+    test_helper_cw_output(OUTPUT_TYPE_WRITE,  outputtest->tmp_filename,
+                          CR_CW_ZSTD_COMPRESSION, FILE_COMPRESSED_1_CONTENT,
+                          FILE_COMPRESSED_1_CONTENT_LEN);
+    test_helper_cw_output(OUTPUT_TYPE_PUTS,   outputtest->tmp_filename,
+                          CR_CW_ZSTD_COMPRESSION, FILE_COMPRESSED_1_CONTENT,
+                          FILE_COMPRESSED_1_CONTENT_LEN);
+    test_helper_cw_output(OUTPUT_TYPE_PRINTF, outputtest->tmp_filename,
+                          CR_CW_ZSTD_COMPRESSION, FILE_COMPRESSED_1_CONTENT,
+                          FILE_COMPRESSED_1_CONTENT_LEN);
+    test_helper_cw_threaded(outputtest->tmp_filename,
+                            CR_CW_ZSTD_COMPRESSION, 2*1024*1024 + 13);
+
+    // Multithreaded compression
+
+    cr_compression_set_threads(4);
+    test_helper_cw_threaded(outputtest->tmp_filename,
+                            CR_CW_ZSTD_COMPRESSION, 100);
+    test_helper_cw_threaded(outputtest->tmp_filename,
+                            CR_CW_ZSTD_COMPRESSION, 8*1024*1024 + 13);
+    cr_compression_set_threads(1);
+
+    // Every chunk is a separate frame, all of them are read
+
+    f = cr_open(outputtest->tmp_filename, CR_CW_MODE_WRITE,
+                CR_CW_ZSTD_COMPRESSION, &tmp_err);
+    g_assert(f);
+    g_assert(!tmp_err);
+    ret = cr_puts(f, "foo", &tmp_err);
+    g_assert_cmpint(ret, ==, 3);
+    ret = cr_end_chunk(f, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    ret = cr_puts(f, "bar", &tmp_err);
+    g_assert_cmpint(ret, ==, 3);
+    ret = cr_close(f, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+
+    test_helper_cw_input(outputtest->tmp_filename, CR_CW_ZSTD_COMPRESSION,
+                         "foobar", 6);
+
+    // Truncated file
+
+    g_assert(!truncate(outputtest->tmp_filename, 10));
+    f = cr_open(outputtest->tmp_filename, CR_CW_MODE_READ,
+                CR_CW_ZSTD_COMPRESSION, &tmp_err);
+    g_assert(f);
+    g_assert(!tmp_err);
+    while ((ret = cr_read(f, buf, COMPRESSED_BUFFER_LEN, &tmp_err)) > 0)
+        ;
+    g_assert_cmpint(ret, ==, CR_CW_ERR);
+    g_assert(tmp_err);
+    g_assert_cmpint(tmp_err->code, ==, CRE_ZSTD);
+    g_clear_error(&tmp_err);
+    cr_close(f, NULL);
+
+    // Plain file is not a zstd file
+
+    f = cr_open(FILE_COMPRESSED_1_PLAIN, CR_CW_MODE_READ,
+                CR_CW_ZSTD_COMPRESSION, &tmp_err);
+    g_assert(f);
+    ret = cr_read(f, buf, COMPRESSED_BUFFER_LEN, &tmp_err);
+    g_assert_cmpint(ret, ==, CR_CW_ERR);
+    g_assert(tmp_err);
+    g_assert_cmpint(tmp_err->code, ==, CRE_ZSTD);
+    g_clear_error(&tmp_err);
+    cr_close(f, NULL);
+#else
+    GError *tmp_err = NULL;
+    CR_FILE *f = cr_open(outputtest->tmp_filename, CR_CW_MODE_WRITE,
+                         CR_CW_ZSTD_COMPRESSION, &tmp_err);
+    g_assert(!f);
+    g_assert(tmp_err);
+    g_assert_cmpint(tmp_err->code, ==, CRE_IO);
+    g_error_free(tmp_err);
+#endif // WITH_ZSTD
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -778,6 +1167,12 @@ main(int argc, char *argv[])
             test_cr_read_with_autodetection);
     g_test_add("/compression_wrapper/outputtest_cw_output", Outputtest, NULL,
             outputtest_setup, outputtest_cw_output, outputtest_teardown);
+    g_test_add("/compression_wrapper/outputtest_cw_output_threaded",
+            Outputtest, NULL, outputtest_setup,
+            outputtest_cw_output_threaded, outputtest_teardown);
+    g_test_add("/compression_wrapper/outputtest_cw_readahead",
+            Outputtest, NULL, outputtest_setup,
+            outputtest_cw_readahead, outputtest_teardown);
     g_test_add_func("/compression_wrapper/test_cr_error_handling",
             test_cr_error_handling);
     g_test_add("/compression_wrapper/test_contentstating_singlewrite",
@@ -786,8 +1181,14 @@ main(int argc, char *argv[])
     g_test_add("/compression_wrapper/test_contentstating_multiwrite",
             Outputtest, NULL, outputtest_setup,
             test_contentstating_multiwrite, outputtest_teardown);
+    g_test_add("/compression_wrapper/test_contentstating_compressed",
+            Outputtest, NULL, outputtest_setup,
+            test_contentstating_compressed, outputtest_teardown);
     g_test_add_func("/compression_wrapper/test_cr_get_zchunk_with_index",
             test_cr_get_zchunk_with_index);
+    g_test_add("/compression_wrapper/outputtest_cw_zstd",
+            Outputtest, NULL, outputtest_setup,
+            outputtest_cw_zstd, outputtest_teardown);
 
     return g_test_run();
 }
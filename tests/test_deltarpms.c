@@ -0,0 +1,564 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "fixtures.h"
+#include "createrepo/checksum_cache.h"
+#include "createrepo/deltarpms.h"
+#include "createrepo/error.h"
+#include "createrepo/misc.h"
+#include "createrepo/package.h"
+#include "createrepo/xml_file.h"
+
+#ifdef CR_DELTA_RPM_SUPPORT
+
+// Log domain of the library
+#define LIB_LOG_DOMAIN          "C_CREATEREPOLIB"
+
+#define DELTA_MAX_RPM_SIZE      G_GINT64_CONSTANT(100000000)
+#define DELTA_MAX_WORK_SIZE     G_GINT64_CONSTANT(1000000000)
+
+static void
+log_to_array(G_GNUC_UNUSED const gchar *log_domain,
+             G_GNUC_UNUSED GLogLevelFlags log_level,
+             const gchar *message,
+             gpointer user_data)
+{
+    g_ptr_array_add((GPtrArray *) user_data, g_strdup(message));
+}
+
+static gboolean
+log_contains(GPtrArray *log, const gchar *prefix)
+{
+    for (guint i = 0; i < log->len; i++)
+        if (g_str_has_prefix(g_ptr_array_index(log, i), prefix))
+            return TRUE;
+    return FALSE;
+}
+
+#define ARCHER_RPM      TEST_PACKAGES_PATH"Archer-3.4.5-6.x86_64.rpm"
+#define EMPTY_RPM       TEST_PACKAGES_PATH"empty-0-0.x86_64.rpm"
+#define EMPTY_SRC_RPM   TEST_PACKAGES_PATH"empty-0-0.src.rpm"
+
+static void
+copy_file(const char *src, const char *dir, const char *filename)
+{
+    gchar *content, *dst;
+    gsize len;
+
+    g_assert(g_file_get_contents(src, &content, &len, NULL));
+    dst = g_build_filename(dir, filename, NULL);
+    g_assert(g_file_set_contents(dst, content, len, NULL));
+    g_free(dst);
+    g_free(content);
+}
+
+/* Copy of the Archer package with another version of the same length.
+ * Digests of the header are not verified when the package is read,
+ * so the patched package is readable. */
+static void
+copy_archer_with_version(const char *dir, const char *version)
+{
+    gchar *content, *dst, *filename;
+    gsize len;
+    const char orig[] = "\0" "3.4.5" "\0";
+    gchar *pos = NULL;
+
+    g_assert_cmpint(strlen(version), ==, strlen("3.4.5"));
+    g_assert(g_file_get_contents(ARCHER_RPM, &content, &len, NULL));
+    for (gsize i = 0; i + sizeof(orig) - 1 <= len; i++)
+        if (!memcmp(content + i, orig, sizeof(orig) - 1)) {
+            pos = content + i;
+            break;
+        }
+    g_assert(pos);
+    memcpy(pos + 1, version, strlen(version));
+
+    filename = g_strdup_printf("Archer-%s-6.x86_64.rpm", version);
+    dst = g_build_filename(dir, filename, NULL);
+    g_assert(g_file_set_contents(dst, content, len, NULL));
+    g_free(dst);
+    g_free(filename);
+    g_free(content);
+}
+
+static void
+test_cr_deltarpms_scan_oldpackagedirs(void)
+{
+    GError *err = NULL;
+    GHashTable *ht;
+    GSList *dirs = NULL, *list;
+    gchar *dir_a, *dir_b;
+    cr_DeltaTargetPackage *tpkg;
+    GLogLevelFlags fatal;
+
+    dir_a = g_strdup(TMPDIR_TEMPLATE);
+    g_assert(mkdtemp(dir_a));
+    dir_b = g_strdup(TMPDIR_TEMPLATE);
+    g_assert(mkdtemp(dir_b));
+
+    // Several versions of one package, the same package with another
+    // arch and a file that is not a package
+    copy_archer_with_version(dir_a, "3.4.4");
+    copy_file(ARCHER_RPM, dir_a, "Archer-3.4.5-6.x86_64.rpm");
+    copy_archer_with_version(dir_a, "3.4.6");
+    copy_file(EMPTY_RPM, dir_a, "empty-0-0.x86_64.rpm");
+    copy_file(EMPTY_SRC_RPM, dir_a, "empty-0-0.src.rpm");
+    copy_file(TEST_EMPTY_FILE, dir_a, "not_a_package.txt");
+    // The same package in another directory
+    copy_file(ARCHER_RPM, dir_b, "Archer-3.4.5-6.x86_64.rpm");
+
+    dirs = g_slist_append(dirs, dir_a);
+    dirs = g_slist_append(dirs, dir_b);
+
+    fatal = g_log_set_always_fatal(G_LOG_FATAL_MASK);
+    ht = cr_deltarpms_scan_oldpackagedirs(dirs, DELTA_MAX_RPM_SIZE, &err);
+    g_log_set_always_fatal(fatal);
+    g_assert(ht);
+    g_assert(!err);
+
+    g_assert_cmpuint(g_hash_table_size(ht), ==, 3);
+    g_assert(g_hash_table_lookup(ht, "empty/x86_64"));
+    g_assert(g_hash_table_lookup(ht, "empty/src"));
+
+    // Sorted from the newest one, without duplicates
+    list = g_hash_table_lookup(ht, "Archer/x86_64");
+    g_assert_cmpuint(g_slist_length(list), ==, 3);
+    tpkg = g_slist_nth_data(list, 0);
+    g_assert_cmpstr(tpkg->version, ==, "3.4.6");
+    tpkg = g_slist_nth_data(list, 1);
+    g_assert_cmpstr(tpkg->version, ==, "3.4.5");
+    tpkg = g_slist_nth_data(list, 2);
+    g_assert_cmpstr(tpkg->version, ==, "3.4.4");
+
+    for (GSList *elem = list; elem; elem = g_slist_next(elem)) {
+        tpkg = elem->data;
+        g_assert_cmpstr(tpkg->name, ==, "Archer");
+        g_assert_cmpstr(tpkg->arch, ==, "x86_64");
+        g_assert_cmpstr(tpkg->epoch, ==, "2");
+        g_assert_cmpstr(tpkg->release, ==, "6");
+        g_assert(tpkg->path);
+        g_assert(tpkg->hdrid);
+        g_assert_cmpint(strlen(tpkg->hdrid), ==, 40);
+    }
+
+    g_hash_table_destroy(ht);
+
+    // Packages bigger than max_delta_rpm_size are skipped
+    fatal = g_log_set_always_fatal(G_LOG_FATAL_MASK);
+    ht = cr_deltarpms_scan_oldpackagedirs(dirs, 1500, &err);
+    g_log_set_always_fatal(fatal);
+    g_assert(ht);
+    g_assert(!err);
+    g_assert_cmpuint(g_hash_table_size(ht), ==, 2);
+    g_assert(!g_hash_table_lookup(ht, "Archer/x86_64"));
+    g_hash_table_destroy(ht);
+
+    cr_remove_dir(dir_a, NULL);
+    cr_remove_dir(dir_b, NULL);
+    g_slist_free_full(dirs, g_free);
+}
+
+/* Package which doesn't exist on the disk, deltas from or to it can't
+ * be generated. */
+static cr_DeltaTargetPackage *
+fake_deltatargetpackage(const char *name,
+                        const char *version,
+                        const char *hdrid,
+                        gint64 size_installed)
+{
+    cr_Package *pkg = cr_package_new();
+    cr_DeltaTargetPackage *tpkg;
+    gchar *path;
+
+    pkg->name = cr_safe_string_chunk_insert(pkg->chunk, name);
+    pkg->arch = cr_safe_string_chunk_insert(pkg->chunk, "x86_64");
+    pkg->epoch = cr_safe_string_chunk_insert(pkg->chunk, "0");
+    pkg->version = cr_safe_string_chunk_insert(pkg->chunk, version);
+    pkg->release = cr_safe_string_chunk_insert(pkg->chunk, "1");
+    pkg->hdrid = cr_safe_string_chunk_insert(pkg->chunk, hdrid);
+    pkg->size_installed = size_installed;
+    path = g_strdup_printf("/nonexistent/%s-%s-1.x86_64.rpm", name, version);
+
+    tpkg = cr_deltatargetpackage_from_package(pkg, path, NULL);
+    g_assert(tpkg);
+
+    g_free(path);
+    cr_package_free(pkg);
+    return tpkg;
+}
+
+/* Catalog of old packages as returned by
+ * cr_deltarpms_scan_oldpackagedirs(), the packages are sorted
+ * from the newest one. */
+static GHashTable *
+fake_oldpackages(cr_DeltaTargetPackage **pkgs)
+{
+    GHashTable *ht = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           g_free, NULL);
+
+    for (; *pkgs; pkgs++) {
+        gchar *key = g_strconcat((*pkgs)->name, "/", (*pkgs)->arch, NULL);
+        GSList *list = g_hash_table_lookup(ht, key);
+        g_hash_table_replace(ht, key, g_slist_append(list, *pkgs));
+    }
+
+    return ht;
+}
+
+static void
+free_oldpackages(GHashTable *ht)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, ht);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        g_slist_free(value);
+    g_hash_table_destroy(ht);
+}
+
+/* Run cr_deltarpms_parallel_deltas() with a single worker and return
+ * its log messages. Generation of the deltas fails with a warning. */
+static GPtrArray *
+run_parallel_deltas(GSList *targets,
+                    GHashTable *oldpackages,
+                    const char *outdeltadir,
+                    gint num_deltas)
+{
+    gboolean ret;
+    GError *err = NULL;
+    GPtrArray *log = g_ptr_array_new_with_free_func(g_free);
+    GLogLevelFlags fatal;
+    guint handler;
+
+    fatal = g_log_set_always_fatal(G_LOG_FATAL_MASK);
+    handler = g_log_set_handler(LIB_LOG_DOMAIN,
+                                G_LOG_LEVEL_WARNING | G_LOG_LEVEL_MESSAGE
+                                | G_LOG_LEVEL_INFO | G_LOG_LEVEL_DEBUG,
+                                log_to_array, log);
+    ret = cr_deltarpms_parallel_deltas(targets, oldpackages, outdeltadir,
+                                       num_deltas, 1, DELTA_MAX_RPM_SIZE,
+                                       DELTA_MAX_WORK_SIZE, &err);
+    g_log_remove_handler(LIB_LOG_DOMAIN, handler);
+    g_log_set_always_fatal(fatal);
+
+    g_assert(ret);
+    g_assert(!err);
+    return log;
+}
+
+static gchar *
+read_index(const char *outdeltadir)
+{
+    gchar *content = NULL;
+    gchar *path = g_build_filename(outdeltadir, CR_DELTARPMS_INDEX_FILENAME,
+                                   NULL);
+    g_assert(g_file_get_contents(path, &content, NULL, NULL));
+    g_free(path);
+    return content;
+}
+
+static void
+write_index(const char *outdeltadir, const char *content)
+{
+    gchar *path = g_build_filename(outdeltadir, CR_DELTARPMS_INDEX_FILENAME,
+                                   NULL);
+    g_assert(g_file_set_contents(path, content, -1, NULL));
+    g_free(path);
+}
+
+static void
+test_cr_deltarpms_parallel_deltas_reuse(void)
+{
+    GPtrArray *log;
+    gchar *tmp_dir, *drpm, *index;
+    cr_DeltaTargetPackage *old = fake_deltatargetpackage("foo", "1", "aaaa", 100);
+    cr_DeltaTargetPackage *new = fake_deltatargetpackage("foo", "2", "bbbb", 100);
+    cr_DeltaTargetPackage *olds[] = {old, NULL};
+    GHashTable *oldpackages = fake_oldpackages(olds);
+    GSList *targets = g_slist_prepend(NULL, new);
+
+    tmp_dir = g_strdup(TMPDIR_TEMPLATE);
+    g_assert(mkdtemp(tmp_dir));
+    drpm = g_build_filename(tmp_dir, "foo-1-1_2-1.x86_64.drpm", NULL);
+    g_assert(g_file_set_contents(drpm, "drpm", 4, NULL));
+
+    // The drpm of the (old hdrid, new hdrid) pair is in the index
+    write_index(tmp_dir, "aaaa\tbbbb\t4\tfoo-1-1_2-1.x86_64.drpm\n");
+
+    log = run_parallel_deltas(targets, oldpackages, tmp_dir, 1);
+    g_assert(log_contains(log, "Reusing delta foo-1-1_2-1.x86_64.drpm"));
+    g_assert(!log_contains(log, "Generating delta"));
+    g_assert(!log_contains(log, "Cannot generate delta"));
+    g_ptr_array_free(log, TRUE);
+
+    // The reused drpm stays in the index
+    index = read_index(tmp_dir);
+    g_assert_cmpstr(index, ==, "aaaa\tbbbb\t4\tfoo-1-1_2-1.x86_64.drpm\n");
+    g_free(index);
+
+    cr_remove_dir(tmp_dir, NULL);
+    g_free(drpm);
+    g_free(tmp_dir);
+    g_slist_free(targets);
+    free_oldpackages(oldpackages);
+    cr_deltatargetpackage_free(old);
+    cr_deltatargetpackage_free(new);
+}
+
+static void
+test_cr_deltarpms_parallel_deltas_invalid_index(void)
+{
+    // Records which don't match the drpm or the packages
+    const char *records[] = {
+        // Different size of the drpm
+        "aaaa\tbbbb\t5\tfoo-1-1_2-1.x86_64.drpm\n",
+        // Missing drpm
+        "aaaa\tbbbb\t4\tmissing.drpm\n",
+        // The old package changed
+        "cccc\tbbbb\t4\tfoo-1-1_2-1.x86_64.drpm\n",
+        // The new package changed
+        "aaaa\tcccc\t4\tfoo-1-1_2-1.x86_64.drpm\n",
+        // Path instead of a filename
+        "aaaa\tbbbb\t4\t../foo-1-1_2-1.x86_64.drpm\n",
+        // Broken line
+        "aaaa\tbbbb\n",
+        NULL,
+    };
+    cr_DeltaTargetPackage *old = fake_deltatargetpackage("foo", "1", "aaaa", 100);
+    cr_DeltaTargetPackage *new = fake_deltatargetpackage("foo", "2", "bbbb", 100);
+    cr_DeltaTargetPackage *olds[] = {old, NULL};
+    GHashTable *oldpackages = fake_oldpackages(olds);
+    GSList *targets = g_slist_prepend(NULL, new);
+
+    for (const char **record = records; *record; record++) {
+        GPtrArray *log;
+        gchar *tmp_dir, *drpm, *index;
+
+        tmp_dir = g_strdup(TMPDIR_TEMPLATE);
+        g_assert(mkdtemp(tmp_dir));
+        drpm = g_build_filename(tmp_dir, "foo-1-1_2-1.x86_64.drpm", NULL);
+        g_assert(g_file_set_contents(drpm, "drpm", 4, NULL));
+        write_index(tmp_dir, *record);
+
+        // The delta is generated again (and fails, the packages are fake)
+        log = run_parallel_deltas(targets, oldpackages, tmp_dir, 1);
+        g_assert(!log_contains(log, "Reusing delta"));
+        g_assert(log_contains(log, "Generating delta /nonexistent/foo-1-1"));
+        g_assert(log_contains(log, "Cannot generate delta"));
+        g_ptr_array_free(log, TRUE);
+
+        // Only deltas of the run are kept in the index
+        index = read_index(tmp_dir);
+        g_assert_cmpstr(index, ==, "");
+        g_free(index);
+
+        cr_remove_dir(tmp_dir, NULL);
+        g_free(drpm);
+        g_free(tmp_dir);
+    }
+
+    g_slist_free(targets);
+    free_oldpackages(oldpackages);
+    cr_deltatargetpackage_free(old);
+    cr_deltatargetpackage_free(new);
+}
+
+static void
+test_cr_deltarpms_parallel_deltas_order(void)
+{
+    GPtrArray *log;
+    GPtrArray *generating = g_ptr_array_new();
+    gchar *tmp_dir, *drpm;
+    GSList *targets = NULL;
+
+    // Cost of a target is number of deltas to generate * size_installed
+    cr_DeltaTargetPackage *a1 = fake_deltatargetpackage("a", "1", "a1", 100);
+    cr_DeltaTargetPackage *a2 = fake_deltatargetpackage("a", "2", "a2", 100);
+    cr_DeltaTargetPackage *b1 = fake_deltatargetpackage("b", "1", "b1", 300);
+    cr_DeltaTargetPackage *b2 = fake_deltatargetpackage("b", "2", "b2", 300);
+    cr_DeltaTargetPackage *c1 = fake_deltatargetpackage("c", "1", "c1", 100);
+    cr_DeltaTargetPackage *c2 = fake_deltatargetpackage("c", "2", "c2", 100);
+    cr_DeltaTargetPackage *c3 = fake_deltatargetpackage("c", "3", "c3", 100);
+    cr_DeltaTargetPackage *d1 = fake_deltatargetpackage("d", "1", "d1", 1000);
+    cr_DeltaTargetPackage *d2 = fake_deltatargetpackage("d", "2", "d2", 1000);
+    cr_DeltaTargetPackage *olds[] = {a1, b1, c2, c1, d1, NULL};
+    GHashTable *oldpackages = fake_oldpackages(olds);
+
+    // Cost: a 100, b 300, c 2 * 100, d 0 (the delta is in the index)
+    targets = g_slist_prepend(targets, d2);
+    targets = g_slist_prepend(targets, c3);
+    targets = g_slist_prepend(targets, b2);
+    targets = g_slist_prepend(targets, a2);
+
+    tmp_dir = g_strdup(TMPDIR_TEMPLATE);
+    g_assert(mkdtemp(tmp_dir));
+    drpm = g_build_filename(tmp_dir, "d.drpm", NULL);
+    g_assert(g_file_set_contents(drpm, "drpm", 4, NULL));
+    write_index(tmp_dir, "d1\td2\t4\td.drpm\n");
+
+    // With a single worker the targets are processed in the order
+    // of their cost
+    log = run_parallel_deltas(targets, oldpackages, tmp_dir, 2);
+    for (guint i = 0; i < log->len; i++) {
+        const gchar *msg = g_ptr_array_index(log, i);
+        if (g_str_has_prefix(msg, "Generating delta ")
+            || g_str_has_prefix(msg, "Reusing delta "))
+            g_ptr_array_add(generating, (gpointer) msg);
+    }
+
+    g_assert_cmpuint(generating->len, ==, 5);
+    g_assert_cmpstr(g_ptr_array_index(generating, 0), ==,
+            "Generating delta /nonexistent/b-1-1.x86_64.rpm -> "
+            "/nonexistent/b-2-1.x86_64.rpm");
+    g_assert_cmpstr(g_ptr_array_index(generating, 1), ==,
+            "Generating delta /nonexistent/c-2-1.x86_64.rpm -> "
+            "/nonexistent/c-3-1.x86_64.rpm");
+    g_assert_cmpstr(g_ptr_array_index(generating, 2), ==,
+            "Generating delta /nonexistent/c-1-1.x86_64.rpm -> "
+            "/nonexistent/c-3-1.x86_64.rpm");
+    g_assert_cmpstr(g_ptr_array_index(generating, 3), ==,
+            "Generating delta /nonexistent/a-1-1.x86_64.rpm -> "
+            "/nonexistent/a-2-1.x86_64.rpm");
+    g_assert(g_str_has_prefix(g_ptr_array_index(generating, 4),
+                              "Reusing delta d.drpm"));
+
+    g_ptr_array_free(generating, TRUE);
+    g_ptr_array_free(log, TRUE);
+    cr_remove_dir(tmp_dir, NULL);
+    g_free(drpm);
+    g_free(tmp_dir);
+    g_slist_free(targets);
+    free_oldpackages(oldpackages);
+    for (cr_DeltaTargetPackage **pkg = olds; *pkg; pkg++)
+        cr_deltatargetpackage_free(*pkg);
+    cr_deltatargetpackage_free(a2);
+    cr_deltatargetpackage_free(b2);
+    cr_deltatargetpackage_free(c3);
+    cr_deltatargetpackage_free(d2);
+}
+
+static void
+test_cr_deltarpms_cache_key(void)
+{
+    gchar *key, *other;
+
+    key = cr_deltarpms_cache_key("/repo/drpms/foo.drpm",
+                                 CR_CHECKSUM_SHA256, 100, 200);
+    g_assert(g_str_has_prefix(key, CR_CHECKSUM_CACHE_DRPM_PREFIX));
+    g_assert_cmpstr(key, ==, CR_CHECKSUM_CACHE_DRPM_PREFIX
+                    "/repo/drpms/foo.drpm-sha256-100-200");
+
+    // Every attribute of the drpm is a part of the key
+    other = cr_deltarpms_cache_key("/repo/drpms/foo.drpm",
+                                   CR_CHECKSUM_SHA256, 100, 201);
+    g_assert_cmpstr(key, !=, other);
+    g_free(other);
+
+    other = cr_deltarpms_cache_key("/repo/drpms/foo.drpm",
+                                   CR_CHECKSUM_SHA256, 101, 200);
+    g_assert_cmpstr(key, !=, other);
+    g_free(other);
+
+    other = cr_deltarpms_cache_key("/repo/drpms/foo.drpm",
+                                   CR_CHECKSUM_SHA1, 100, 200);
+    g_assert_cmpstr(key, !=, other);
+    g_free(other);
+
+    g_free(key);
+}
+
+static void
+test_cr_deltarpms_generate_prestodelta_file_empty(void)
+{
+    gboolean ret;
+    GError *err = NULL;
+    gchar *tmp_dir, *drpms_dir, *path, *cache_path;
+    cr_ChecksumCache *cache;
+    cr_XmlFile *f;
+
+    tmp_dir = g_strdup(TMPDIR_TEMPLATE);
+    g_assert(mkdtemp(tmp_dir));
+    drpms_dir = g_build_filename(tmp_dir, "drpms", NULL);
+    g_assert_cmpint(g_mkdir(drpms_dir, 0755), ==, 0);
+    path = g_build_filename(tmp_dir, "prestodelta.xml", NULL);
+    cache_path = g_build_filename(tmp_dir, CR_CHECKSUM_CACHE_FILENAME, NULL);
+
+    // Without the cache (the original API)
+    f = cr_xmlfile_sopen_prestodelta(path, CR_CW_NO_COMPRESSION, NULL, &err);
+    g_assert(f);
+    ret = cr_deltarpms_generate_prestodelta_file(drpms_dir, f, NULL,
+                                                 CR_CHECKSUM_SHA256, 2,
+                                                 tmp_dir, &err);
+    g_assert(ret);
+    g_assert(!err);
+    cr_xmlfile_close(f, NULL);
+
+    // With the cache
+    cache = cr_checksum_cache_open(cache_path, &err);
+    g_assert(cache);
+    f = cr_xmlfile_sopen_prestodelta(path, CR_CW_NO_COMPRESSION, NULL, &err);
+    g_assert(f);
+    ret = cr_deltarpms_generate_prestodelta_file_with_cache(drpms_dir, f,
+                                                            NULL,
+                                                            CR_CHECKSUM_SHA256,
+                                                            cache, 2,
+                                                            tmp_dir, &err);
+    g_assert(ret);
+    g_assert(!err);
+    cr_xmlfile_close(f, NULL);
+    g_assert_cmpuint(cr_checksum_cache_size(cache), ==, 0);
+    cr_checksum_cache_close(cache, NULL);
+
+    cr_remove_dir(tmp_dir, NULL);
+    g_free(cache_path);
+    g_free(path);
+    g_free(drpms_dir);
+    g_free(tmp_dir);
+}
+
+#endif  // CR_DELTA_RPM_SUPPORT
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+#ifdef CR_DELTA_RPM_SUPPORT
+    g_test_add_func("/deltarpms/test_cr_deltarpms_scan_oldpackagedirs",
+            test_cr_deltarpms_scan_oldpackagedirs);
+    g_test_add_func("/deltarpms/test_cr_deltarpms_parallel_deltas_reuse",
+            test_cr_deltarpms_parallel_deltas_reuse);
+    g_test_add_func("/deltarpms/test_cr_deltarpms_parallel_deltas_invalid_index",
+            test_cr_deltarpms_parallel_deltas_invalid_index);
+    g_test_add_func("/deltarpms/test_cr_deltarpms_parallel_deltas_order",
+            test_cr_deltarpms_parallel_deltas_order);
+    g_test_add_func("/deltarpms/test_cr_deltarpms_cache_key",
+            test_cr_deltarpms_cache_key);
+    g_test_add_func("/deltarpms/test_cr_deltarpms_generate_prestodelta_file_empty",
+            test_cr_deltarpms_generate_prestodelta_file_empty);
+#endif  // CR_DELTA_RPM_SUPPORT
+
+    return g_test_run();
+}
@@ -180,6 +180,44 @@ test_koji_stuff_03_get_srpm_from_first_repo_even_if_its_older(void)
     g_free(template);
 }
 
+static void
+test_koji_stuff_04_add_repo_srpms_one_by_one(void)
+{
+    gchar *template = g_strdup(TMPDIR_TEMPLATE);
+    gchar *tmp = g_strconcat(mkdtemp(template), "/", NULL);
+
+    struct KojiMergedReposStuff *koji_stuff = NULL;
+    struct CmdOptions o = {.koji=0, .blocked=NULL, .tmp_out_repo=tmp};
+
+    int ret = koji_stuff_prepare(&koji_stuff, &o, NULL);
+    g_assert_cmpint(ret, ==, 0);
+    g_assert_cmpint(g_hash_table_size(koji_stuff->include_srpms), ==, 0);
+
+    const gchar *repos[] = { TEST_REPO_KOJI_02, TEST_REPO_KOJI_01, NULL };
+    for (int repoid = 0; repos[repoid]; repoid++) {
+        cr_Metadata *metadata = cr_metadata_new(CR_HT_KEY_HASH, 0, NULL);
+        ret = cr_metadata_locate_and_load_xml(metadata, repos[repoid], NULL);
+        g_assert_cmpint(ret, ==, 0);
+        koji_stuff_add_repo_srpms(koji_stuff,
+                                  cr_metadata_hashtable(metadata),
+                                  repos[repoid],
+                                  repoid);
+        cr_metadata_free(metadata);
+    }
+
+    // Same result as if the repos were loaded by koji_stuff_prepare()
+    g_assert_cmpint(g_hash_table_size(koji_stuff->include_srpms), ==, 1);
+    struct srpm_val *value = g_hash_table_lookup(koji_stuff->include_srpms, "dwm");
+    g_assert(value);
+    g_assert_cmpint(value->repo_id, ==, 0);
+    g_assert_cmpstr(value->sourcerpm, ==, "dwm-5.8.2-2.src.rpm");
+
+    koji_stuff_destroy(&koji_stuff);
+
+    g_free(tmp);
+    g_free(template);
+}
+
 struct KojiMergedReposStuff *
 create_empty_koji_stuff_for_test(gboolean simple)
 {
@@ -359,6 +397,8 @@ main(int argc, char *argv[])
                    test_koji_stuff_02_get_newest_srpm_from_one_repo);
     g_test_add_func("/mergerepo_c/test_koji_stuff_03_get_srpm_from_first_repo_even_if_its_older",
                    test_koji_stuff_03_get_srpm_from_first_repo_even_if_its_older);
+    g_test_add_func("/mergerepo_c/test_koji_stuff_04_add_repo_srpms_one_by_one",
+                   test_koji_stuff_04_add_repo_srpms_one_by_one);
 
     g_test_add_func("/mergerepo_c/test_koji_allowed_pkg_not_included",
                    test_koji_allowed_pkg_not_included);
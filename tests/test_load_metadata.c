@@ -20,6 +20,7 @@
 #include <glib.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "fixtures.h"
 #include "createrepo/error.h"
 #include "createrepo/package.h"
@@ -27,6 +28,7 @@
 #include "createrepo/load_metadata.h"
 #include "createrepo/locate_metadata.h"
 #include "createrepo/metadata_internal.h"
+#include "createrepo/xml_dump.h"
 
 #define REPO_SIZE_00    0
 static const char *REPO_HASH_KEYS_00[] = {};
@@ -173,6 +175,188 @@ static void test_cr_metadata_locate_and_load_xml_detailed(void)
 }
 
 
+static void test_cr_metadata_keep_raw_xml(void)
+{
+    int ret;
+    char *relocated;
+    cr_Package *pkg;
+    cr_Metadata *metadata;
+    cr_MetadataRawXml *raw;
+    GError *err = NULL;
+
+    metadata = cr_metadata_new(CR_HT_KEY_NAME, 1, NULL);
+    g_assert(metadata);
+    cr_metadata_set_keep_raw_xml(metadata, TRUE);
+    ret = cr_metadata_locate_and_load_xml(metadata, TEST_REPO_01, NULL);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    pkg = (cr_Package *) g_hash_table_lookup(cr_metadata_hashtable(metadata),
+                                             "super_kernel");
+    g_assert(pkg);
+
+    raw = cr_metadata_steal_raw_xml(metadata, pkg, &err);
+    g_assert_no_error(err);
+    g_assert(raw);
+    g_assert(g_str_has_prefix(raw->primary, "<package type=\"rpm\">\n"));
+    g_assert(g_str_has_suffix(raw->primary, "</package>\n"));
+    g_assert(strstr(raw->primary, "<location href=\"super_kernel-6.0.1-2.x86_64.rpm\"/>"));
+    g_assert(g_str_has_prefix(raw->filelists, "<package pkgid=\"152824bff2aa6d54f429d43e87a3ff3a0286505c6d93ec87692b5e3a9e3b97bf\""));
+    g_assert(g_str_has_suffix(raw->filelists, "</package>\n"));
+    g_assert(g_str_has_prefix(raw->other, "<package pkgid=\"152824bff2aa6d54f429d43e87a3ff3a0286505c6d93ec87692b5e3a9e3b97bf\""));
+    g_assert(g_str_has_suffix(raw->other, "</package>\n"));
+
+    // Already stolen
+    g_assert(!cr_metadata_steal_raw_xml(metadata, pkg, NULL));
+
+    pkg->location_href = "foo/super_kernel.rpm";
+    pkg->location_base = "http://foo/";
+    relocated = cr_xml_relocate_primary(raw->primary, pkg, &err);
+    g_assert_no_error(err);
+    g_assert(relocated);
+    g_assert(strstr(relocated, "\n<location xml:base=\"http://foo/\" href=\"foo/super_kernel.rpm\"/>\n"));
+    g_assert(!strstr(relocated, "super_kernel-6.0.1-2.x86_64.rpm"));
+    g_assert_cmpuint(strlen(relocated), ==, strlen(raw->primary)
+                     - strlen("super_kernel-6.0.1-2.x86_64.rpm")
+                     + strlen(" xml:base=\"http://foo/\"")
+                     + strlen("foo/super_kernel.rpm"));
+
+    g_free(relocated);
+    cr_metadata_raw_xml_free(raw);
+    cr_metadata_free(metadata);
+}
+
+
+static void test_cr_metadata_lazy_loading(void)
+{
+    int ret;
+    cr_Package *pkg;
+    cr_Metadata *metadata;
+    cr_MetadataRawXml *raw;
+    GError *err = NULL;
+
+    metadata = cr_metadata_new(CR_HT_KEY_NAME, 1, NULL);
+    g_assert(metadata);
+    cr_metadata_set_lazy_loading(metadata, TRUE);
+    ret = cr_metadata_locate_and_load_xml(metadata, TEST_REPO_01, NULL);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    pkg = (cr_Package *) g_hash_table_lookup(cr_metadata_hashtable(metadata),
+                                             "super_kernel");
+    g_assert(pkg);
+
+    // Only primary data are loaded
+    g_assert_cmpstr(pkg->location_href, ==, "super_kernel-6.0.1-2.x86_64.rpm");
+    g_assert_cmpint(pkg->time_file, ==, 1334667003);
+    g_assert_cmpint(pkg->size_package, ==, 2845);
+    g_assert(!pkg->files);
+    g_assert(!pkg->changelogs);
+
+    raw = cr_metadata_steal_raw_xml(metadata, pkg, &err);
+    g_assert_no_error(err);
+    g_assert(raw);
+    g_assert(!raw->primary);
+    g_assert(g_str_has_suffix(raw->filelists, "</package>\n"));
+    g_assert(g_str_has_suffix(raw->other, "</package>\n"));
+
+    ret = cr_metadata_fill_package(pkg, raw, &err);
+    g_assert_no_error(err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert_cmpint(g_slist_length(pkg->files), ==, 2);
+    g_assert_cmpstr(((cr_PackageFile *) pkg->files->data)->name, ==, "super_kernel");
+    g_assert_cmpint(g_slist_length(pkg->changelogs), ==, 2);
+    g_assert_cmpstr(((cr_ChangelogEntry *) pkg->changelogs->data)->changelog, ==, "- First release");
+
+    // Filling is done only once
+    ret = cr_metadata_fill_package(pkg, raw, &err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert_cmpint(g_slist_length(pkg->files), ==, 2);
+
+    cr_metadata_raw_xml_free(raw);
+    cr_metadata_free(metadata);
+}
+
+
+static void test_cr_metadata_parallel_loading(void)
+{
+    int ret;
+    cr_Package *pkg;
+    cr_Metadata *metadata;
+
+    for (int use_single_chunk = 0; use_single_chunk < 2; use_single_chunk++) {
+        metadata = cr_metadata_new(CR_HT_KEY_NAME, use_single_chunk, NULL);
+        g_assert(metadata);
+        cr_metadata_set_parallel_loading(metadata, TRUE);
+        ret = cr_metadata_locate_and_load_xml(metadata, TEST_REPO_01, NULL);
+        g_assert_cmpint(ret, ==, CRE_OK);
+        g_assert_cmpuint(g_hash_table_size(cr_metadata_hashtable(metadata)),
+                         ==, REPO_SIZE_01);
+        pkg = (cr_Package *) g_hash_table_lookup(cr_metadata_hashtable(metadata),
+                                                 "super_kernel");
+        g_assert(pkg);
+
+        g_assert(pkg->loadingflags & CR_PACKAGE_LOADED_FIL);
+        g_assert(pkg->loadingflags & CR_PACKAGE_LOADED_OTH);
+        g_assert_cmpint(g_slist_length(pkg->files), ==, 2);
+        g_assert_cmpstr(((cr_PackageFile *) pkg->files->data)->name, ==, "super_kernel");
+        g_assert_cmpint(g_slist_length(pkg->changelogs), ==, 2);
+        g_assert_cmpstr(((cr_ChangelogEntry *) pkg->changelogs->data)->changelog, ==, "- First release");
+
+        cr_metadata_free(metadata);
+    }
+}
+
+
+static void test_cr_metadata_parallel_loading_filelists_error(void)
+{
+    int ret;
+    GError *err = NULL;
+    cr_Metadata *metadata;
+    struct cr_MetadataLocation ml;
+    gchar *tmp_dir, *filelists;
+    GLogLevelFlags fatal;
+
+    // The other.xml parsed in parallel is interrupted by the filelists.xml
+    // error, the filelists.xml error has to be reported
+
+    tmp_dir = g_strdup(TMPDIR_TEMPLATE);
+    g_assert(mkdtemp(tmp_dir));
+    filelists = g_build_filename(tmp_dir, "filelists.xml", NULL);
+    g_assert(g_file_set_contents(filelists,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<filelists xmlns=\"http://linux.duke.edu/metadata/filelists\" "
+        "packages=\"2\">\n"
+        "<package pkgid=\"6d43a638af70ef899933b1fd86a866f18f65b0e0e17dcbf2e42bfd0cdd7c63c3\" "
+        "name=\"super_kernel\" arch=\"x86_64\">\n"
+        "</broken>\n", -1, NULL));
+
+    memset(&ml, 0, sizeof(ml));
+    ml.pri_xml_href = TEST_REPO_02_PRIMARY;
+    ml.fil_xml_href = filelists;
+    ml.oth_xml_href = TEST_REPO_02_OTHER;
+    ml.original_url = TEST_REPO_02;
+    ml.local_path = TEST_REPO_02;
+
+    metadata = cr_metadata_new(CR_HT_KEY_NAME, 0, NULL);
+    g_assert(metadata);
+    cr_metadata_set_parallel_loading(metadata, TRUE);
+
+    // The failed loading is logged as critical
+    fatal = g_log_set_always_fatal(G_LOG_FATAL_MASK);
+    ret = cr_metadata_load_xml(metadata, &ml, &err);
+    g_log_set_always_fatal(fatal);
+
+    g_assert_cmpint(ret, !=, CRE_OK);
+    g_assert(err);
+    g_assert_cmpint(err->code, !=, CRE_CBINTERRUPTED);
+    g_assert(strstr(err->message, "filelists.xml parsing: "));
+    g_assert(!strstr(err->message, "other.xml"));
+    g_error_free(err);
+    cr_metadata_free(metadata);
+
+    cr_remove_dir(tmp_dir, NULL);
+    g_free(filelists);
+    g_free(tmp_dir);
+}
+
+
 #ifdef WITH_LIBMODULEMD
 static void test_cr_metadata_locate_and_load_modulemd(void)
 {
@@ -204,6 +388,10 @@ int main(int argc, char *argv[])
     g_test_add_func("/load_metadata/test_cr_metadata_new", test_cr_metadata_new);
     g_test_add_func("/load_metadata/test_cr_metadata_locate_and_load_xml", test_cr_metadata_locate_and_load_xml);
     g_test_add_func("/load_metadata/test_cr_metadata_locate_and_load_xml_detailed", test_cr_metadata_locate_and_load_xml_detailed);
+    g_test_add_func("/load_metadata/test_cr_metadata_keep_raw_xml", test_cr_metadata_keep_raw_xml);
+    g_test_add_func("/load_metadata/test_cr_metadata_lazy_loading", test_cr_metadata_lazy_loading);
+    g_test_add_func("/load_metadata/test_cr_metadata_parallel_loading", test_cr_metadata_parallel_loading);
+    g_test_add_func("/load_metadata/test_cr_metadata_parallel_loading_filelists_error", test_cr_metadata_parallel_loading_filelists_error);
 
 #ifdef WITH_LIBMODULEMD
     g_test_add_func("/load_metadata/test_cr_metadata_locate_and_load_modulemd", test_cr_metadata_locate_and_load_modulemd);
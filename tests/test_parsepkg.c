@@ -0,0 +1,154 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "fixtures.h"
+#include "createrepo/error.h"
+#include "createrepo/misc.h"
+#include "createrepo/package.h"
+#include "createrepo/parsepkg.h"
+
+#define PACKAGE_01              TEST_PACKAGES_PATH"super_kernel-6.0.1-2.x86_64.rpm"
+#define PACKAGE_01_SHA256       "6d43a638af70ef899933b1fd86a866f18f65b0e0e17dcbf2e42bfd0cdd7c63c3"
+#define PACKAGE_01_SIZE         2845
+#define PACKAGE_01_HEADER_START 280
+#define PACKAGE_01_HEADER_END   2637
+
+#define PACKAGE_SRC             TEST_PACKAGES_PATH"empty-0-0.src.rpm"
+#define PACKAGE_SRC_SHA256      "510d6d527e952188d0c93778bda58ccca35fbdde2d4cd0a80aee1e30f9f919af"
+#define PACKAGE_SRC_HEADER_END  1277
+
+static char *
+lookup_cb(cr_Package *pkg, void *cbdata)
+{
+    int *called = cbdata;
+    (*called)++;
+    g_assert_cmpstr(pkg->name, ==, "super_kernel");
+    g_assert_cmpint(pkg->size_package, ==, PACKAGE_01_SIZE);
+    return g_strdup("cachedchecksum");
+}
+
+static void
+test_cr_package_from_rpm_single_pass(void)
+{
+    cr_Package *pkg;
+    GError *tmp_err = NULL;
+
+    pkg = cr_package_from_rpm_single_pass(PACKAGE_01, CR_CHECKSUM_SHA256, 0,
+                                          NULL, CR_HDRR_NONE, NULL, NULL,
+                                          &tmp_err);
+    g_assert(pkg);
+    g_assert(!tmp_err);
+    g_assert_cmpstr(pkg->name, ==, "super_kernel");
+    g_assert_cmpstr(pkg->arch, ==, "x86_64");
+    g_assert_cmpstr(pkg->pkgId, ==, PACKAGE_01_SHA256);
+    g_assert_cmpstr(pkg->checksum_type, ==, "sha256");
+    g_assert_cmpint(pkg->size_package, ==, PACKAGE_01_SIZE);
+    g_assert_cmpint(pkg->rpm_header_start, ==, PACKAGE_01_HEADER_START);
+    g_assert_cmpint(pkg->rpm_header_end, ==, PACKAGE_01_HEADER_END);
+    g_assert(!pkg->location_href);
+    cr_package_free(pkg);
+
+    pkg = cr_package_from_rpm_single_pass(PACKAGE_SRC, CR_CHECKSUM_SHA256, 0,
+                                          NULL, CR_HDRR_LOADHDRID, NULL, NULL,
+                                          &tmp_err);
+    g_assert(pkg);
+    g_assert(!tmp_err);
+    g_assert_cmpstr(pkg->name, ==, "empty");
+    g_assert_cmpstr(pkg->arch, ==, "src");
+    g_assert_cmpstr(pkg->pkgId, ==, PACKAGE_SRC_SHA256);
+    g_assert_cmpint(pkg->rpm_header_end, ==, PACKAGE_SRC_HEADER_END);
+    g_assert(pkg->hdrid);
+    cr_package_free(pkg);
+
+    pkg = cr_package_from_rpm_single_pass(NON_EXIST_FILE, CR_CHECKSUM_SHA256,
+                                          0, NULL, CR_HDRR_NONE, NULL, NULL,
+                                          &tmp_err);
+    g_assert(!pkg);
+    g_assert(tmp_err);
+    g_error_free(tmp_err);
+    tmp_err = NULL;
+
+    pkg = cr_package_from_rpm_single_pass(TEST_TEXT_FILE, CR_CHECKSUM_SHA256,
+                                          0, NULL, CR_HDRR_NONE, NULL, NULL,
+                                          &tmp_err);
+    g_assert(!pkg);
+    g_assert(tmp_err);
+    g_error_free(tmp_err);
+    tmp_err = NULL;
+}
+
+static void
+test_cr_package_from_rpm_single_pass_lookup(void)
+{
+    cr_Package *pkg;
+    GError *tmp_err = NULL;
+    int called = 0;
+
+    pkg = cr_package_from_rpm_single_pass(PACKAGE_01, CR_CHECKSUM_SHA256, 0,
+                                          NULL, CR_HDRR_NONE, lookup_cb,
+                                          &called, &tmp_err);
+    g_assert(pkg);
+    g_assert(!tmp_err);
+    g_assert_cmpint(called, ==, 1);
+    g_assert_cmpstr(pkg->pkgId, ==, "cachedchecksum");
+    g_assert_cmpint(pkg->rpm_header_start, ==, PACKAGE_01_HEADER_START);
+    g_assert_cmpint(pkg->rpm_header_end, ==, PACKAGE_01_HEADER_END);
+    cr_package_free(pkg);
+}
+
+static void
+test_cr_package_from_rpm(void)
+{
+    cr_Package *pkg;
+    GError *tmp_err = NULL;
+
+    pkg = cr_package_from_rpm(PACKAGE_01, CR_CHECKSUM_SHA256,
+                              "super_kernel-6.0.1-2.x86_64.rpm", NULL, 10,
+                              NULL, CR_HDRR_NONE, &tmp_err);
+    g_assert(pkg);
+    g_assert(!tmp_err);
+    g_assert_cmpstr(pkg->pkgId, ==, PACKAGE_01_SHA256);
+    g_assert_cmpstr(pkg->location_href, ==, "super_kernel-6.0.1-2.x86_64.rpm");
+    g_assert(!pkg->location_base);
+    g_assert_cmpint(pkg->rpm_header_start, ==, PACKAGE_01_HEADER_START);
+    g_assert_cmpint(pkg->rpm_header_end, ==, PACKAGE_01_HEADER_END);
+    cr_package_free(pkg);
+}
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    cr_package_parser_init();
+
+    g_test_add_func("/parsepkg/test_cr_package_from_rpm_single_pass",
+            test_cr_package_from_rpm_single_pass);
+    g_test_add_func("/parsepkg/test_cr_package_from_rpm_single_pass_lookup",
+            test_cr_package_from_rpm_single_pass_lookup);
+    g_test_add_func("/parsepkg/test_cr_package_from_rpm",
+            test_cr_package_from_rpm);
+
+    int ret = g_test_run();
+    cr_package_parser_cleanup();
+    return ret;
+}
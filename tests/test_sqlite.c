@@ -37,6 +37,9 @@
 
 #define EMPTY_PKG               TEST_PACKAGES_PATH"empty-0-0.x86_64.rpm"
 #define EMPTY_PKG_SRC           TEST_PACKAGES_PATH"empty-0-0.src.rpm"
+#define ARCHER_PKG              TEST_PACKAGES_PATH"Archer-3.4.5-6.x86_64.rpm"
+#define FAKE_BASH_PKG           TEST_PACKAGES_PATH"fake_bash-1.1.1-1.x86_64.rpm"
+#define SUPER_KERNEL_PKG        TEST_PACKAGES_PATH"super_kernel-6.0.1-2.x86_64.rpm"
 
 
 typedef struct {
@@ -242,6 +245,127 @@ test_all(TestData *testdata,
 }
 
 
+static gchar *
+dump_db(const gchar *path)
+{
+    sqlite3 *db;
+    sqlite3_stmt *tables, *rows;
+    GString *dump = g_string_new(NULL);
+
+    g_assert_cmpint(sqlite3_open(path, &db), ==, SQLITE_OK);
+    g_assert_cmpint(sqlite3_prepare_v2(db,
+            "SELECT name FROM sqlite_master WHERE type = 'table' "
+            "AND name != 'db_info' ORDER BY name", -1, &tables, NULL),
+            ==, SQLITE_OK);
+
+    while (sqlite3_step(tables) == SQLITE_ROW) {
+        const char *table = (const char *) sqlite3_column_text(tables, 0);
+        gchar *query = g_strdup_printf("SELECT rowid, * FROM %s ORDER BY rowid",
+                                       table);
+        g_assert_cmpint(sqlite3_prepare_v2(db, query, -1, &rows, NULL),
+                        ==, SQLITE_OK);
+        g_free(query);
+
+        g_string_append_printf(dump, "%s:\n", table);
+        while (sqlite3_step(rows) == SQLITE_ROW) {
+            for (int i = 0; i < sqlite3_column_count(rows); i++)
+                g_string_append_printf(dump, "%s|",
+                        (const char *) sqlite3_column_text(rows, i));
+            g_string_append(dump, "\n");
+        }
+        sqlite3_finalize(rows);
+    }
+
+    sqlite3_finalize(tables);
+    sqlite3_close(db);
+    return g_string_free(dump, FALSE);
+}
+
+
+static void
+test_cr_db_merge_shards(TestData *testdata,
+                        G_GNUC_UNUSED gconstpointer test_data)
+{
+    GError *err = NULL;
+    const char *rpms[] = { ARCHER_PKG, EMPTY_PKG, FAKE_BASH_PKG,
+                           SUPER_KERNEL_PKG, EMPTY_PKG_SRC };
+    const int npkgs = G_N_ELEMENTS(rpms);
+    const int nshards = 2;
+    cr_Package *pkgs[G_N_ELEMENTS(rpms)];
+
+    cr_package_parser_init();
+    for (int i = 0; i < npkgs; i++) {
+        pkgs[i] = cr_package_from_rpm(rpms[i], CR_CHECKSUM_SHA256, rpms[i],
+                                      NULL, 5, NULL, CR_HDRR_NONE, NULL);
+        g_assert(pkgs[i]);
+    }
+    cr_package_parser_cleanup();
+
+    for (int type = CR_DB_PRIMARY; type < CR_DB_SENTINEL; type++) {
+        gchar *direct_path = g_strdup_printf("%s/direct_%d.sqlite",
+                                             testdata->tmp_dir, type);
+        gchar *merged_path = g_strdup_printf("%s/merged_%d.sqlite",
+                                             testdata->tmp_dir, type);
+        gchar *shard_paths[3] = { NULL, NULL, NULL };
+        cr_SqliteDb *shards[2];
+        cr_SqliteDb *db;
+
+        // Db with all the packages added directly
+
+        db = cr_db_open(direct_path, type, &err);
+        g_assert_no_error(err);
+        for (int i = 0; i < npkgs; i++) {
+            cr_db_add_pkg(db, pkgs[i], &err);
+            g_assert_no_error(err);
+        }
+        cr_db_close(db, &err);
+        g_assert_no_error(err);
+
+        // Db merged from shards
+
+        for (int i = 0; i < nshards; i++) {
+            shard_paths[i] = g_strdup_printf("%s.shard%d", merged_path, i);
+            shards[i] = cr_db_open_shard(shard_paths[i], type, &err);
+            g_assert_no_error(err);
+        }
+
+        for (int i = 0; i < npkgs; i++) {
+            cr_Package pkg = *(pkgs[i]);
+            pkg.pkgKey = i + 1;
+            cr_db_add_pkg(shards[pkg.pkgKey % nshards], &pkg, &err);
+            g_assert_no_error(err);
+        }
+
+        for (int i = 0; i < nshards; i++) {
+            cr_db_close(shards[i], &err);
+            g_assert_no_error(err);
+        }
+
+        db = cr_db_open(merged_path, type, &err);
+        g_assert_no_error(err);
+        cr_db_merge_shards(db, shard_paths, &err);
+        g_assert_no_error(err);
+        cr_db_close(db, &err);
+        g_assert_no_error(err);
+
+        // Both dbs must be the same
+
+        gchar *direct_dump = dump_db(direct_path);
+        gchar *merged_dump = dump_db(merged_path);
+        g_assert_cmpstr(merged_dump, ==, direct_dump);
+
+        g_free(direct_dump);
+        g_free(merged_dump);
+        for (int i = 0; i < nshards; i++)
+            g_free(shard_paths[i]);
+        g_free(direct_path);
+        g_free(merged_path);
+    }
+
+    for (int i = 0; i < npkgs; i++)
+        cr_package_free(pkgs[i]);
+}
+
 
 int
 main(int argc, char *argv[])
@@ -252,6 +376,7 @@ main(int argc, char *argv[])
     g_test_add("/sqlite/test_cr_db_add_primary_pkg", TestData, NULL, testdata_setup, test_cr_db_add_primary_pkg, testdata_teardown);
     g_test_add("/sqlite/test_cr_db_dbinfo_update", TestData, NULL, testdata_setup, test_cr_db_dbinfo_update, testdata_teardown);
     g_test_add("/sqlite/test_all", TestData, NULL, testdata_setup, test_all, testdata_teardown);
+    g_test_add("/sqlite/test_cr_db_merge_shards", TestData, NULL, testdata_setup, test_cr_db_merge_shards, testdata_teardown);
 
     return g_test_run();
 }
@@ -0,0 +1,193 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <libxml/tree.h>
+#include "fixtures.h"
+#include "createrepo/error.h"
+#include "createrepo/load_metadata.h"
+#include "createrepo/package.h"
+#include "createrepo/parsepkg.h"
+#include "createrepo/xml_dump.h"
+#include "createrepo/xml_dump_internal.h"
+
+typedef void (*DomItemsFunc)(xmlNodePtr root, cr_Package *package);
+
+// Serialize the package the way the dump functions used to do it
+// (libxml2 tree + xmlNodeDump)
+static char *
+dom_dump(DomItemsFunc items, cr_Package *pkg)
+{
+    xmlNodePtr root = xmlNewNode(NULL, BAD_CAST "package");
+    xmlBufferPtr buf = xmlBufferCreate();
+
+    items(root, pkg);
+    xmlNodeDump(buf, NULL, root, 0, 1);
+    char *result = g_strconcat((char *) buf->content, "\n", NULL);
+
+    xmlBufferFree(buf);
+    xmlFreeNode(root);
+    return result;
+}
+
+static void
+cmp_with_libxml2(cr_Package *pkg)
+{
+    char *stream, *dom;
+
+    stream = cr_xml_dump_primary(pkg, NULL);
+    dom = dom_dump(cr_xml_dump_primary_base_items, pkg);
+    g_assert_cmpstr(stream, ==, dom);
+    g_free(stream);
+    g_free(dom);
+
+    stream = cr_xml_dump_filelists(pkg, NULL);
+    dom = dom_dump(cr_xml_dump_filelists_items, pkg);
+    g_assert_cmpstr(stream, ==, dom);
+    g_free(stream);
+    g_free(dom);
+
+    stream = cr_xml_dump_other(pkg, NULL);
+    dom = dom_dump(cr_xml_dump_other_items, pkg);
+    g_assert_cmpstr(stream, ==, dom);
+    g_free(stream);
+    g_free(dom);
+}
+
+static void
+cmp_repo_with_libxml2(const char *repopath)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    cr_Metadata *md = cr_metadata_new(CR_HT_KEY_HASH, 0, NULL);
+
+    g_assert_cmpint(cr_metadata_locate_and_load_xml(md, repopath, NULL),
+                    ==, CRE_OK);
+    g_assert_cmpint(g_hash_table_size(cr_metadata_hashtable(md)), >, 0);
+
+    g_hash_table_iter_init(&iter, cr_metadata_hashtable(md));
+    while (g_hash_table_iter_next(&iter, &key, &value))
+        cmp_with_libxml2((cr_Package *) value);
+
+    cr_metadata_free(md);
+}
+
+static void
+test_cr_xml_dump_stream_test_repos(void)
+{
+    cmp_repo_with_libxml2(TEST_REPO_01);
+    cmp_repo_with_libxml2(TEST_REPO_02);
+    cmp_repo_with_libxml2(TEST_REPO_KOJI_01);
+    cmp_repo_with_libxml2(TEST_REPO_KOJI_02);
+}
+
+static void
+test_cr_xml_dump_stream_test_packages(void)
+{
+    GDir *dir;
+    const gchar *filename;
+
+    dir = g_dir_open(TEST_PACKAGES_PATH, 0, NULL);
+    g_assert(dir);
+
+    while ((filename = g_dir_read_name(dir))) {
+        if (!g_str_has_suffix(filename, ".rpm"))
+            continue;
+
+        gchar *path = g_build_filename(TEST_PACKAGES_PATH, filename, NULL);
+        cr_Package *pkg = cr_package_from_rpm(path, CR_CHECKSUM_SHA256,
+                                              filename, "/base/", 10,
+                                              NULL, CR_HDRR_NONE, NULL);
+        g_assert(pkg);
+        cmp_with_libxml2(pkg);
+        cr_package_free(pkg);
+        g_free(path);
+    }
+
+    g_dir_close(dir);
+}
+
+static void
+test_cr_xml_dump_stream_fixture_packages(void)
+{
+    cr_Package *pkg;
+
+    pkg = get_package();
+    cmp_with_libxml2(pkg);
+    cr_package_free(pkg);
+
+    pkg = get_empty_package();
+    cmp_with_libxml2(pkg);
+    cr_package_free(pkg);
+}
+
+static void
+test_cr_xml_dump_stream_escaping(void)
+{
+    cr_Package *pkg = get_package();
+    cr_ChangelogEntry *entry;
+
+    pkg->summary = "<tag> & \"quotes\" 'apos'\r\n\ttab";
+    pkg->description = "P\xc5\x99\xc3\xadli\xc5\xa1 \xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd k\xc5\xaf\xc5\x88";
+    pkg->url = "latin1 \xe9\xe8";
+    pkg->location_href = "dir/\xc5\xa1pa\"tn\xc3\xbd & <x>\t.rpm";
+    pkg->rpm_vendor = "\xf0\x9f\x98\x80 emoji";
+    pkg->epoch = "\xe9";
+
+    entry = cr_changelog_entry_new();
+    entry->author = "Tom\xc3\xa1\xc5\xa1 <tom@example.com>\n";
+    entry->date = 1234567890;
+    entry->changelog = "- fixed <&> \"bug\"\r\n- \xc4\x8d";
+    pkg->changelogs = g_slist_prepend(pkg->changelogs, entry);
+
+    entry = cr_changelog_entry_new();
+    entry->author = NULL;
+    entry->date = 0;
+    entry->changelog = NULL;
+    pkg->changelogs = g_slist_prepend(pkg->changelogs, entry);
+
+    cmp_with_libxml2(pkg);
+    cr_package_free(pkg);
+}
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    cr_xml_dump_init();
+    cr_package_parser_init();
+
+    g_test_add_func("/xml_dump_stream/test_cr_xml_dump_stream_test_repos",
+                    test_cr_xml_dump_stream_test_repos);
+    g_test_add_func("/xml_dump_stream/test_cr_xml_dump_stream_test_packages",
+                    test_cr_xml_dump_stream_test_packages);
+    g_test_add_func("/xml_dump_stream/test_cr_xml_dump_stream_fixture_packages",
+                    test_cr_xml_dump_stream_fixture_packages);
+    g_test_add_func("/xml_dump_stream/test_cr_xml_dump_stream_escaping",
+                    test_cr_xml_dump_stream_escaping);
+
+    int ret = g_test_run();
+
+    cr_package_parser_cleanup();
+    cr_xml_dump_cleanup();
+    return ret;
+}
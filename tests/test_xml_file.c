@@ -23,6 +23,7 @@
 #include <glib/gstdio.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include "fixtures.h"
 #include "createrepo/misc.h"
@@ -139,6 +140,62 @@ test_rewrite_header_pacakge_count(TestFixtures *fixtures,
     g_free(path);
 }
 
+static void
+test_rewrite_header_package_count_xz(TestFixtures *fixtures,
+                                     G_GNUC_UNUSED gconstpointer test_data)
+{
+    cr_XmlFile *f;
+    gchar *path;
+    gchar *header = NULL;
+    gchar contents[2048];
+    int ret;
+    ssize_t len;
+    GError *err = NULL;
+
+    path = g_build_filename(fixtures->tmpdir, "primary.xml.xz", NULL);
+    f = cr_xmlfile_open_primary(path, CR_CW_XZ_COMPRESSION, &err);
+    g_assert(f);
+    g_assert(err == NULL);
+    cr_xmlfile_set_num_of_pkgs(f, 12, &err);
+    g_assert(err == NULL);
+    cr_xmlfile_add_chunk(f, "<package/>\n", &err);
+    g_assert(err == NULL);
+    cr_xmlfile_close(f, &err);
+    g_assert(err == NULL);
+
+    // The header is a separate xz block
+    len = cr_get_first_chunk(path, CR_CW_XZ_COMPRESSION, 1024, &header, &err);
+    g_assert(!err);
+    g_assert_cmpint(len, ==, strlen(header));
+    g_assert(g_str_has_suffix(header, "packages=\"12\">\n"));
+    g_free(header);
+
+    cr_ContentStat *stat;
+    stat = cr_contentstat_new(CR_CHECKSUM_SHA256, &err);
+    cr_rewrite_header_package_count(path, CR_CW_XZ_COMPRESSION, 1, 12,
+                                    stat, NULL, &err);
+    g_assert(!err);
+    g_assert(stat->checksum);
+
+    CR_FILE *crf = cr_open(path,
+                           CR_CW_MODE_READ,
+                           CR_CW_AUTO_DETECT_COMPRESSION,
+                           NULL);
+    g_assert(crf);
+    ret = cr_read(crf, &contents, 2047, NULL);
+    g_assert(ret != CR_CW_ERR);
+    contents[ret] = '\0';
+    cr_close(crf, NULL);
+    g_assert_cmpint(stat->size, ==, ret);
+    g_assert_cmpstr(contents, ==, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<metadata xmlns=\"http://linux.duke.edu/metadata/common\" "
+            "xmlns:rpm=\"http://linux.duke.edu/metadata/rpm\" "
+            "packages=\"1\">\n<package/>\n</metadata>");
+
+    cr_contentstat_free(stat, &err);
+    g_free(path);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -147,6 +204,8 @@ main(int argc, char *argv[])
     g_test_add("/xml_file/test_no_packages", TestFixtures, NULL, fixtures_setup, test_no_packages, fixtures_teardown);
     g_test_add("/xml_file/test_write_modified_header", TestFixtures, NULL,
             fixtures_setup, test_rewrite_header_pacakge_count, fixtures_teardown);
+    g_test_add("/xml_file/test_rewrite_header_package_count_xz", TestFixtures, NULL,
+            fixtures_setup, test_rewrite_header_package_count_xz, fixtures_teardown);
 
     return g_test_run();
 }
@@ -0,0 +1,267 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2026  agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "fixtures.h"
+#include "createrepo/error.h"
+#include "createrepo/xml_dump.h"
+#include "createrepo/zck_dict.h"
+
+
+static void
+test_cr_zck_dict_filename(void)
+{
+    g_assert_cmpstr(cr_zck_dict_filename(CR_ZCK_DICT_PRIMARY), ==,
+                    "primary.xml.zdict");
+    g_assert_cmpstr(cr_zck_dict_filename(CR_ZCK_DICT_FILELISTS), ==,
+                    "filelists.xml.zdict");
+    g_assert_cmpstr(cr_zck_dict_filename(CR_ZCK_DICT_OTHER), ==,
+                    "other.xml.zdict");
+    g_assert(!cr_zck_dict_filename(CR_ZCK_DICT_SENTINEL));
+}
+
+static void
+test_cr_zck_dict_samples_add_repo(void)
+{
+    int ret;
+    GError *tmp_err = NULL;
+    cr_ZckDictSamples *samples = cr_zck_dict_samples_new();
+
+    for (int type = 0; type < CR_ZCK_DICT_SENTINEL; type++)
+        g_assert_cmpint(cr_zck_dict_samples_count(samples, type), ==, 0);
+
+    // One package
+    ret = cr_zck_dict_samples_add_repo(samples, TEST_REPO_01, &tmp_err);
+    g_assert(!tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    for (int type = 0; type < CR_ZCK_DICT_SENTINEL; type++)
+        g_assert_cmpint(cr_zck_dict_samples_count(samples, type), ==, 1);
+
+    // Two packages from different srpms
+    ret = cr_zck_dict_samples_add_repo(samples, TEST_REPO_02, &tmp_err);
+    g_assert(!tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    for (int type = 0; type < CR_ZCK_DICT_SENTINEL; type++)
+        g_assert_cmpint(cr_zck_dict_samples_count(samples, type), ==, 3);
+
+    cr_zck_dict_samples_free(samples);
+}
+
+static void
+test_cr_zck_dict_samples_add_repo_nonexistent(void)
+{
+    int ret;
+    GError *tmp_err = NULL;
+    cr_ZckDictSamples *samples = cr_zck_dict_samples_new();
+
+    ret = cr_zck_dict_samples_add_repo(samples, TEST_DATA_PATH"nonexistent",
+                                       &tmp_err);
+    g_assert(tmp_err);
+    g_assert_cmpint(ret, !=, CRE_OK);
+    g_error_free(tmp_err);
+
+    for (int type = 0; type < CR_ZCK_DICT_SENTINEL; type++)
+        g_assert_cmpint(cr_zck_dict_samples_count(samples, type), ==, 0);
+
+    cr_zck_dict_samples_free(samples);
+}
+
+static void
+test_cr_zck_dict_samples_split(void)
+{
+    int ret;
+    GError *tmp_err = NULL;
+    cr_ZckDictSamples *samples = cr_zck_dict_samples_new();
+    cr_ZckDictSamples *held_out;
+
+    // Three chunks of every type
+    ret = cr_zck_dict_samples_add_repo(samples, TEST_REPO_01, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    ret = cr_zck_dict_samples_add_repo(samples, TEST_REPO_02, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+
+    held_out = cr_zck_dict_samples_split(samples);
+    for (int type = 0; type < CR_ZCK_DICT_SENTINEL; type++) {
+        g_assert_cmpint(cr_zck_dict_samples_count(samples, type), ==, 2);
+        g_assert_cmpint(cr_zck_dict_samples_count(held_out, type), ==, 1);
+    }
+
+    cr_zck_dict_samples_free(held_out);
+    cr_zck_dict_samples_free(samples);
+}
+
+#ifdef WITH_ZSTD
+static void
+test_cr_zck_dict_evaluate(void)
+{
+    int ret;
+    GError *tmp_err = NULL;
+    cr_ZckDictStats stats;
+    cr_ZckDictSamples *samples = cr_zck_dict_samples_new();
+    cr_ZckDictSamples *old_samples = cr_zck_dict_samples_new();
+
+    ret = cr_zck_dict_samples_add_repo(samples, TEST_REPO_02, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+
+    // Without old samples all chunks are downloaded
+    ret = cr_zck_dict_evaluate(samples, NULL, CR_ZCK_DICT_PRIMARY, NULL, 0,
+                               &stats, &tmp_err);
+    g_assert(!tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert_cmpint(stats.chunks, ==, 2);
+    g_assert_cmpint(stats.size, >, 0);
+    g_assert_cmpint(stats.compressed_size, >, 0);
+    g_assert_cmpint(stats.dict_compressed_size, ==, stats.compressed_size);
+    g_assert_cmpint(stats.changed_chunks, ==, 2);
+    g_assert_cmpint(stats.changed_compressed_size, ==, stats.compressed_size);
+
+    // Nothing changed
+    ret = cr_zck_dict_samples_add_repo(old_samples, TEST_REPO_02, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    ret = cr_zck_dict_evaluate(samples, old_samples, CR_ZCK_DICT_OTHER,
+                               NULL, 0, &stats, &tmp_err);
+    g_assert(!tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert_cmpint(stats.chunks, ==, 2);
+    g_assert_cmpint(stats.changed_chunks, ==, 0);
+    g_assert_cmpint(stats.changed_compressed_size, ==, 0);
+
+    cr_zck_dict_samples_free(old_samples);
+    cr_zck_dict_samples_free(samples);
+}
+
+static void
+test_cr_zck_dict_train(void)
+{
+    int ret;
+    GError *tmp_err = NULL;
+    cr_ZckDictSamples *samples = cr_zck_dict_samples_new();
+    cr_ZckDictSamples *held_out;
+
+    // Dictionary training needs more than a few samples
+    for (int i = 0; i < 20; i++) {
+        ret = cr_zck_dict_samples_add_repo(samples, TEST_REPO_01, &tmp_err);
+        g_assert_cmpint(ret, ==, CRE_OK);
+        ret = cr_zck_dict_samples_add_repo(samples, TEST_REPO_02, &tmp_err);
+        g_assert_cmpint(ret, ==, CRE_OK);
+    }
+
+    // Evaluate on the chunks which are not used for the training
+    held_out = cr_zck_dict_samples_split(samples);
+
+    for (int type = 0; type < CR_ZCK_DICT_SENTINEL; type++) {
+        size_t len = 0;
+        cr_ZckDictStats stats;
+        char *dict;
+
+        dict = cr_zck_dict_train(samples, type, 1024,
+                                 CR_ZCK_DICT_DEFAULT_MAX_SAMPLES,
+                                 &len, &tmp_err);
+        g_assert(!tmp_err);
+        g_assert(dict);
+        g_assert_cmpint(len, >, 0);
+        g_assert_cmpint(len, <=, 1024);
+
+        ret = cr_zck_dict_evaluate(held_out, NULL, type, dict, len,
+                                   &stats, &tmp_err);
+        g_assert(!tmp_err);
+        g_assert_cmpint(ret, ==, CRE_OK);
+        g_assert_cmpint(stats.chunks, ==, 30);
+        g_assert_cmpint(stats.dict_compressed_size, <, stats.compressed_size);
+        g_free(dict);
+    }
+
+    cr_zck_dict_samples_free(held_out);
+    cr_zck_dict_samples_free(samples);
+}
+
+static void
+test_cr_zck_dict_train_too_small_max_samples(void)
+{
+    int ret;
+    size_t len = 0;
+    GError *tmp_err = NULL;
+    cr_ZckDictSamples *samples = cr_zck_dict_samples_new();
+    char *dict;
+
+    ret = cr_zck_dict_samples_add_repo(samples, TEST_REPO_02, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+
+    // No chunk fits into the samples
+    dict = cr_zck_dict_train(samples, CR_ZCK_DICT_PRIMARY, 1, 1,
+                             &len, &tmp_err);
+    g_assert(!dict);
+    g_assert(tmp_err);
+    g_error_free(tmp_err);
+
+    cr_zck_dict_samples_free(samples);
+}
+
+static void
+test_cr_zck_dict_train_no_samples(void)
+{
+    size_t len = 0;
+    GError *tmp_err = NULL;
+    cr_ZckDictSamples *samples = cr_zck_dict_samples_new();
+    char *dict;
+
+    dict = cr_zck_dict_train(samples, CR_ZCK_DICT_PRIMARY, 1024,
+                             CR_ZCK_DICT_DEFAULT_MAX_SAMPLES, &len, &tmp_err);
+    g_assert(!dict);
+    g_assert(tmp_err);
+    g_error_free(tmp_err);
+
+    cr_zck_dict_samples_free(samples);
+}
+#endif  // WITH_ZSTD
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    cr_xml_dump_init();
+
+    g_test_add_func("/zck_dict/test_cr_zck_dict_filename",
+                    test_cr_zck_dict_filename);
+    g_test_add_func("/zck_dict/test_cr_zck_dict_samples_add_repo",
+                    test_cr_zck_dict_samples_add_repo);
+    g_test_add_func("/zck_dict/test_cr_zck_dict_samples_add_repo_nonexistent",
+                    test_cr_zck_dict_samples_add_repo_nonexistent);
+    g_test_add_func("/zck_dict/test_cr_zck_dict_samples_split",
+                    test_cr_zck_dict_samples_split);
+#ifdef WITH_ZSTD
+    g_test_add_func("/zck_dict/test_cr_zck_dict_evaluate",
+                    test_cr_zck_dict_evaluate);
+    g_test_add_func("/zck_dict/test_cr_zck_dict_train",
+                    test_cr_zck_dict_train);
+    g_test_add_func("/zck_dict/test_cr_zck_dict_train_no_samples",
+                    test_cr_zck_dict_train_no_samples);
+    g_test_add_func("/zck_dict/test_cr_zck_dict_train_too_small_max_samples",
+                    test_cr_zck_dict_train_too_small_max_samples);
+#endif  // WITH_ZSTD
+
+    int ret = g_test_run();
+
+    cr_xml_dump_cleanup();
+
+    return ret;
+}
@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+"""
+Compare the compression types on repository metadata.
+
+The metadata files (compressed or not) are decompressed, concatenated
+and repeated until they reach the requested size. Then the data are
+compressed and decompressed by every available compression type.
+
+E.g:
+    PYTHONPATH=`readlink -f ./build/src/python/` \\
+        utils/benchmark_compression.py tests/testdata/repo_01/repodata/*.xml.gz
+"""
+
+import os
+import sys
+import time
+import shutil
+import argparse
+import tempfile
+import createrepo_c as cr
+
+DEFAULT_SIZE = 8  # MB
+
+
+def prepare_data(paths, size, tmpdir):
+    """Create a file with at least size bytes of the metadata"""
+    metadata = b""
+    for path in paths:
+        dst = os.path.join(tmpdir, "part.xml")
+        cr.decompress_file(path, dst, cr.AUTO_DETECT_COMPRESSION)
+        with open(dst, "rb") as f:
+            metadata += f.read()
+        os.remove(dst)
+
+    if not metadata:
+        return None
+
+    src = os.path.join(tmpdir, "metadata.xml")
+    with open(src, "wb") as f:
+        f.write(metadata * (size // len(metadata) + 1))
+    return src
+
+
+def benchmark(src, codec):
+    size = os.path.getsize(src)
+    suffix = cr.compression_suffix(codec)
+    compressed = src + suffix
+    decompressed = src + suffix + ".out"
+
+    start = time.time()
+    cr.compress_file(src, compressed, codec)
+    comp_time = time.time() - start
+
+    start = time.time()
+    cr.decompress_file(compressed, decompressed, codec)
+    decomp_time = time.time() - start
+
+    if os.path.getsize(decompressed) != size:
+        print("%s: decompressed data differ from the original" % suffix[1:])
+    else:
+        print("%-4s: ratio %5.2f, compression %6.1f MB/s, "
+              "decompression %6.1f MB/s" % (
+                  suffix[1:], float(size) / os.path.getsize(compressed),
+                  size / max(comp_time, 1e-6) / 1e6,
+                  size / max(decomp_time, 1e-6) / 1e6))
+
+    os.remove(compressed)
+    os.remove(decompressed)
+
+
+if __name__ == "__main__":
+
+    parser = argparse.ArgumentParser(description='Compare speed and ratio '\
+            'of the compression types on repository metadata')
+
+    parser.add_argument('paths', metavar='METADATA', type=str, nargs='+',
+                        help='Metadata files (e.g. primary.xml.gz)')
+    parser.add_argument('--size', type=int, default=DEFAULT_SIZE,
+                        help='Size of the benchmarked data in MB '\
+                             '(default %d)' % DEFAULT_SIZE)
+    args = parser.parse_args()
+
+    codecs = [cr.GZ, cr.BZ2, cr.XZ]
+    if cr.HAS_ZSTD:
+        codecs.append(cr.ZSTD)
+
+    tmpdir = tempfile.mkdtemp(prefix="createrepo_cbenchmark-")
+    try:
+        src = prepare_data(args.paths, args.size * 1024 * 1024, tmpdir)
+        if not src:
+            print("No metadata to benchmark")
+            sys.exit(1)
+        for codec in codecs:
+            benchmark(src, codec)
+    finally:
+        shutil.rmtree(tmpdir, True)
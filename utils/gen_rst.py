@@ -140,10 +140,11 @@ def parse_arguments_from_c_file(filename):
 
 
 if __name__ == "__main__":
-    parser = OptionParser('usage: %prog [options] <filename> [--mergerepo|--modifyrepo|--sqliterepo]')
+    parser = OptionParser('usage: %prog [options] <filename> [--mergerepo|--modifyrepo|--sqliterepo|--zckdict]')
     parser.add_option('-m', '--mergerepo', action="store_true", help="Gen rst for mergerepo")
     parser.add_option('-r', '--modifyrepo', action="store_true", help="Gen rst for modifyrepo")
     parser.add_option('-s', '--sqliterepo', action="store_true", help="Gen rst for sqliterepo")
+    parser.add_option('-z', '--zckdict', action="store_true", help="Gen rst for zckdict")
     options, args = parser.parse_args()
 
     if len(args) < 1:
@@ -172,6 +173,12 @@ if __name__ == "__main__":
                 summary="Generate sqlite db files for a repository in rpm-md format",
                 synopsis=["%s [options] <repo_directory>" % (NAME,) ],
                 options=args)
+    elif options.zckdict:
+        NAME = "zckdict_c"
+        info = Info(NAME,
+                summary="Train zchunk dictionaries from repositories in rpm-md format",
+                synopsis=["%s [options] <repo> [<repo>...]" % (NAME,) ],
+                options=args)
     else:
         NAME = "createrepo_c"
         info = Info(NAME,